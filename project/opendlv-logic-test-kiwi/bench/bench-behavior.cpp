@@ -0,0 +1,231 @@
+/*
+ * Copyright (C) 2018 Ola Benderius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include "cluon-complete.hpp"
+#include "opendlv-standard-message-set.hpp"
+#include "behavior.hpp"
+#include "message-bus.hpp"
+#include "reactor.hpp"
+#include "bench.hpp"
+
+namespace {
+
+// The parameters of the default Kiwi configuration, in step() order.
+void stepBehavior(Behavior &behavior)
+{
+  behavior.step(0.12f, 0.3f, 0.2f, 0.25f, 0.2f, 1.0f, 0.25f, 0.3f, 0.1f, -0.15f, 10.0f, 1.5f,
+      0.2f, 0.35f, 0.3f, 1.0f, 0.1f);
+}
+
+void setSensors(Behavior &behavior, float front, float rear, float leftVoltage, float rightVoltage)
+{
+  opendlv::proxy::DistanceReading distance;
+  distance.distance(front);
+  behavior.setFrontUltrasonic(distance);
+  distance.distance(rear);
+  behavior.setRearUltrasonic(distance);
+  opendlv::proxy::VoltageReading voltage;
+  voltage.voltage(leftVoltage);
+  behavior.setLeftIr(voltage);
+  voltage.voltage(rightVoltage);
+  behavior.setRightIr(voltage);
+}
+
+template <typename T>
+void encode(BenchmarkState &state, T message)
+{
+  std::size_t bytes{0};
+  while (state.keepRunning()) {
+    cluon::ToProtoVisitor encoder;
+    message.accept(encoder);
+    bytes += encoder.encodedData().size();
+  }
+  doNotOptimize(bytes);
+  state.setItemsProcessed(state.iterations());
+}
+
+template <typename T>
+void decode(BenchmarkState &state, T message)
+{
+  cluon::ToProtoVisitor encoder;
+  message.accept(encoder);
+  std::string const payload{encoder.encodedData()};
+  while (state.keepRunning()) {
+    std::stringstream sstr{payload};
+    cluon::FromProtoVisitor decoder;
+    decoder.decodeFrom(sstr);
+    T decoded;
+    decoded.accept(decoder);
+    doNotOptimize(decoded);
+  }
+  state.setItemsProcessed(state.iterations());
+}
+
+// Sends a GroundSteeringRequest and waits for the PedalPositionRequest the
+// echoing peer answers with, over multicast loopback.
+template <typename Session>
+void roundTrip(BenchmarkState &state, Session &client, std::atomic<uint64_t> &answered)
+{
+  opendlv::proxy::GroundSteeringRequest request;
+  request.groundSteering(0.1f);
+  uint64_t lost{0};
+  while (state.keepRunning()) {
+    uint64_t const expected{answered.load() + 1};
+    client.send(request);
+    auto const deadline = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+    while (answered.load() < expected) {
+      if (std::chrono::steady_clock::now() > deadline) {
+        lost++;
+        break;
+      }
+      std::this_thread::yield();
+    }
+  }
+  state.setItemsProcessed(state.iterations());
+  state.setCounter("lost", static_cast<double>(lost));
+}
+
+}
+
+BENCHMARK_CASE("Behavior/step driving forward")
+{
+  Behavior behavior;
+  setSensors(behavior, 1.0f, 1.0f, 0.2f, 0.2f);
+  while (state.keepRunning()) {
+    stepBehavior(behavior);
+  }
+  doNotOptimize(behavior.getPedalPositionRequest().position());
+  state.setItemsProcessed(state.iterations());
+}
+
+BENCHMARK_CASE("Behavior/step alternating wall and free corridor")
+{
+  Behavior behavior;
+  uint64_t i{0};
+  while (state.keepRunning()) {
+    bool const wall{0 == (i++ / 16) % 2};
+    setSensors(behavior, wall ? 0.1f : 1.0f, 1.0f, wall ? 1.2f : 0.2f, 0.2f);
+    stepBehavior(behavior);
+  }
+  doNotOptimize(behavior.getPedalPositionRequest().position());
+  state.setItemsProcessed(state.iterations());
+}
+
+// convertIrVoltageToDistance is private; getLeftIr() is that conversion
+// behind one uncontended lock.
+BENCHMARK_CASE("Behavior/convertIrVoltageToDistance via getLeftIr")
+{
+  Behavior behavior;
+  setSensors(behavior, 1.0f, 1.0f, 0.4f, 0.4f);
+  double sum{0.0};
+  while (state.keepRunning()) {
+    sum += behavior.getLeftIr();
+  }
+  doNotOptimize(sum);
+  state.setItemsProcessed(state.iterations());
+}
+
+BENCHMARK_CASE("Proto/encode DistanceReading")
+{
+  opendlv::proxy::DistanceReading message;
+  message.distance(0.42f);
+  encode(state, message);
+}
+
+BENCHMARK_CASE("Proto/decode DistanceReading")
+{
+  opendlv::proxy::DistanceReading message;
+  message.distance(0.42f);
+  decode(state, message);
+}
+
+BENCHMARK_CASE("Proto/encode VoltageReading")
+{
+  opendlv::proxy::VoltageReading message;
+  message.voltage(0.61f);
+  encode(state, message);
+}
+
+BENCHMARK_CASE("Proto/decode VoltageReading")
+{
+  opendlv::proxy::VoltageReading message;
+  message.voltage(0.61f);
+  decode(state, message);
+}
+
+BENCHMARK_CASE("Proto/encode GroundSteeringRequest")
+{
+  opendlv::proxy::GroundSteeringRequest message;
+  message.groundSteering(-0.25f);
+  encode(state, message);
+}
+
+BENCHMARK_CASE("Proto/decode GroundSteeringRequest")
+{
+  opendlv::proxy::GroundSteeringRequest message;
+  message.groundSteering(-0.25f);
+  decode(state, message);
+}
+
+BENCHMARK_CASE("Proto/encode PedalPositionRequest")
+{
+  opendlv::proxy::PedalPositionRequest message;
+  message.position(0.12f);
+  encode(state, message);
+}
+
+BENCHMARK_CASE("Proto/decode PedalPositionRequest")
+{
+  opendlv::proxy::PedalPositionRequest message;
+  message.position(0.12f);
+  decode(state, message);
+}
+
+BENCHMARK_CASE("Loopback/OD4Session round trip")
+{
+  std::atomic<uint64_t> answered{0};
+  cluon::OD4Session client{231};
+  client.dataTrigger(opendlv::proxy::PedalPositionRequest::ID(), [&answered](cluon::data::Envelope &&) { answered++; });
+  cluon::OD4Session echo{231};
+  echo.dataTrigger(opendlv::proxy::GroundSteeringRequest::ID(), [&echo](cluon::data::Envelope &&) {
+      opendlv::proxy::PedalPositionRequest answer;
+      answer.position(0.1f);
+      echo.send(answer);
+    });
+  roundTrip(state, client, answered);
+}
+
+BENCHMARK_CASE("Loopback/MessageBus round trip")
+{
+  std::atomic<uint64_t> answered{0};
+  Reactor reactor{1};
+  MessageBus client{232, reactor};
+  client.dataTrigger(opendlv::proxy::PedalPositionRequest::ID(), [&answered](cluon::data::Envelope &&) { answered++; });
+  MessageBus echo{232, reactor};
+  echo.dataTrigger(opendlv::proxy::GroundSteeringRequest::ID(), [&echo](cluon::data::Envelope &&) {
+      opendlv::proxy::PedalPositionRequest answer;
+      answer.position(0.1f);
+      echo.send(answer);
+    });
+  roundTrip(state, client, answered);
+}
@@ -0,0 +1,55 @@
+/*
+ * Copyright (C) 2018 Ola Benderius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "centering-controller.hpp"
+#include "bench.hpp"
+
+// One tick on side distances swinging around the middle of the corridor,
+// at pedal positions all over the schedule. Items are ticks.
+BENCHMARK_CASE("CenteringController/update")
+{
+  CenteringController controller;
+  CenteringController::Config config;
+  config.ki = 0.005f;
+  config.kd = 0.005f;
+  controller.setConfig(config);
+  uint64_t const allocations{allocationCount()};
+  uint32_t i{0};
+  float sum{0.0f};
+  while (state.keepRunning()) {
+    float const offset{static_cast<float>(i % 21) - 10.0f};
+    float const speed{static_cast<float>(i % 17) / 16.0f};
+    sum += controller.update(40.0f - offset, 40.0f + offset, speed, 0.1f);
+    i++;
+  }
+  doNotOptimize(sum);
+  state.setCounter("allocs/op", static_cast<double>(allocationCount() - allocations) / static_cast<double>(state.iterations()));
+  state.setItemsProcessed(state.iterations());
+}
+
+// Rebuilding the schedule after a parameter change.
+BENCHMARK_CASE("CenteringController/setConfig")
+{
+  CenteringController controller;
+  CenteringController::Config config;
+  uint32_t i{0};
+  while (state.keepRunning()) {
+    config.kp = 0.01f + static_cast<float>(i++ & 1) * 0.001f;
+    doNotOptimize(controller.setConfig(config));
+  }
+  state.setItemsProcessed(state.iterations());
+}
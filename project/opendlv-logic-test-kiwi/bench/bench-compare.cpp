@@ -0,0 +1,85 @@
+/*
+ * Copyright (C) 2018 Ola Benderius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#include "cluon-complete.hpp"
+#include "benchmark-comparison.hpp"
+
+namespace {
+
+std::vector<std::string> splitGates(std::string const &list)
+{
+  std::vector<std::string> gates;
+  std::stringstream sstr{list};
+  std::string gate;
+  while (std::getline(sstr, gate, ',')) {
+    if (!gate.empty()) {
+      gates.push_back(gate);
+    }
+  }
+  return gates;
+}
+
+bool read(std::string const &path, BenchmarkResults &results)
+{
+  std::ifstream file{path};
+  std::string error;
+  if (!file.good()) {
+    error = "cannot open file";
+  } else if (readBenchmarkResults(file, results, error)) {
+    return true;
+  }
+  std::cerr << "[bench-compare]: " << path << ": " << error << std::endl;
+  return false;
+}
+
+}
+
+int32_t main(int32_t argc, char **argv) {
+  int32_t retCode{0};
+  auto commandlineArguments = cluon::getCommandlineArguments(argc, argv);
+  if (0 == commandlineArguments.count("baseline") || 0 == commandlineArguments.count("contender")) {
+    std::cerr << argv[0] << " compares two benchmark result files and fails if a gated benchmark got significantly slower." << std::endl;
+    std::cerr << "Usage:   " << argv[0] << " --baseline=<JSON file> --contender=<JSON file> [--threshold=<relative, default 0.05>] [--alpha=<significance, default 0.05>] [--gates=<comma separated name parts, default Behavior/step,SingleTrackModel/step,Proto/>]" << std::endl;
+    std::cerr << "Example: " << argv[0] << " --baseline=v0.0.65.json --contender=v0.0.74.json" << std::endl;
+    retCode = 1;
+  } else {
+    ComparisonCriteria criteria;
+    if (0 != commandlineArguments.count("threshold")) {
+      criteria.threshold = std::stod(commandlineArguments["threshold"]);
+    }
+    if (0 != commandlineArguments.count("alpha")) {
+      criteria.alpha = std::stod(commandlineArguments["alpha"]);
+    }
+    criteria.gates = splitGates((0 != commandlineArguments.count("gates")) ? commandlineArguments["gates"] : "Behavior/step,SingleTrackModel/step,Proto/");
+
+    BenchmarkResults baseline;
+    BenchmarkResults contender;
+    if (!read(commandlineArguments["baseline"], baseline) || !read(commandlineArguments["contender"], contender)) {
+      retCode = 1;
+    } else {
+      auto const comparisons = compareBenchmarks(baseline, contender, criteria);
+      if (0 < writeComparisonReport(std::cout, baseline, contender, comparisons, criteria)) {
+        retCode = 1;
+      }
+    }
+  }
+  return retCode;
+}
@@ -0,0 +1,63 @@
+/*
+ * Copyright (C) 2018 Ola Benderius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <vector>
+
+#include "drive-state-machine.hpp"
+#include "bench.hpp"
+
+namespace {
+
+// Steps many independent machines per iteration, as a bulk simulation
+// would; the front is blocked in a fixed pattern so all modes and
+// transitions are visited. Items are machine steps.
+void simulate(BenchmarkState &state, uint32_t machines)
+{
+  std::vector<DriveStateMachine> fleet(machines);
+  std::vector<float> steering(machines, 0.05f);
+  DriveStateMachine::Parameters parameters;
+  parameters.reverseTimeThreshold = 0.5f;
+  parameters.forwardTimeAfterReverseLimit = 0.5f;
+  uint32_t tick{0};
+  uint32_t reversing{0};
+  while (state.keepRunning()) {
+    for (uint32_t i{0}; i < machines; i++) {
+      bool const blocked{0 == ((tick + i) & 31)};
+      reversing += fleet[i].step(blocked, false, 0.3f, 0.2f, 0.1f, parameters, steering[i]) ? 1 : 0;
+    }
+    tick++;
+  }
+  doNotOptimize(reversing);
+  uint64_t transitions{0};
+  for (auto const &machine : fleet) {
+    transitions += machine.transitionCount();
+  }
+  state.setItemsProcessed(state.iterations() * machines);
+  state.setCounter("transitions/step", static_cast<double>(transitions) / static_cast<double>(state.iterations() * machines));
+}
+
+}
+
+BENCHMARK_CASE("DriveStateMachine/step/machines:1")
+{
+  simulate(state, 1);
+}
+
+BENCHMARK_CASE("DriveStateMachine/step/machines:1024")
+{
+  simulate(state, 1024);
+}
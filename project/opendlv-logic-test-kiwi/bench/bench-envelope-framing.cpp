@@ -0,0 +1,105 @@
+/*
+ * Copyright (C) 2018 Ola Benderius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string>
+#include <utility>
+
+#include "cluon-complete.hpp"
+#include "opendlv-standard-message-set.hpp"
+#include "envelope-framing.hpp"
+#include "bench.hpp"
+
+namespace {
+
+// The path OD4Session::send takes: encode the payload, fill an Envelope
+// and let serializeEnvelope frame it.
+std::string serializeLikeOd4Session(opendlv::proxy::GroundSteeringRequest &message, cluon::data::TimeStamp const &sampleTimeStamp, uint32_t senderStamp)
+{
+  cluon::ToProtoVisitor protoEncoder;
+  message.accept(protoEncoder);
+
+  cluon::data::Envelope envelope;
+  envelope.dataType(static_cast<int32_t>(message.ID()));
+  envelope.serializedData(protoEncoder.encodedData());
+  envelope.sent(cluon::time::now());
+  envelope.sampleTimeStamp((0 == (sampleTimeStamp.seconds() + sampleTimeStamp.microseconds())) ? envelope.sent() : sampleTimeStamp);
+  envelope.senderStamp(senderStamp);
+  return cluon::serializeEnvelope(std::move(envelope));
+}
+
+}
+
+BENCHMARK_CASE("EnvelopeFraming/serializeEnvelope GroundSteeringRequest")
+{
+  opendlv::proxy::GroundSteeringRequest request;
+  request.groundSteering(0.25f);
+  cluon::data::TimeStamp sampleTimeStamp{cluon::time::now()};
+
+  uint64_t bytes{0};
+  uint64_t const allocationsBefore{allocationCount()};
+  while (state.keepRunning()) {
+    std::string frame{serializeLikeOd4Session(request, sampleTimeStamp, 0)};
+    bytes += frame.size();
+  }
+  doNotOptimize(bytes);
+  state.setItemsProcessed(state.iterations());
+  state.setCounter("allocs/op", static_cast<double>(allocationCount() - allocationsBefore) / static_cast<double>(state.iterations()));
+}
+
+BENCHMARK_CASE("EnvelopeFraming/appendFrame GroundSteeringRequest")
+{
+  opendlv::proxy::GroundSteeringRequest request;
+  request.groundSteering(0.25f);
+  cluon::data::TimeStamp sampleTimeStamp{cluon::time::now()};
+
+  uint64_t bytes{0};
+  uint64_t const allocationsBefore{allocationCount()};
+  while (state.keepRunning()) {
+    std::string &frame = threadLocalFrameBuffer();
+    frame.clear();
+    appendFrame(frame, request, sampleTimeStamp, 0);
+    bytes += frame.size();
+  }
+  doNotOptimize(bytes);
+  state.setItemsProcessed(state.iterations());
+  state.setCounter("allocs/op", static_cast<double>(allocationCount() - allocationsBefore) / static_cast<double>(state.iterations()));
+}
+
+BENCHMARK_CASE("EnvelopeFraming/appendEnvelope pre-built Envelope")
+{
+  opendlv::proxy::GroundSteeringRequest request;
+  request.groundSteering(0.25f);
+  cluon::ToProtoVisitor protoEncoder;
+  request.accept(protoEncoder);
+  cluon::data::Envelope envelope;
+  envelope.dataType(opendlv::proxy::GroundSteeringRequest::ID())
+    .serializedData(protoEncoder.encodedData())
+    .sent(cluon::time::now())
+    .sampleTimeStamp(cluon::time::now());
+
+  uint64_t bytes{0};
+  uint64_t const allocationsBefore{allocationCount()};
+  while (state.keepRunning()) {
+    std::string &frame = threadLocalFrameBuffer();
+    frame.clear();
+    appendEnvelope(frame, envelope);
+    bytes += frame.size();
+  }
+  doNotOptimize(bytes);
+  state.setItemsProcessed(state.iterations());
+  state.setCounter("allocs/op", static_cast<double>(allocationCount() - allocationsBefore) / static_cast<double>(state.iterations()));
+}
@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) 2018 Ola Benderius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <fstream>
+#include <sstream>
+#include <vector>
+
+#include "cluon-complete.hpp"
+#include "opendlv-standard-message-set.hpp"
+#include "envelope-json-encoder.hpp"
+#include "bench.hpp"
+
+namespace {
+
+std::string readMessageSpecification()
+{
+  std::ifstream file(OPENDLV_STANDARD_MESSAGE_SET_FILE);
+  std::stringstream sstr;
+  sstr << file.rdbuf();
+  return sstr.str();
+}
+
+// The traffic of one tick of the kiwi stack: sensor readings and requests.
+std::vector<cluon::data::Envelope> tickEnvelopes()
+{
+  std::vector<cluon::data::Envelope> envelopes;
+  auto add = [&envelopes](auto &&message, uint32_t senderStamp) {
+    cluon::ToProtoVisitor encoder;
+    message.accept(encoder);
+    cluon::data::Envelope envelope;
+    envelope.dataType(message.ID()).serializedData(encoder.encodedData()).senderStamp(senderStamp);
+    envelope.sent(cluon::data::TimeStamp().seconds(1536000000).microseconds(123456));
+    envelope.sampleTimeStamp(envelope.sent());
+    envelopes.push_back(envelope);
+  };
+  for (uint32_t i{0}; i < 16; i++) {
+    add(opendlv::proxy::DistanceReading().distance(0.1f * static_cast<float>(i)), i % 4);
+    add(opendlv::proxy::VoltageReading().voltage(0.37f + 0.01f * static_cast<float>(i)), i % 4);
+    add(opendlv::proxy::GroundSteeringRequest().groundSteering(-0.05f * static_cast<float>(i)), 0);
+    add(opendlv::sim::KinematicState().vx(0.4f).vy(0.01f).yawRate(0.3f), 0);
+  }
+  return envelopes;
+}
+
+}
+
+BENCHMARK_CASE("EnvelopeConverter/getJSONFromEnvelope")
+{
+  auto envelopes = tickEnvelopes();
+  cluon::EnvelopeConverter converter;
+  converter.setMessageSpecification(readMessageSpecification());
+  std::size_t bytes{0};
+  while (state.keepRunning()) {
+    for (auto &envelope : envelopes) {
+      bytes += converter.getJSONFromEnvelope(envelope).size();
+    }
+  }
+  doNotOptimize(bytes);
+  state.setItemsProcessed(state.iterations() * envelopes.size());
+}
+
+BENCHMARK_CASE("EnvelopeJsonEncoder/encode one envelope at a time")
+{
+  auto const envelopes = tickEnvelopes();
+  MessageProgramSet programs;
+  programs.setMessageSpecification(readMessageSpecification());
+  EnvelopeJsonEncoder encoder{programs};
+  std::size_t bytes{0};
+  while (state.keepRunning()) {
+    for (auto const &envelope : envelopes) {
+      bytes += encoder.encode(envelope).size();
+    }
+  }
+  doNotOptimize(bytes);
+  state.setItemsProcessed(state.iterations() * envelopes.size());
+}
+
+BENCHMARK_CASE("EnvelopeJsonEncoder/batched frame per tick")
+{
+  auto const envelopes = tickEnvelopes();
+  MessageProgramSet programs;
+  programs.setMessageSpecification(readMessageSpecification());
+  EnvelopeJsonEncoder encoder{programs};
+  std::size_t bytes{0};
+  while (state.keepRunning()) {
+    encoder.beginFrame();
+    for (auto const &envelope : envelopes) {
+      encoder.append(envelope);
+    }
+    bytes += encoder.endFrame().size();
+  }
+  doNotOptimize(bytes);
+  state.setItemsProcessed(state.iterations() * envelopes.size());
+  state.setCounter("envelopes/frame", static_cast<double>(envelopes.size()));
+}
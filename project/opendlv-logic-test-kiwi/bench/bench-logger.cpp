@@ -0,0 +1,119 @@
+/*
+ * Copyright (C) 2018 Ola Benderius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <thread>
+#include <vector>
+
+#include "logger.hpp"
+#include "bench.hpp"
+
+namespace {
+
+enum class Output { Disabled, Synchronous, Asynchronous };
+
+// The verbose line of the logic loop written every tick of a 1 kHz loop;
+// counters are the wakeup latencies in microseconds, as in bench-realtime.
+void loggingLoop(BenchmarkState &state, Output output)
+{
+  std::ofstream sink{"/dev/null"};
+  Logger logger{sink};
+  LogSite site{"Steer %6g Pedal %6g Front %6g Rear %6g Left %6g", std::chrono::nanoseconds(0), 1};
+  std::vector<double> latencies;
+  latencies.reserve(state.iterations());
+  std::vector<double> costs;
+  costs.reserve(state.iterations());
+  auto const PERIOD = std::chrono::microseconds(1000);
+  auto next = std::chrono::steady_clock::now() + PERIOD;
+  float value{0.0f};
+  while (state.keepRunning()) {
+    std::this_thread::sleep_until(next);
+    auto const now = std::chrono::steady_clock::now();
+    latencies.push_back(std::chrono::duration<double, std::micro>(now - next).count());
+    value += 0.001f;
+    if (Output::Synchronous == output) {
+      sink << "Steer " << value << " Pedal " << value << " Front " << value
+        << " Rear " << value << " Left " << value << std::endl;
+    } else if (Output::Asynchronous == output) {
+      logger.log(site, value, value, value, value, value);
+    }
+    costs.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - now).count());
+    next += PERIOD;
+    if (next < now) {
+      next = now + PERIOD;
+    }
+  }
+
+  std::sort(latencies.begin(), latencies.end());
+  std::sort(costs.begin(), costs.end());
+  auto const percentile = [](std::vector<double> const &v, double p) {
+    return v[static_cast<std::size_t>(p * static_cast<double>(v.size() - 1))];
+  };
+  state.setItemsProcessed(state.iterations());
+  state.setCounter("p50us", percentile(latencies, 0.5));
+  state.setCounter("p99us", percentile(latencies, 0.99));
+  state.setCounter("maxus", latencies.back());
+  state.setCounter("logp50us", percentile(costs, 0.5));
+  state.setCounter("logp99us", percentile(costs, 0.99));
+  state.setCounter("dropped", static_cast<double>(logger.dropped()));
+}
+
+}
+
+BENCHMARK_CASE("Logger/log call, five floats")
+{
+  std::ofstream sink{"/dev/null"};
+  Logger logger{sink, std::chrono::milliseconds(1)};
+  LogSite site{"Steer %6g Pedal %6g Front %6g Rear %6g Left %6g", std::chrono::nanoseconds(0), 1};
+  float value{0.0f};
+  while (state.keepRunning()) {
+    value += 0.001f;
+    logger.log(site, value, value, value, value, value);
+  }
+  state.setItemsProcessed(state.iterations());
+  state.setCounter("dropped", static_cast<double>(logger.dropped()));
+}
+
+BENCHMARK_CASE("Logger/log call, suppressed by rate limit")
+{
+  std::ofstream sink{"/dev/null"};
+  Logger logger{sink};
+  LogSite site{"Steer %6g", std::chrono::hours(1), 1};
+  float value{0.0f};
+  while (state.keepRunning()) {
+    value += 0.001f;
+    logger.log(site, value);
+  }
+  state.setItemsProcessed(state.iterations());
+}
+
+BENCHMARK_CASE("Jitter/1 kHz loop, logging disabled")
+{
+  loggingLoop(state, Output::Disabled);
+}
+
+BENCHMARK_CASE("Jitter/1 kHz loop, std::ostream with endl")
+{
+  loggingLoop(state, Output::Synchronous);
+}
+
+BENCHMARK_CASE("Jitter/1 kHz loop, asynchronous logger")
+{
+  loggingLoop(state, Output::Asynchronous);
+}
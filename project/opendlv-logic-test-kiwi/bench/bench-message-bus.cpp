@@ -0,0 +1,187 @@
+/*
+ * Copyright (C) 2018 Ola Benderius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <atomic>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include "cluon-complete.hpp"
+#include "opendlv-standard-message-set.hpp"
+#include "message-bus.hpp"
+#include "bench.hpp"
+
+namespace {
+
+uint32_t const VEHICLES{50};
+
+// One tick of actuation requests from every vehicle of a fleet.
+std::vector<std::string> fleetFrames()
+{
+  std::vector<std::string> frames;
+  for (uint32_t frameId{0}; frameId < VEHICLES; frameId++) {
+    opendlv::proxy::GroundSteeringRequest gsr;
+    gsr.groundSteering(0.01f * static_cast<float>(frameId));
+    opendlv::proxy::PedalPositionRequest ppr;
+    ppr.position(0.5f);
+    cluon::ToProtoVisitor gsrEncoder;
+    gsr.accept(gsrEncoder);
+    cluon::ToProtoVisitor pprEncoder;
+    ppr.accept(pprEncoder);
+    cluon::data::Envelope a;
+    a.dataType(opendlv::proxy::GroundSteeringRequest::ID()).serializedData(gsrEncoder.encodedData()).senderStamp(frameId).sent(cluon::time::now());
+    cluon::data::Envelope b;
+    b.dataType(opendlv::proxy::PedalPositionRequest::ID()).serializedData(pprEncoder.encodedData()).senderStamp(frameId).sent(cluon::time::now());
+    frames.push_back(cluon::serializeEnvelope(std::move(a)));
+    frames.push_back(cluon::serializeEnvelope(std::move(b)));
+  }
+  return frames;
+}
+
+}
+
+BENCHMARK_CASE("OD4Session-style/decode then filter on sender stamp")
+{
+  auto const frames = fleetFrames();
+  uint32_t const FRAME_ID{7};
+  float sum{0.0f};
+  while (state.keepRunning()) {
+    for (auto const &frame : frames) {
+      std::stringstream sstr(frame);
+      auto retVal = cluon::extractEnvelope(sstr);
+      if (retVal.first && FRAME_ID == retVal.second.senderStamp()
+          && opendlv::proxy::GroundSteeringRequest::ID() == retVal.second.dataType()) {
+        sum += cluon::extractMessage<opendlv::proxy::GroundSteeringRequest>(std::move(retVal.second)).groundSteering();
+      }
+    }
+  }
+  doNotOptimize(sum);
+  state.setItemsProcessed(state.iterations() * frames.size());
+}
+
+BENCHMARK_CASE("MessageBus/filter on header then decode")
+{
+  auto const frames = fleetFrames();
+  MessageBus bus{248};
+  float sum{0.0f};
+  bus.dataTrigger(opendlv::proxy::GroundSteeringRequest::ID(), 7, [&sum](cluon::data::Envelope &&envelope) {
+      sum += cluon::extractMessage<opendlv::proxy::GroundSteeringRequest>(std::move(envelope)).groundSteering();
+    });
+  auto const now = std::chrono::system_clock::now();
+  while (state.keepRunning()) {
+    for (auto const &frame : frames) {
+      bus.dispatch(frame, now);
+    }
+  }
+  doNotOptimize(sum);
+  MessageBus::Statistics const statistics = bus.statistics();
+  state.setItemsProcessed(state.iterations() * frames.size());
+  state.setCounter("skipped%", 100.0 * static_cast<double>(statistics.skipped) / static_cast<double>(statistics.received));
+  state.setCounter("skippedKiB", static_cast<double>(statistics.skippedBytes) / 1024.0);
+}
+
+BENCHMARK_CASE("MessageBus/conflated dispatch to a slow consumer")
+{
+  auto const frames = fleetFrames();
+  MessageBus bus{248};
+  std::atomic<uint64_t> consumed{0};
+  bus.dataTrigger(opendlv::proxy::GroundSteeringRequest::ID(), [&consumed](cluon::data::Envelope &&) {
+      std::this_thread::sleep_for(std::chrono::microseconds(50));
+      consumed++;
+    }, MessageBus::Delivery::Conflate);
+  auto const now = std::chrono::system_clock::now();
+  while (state.keepRunning()) {
+    for (auto const &frame : frames) {
+      bus.dispatch(frame, now);
+    }
+  }
+  MessageBus::Statistics const statistics = bus.statistics();
+  state.setItemsProcessed(state.iterations() * frames.size());
+  state.setCounter("conflationRate", statistics.conflationRate());
+}
+
+BENCHMARK_CASE("MessageBus/send two requests as two datagrams")
+{
+  MessageBus bus{247};
+  bus.setPackedBatches(true);
+  opendlv::proxy::GroundSteeringRequest gsr;
+  gsr.groundSteering(0.1f);
+  opendlv::proxy::PedalPositionRequest ppr;
+  ppr.position(0.5f);
+  cluon::data::TimeStamp sampleTime;
+  while (state.keepRunning()) {
+    bus.send(gsr, sampleTime, 0);
+    bus.send(ppr, sampleTime, 0);
+  }
+  state.setItemsProcessed(state.iterations() * 2);
+  state.setCounter("datagrams/tick", 2.0);
+}
+
+BENCHMARK_CASE("MessageBus/send two requests as one batch")
+{
+  MessageBus bus{247};
+  bus.setPackedBatches(true);
+  opendlv::proxy::GroundSteeringRequest gsr;
+  gsr.groundSteering(0.1f);
+  opendlv::proxy::PedalPositionRequest ppr;
+  ppr.position(0.5f);
+  cluon::data::TimeStamp sampleTime;
+  EnvelopeBatch batch;
+  uint64_t datagrams{0};
+  while (state.keepRunning()) {
+    batch.clear();
+    batch.add(gsr, sampleTime, 0);
+    batch.add(ppr, sampleTime, 0);
+    datagrams += bus.sendBatch(batch);
+  }
+  state.setItemsProcessed(state.iterations() * 2);
+  state.setCounter("datagrams/tick", static_cast<double>(datagrams) / static_cast<double>(state.iterations()));
+}
+
+BENCHMARK_CASE("MessageBus/receive fleet tick as one datagram per envelope")
+{
+  auto const frames = fleetFrames();
+  MessageBus bus{248};
+  uint64_t count{0};
+  bus.dataTrigger(opendlv::proxy::PedalPositionRequest::ID(), [&count](cluon::data::Envelope &&) { count++; });
+  auto const now = std::chrono::system_clock::now();
+  while (state.keepRunning()) {
+    for (auto const &frame : frames) {
+      bus.dispatch(frame, now);
+    }
+  }
+  doNotOptimize(count);
+  state.setItemsProcessed(state.iterations() * frames.size());
+}
+
+BENCHMARK_CASE("MessageBus/receive fleet tick as one batched datagram")
+{
+  auto const frames = fleetFrames();
+  std::string datagram;
+  for (auto const &frame : frames) {
+    datagram.append(frame);
+  }
+  MessageBus bus{248};
+  uint64_t count{0};
+  bus.dataTrigger(opendlv::proxy::PedalPositionRequest::ID(), [&count](cluon::data::Envelope &&) { count++; });
+  auto const now = std::chrono::system_clock::now();
+  while (state.keepRunning()) {
+    bus.dispatch(datagram, now);
+  }
+  doNotOptimize(count);
+  state.setItemsProcessed(state.iterations() * frames.size());
+}
@@ -0,0 +1,173 @@
+/*
+ * Copyright (C) 2018 Ola Benderius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <fstream>
+#include <sstream>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "cluon-complete.hpp"
+#include "message-program.hpp"
+#include "bench.hpp"
+
+namespace {
+
+std::string readMessageSpecification()
+{
+  std::ifstream file(OPENDLV_STANDARD_MESSAGE_SET_FILE);
+  std::stringstream sstr;
+  sstr << file.rdbuf();
+  return sstr.str();
+}
+
+// One synthetic payload per message in the set, with every field populated.
+std::vector<std::pair<int32_t, std::string>> const &standardMessageSetPayloads()
+{
+  static std::vector<std::pair<int32_t, std::string>> payloads;
+  if (payloads.empty()) {
+    cluon::MessageParser messageParser;
+    auto result = messageParser.parse(readMessageSpecification());
+    for (auto const &metaMessage : result.first) {
+      cluon::ToProtoVisitor encoder;
+      for (auto const &f : metaMessage.listOfMetaFields()) {
+        std::string typeName{f.fieldDataTypeName()};
+        std::string name{f.fieldName()};
+        switch (f.fieldDataType()) {
+          case cluon::MetaMessage::MetaField::BOOL_T: { bool v{true}; encoder.visit(f.fieldIdentifier(), std::move(typeName), std::move(name), v); break; }
+          case cluon::MetaMessage::MetaField::CHAR_T: { char v{'k'}; encoder.visit(f.fieldIdentifier(), std::move(typeName), std::move(name), v); break; }
+          case cluon::MetaMessage::MetaField::INT8_T: { int8_t v{-8}; encoder.visit(f.fieldIdentifier(), std::move(typeName), std::move(name), v); break; }
+          case cluon::MetaMessage::MetaField::UINT8_T: { uint8_t v{8}; encoder.visit(f.fieldIdentifier(), std::move(typeName), std::move(name), v); break; }
+          case cluon::MetaMessage::MetaField::INT16_T: { int16_t v{-1600}; encoder.visit(f.fieldIdentifier(), std::move(typeName), std::move(name), v); break; }
+          case cluon::MetaMessage::MetaField::UINT16_T: { uint16_t v{1600}; encoder.visit(f.fieldIdentifier(), std::move(typeName), std::move(name), v); break; }
+          case cluon::MetaMessage::MetaField::INT32_T: { int32_t v{-320000}; encoder.visit(f.fieldIdentifier(), std::move(typeName), std::move(name), v); break; }
+          case cluon::MetaMessage::MetaField::UINT32_T: { uint32_t v{320000}; encoder.visit(f.fieldIdentifier(), std::move(typeName), std::move(name), v); break; }
+          case cluon::MetaMessage::MetaField::INT64_T: { int64_t v{-6400000000}; encoder.visit(f.fieldIdentifier(), std::move(typeName), std::move(name), v); break; }
+          case cluon::MetaMessage::MetaField::UINT64_T: { uint64_t v{6400000000}; encoder.visit(f.fieldIdentifier(), std::move(typeName), std::move(name), v); break; }
+          case cluon::MetaMessage::MetaField::FLOAT_T: { float v{1.25f}; encoder.visit(f.fieldIdentifier(), std::move(typeName), std::move(name), v); break; }
+          case cluon::MetaMessage::MetaField::DOUBLE_T: { double v{-2.5}; encoder.visit(f.fieldIdentifier(), std::move(typeName), std::move(name), v); break; }
+          case cluon::MetaMessage::MetaField::STRING_T:
+          case cluon::MetaMessage::MetaField::BYTES_T: { std::string v{"kiwi"}; encoder.visit(f.fieldIdentifier(), std::move(typeName), std::move(name), v); break; }
+          default: break;
+        }
+      }
+      payloads.emplace_back(metaMessage.messageIdentifier(), encoder.encodedData());
+    }
+  }
+  return payloads;
+}
+
+// Touches every decoded value, as a monitoring consumer would.
+class ChecksumVisitor {
+ public:
+  double sum{0.0};
+
+  void preVisit(int32_t, std::string const &, std::string const &) noexcept {}
+  void postVisit() noexcept {}
+
+  template <typename T, typename std::enable_if<std::is_arithmetic<T>::value, int>::type = 0>
+  void visit(uint32_t, std::string &&, std::string &&, T &v) noexcept
+  {
+    sum += static_cast<double>(v);
+  }
+  void visit(uint32_t, std::string &&, std::string &&, std::string &v) noexcept
+  {
+    sum += static_cast<double>(v.size());
+  }
+  template <typename T, typename std::enable_if<!std::is_arithmetic<T>::value, int>::type = 0>
+  void visit(uint32_t &, std::string &&, std::string &&, T &v) noexcept
+  {
+    v.accept(*this);
+  }
+
+  template <typename T>
+  void operator()(MessageProgram::Field const &, T v) noexcept
+  {
+    sum += static_cast<double>(v);
+  }
+  void operator()(MessageProgram::Field const &, DynamicRecord::StringSlice v) noexcept
+  {
+    sum += static_cast<double>(v.size);
+  }
+};
+
+}
+
+BENCHMARK_CASE("GenericMessage/decode+visit standard message set")
+{
+  auto const &payloads = standardMessageSetPayloads();
+  std::vector<cluon::MetaMessage> metaMessages;
+  {
+    cluon::MessageParser messageParser;
+    metaMessages = messageParser.parse(readMessageSpecification()).first;
+  }
+  std::map<int32_t, cluon::MetaMessage> scope;
+  for (auto const &mm : metaMessages) {
+    scope[mm.messageIdentifier()] = mm;
+  }
+
+  ChecksumVisitor checksum;
+  while (state.keepRunning()) {
+    for (auto const &payload : payloads) {
+      std::stringstream sstr{payload.second};
+      cluon::FromProtoVisitor protoDecoder;
+      protoDecoder.decodeFrom(sstr);
+      cluon::GenericMessage gm;
+      gm.createFrom(scope[payload.first], metaMessages);
+      gm.accept(protoDecoder);
+      gm.accept(checksum);
+    }
+  }
+  doNotOptimize(checksum.sum);
+  state.setItemsProcessed(state.iterations() * payloads.size());
+}
+
+BENCHMARK_CASE("DynamicRecord/decode+visit standard message set")
+{
+  auto const &payloads = standardMessageSetPayloads();
+  MessageProgramSet programs;
+  programs.setMessageSpecification(readMessageSpecification());
+  DynamicRecord record{programs};
+
+  ChecksumVisitor checksum;
+  while (state.keepRunning()) {
+    for (auto const &payload : payloads) {
+      record.decode(payload.first, payload.second);
+      record.forEachField(checksum);
+    }
+  }
+  doNotOptimize(checksum.sum);
+  state.setItemsProcessed(state.iterations() * payloads.size());
+}
+
+BENCHMARK_CASE("DynamicRecord/decode+cluon visitor standard message set")
+{
+  auto const &payloads = standardMessageSetPayloads();
+  MessageProgramSet programs;
+  programs.setMessageSpecification(readMessageSpecification());
+  DynamicRecord record{programs};
+
+  ChecksumVisitor checksum;
+  while (state.keepRunning()) {
+    for (auto const &payload : payloads) {
+      record.decode(payload.first, payload.second);
+      record.accept(checksum);
+    }
+  }
+  doNotOptimize(checksum.sum);
+  state.setItemsProcessed(state.iterations() * payloads.size());
+}
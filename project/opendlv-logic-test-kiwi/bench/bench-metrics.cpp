@@ -0,0 +1,113 @@
+/*
+ * Copyright (C) 2018 Ola Benderius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string>
+#include <vector>
+
+#include "cluon-complete.hpp"
+#include "opendlv-standard-message-set.hpp"
+#include "message-bus.hpp"
+#include "metrics.hpp"
+#include "proto-decoder.hpp"
+#include "bench.hpp"
+
+namespace {
+
+// Sensor readings as the logic binary receives them, all subscribed to.
+std::vector<std::string> sensorFrames()
+{
+  std::vector<std::string> frames;
+  for (uint32_t senderStamp{0}; senderStamp < 2; senderStamp++) {
+    opendlv::proxy::DistanceReading distance;
+    distance.distance(0.5f);
+    opendlv::proxy::VoltageReading voltage;
+    voltage.voltage(0.1f);
+    std::string frame;
+    appendFrame(frame, distance, cluon::data::TimeStamp(), senderStamp);
+    frames.push_back(frame);
+    frame.clear();
+    appendFrame(frame, voltage, cluon::data::TimeStamp(), senderStamp);
+    frames.push_back(frame);
+  }
+  return frames;
+}
+
+void dispatchSensorFrames(BenchmarkState &state, Metrics *metrics)
+{
+  auto const frames = sensorFrames();
+  MessageBus bus{248};
+  bus.setMetrics(metrics);
+  float sum{0.0f};
+  bus.dataTrigger(opendlv::proxy::DistanceReading::ID(), [&sum](cluon::data::Envelope &&envelope) {
+      sum += decodeProto<opendlv::proxy::DistanceReading>(envelope).distance();
+    });
+  bus.dataTrigger(opendlv::proxy::VoltageReading::ID(), [&sum](cluon::data::Envelope &&envelope) {
+      sum += decodeProto<opendlv::proxy::VoltageReading>(envelope).voltage();
+    });
+  auto const now = std::chrono::system_clock::now();
+  while (state.keepRunning()) {
+    for (auto const &frame : frames) {
+      bus.dispatch(frame, now);
+    }
+  }
+  doNotOptimize(sum);
+  state.setItemsProcessed(state.iterations() * frames.size());
+}
+
+}
+
+BENCHMARK_CASE("Metrics/dispatch sensor frames without metrics")
+{
+  dispatchSensorFrames(state, nullptr);
+}
+
+BENCHMARK_CASE("Metrics/dispatch sensor frames with metrics")
+{
+  Metrics metrics;
+  dispatchSensorFrames(state, &metrics);
+}
+
+// Everything the bus adds per delivered frame: the counters, and for
+// sampled frames the three clock reads and the histograms.
+BENCHMARK_CASE("Metrics/record one delivered frame")
+{
+  Metrics metrics;
+  while (state.keepRunning()) {
+    metrics.received(1039, 40);
+    if (metrics.sampleLatency()) {
+      auto const decodeStart = std::chrono::steady_clock::now();
+      auto const delegateStart = std::chrono::steady_clock::now();
+      metrics.delivered(1039, delegateStart - decodeStart, std::chrono::steady_clock::now() - delegateStart);
+    }
+  }
+  state.setItemsProcessed(state.iterations());
+}
+
+BENCHMARK_CASE("Metrics/exposition of 4 message IDs")
+{
+  Metrics metrics;
+  for (int32_t id : {1039, 1037, 1090, 1086}) {
+    metrics.received(id, 40);
+    metrics.delegateTime(id, std::chrono::nanoseconds(100));
+  }
+  std::size_t bytes{0};
+  while (state.keepRunning()) {
+    bytes += metrics.exposition().size();
+  }
+  doNotOptimize(bytes);
+  state.setItemsProcessed(state.iterations());
+}
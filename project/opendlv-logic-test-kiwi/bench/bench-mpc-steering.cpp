@@ -0,0 +1,112 @@
+/*
+ * Copyright (C) 2018 Ola Benderius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+#include "mpc-steering.hpp"
+#include "bench.hpp"
+
+namespace {
+
+char const *BOX = "-2.0,-2.0,-2.0,2.0;\n-2.0,2.0,2.0,2.0;\n2.0,2.0,2.0,-2.0;\n2.0,-2.0,-2.0,-2.0;\n";
+
+// Closed-loop solves in the 4 x 4 m simulation box, one per 10 Hz tick;
+// reports the solve time distribution, the rollouts per solve and how often
+// the budget cut the search short.
+void solveClosedLoop(BenchmarkState &state, uint32_t horizon, std::chrono::microseconds budget)
+{
+  WallMap map;
+  map.setSegments(BOX);
+  MpcSteering::Config config;
+  config.horizon = horizon;
+  config.budget = budget;
+  MpcSteering mpc{map, config};
+
+  std::vector<double> solveTimes;
+  solveTimes.reserve(state.iterations());
+  uint64_t rollouts{0};
+  uint64_t deadlineHits{0};
+  VehicleState vehicle;
+  vehicle.x = -1.0;
+  vehicle.yaw = 0.3;
+  uint64_t const allocations{allocationCount()};
+  while (state.keepRunning()) {
+    MpcSteering::Solution const solution{mpc.solve(vehicle)};
+    solveTimes.push_back(std::chrono::duration<double, std::micro>(solution.solveTime).count());
+    rollouts += solution.rollouts;
+    deadlineHits += solution.deadlineHit ? 1 : 0;
+    if (solution.feasible) {
+      MpcSteering::predict(vehicle, solution.groundSteering, solution.pedalPosition, config.stepTime, config.substeps);
+    } else {
+      vehicle = VehicleState{};
+      mpc.reset();
+    }
+  }
+  double const n{static_cast<double>(state.iterations())};
+  state.setCounter("allocs/op", static_cast<double>(allocationCount() - allocations) / n);
+  std::sort(solveTimes.begin(), solveTimes.end());
+  state.setCounter("p50_us", solveTimes[solveTimes.size() / 2]);
+  state.setCounter("p99_us", solveTimes[std::min(solveTimes.size() - 1, solveTimes.size() * 99 / 100)]);
+  state.setCounter("max_us", solveTimes.back());
+  state.setCounter("rollouts/solve", static_cast<double>(rollouts) / n);
+  state.setCounter("deadline_hit_ratio", static_cast<double>(deadlineHits) / n);
+  state.setItemsProcessed(state.iterations());
+}
+
+}
+
+BENCHMARK_CASE("MpcSteering/solve/horizon:5/unbounded")
+{
+  solveClosedLoop(state, 5, std::chrono::microseconds(0));
+}
+
+BENCHMARK_CASE("MpcSteering/solve/horizon:10/unbounded")
+{
+  solveClosedLoop(state, 10, std::chrono::microseconds(0));
+}
+
+BENCHMARK_CASE("MpcSteering/solve/horizon:20/unbounded")
+{
+  solveClosedLoop(state, 20, std::chrono::microseconds(0));
+}
+
+BENCHMARK_CASE("MpcSteering/solve/horizon:40/unbounded")
+{
+  solveClosedLoop(state, 40, std::chrono::microseconds(0));
+}
+
+BENCHMARK_CASE("MpcSteering/solve/horizon:5/budget:2ms")
+{
+  solveClosedLoop(state, 5, std::chrono::microseconds(2000));
+}
+
+BENCHMARK_CASE("MpcSteering/solve/horizon:10/budget:2ms")
+{
+  solveClosedLoop(state, 10, std::chrono::microseconds(2000));
+}
+
+BENCHMARK_CASE("MpcSteering/solve/horizon:20/budget:2ms")
+{
+  solveClosedLoop(state, 20, std::chrono::microseconds(2000));
+}
+
+BENCHMARK_CASE("MpcSteering/solve/horizon:40/budget:2ms")
+{
+  solveClosedLoop(state, 40, std::chrono::microseconds(2000));
+}
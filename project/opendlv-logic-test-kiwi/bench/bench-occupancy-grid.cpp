@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) 2018 Ola Benderius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cmath>
+#include <vector>
+
+#include "occupancy-grid.hpp"
+#include "wall-map.hpp"
+#include "bench.hpp"
+
+namespace {
+
+char const *BOX = "-2.0,-2.0,-2.0,2.0;\n-2.0,2.0,2.0,2.0;\n2.0,2.0,2.0,-2.0;\n2.0,-2.0,-2.0,-2.0;\n";
+
+struct Reading {
+  double x{0.0};
+  double y{0.0};
+  double yaw{0.0};
+  OccupancyMapper::Sensor sensor{OccupancyMapper::Sensor::FrontUltrasonic};
+  double range{0.0};
+};
+
+// All four sensors at 10 Hz along a 1 m circle in the simulation box,
+// from the walls as the simulated sensors see them.
+std::vector<Reading> simulatedReadings(OccupancyMapper &mapper)
+{
+  WallMap map;
+  map.setSegments(BOX);
+  std::vector<Reading> readings;
+  for (uint32_t tick{0}; tick < 600; tick++) {
+    double const angle{static_cast<double>(tick) * 0.04};
+    Reading reading;
+    reading.x = std::cos(angle);
+    reading.y = std::sin(angle);
+    reading.yaw = angle + 0.5 * M_PI;
+    for (auto sensor : {OccupancyMapper::Sensor::FrontUltrasonic, OccupancyMapper::Sensor::RearUltrasonic,
+        OccupancyMapper::Sensor::LeftIr, OccupancyMapper::Sensor::RightIr}) {
+      OccupancyMapper::Mount const &m = mapper.mount(sensor);
+      double const x{reading.x + m.x * std::cos(reading.yaw) - m.y * std::sin(reading.yaw)};
+      double const y{reading.y + m.x * std::sin(reading.yaw) + m.y * std::cos(reading.yaw)};
+      reading.sensor = sensor;
+      reading.range = map.castRay(x, y, reading.yaw + m.yaw, 10.0);
+      readings.push_back(reading);
+    }
+  }
+  return readings;
+}
+
+void mapReadings(BenchmarkState &state, double resolution)
+{
+  OccupancyGrid::Config config;
+  config.resolution = resolution;
+  OccupancyGrid grid{config};
+  OccupancyMapper mapper{grid};
+  std::vector<Reading> const readings{simulatedReadings(mapper)};
+  std::size_t next{0};
+  uint64_t const allocations{allocationCount()};
+  while (state.keepRunning()) {
+    Reading const &reading = readings[next];
+    mapper.setPose(reading.x, reading.y, reading.yaw);
+    mapper.addRange(reading.sensor, reading.range);
+    next = (next + 1 == readings.size()) ? 0 : next + 1;
+  }
+  double const n{static_cast<double>(state.iterations())};
+  state.setCounter("allocs/op", static_cast<double>(allocationCount() - allocations) / n);
+  state.setCounter("cells/update", static_cast<double>(grid.cellUpdates()) / n);
+  state.setCounter("bytes/m2", static_cast<double>(grid.memoryBytes()) / grid.areaSquareMetres());
+  state.setCounter("grid_bytes", static_cast<double>(grid.memoryBytes()));
+  state.setItemsProcessed(state.iterations());
+}
+
+}
+
+BENCHMARK_CASE("OccupancyGrid/updateRay/1.5m")
+{
+  OccupancyGrid::Config config;
+  OccupancyGrid grid{config};
+  double angle{0.0};
+  while (state.keepRunning()) {
+    grid.updateRay(0.0, 0.0, 1.5 * std::cos(angle), 1.5 * std::sin(angle), true);
+    angle += 0.01;
+  }
+  state.setCounter("cells/update", static_cast<double>(grid.cellUpdates()) / static_cast<double>(state.iterations()));
+  state.setItemsProcessed(state.iterations());
+}
+
+BENCHMARK_CASE("OccupancyMapper/addRange/resolution:5cm")
+{
+  mapReadings(state, 0.05);
+}
+
+BENCHMARK_CASE("OccupancyMapper/addRange/resolution:2cm")
+{
+  mapReadings(state, 0.02);
+}
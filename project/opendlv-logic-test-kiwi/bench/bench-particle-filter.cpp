@@ -0,0 +1,87 @@
+/*
+ * Copyright (C) 2018 Ola Benderius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cmath>
+
+#include "mpc-steering.hpp"
+#include "particle-filter.hpp"
+#include "bench.hpp"
+
+namespace {
+
+char const *BOX = "-2.0,-2.0,-2.0,2.0;\n-2.0,2.0,2.0,2.0;\n2.0,2.0,2.0,-2.0;\n2.0,-2.0,-2.0,-2.0;\n";
+
+// One 10 Hz localization step while circling in the simulation box: a
+// motion update and a measurement update with all four sensors. Items are
+// particle updates.
+void localize(BenchmarkState &state, uint32_t particles, uint32_t threads)
+{
+  WallMap map;
+  map.setSegments(BOX);
+  ParticleFilter::Config config;
+  config.particles = particles;
+  config.threads = threads;
+  ParticleFilter filter{map, config};
+  VehicleState vehicle;
+  vehicle.x = -1.0;
+  filter.initialize(vehicle.x, vehicle.y, vehicle.yaw, 0.2, 0.2);
+
+  uint64_t const allocations{allocationCount()};
+  while (state.keepRunning()) {
+    MpcSteering::predict(vehicle, 0.2f, 0.6f, 0.1, 10);
+    std::array<double, ParticleFilter::SENSORS> ranges;
+    for (uint32_t k{0}; k < ParticleFilter::SENSORS; k++) {
+      ParticleFilter::Beam const &beam = config.beams[k];
+      double const x{vehicle.x + beam.x * std::cos(vehicle.yaw) - beam.y * std::sin(vehicle.yaw)};
+      double const y{vehicle.y + beam.x * std::sin(vehicle.yaw) + beam.y * std::cos(vehicle.yaw)};
+      ranges[k] = map.castRay(x, y, vehicle.yaw + beam.yaw, 10.0);
+    }
+    filter.predict(vehicle.longitudinalSpeed, vehicle.lateralSpeed, vehicle.yawRate, 0.1);
+    filter.update(ranges);
+  }
+  double const n{static_cast<double>(state.iterations())};
+  state.setCounter("allocs/op", static_cast<double>(allocationCount() - allocations) / n);
+  state.setCounter("ms/tick", state.elapsedSeconds() * 1e3 / n);
+  state.setItemsProcessed(state.iterations() * filter.size());
+}
+
+}
+
+BENCHMARK_CASE("ParticleFilter/step/particles:256/threads:1")
+{
+  localize(state, 256, 1);
+}
+
+BENCHMARK_CASE("ParticleFilter/step/particles:1024/threads:1")
+{
+  localize(state, 1024, 1);
+}
+
+BENCHMARK_CASE("ParticleFilter/step/particles:4096/threads:1")
+{
+  localize(state, 4096, 1);
+}
+
+BENCHMARK_CASE("ParticleFilter/step/particles:4096/threads:2")
+{
+  localize(state, 4096, 2);
+}
+
+BENCHMARK_CASE("ParticleFilter/step/particles:4096/threads:4")
+{
+  localize(state, 4096, 4);
+}
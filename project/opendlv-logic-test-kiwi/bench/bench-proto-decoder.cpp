@@ -0,0 +1,108 @@
+/*
+ * Copyright (C) 2018 Ola Benderius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <sstream>
+
+#include "cluon-complete.hpp"
+#include "opendlv-standard-message-set.hpp"
+#include "test-message-set.hpp"
+#include "proto-decoder.hpp"
+#include "bench.hpp"
+
+namespace {
+
+std::string kinematicStatePayload()
+{
+  opendlv::sim::KinematicState ks;
+  ks.vx(0.5f).vy(-0.25f).vz(0.125f).rollRate(-1.0f).pitchRate(2.0f).yawRate(1.5f);
+  cluon::ToProtoVisitor encoder;
+  ks.accept(encoder);
+  return encoder.encodedData();
+}
+
+std::string myTestMessage2Payload()
+{
+  MyTestMessage1 inner;
+  inner.myValue(4711);
+  MyTestMessage2 message;
+  message.myValue1(true).myValue2(200).myValue3(-7).myValue4(60000).myValue5(-30000)
+    .myValue6(4000000000u).myValue7(-2000000000).myValue8(18000000000000u).myValue9(-9000000000000)
+    .myValue10(3.5f).myValue11(-6.25).myValue12("kiwi").myValue13(inner);
+  cluon::ToProtoVisitor encoder;
+  message.accept(encoder);
+  return encoder.encodedData();
+}
+
+}
+
+BENCHMARK_CASE("FromProtoVisitor/KinematicState")
+{
+  std::string const payload{kinematicStatePayload()};
+  float sum{0.0f};
+  while (state.keepRunning()) {
+    std::stringstream sstr{payload};
+    cluon::FromProtoVisitor decoder;
+    decoder.decodeFrom(sstr);
+    opendlv::sim::KinematicState ks;
+    ks.accept(decoder);
+    sum += ks.yawRate();
+  }
+  doNotOptimize(sum);
+  state.setItemsProcessed(state.iterations());
+}
+
+BENCHMARK_CASE("ProtoLayout/KinematicState")
+{
+  std::string const payload{kinematicStatePayload()};
+  float sum{0.0f};
+  opendlv::sim::KinematicState ks;
+  while (state.keepRunning()) {
+    decodeProto(payload, ks);
+    sum += ks.yawRate();
+  }
+  doNotOptimize(sum);
+  state.setItemsProcessed(state.iterations());
+}
+
+BENCHMARK_CASE("FromProtoVisitor/MyTestMessage2")
+{
+  std::string const payload{myTestMessage2Payload()};
+  uint64_t sum{0};
+  while (state.keepRunning()) {
+    std::stringstream sstr{payload};
+    cluon::FromProtoVisitor decoder;
+    decoder.decodeFrom(sstr);
+    MyTestMessage2 message;
+    message.accept(decoder);
+    sum += message.myValue8() + message.myValue12().size() + message.myValue13().myValue();
+  }
+  doNotOptimize(sum);
+  state.setItemsProcessed(state.iterations());
+}
+
+BENCHMARK_CASE("ProtoLayout/MyTestMessage2")
+{
+  std::string const payload{myTestMessage2Payload()};
+  uint64_t sum{0};
+  MyTestMessage2 message;
+  while (state.keepRunning()) {
+    decodeProto(payload, message);
+    sum += message.myValue8() + message.myValue12().size() + message.myValue13().myValue();
+  }
+  doNotOptimize(sum);
+  state.setItemsProcessed(state.iterations());
+}
@@ -0,0 +1,135 @@
+/*
+ * Copyright (C) 2018 Ola Benderius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <sys/resource.h>
+
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "cluon-complete.hpp"
+#include "message-bus.hpp"
+#include "reactor.hpp"
+#include "bench.hpp"
+
+namespace {
+
+uint32_t const SESSIONS{8};
+
+double threadCount()
+{
+  std::ifstream status{"/proc/self/status"};
+  std::string line;
+  while (std::getline(status, line)) {
+    if (0 == line.find("Threads:")) {
+      return std::stod(line.substr(8));
+    }
+  }
+  return 0.0;
+}
+
+double contextSwitches()
+{
+  struct rusage usage{};
+  ::getrusage(RUSAGE_SELF, &usage);
+  return static_cast<double>(usage.ru_nvcsw + usage.ru_nivcsw);
+}
+
+// One datagram per session per iteration, waiting until all are delivered.
+template <typename Session>
+void pingSessions(BenchmarkState &state, std::vector<std::unique_ptr<Session>> &sessions, std::atomic<uint64_t> &delivered)
+{
+  uint64_t expected{0};
+  double const threads{threadCount()};
+  double const switchesBefore{contextSwitches()};
+  while (state.keepRunning()) {
+    for (auto &session : sessions) {
+      cluon::data::TimeStamp timeStamp;
+      session->send(timeStamp);
+    }
+    expected += sessions.size();
+    while (delivered.load() < expected) {
+      std::this_thread::yield();
+    }
+  }
+  state.setItemsProcessed(state.iterations() * sessions.size());
+  state.setCounter("threads", threads);
+  state.setCounter("csw/op", (contextSwitches() - switchesBefore) / static_cast<double>(state.iterations()));
+}
+
+// Ten idle milliseconds per iteration, to count the wakeups of the
+// receiver threads themselves.
+void idle(BenchmarkState &state)
+{
+  double const threads{threadCount()};
+  double const switchesBefore{contextSwitches()};
+  auto const start = std::chrono::steady_clock::now();
+  while (state.keepRunning()) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  double const seconds{std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count()};
+  state.setCounter("threads", threads);
+  state.setCounter("csw/s", (contextSwitches() - switchesBefore) / seconds);
+}
+
+}
+
+BENCHMARK_CASE("Reactor/8 OD4Sessions idle")
+{
+  std::vector<std::unique_ptr<cluon::OD4Session>> sessions;
+  for (uint32_t i{0}; i < SESSIONS; i++) {
+    sessions.push_back(std::make_unique<cluon::OD4Session>(static_cast<uint16_t>(200 + i)));
+  }
+  idle(state);
+}
+
+BENCHMARK_CASE("Reactor/8 MessageBus on one reactor idle")
+{
+  Reactor reactor{2};
+  std::vector<std::unique_ptr<MessageBus>> buses;
+  for (uint32_t i{0}; i < SESSIONS; i++) {
+    buses.push_back(std::make_unique<MessageBus>(static_cast<uint16_t>(200 + i), reactor));
+  }
+  idle(state);
+}
+
+BENCHMARK_CASE("Reactor/8 OD4Sessions ping")
+{
+  std::atomic<uint64_t> delivered{0};
+  std::vector<std::unique_ptr<cluon::OD4Session>> sessions;
+  for (uint32_t i{0}; i < SESSIONS; i++) {
+    sessions.push_back(std::make_unique<cluon::OD4Session>(static_cast<uint16_t>(200 + i),
+          [&delivered](cluon::data::Envelope &&) { delivered++; }));
+  }
+  pingSessions(state, sessions, delivered);
+}
+
+BENCHMARK_CASE("Reactor/8 MessageBus on one reactor ping")
+{
+  std::atomic<uint64_t> delivered{0};
+  Reactor reactor{2};
+  std::vector<std::unique_ptr<MessageBus>> buses;
+  for (uint32_t i{0}; i < SESSIONS; i++) {
+    buses.push_back(std::make_unique<MessageBus>(static_cast<uint16_t>(200 + i), reactor));
+    buses.back()->dataTrigger(cluon::data::TimeStamp::ID(), [&delivered](cluon::data::Envelope &&) { delivered++; });
+  }
+  pingSessions(state, buses, delivered);
+}
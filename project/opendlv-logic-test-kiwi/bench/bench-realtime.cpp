@@ -0,0 +1,130 @@
+/*
+ * Copyright (C) 2018 Ola Benderius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "realtime.hpp"
+#include "bench.hpp"
+
+namespace {
+
+// Keeps every CPU busy for as long as it lives.
+class CpuLoad {
+ private:
+  CpuLoad(CpuLoad const &) = delete;
+  CpuLoad(CpuLoad &&) = delete;
+  CpuLoad &operator=(CpuLoad const &) = delete;
+  CpuLoad &operator=(CpuLoad &&) = delete;
+
+ public:
+  CpuLoad():
+    m_running{true},
+    m_threads{}
+  {
+    uint32_t const cpus{std::max(1u, std::thread::hardware_concurrency())};
+    for (uint32_t i{0}; i < cpus; i++) {
+      m_threads.emplace_back([this]() {
+          volatile uint64_t spin{0};
+          while (m_running.load(std::memory_order_relaxed)) {
+            spin = spin + 1;
+          }
+        });
+    }
+  }
+
+  ~CpuLoad()
+  {
+    m_running = false;
+    for (auto &thread : m_threads) {
+      thread.join();
+    }
+  }
+
+ private:
+  std::atomic<bool> m_running;
+  std::vector<std::thread> m_threads;
+};
+
+// A 1 kHz loop paced like MessageBus::timeTrigger, on its own thread with
+// the given policy; counters are the wakeup latencies in microseconds.
+void periodicLoop(BenchmarkState &state, ThreadPolicy const &policy, bool lockMemory)
+{
+  if (lockMemory) {
+    lockAndPrefaultMemory(1024 * 1024, 16 * 1024 * 1024);
+  }
+  std::vector<double> latencies;
+  latencies.reserve(state.iterations());
+  bool applied{false};
+  std::thread loop{[&state, &policy, &latencies, &applied]() {
+      applied = applyThreadPolicy(policy);
+      auto const PERIOD = std::chrono::microseconds(1000);
+      auto next = std::chrono::steady_clock::now() + PERIOD;
+      while (state.keepRunning()) {
+        std::this_thread::sleep_until(next);
+        auto const now = std::chrono::steady_clock::now();
+        latencies.push_back(std::chrono::duration<double, std::micro>(now - next).count());
+        next += PERIOD;
+        if (next < now) {
+          next = now + PERIOD;
+        }
+      }
+    }};
+  loop.join();
+
+  std::sort(latencies.begin(), latencies.end());
+  auto const percentile = [&latencies](double p) {
+    return latencies[static_cast<std::size_t>(p * static_cast<double>(latencies.size() - 1))];
+  };
+  state.setItemsProcessed(state.iterations());
+  state.setCounter("p50us", percentile(0.5));
+  state.setCounter("p99us", percentile(0.99));
+  state.setCounter("maxus", latencies.back());
+  state.setCounter("applied", applied ? 1.0 : 0.0);
+}
+
+ThreadPolicy realtimePolicy()
+{
+  ThreadPolicy policy;
+  policy.name = "bench-control";
+  policy.cpus = {0};
+  policy.priority = 80;
+  return policy;
+}
+
+}
+
+BENCHMARK_CASE("Jitter/1 kHz loop idle, default scheduling")
+{
+  periodicLoop(state, ThreadPolicy(), false);
+}
+
+BENCHMARK_CASE("Jitter/1 kHz loop under CPU load, default scheduling")
+{
+  CpuLoad load;
+  periodicLoop(state, ThreadPolicy(), false);
+}
+
+BENCHMARK_CASE("Jitter/1 kHz loop under CPU load, FIFO pinned mlockall")
+{
+  CpuLoad load;
+  periodicLoop(state, realtimePolicy(), true);
+}
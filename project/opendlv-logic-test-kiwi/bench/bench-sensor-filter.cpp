@@ -0,0 +1,107 @@
+/*
+ * Copyright (C) 2018 Ola Benderius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include "behavior.hpp"
+#include "sensor-filter.hpp"
+#include "bench.hpp"
+
+namespace {
+
+// Noisy corridor distances with a glitch every 37 samples, cycled so that
+// the median window keeps reordering.
+std::vector<float> samples()
+{
+  std::vector<float> trace(1024);
+  for (uint32_t i{0}; i < trace.size(); i++) {
+    trace[i] = (0 == i % 37) ? 0.05f : 1.0f + 0.05f * std::sin(1.3f * static_cast<float>(i));
+  }
+  return trace;
+}
+
+void filter(BenchmarkState &state, std::string const &pipeline)
+{
+  SensorFilter::Config config;
+  SensorFilter::parse(pipeline, config);
+  SensorFilter sensorFilter;
+  sensorFilter.setConfig(config);
+  std::vector<float> const trace{samples()};
+  uint64_t const allocations{allocationCount()};
+  uint32_t i{0};
+  float sum{0.0f};
+  while (state.keepRunning()) {
+    sum += sensorFilter.update(trace[i++ & 1023]);
+  }
+  doNotOptimize(sum);
+  state.setCounter("allocs/op", static_cast<double>(allocationCount() - allocations) / static_cast<double>(state.iterations()));
+  state.setItemsProcessed(state.iterations());
+}
+
+}
+
+BENCHMARK_CASE("SensorFilter/update/none")
+{
+  filter(state, "none");
+}
+
+BENCHMARK_CASE("SensorFilter/update/median:3")
+{
+  filter(state, "median:3");
+}
+
+BENCHMARK_CASE("SensorFilter/update/median:15")
+{
+  filter(state, "median:15");
+}
+
+BENCHMARK_CASE("SensorFilter/update/ema:0.3")
+{
+  filter(state, "ema:0.3");
+}
+
+BENCHMARK_CASE("SensorFilter/update/kalman")
+{
+  filter(state, "kalman");
+}
+
+BENCHMARK_CASE("SensorFilter/update/median:5,ema:0.5,kalman")
+{
+  filter(state, "median:5,ema:0.5,kalman");
+}
+
+// The data-trigger path of a front reading: lock, filter and store.
+BENCHMARK_CASE("SensorFilter/Behavior::setFrontUltrasonic/median:5,kalman")
+{
+  SensorFilter::Config config;
+  SensorFilter::parse("median:5,kalman", config);
+  Behavior behavior;
+  behavior.setFilters(config, SensorFilter::Config{});
+  std::vector<float> const trace{samples()};
+  opendlv::proxy::DistanceReading reading;
+  uint64_t const allocations{allocationCount()};
+  uint32_t i{0};
+  while (state.keepRunning()) {
+    reading.distance(trace[i++ & 1023]);
+    behavior.setFrontUltrasonic(reading);
+  }
+  doNotOptimize(behavior.getFrontUltrasonic().distance());
+  state.setCounter("allocs/op", static_cast<double>(allocationCount() - allocations) / static_cast<double>(state.iterations()));
+  state.setItemsProcessed(state.iterations());
+}
@@ -0,0 +1,64 @@
+/*
+ * Copyright (C) 2018 Ola Benderius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "sensor-history.hpp"
+#include "bench.hpp"
+
+namespace {
+
+// A full history of 10 Hz samples queried at instants spread over it and
+// slightly past its end. Items are lookups.
+void lookup(BenchmarkState &state, int64_t spread)
+{
+  SensorHistory history;
+  for (int64_t i{0}; i < SensorHistory::CAPACITY; i++) {
+    history.add(i * 100000, static_cast<float>(i % 7));
+  }
+  int64_t const newest{history.newestTime()};
+  uint64_t i{0};
+  float sum{0.0f};
+  while (state.keepRunning()) {
+    int64_t const time{newest + 50000 - static_cast<int64_t>((i++ * 7919) % static_cast<uint64_t>(spread))};
+    sum += history.at(time, 100000).value;
+  }
+  doNotOptimize(sum);
+  state.setItemsProcessed(state.iterations());
+}
+
+}
+
+BENCHMARK_CASE("SensorHistory/add")
+{
+  SensorHistory history;
+  int64_t time{0};
+  while (state.keepRunning()) {
+    history.add(time, static_cast<float>(time & 0xff));
+    time += 100000;
+  }
+  doNotOptimize(history.newestTime());
+  state.setItemsProcessed(state.iterations());
+}
+
+BENCHMARK_CASE("SensorHistory/at/latest tick")
+{
+  lookup(state, 100000);
+}
+
+BENCHMARK_CASE("SensorHistory/at/whole history")
+{
+  lookup(state, static_cast<int64_t>(SensorHistory::CAPACITY) * 100000);
+}
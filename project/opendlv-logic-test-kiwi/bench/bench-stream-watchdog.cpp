@@ -0,0 +1,72 @@
+/*
+ * Copyright (C) 2018 Ola Benderius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <vector>
+
+#include "stream-watchdog.hpp"
+#include "bench.hpp"
+
+// The percentage of one core the watchdog takes at 10 000 messages per
+// second is reported as "core % at 10k/s".
+
+BENCHMARK_CASE("StreamWatchdog/heartbeat")
+{
+  StreamWatchdog watchdog{StreamWatchdog::Config{}};
+  for (uint32_t i{0}; i < 4; i++) {
+    watchdog.addStream("sensor", 10.0f);
+  }
+  int64_t time{0};
+  while (state.keepRunning()) {
+    watchdog.heartbeat(static_cast<uint32_t>(time & 3), time);
+    time += 100;
+  }
+  doNotOptimize(watchdog.messages(0));
+  state.setCounter("core % at 10k/s", state.elapsedSeconds() / static_cast<double>(state.iterations()) * 1e6);
+  state.setItemsProcessed(state.iterations());
+}
+
+// Messages at 10 kHz spread over 32 streams, with the wheel advanced by a
+// 10 Hz control loop and one stream stalling and coming back every
+// second. Items are messages; the advance() calls are included.
+BENCHMARK_CASE("StreamWatchdog/10k messages per s")
+{
+  StreamWatchdog watchdog{StreamWatchdog::Config{}};
+  for (uint32_t i{0}; i < StreamWatchdog::MAX_STREAMS; i++) {
+    watchdog.addStream("sensor", 10000.0f / static_cast<float>(StreamWatchdog::MAX_STREAMS));
+  }
+  std::vector<StreamWatchdog::Change> changes;
+  changes.reserve(StreamWatchdog::MAX_STREAMS);
+  uint64_t const allocations{allocationCount()};
+  uint64_t message{0};
+  uint64_t stalls{0};
+  while (state.keepRunning()) {
+    int64_t const time{static_cast<int64_t>(message) * 100};
+    uint32_t const stream{static_cast<uint32_t>(message % StreamWatchdog::MAX_STREAMS)};
+    if (0 != stream || 5000 > message % 10000) {
+      watchdog.heartbeat(stream, time);
+    }
+    if (0 == message % 1000) {
+      changes.clear();
+      stalls += watchdog.advance(time, changes);
+    }
+    message++;
+  }
+  doNotOptimize(stalls);
+  state.setCounter("allocs/op", static_cast<double>(allocationCount() - allocations) / static_cast<double>(state.iterations()));
+  state.setCounter("core % at 10k/s", state.elapsedSeconds() / static_cast<double>(state.iterations()) * 1e6);
+  state.setItemsProcessed(state.iterations());
+}
@@ -0,0 +1,341 @@
+/*
+ * Copyright (C) 2018 Ola Benderius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <ctime>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <numeric>
+#include <utility>
+#include <vector>
+
+#include "cluon-complete.hpp"
+#include "bench.hpp"
+
+namespace {
+
+std::atomic<uint64_t> g_allocations{0};
+
+// Process CPU time, so that time spent in helper threads is included.
+double processCpuSeconds() noexcept
+{
+  struct timespec now{};
+  ::clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &now);
+  return static_cast<double>(now.tv_sec) + static_cast<double>(now.tv_nsec) * 1e-9;
+}
+
+void writeJsonString(std::ostream &out, std::string const &text)
+{
+  out << '"';
+  for (char const c : text) {
+    if ('"' == c || '\\' == c) {
+      out << '\\';
+    }
+    out << c;
+  }
+  out << '"';
+}
+
+struct Result {
+  std::string name{};
+  std::string aggregate{};
+  uint32_t repetition{0};
+  uint64_t iterations{0};
+  double realNanoseconds{0.0};
+  double cpuNanoseconds{0.0};
+  double itemsPerSecond{0.0};
+  std::map<std::string, double> counters{};
+};
+
+Result measure(std::string const &name, BenchmarkState const &state, uint32_t repetition)
+{
+  double const elapsed{state.elapsedSeconds()};
+  Result result;
+  result.name = name;
+  result.repetition = repetition;
+  result.iterations = state.iterations();
+  result.realNanoseconds = elapsed * 1e9 / static_cast<double>(state.iterations());
+  result.cpuNanoseconds = state.cpuSeconds() * 1e9 / static_cast<double>(state.iterations());
+  result.itemsPerSecond = (elapsed > 0.0) ? static_cast<double>(state.itemsProcessed()) / elapsed : 0.0;
+  result.counters = state.counters();
+  return result;
+}
+
+// Median, mean and standard deviation over the repetitions of a benchmark,
+// reported like Google Benchmark does with --benchmark_repetitions.
+std::vector<Result> aggregate(std::vector<Result> const &repetitions)
+{
+  auto const statistic = [&repetitions](double Result::*field, std::string const &name) {
+    std::vector<double> values;
+    for (auto const &repetition : repetitions) {
+      values.push_back(repetition.*field);
+    }
+    std::sort(values.begin(), values.end());
+    std::size_t const n{values.size()};
+    double const mean{std::accumulate(values.begin(), values.end(), 0.0) / static_cast<double>(n)};
+    if ("median" == name) {
+      return (0 == n % 2) ? 0.5 * (values[n / 2 - 1] + values[n / 2]) : values[n / 2];
+    }
+    if ("stddev" == name) {
+      double sum{0.0};
+      for (double const value : values) {
+        sum += (value - mean) * (value - mean);
+      }
+      return std::sqrt(sum / static_cast<double>(n - 1));
+    }
+    return mean;
+  };
+
+  std::vector<Result> aggregates;
+  for (std::string const name : {"mean", "median", "stddev"}) {
+    Result result;
+    result.name = repetitions.front().name + "_" + name;
+    result.aggregate = name;
+    result.iterations = repetitions.size();
+    result.realNanoseconds = statistic(&Result::realNanoseconds, name);
+    result.cpuNanoseconds = statistic(&Result::cpuNanoseconds, name);
+    result.itemsPerSecond = statistic(&Result::itemsPerSecond, name);
+    aggregates.push_back(result);
+  }
+  return aggregates;
+}
+
+void printResult(Result const &result)
+{
+  std::cout << std::left << std::setw(56) << result.name << std::right
+    << std::setw(14) << result.iterations << std::setw(14) << std::fixed << std::setprecision(1) << result.realNanoseconds
+    << std::setw(16) << std::setprecision(0) << result.itemsPerSecond;
+  for (auto const &counter : result.counters) {
+    std::cout << " " << counter.first << "=" << std::setprecision(3) << counter.second;
+  }
+  std::cout << std::endl;
+}
+
+// Same layout as Google Benchmark's --benchmark_format=json, so its
+// tooling can read the results as well.
+void writeJson(std::ostream &out, char const *executable, uint32_t repetitions, std::vector<Result> const &results)
+{
+  char hostName[256]{};
+  ::gethostname(hostName, sizeof(hostName) - 1);
+  char date[32]{};
+  std::time_t const now{std::time(nullptr)};
+  std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S%z", std::localtime(&now));
+
+  out << std::setprecision(17) << "{\n  \"context\": {\n    \"date\": ";
+  writeJsonString(out, date);
+  out << ",\n    \"host_name\": ";
+  writeJsonString(out, hostName);
+  out << ",\n    \"executable\": ";
+  writeJsonString(out, executable);
+  out << ",\n    \"num_cpus\": " << ::sysconf(_SC_NPROCESSORS_ONLN)
+    << ",\n    \"libcluon\": ";
+  writeJsonString(out, CLUON_COMPLETE_VERSION);
+  out << ",\n    \"library_build_type\": \"release\"\n  },\n  \"benchmarks\": [";
+  for (std::size_t i{0}; i < results.size(); i++) {
+    Result const &result = results[i];
+    std::string const runName{result.aggregate.empty() ? result.name : result.name.substr(0, result.name.size() - result.aggregate.size() - 1)};
+    out << ((0 == i) ? "\n" : ",\n") << "    {\"name\": ";
+    writeJsonString(out, result.name);
+    out << ", \"run_name\": ";
+    writeJsonString(out, runName);
+    if (result.aggregate.empty()) {
+      out << ", \"run_type\": \"iteration\", \"repetitions\": " << repetitions << ", \"repetition_index\": " << result.repetition;
+    } else {
+      out << ", \"run_type\": \"aggregate\", \"repetitions\": " << repetitions << ", \"aggregate_name\": ";
+      writeJsonString(out, result.aggregate);
+    }
+    out << ", \"iterations\": " << result.iterations
+      << ", \"real_time\": " << result.realNanoseconds << ", \"cpu_time\": " << result.cpuNanoseconds
+      << ", \"time_unit\": \"ns\", \"items_per_second\": " << result.itemsPerSecond;
+    for (auto const &counter : result.counters) {
+      out << ", ";
+      writeJsonString(out, counter.first);
+      out << ": " << counter.second;
+    }
+    out << "}";
+  }
+  out << "\n  ]\n}\n";
+}
+
+std::vector<std::pair<std::string, std::function<void(BenchmarkState &)>>> &benchmarks()
+{
+  static std::vector<std::pair<std::string, std::function<void(BenchmarkState &)>>> registered;
+  return registered;
+}
+
+}
+
+// Counting replacements of the global allocation functions; the array and
+// nothrow forms forward to these. They are not inlined, so that GCC does not
+// match the malloc() and free() inside against new and delete expressions.
+__attribute__((noinline)) void *operator new(std::size_t size)
+{
+  g_allocations.fetch_add(1, std::memory_order_relaxed);
+  void *p{std::malloc((0 == size) ? 1 : size)};
+  if (nullptr == p) {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+__attribute__((noinline)) void operator delete(void *p) noexcept
+{
+  std::free(p);
+}
+
+__attribute__((noinline)) void operator delete(void *p, std::size_t) noexcept
+{
+  std::free(p);
+}
+
+uint64_t allocationCount() noexcept
+{
+  return g_allocations.load(std::memory_order_relaxed);
+}
+
+BenchmarkState::BenchmarkState(uint64_t iterations) noexcept:
+  m_iterations{iterations},
+  m_remaining{iterations + 1},
+  m_itemsProcessed{0},
+  m_start{},
+  m_stop{},
+  m_cpuStart{0.0},
+  m_cpuStop{0.0},
+  m_counters{}
+{
+}
+
+bool BenchmarkState::keepRunning() noexcept
+{
+  if (m_remaining == m_iterations + 1) {
+    m_cpuStart = processCpuSeconds();
+    m_start = std::chrono::steady_clock::now();
+  }
+  if (--m_remaining > 0) {
+    return true;
+  }
+  m_stop = std::chrono::steady_clock::now();
+  m_cpuStop = processCpuSeconds();
+  return false;
+}
+
+uint64_t BenchmarkState::iterations() const noexcept
+{
+  return m_iterations;
+}
+
+double BenchmarkState::elapsedSeconds() const noexcept
+{
+  return std::chrono::duration<double>(m_stop - m_start).count();
+}
+
+double BenchmarkState::cpuSeconds() const noexcept
+{
+  return m_cpuStop - m_cpuStart;
+}
+
+uint64_t BenchmarkState::itemsProcessed() const noexcept
+{
+  return m_itemsProcessed;
+}
+
+void BenchmarkState::setItemsProcessed(uint64_t itemsProcessed) noexcept
+{
+  m_itemsProcessed = itemsProcessed;
+}
+
+std::map<std::string, double> const &BenchmarkState::counters() const noexcept
+{
+  return m_counters;
+}
+
+void BenchmarkState::setCounter(std::string const &name, double value) noexcept
+{
+  m_counters[name] = value;
+}
+
+bool registerBenchmark(std::string const &name, std::function<void(BenchmarkState &)> function)
+{
+  benchmarks().emplace_back(name, std::move(function));
+  return true;
+}
+
+int32_t main(int32_t argc, char **argv) {
+  auto commandlineArguments = cluon::getCommandlineArguments(argc, argv);
+  std::string const FILTER{commandlineArguments["filter"]};
+  double const MIN_TIME{(0 != commandlineArguments.count("min-time")) ? std::stod(commandlineArguments["min-time"]) : 0.5};
+  uint32_t const REPETITIONS{(0 != commandlineArguments.count("repetitions")) ? static_cast<uint32_t>(std::max(1, std::stoi(commandlineArguments["repetitions"]))) : 1};
+  std::string const JSON_FILE{commandlineArguments["json"]};
+  std::vector<Result> results;
+
+  std::cout << std::left << std::setw(56) << "Benchmark" << std::right
+    << std::setw(14) << "Iterations" << std::setw(14) << "ns/op" << std::setw(16) << "items/s" << std::endl;
+  for (auto &benchmark : benchmarks()) {
+    if (!FILTER.empty() && std::string::npos == benchmark.first.find(FILTER)) {
+      continue;
+    }
+
+    // Grow the iteration count until one run lasts at least MIN_TIME; that
+    // run is the first repetition and the others use the same count.
+    std::vector<Result> repetitions;
+    uint64_t iterations{1};
+    while (true) {
+      BenchmarkState state{iterations};
+      benchmark.second(state);
+      double const elapsed{state.elapsedSeconds()};
+      if (elapsed >= MIN_TIME || iterations >= (1ull << 40)) {
+        repetitions.push_back(measure(benchmark.first, state, 0));
+        break;
+      }
+      double const factor{(elapsed > 0.0) ? 1.4 * MIN_TIME / elapsed : 10.0};
+      iterations = static_cast<uint64_t>(static_cast<double>(iterations) * ((factor > 10.0) ? 10.0 : ((factor < 2.0) ? 2.0 : factor)));
+    }
+    for (uint32_t repetition{1}; repetition < REPETITIONS; repetition++) {
+      BenchmarkState state{iterations};
+      benchmark.second(state);
+      repetitions.push_back(measure(benchmark.first, state, repetition));
+    }
+
+    for (auto const &result : repetitions) {
+      printResult(result);
+    }
+    results.insert(results.end(), repetitions.begin(), repetitions.end());
+    if (REPETITIONS > 1) {
+      for (auto const &result : aggregate(repetitions)) {
+        printResult(result);
+        results.push_back(result);
+      }
+    }
+  }
+
+  if (!JSON_FILE.empty()) {
+    std::ofstream file{JSON_FILE};
+    writeJson(file, argv[0], REPETITIONS, results);
+    if (!file.good()) {
+      std::cerr << argv[0] << ": failed to write " << JSON_FILE << "." << std::endl;
+      return 1;
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,504 @@
+/*
+ * Copyright (C) 2018 Ola Benderius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iterator>
+#include <sstream>
+
+#include "benchmark-comparison.hpp"
+
+namespace {
+
+// Just enough JSON for benchmark result files: objects, arrays, strings,
+// numbers and literals, kept as a tree.
+struct JsonValue {
+  enum class Type { Null, Boolean, Number, String, Array, Object };
+  Type type{Type::Null};
+  double number{0.0};
+  std::string text{};
+  std::vector<JsonValue> elements{};
+  std::vector<std::pair<std::string, JsonValue>> members{};
+
+  JsonValue const *find(std::string const &key) const noexcept
+  {
+    for (auto const &member : members) {
+      if (member.first == key) {
+        return &member.second;
+      }
+    }
+    return nullptr;
+  }
+};
+
+class JsonReader {
+ private:
+  JsonReader(JsonReader const &) = delete;
+  JsonReader(JsonReader &&) = delete;
+  JsonReader &operator=(JsonReader const &) = delete;
+  JsonReader &operator=(JsonReader &&) = delete;
+
+ public:
+  explicit JsonReader(std::string const &input) noexcept:
+    m_input(input),
+    m_position{0},
+    m_error{}
+  {
+  }
+  ~JsonReader() = default;
+
+  bool read(JsonValue &value)
+  {
+    if (!parseValue(value, 0)) {
+      return false;
+    }
+    skipWhitespace();
+    return (m_position == m_input.size()) || fail("trailing characters");
+  }
+
+  std::string const &error() const noexcept
+  {
+    return m_error;
+  }
+
+ private:
+  static uint32_t const MAX_DEPTH{64};
+
+  bool fail(char const *what)
+  {
+    if (m_error.empty()) {
+      m_error = std::string(what) + " at offset " + std::to_string(m_position);
+    }
+    return false;
+  }
+
+  void skipWhitespace() noexcept
+  {
+    while (m_position < m_input.size() && nullptr != std::strchr(" \t\r\n", m_input[m_position])) {
+      m_position++;
+    }
+  }
+
+  bool consume(char c) noexcept
+  {
+    skipWhitespace();
+    if (m_position < m_input.size() && c == m_input[m_position]) {
+      m_position++;
+      return true;
+    }
+    return false;
+  }
+
+  bool parseValue(JsonValue &value, uint32_t depth)
+  {
+    skipWhitespace();
+    if (depth > MAX_DEPTH) {
+      return fail("nesting too deep");
+    }
+    if (m_position >= m_input.size()) {
+      return fail("unexpected end");
+    }
+    char const c{m_input[m_position]};
+    if ('{' == c) {
+      m_position++;
+      value.type = JsonValue::Type::Object;
+      if (consume('}')) {
+        return true;
+      }
+      do {
+        std::pair<std::string, JsonValue> member;
+        skipWhitespace();
+        if (!parseString(member.first) || !consume(':') || !parseValue(member.second, depth + 1)) {
+          return fail("malformed object");
+        }
+        value.members.push_back(std::move(member));
+      } while (consume(','));
+      return consume('}') || fail("expected }");
+    }
+    if ('[' == c) {
+      m_position++;
+      value.type = JsonValue::Type::Array;
+      if (consume(']')) {
+        return true;
+      }
+      do {
+        value.elements.emplace_back();
+        if (!parseValue(value.elements.back(), depth + 1)) {
+          return false;
+        }
+      } while (consume(','));
+      return consume(']') || fail("expected ]");
+    }
+    if ('"' == c) {
+      value.type = JsonValue::Type::String;
+      return parseString(value.text);
+    }
+    for (char const *literal : {"true", "false", "null"}) {
+      std::size_t const length{std::strlen(literal)};
+      if (0 == m_input.compare(m_position, length, literal)) {
+        m_position += length;
+        value.type = ('n' == literal[0]) ? JsonValue::Type::Null : JsonValue::Type::Boolean;
+        value.number = ('t' == literal[0]) ? 1.0 : 0.0;
+        return true;
+      }
+    }
+    char *end{nullptr};
+    value.number = std::strtod(m_input.c_str() + m_position, &end);
+    if (end == m_input.c_str() + m_position) {
+      return fail("unexpected character");
+    }
+    value.type = JsonValue::Type::Number;
+    m_position = static_cast<std::size_t>(end - m_input.c_str());
+    return true;
+  }
+
+  // Escapes other than \uXXXX are decoded; those are kept verbatim, as
+  // benchmark names are ASCII.
+  bool parseString(std::string &text)
+  {
+    if (m_position >= m_input.size() || '"' != m_input[m_position]) {
+      return fail("expected string");
+    }
+    m_position++;
+    while (m_position < m_input.size()) {
+      char const c{m_input[m_position++]};
+      if ('"' == c) {
+        return true;
+      }
+      if ('\\' == c && m_position < m_input.size()) {
+        char const escaped{m_input[m_position++]};
+        switch (escaped) {
+          case 'n': text.push_back('\n'); break;
+          case 't': text.push_back('\t'); break;
+          case 'r': text.push_back('\r'); break;
+          case 'b': text.push_back('\b'); break;
+          case 'f': text.push_back('\f'); break;
+          case 'u': text.append("\\u"); break;
+          default: text.push_back(escaped); break;
+        }
+      } else {
+        text.push_back(c);
+      }
+    }
+    return fail("unterminated string");
+  }
+
+ private:
+  std::string const &m_input;
+  std::size_t m_position;
+  std::string m_error;
+};
+
+double nanosecondsPer(std::string const &unit) noexcept
+{
+  if ("us" == unit) {
+    return 1e3;
+  }
+  if ("ms" == unit) {
+    return 1e6;
+  }
+  if ("s" == unit) {
+    return 1e9;
+  }
+  return 1.0;
+}
+
+// P(X < k) for X ~ Binomial(n, 1/2).
+double binomialBelow(std::size_t n, std::size_t k) noexcept
+{
+  double sum{0.0};
+  for (std::size_t i{0}; i < k && i <= n; i++) {
+    sum += std::exp(std::lgamma(static_cast<double>(n) + 1.0) - std::lgamma(static_cast<double>(i) + 1.0)
+        - std::lgamma(static_cast<double>(n - i) + 1.0) - static_cast<double>(n) * std::log(2.0));
+  }
+  return sum;
+}
+
+double binomialCoefficient(std::size_t n, std::size_t k) noexcept
+{
+  return std::exp(std::lgamma(static_cast<double>(n) + 1.0) - std::lgamma(static_cast<double>(k) + 1.0)
+      - std::lgamma(static_cast<double>(n - k) + 1.0));
+}
+
+// Exact two-sided p-value from the permutation distribution of the rank sum
+// of the first sample. Ranks are doubled so that tied (mid-)ranks stay
+// integers; ways[k][s] counts the subsets of k ranks with doubled sum s.
+double exactRankSumPValue(std::vector<int64_t> const &doubledRanks, std::size_t n1, int64_t observedSum) noexcept
+{
+  std::size_t const n{doubledRanks.size()};
+  int64_t total{0};
+  for (int64_t const rank : doubledRanks) {
+    total += rank;
+  }
+  std::vector<std::vector<double>> ways(n1 + 1, std::vector<double>(static_cast<std::size_t>(total) + 1, 0.0));
+  ways[0][0] = 1.0;
+  for (int64_t const rank : doubledRanks) {
+    for (std::size_t k{n1}; k > 0; k--) {
+      for (int64_t sum{total}; sum >= rank; sum--) {
+        ways[k][static_cast<std::size_t>(sum)] += ways[k - 1][static_cast<std::size_t>(sum - rank)];
+      }
+    }
+  }
+  // Deviations from the mean rank sum, scaled by n to stay integers.
+  int64_t const scale{static_cast<int64_t>(n)};
+  int64_t const expected{static_cast<int64_t>(n1) * total};
+  int64_t const observed{std::llabs(scale * observedSum - expected)};
+  double extreme{0.0};
+  for (int64_t sum{0}; sum <= total; sum++) {
+    if (std::llabs(scale * sum - expected) >= observed) {
+      extreme += ways[n1][static_cast<std::size_t>(sum)];
+    }
+  }
+  return std::min(1.0, extreme / binomialCoefficient(n, n1));
+}
+
+}
+
+bool readBenchmarkResults(std::istream &in, BenchmarkResults &results, std::string &error)
+{
+  std::string const input{std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()};
+  JsonValue root;
+  JsonReader reader{input};
+  if (!reader.read(root)) {
+    error = reader.error();
+    return false;
+  }
+  JsonValue const *benchmarks{root.find("benchmarks")};
+  if (nullptr == benchmarks || JsonValue::Type::Array != benchmarks->type) {
+    error = "no benchmarks array";
+    return false;
+  }
+
+  results = BenchmarkResults();
+  JsonValue const *context{root.find("context")};
+  if (nullptr != context) {
+    for (auto const &member : context->members) {
+      std::ostringstream value;
+      if (JsonValue::Type::String == member.second.type) {
+        value << member.second.text;
+      } else {
+        value << member.second.number;
+      }
+      results.context[member.first] = value.str();
+    }
+  }
+  for (auto const &benchmark : benchmarks->elements) {
+    JsonValue const *name{benchmark.find("name")};
+    JsonValue const *runType{benchmark.find("run_type")};
+    JsonValue const *realTime{benchmark.find("real_time")};
+    JsonValue const *timeUnit{benchmark.find("time_unit")};
+    if (nullptr == name || nullptr == realTime || JsonValue::Type::Number != realTime->type) {
+      continue;
+    }
+    // Aggregates are recomputed from the repetitions.
+    if (nullptr != runType && "aggregate" == runType->text) {
+      continue;
+    }
+    double const scale{(nullptr != timeUnit) ? nanosecondsPer(timeUnit->text) : 1.0};
+    results.samples[name->text].push_back(realTime->number * scale);
+  }
+  return true;
+}
+
+double median(std::vector<double> values)
+{
+  if (values.empty()) {
+    return 0.0;
+  }
+  std::sort(values.begin(), values.end());
+  std::size_t const n{values.size()};
+  return (0 == n % 2) ? 0.5 * (values[n / 2 - 1] + values[n / 2]) : values[n / 2];
+}
+
+Interval medianInterval(std::vector<double> values, double confidence)
+{
+  Interval interval;
+  if (values.empty()) {
+    return interval;
+  }
+  std::sort(values.begin(), values.end());
+  std::size_t const n{values.size()};
+  // The largest k with P(X < k) <= (1 - confidence) / 2 gives the interval
+  // [x(k), x(n - k + 1)] of the sorted values, counted from one.
+  std::size_t k{0};
+  while (k + 1 <= n / 2 && binomialBelow(n, k + 1) <= 0.5 * (1.0 - confidence)) {
+    k++;
+  }
+  interval.low = values[(k > 0) ? k - 1 : 0];
+  interval.high = values[(k > 0) ? n - k : n - 1];
+  return interval;
+}
+
+double mannWhitneyPValue(std::vector<double> const &a, std::vector<double> const &b)
+{
+  std::size_t const n1{a.size()};
+  std::size_t const n2{b.size()};
+  if (n1 < 2 || n2 < 2) {
+    return 1.0;
+  }
+  std::vector<std::pair<double, bool>> all;
+  for (double const value : a) {
+    all.emplace_back(value, true);
+  }
+  for (double const value : b) {
+    all.emplace_back(value, false);
+  }
+  std::sort(all.begin(), all.end(), [](std::pair<double, bool> const &x, std::pair<double, bool> const &y) { return x.first < y.first; });
+
+  // Tied values share their average rank.
+  std::size_t const n{all.size()};
+  std::vector<int64_t> doubledRanks;
+  int64_t doubledRankSumA{0};
+  double tieCorrection{0.0};
+  for (std::size_t i{0}; i < n;) {
+    std::size_t j{i + 1};
+    while (j < n && !(all[i].first < all[j].first)) {
+      j++;
+    }
+    int64_t const doubledRank{static_cast<int64_t>(i + 1 + j)};
+    double const ties{static_cast<double>(j - i)};
+    tieCorrection += ties * ties * ties - ties;
+    for (std::size_t t{i}; t < j; t++) {
+      doubledRanks.push_back(doubledRank);
+      if (all[t].second) {
+        doubledRankSumA += doubledRank;
+      }
+    }
+    i = j;
+  }
+  if (n <= MANN_WHITNEY_EXACT_LIMIT) {
+    return exactRankSumPValue(doubledRanks, n1, doubledRankSumA);
+  }
+  double const rankSumA{0.5 * static_cast<double>(doubledRankSumA)};
+
+  double const m1{static_cast<double>(n1)};
+  double const m2{static_cast<double>(n2)};
+  double const total{m1 + m2};
+  double const u{rankSumA - m1 * (m1 + 1.0) / 2.0};
+  double const mean{m1 * m2 / 2.0};
+  double const variance{m1 * m2 / 12.0 * ((total + 1.0) - tieCorrection / (total * (total - 1.0)))};
+  if (variance <= 0.0) {
+    return 1.0;
+  }
+  double const z{std::max(0.0, std::fabs(u - mean) - 0.5) / std::sqrt(variance)};
+  return std::erfc(z / std::sqrt(2.0));
+}
+
+double mannWhitneyMinimumPValue(std::size_t n1, std::size_t n2)
+{
+  if (n1 < 2 || n2 < 2) {
+    return 1.0;
+  }
+  // Only the two complete separations are as extreme as themselves.
+  return std::min(1.0, 2.0 / binomialCoefficient(n1 + n2, n1));
+}
+
+std::vector<BenchmarkComparison> compareBenchmarks(BenchmarkResults const &baseline, BenchmarkResults const &contender, ComparisonCriteria const &criteria)
+{
+  std::vector<BenchmarkComparison> comparisons;
+  for (auto const &entry : baseline.samples) {
+    auto const other = contender.samples.find(entry.first);
+    if (contender.samples.end() == other || entry.second.empty() || other->second.empty()) {
+      continue;
+    }
+    BenchmarkComparison comparison;
+    comparison.name = entry.first;
+    comparison.baselineRepetitions = entry.second.size();
+    comparison.contenderRepetitions = other->second.size();
+    comparison.baselineMedian = median(entry.second);
+    comparison.contenderMedian = median(other->second);
+    comparison.baselineInterval = medianInterval(entry.second, criteria.confidence);
+    comparison.contenderInterval = medianInterval(other->second, criteria.confidence);
+    comparison.change = (comparison.baselineMedian > 0.0) ? comparison.contenderMedian / comparison.baselineMedian - 1.0 : 0.0;
+    comparison.pValue = mannWhitneyPValue(entry.second, other->second);
+
+    comparison.gated = criteria.gates.empty();
+    for (auto const &gate : criteria.gates) {
+      comparison.gated = comparison.gated || std::string::npos != entry.first.find(gate);
+    }
+    // When even a complete separation of the repetitions cannot give
+    // p < alpha, the threshold alone decides.
+    comparison.tested = mannWhitneyMinimumPValue(comparison.baselineRepetitions, comparison.contenderRepetitions) < criteria.alpha;
+    comparison.regressed = comparison.gated && comparison.change > criteria.threshold
+      && (!comparison.tested || comparison.pValue < criteria.alpha);
+    comparisons.push_back(comparison);
+  }
+  return comparisons;
+}
+
+uint32_t writeComparisonReport(std::ostream &out, BenchmarkResults const &baseline, BenchmarkResults const &contender,
+    std::vector<BenchmarkComparison> const &comparisons, ComparisonCriteria const &criteria)
+{
+  auto const describe = [](BenchmarkResults const &results) {
+    std::string description;
+    for (char const *key : {"libcluon", "date", "host_name"}) {
+      auto const it = results.context.find(key);
+      if (results.context.end() != it) {
+        description += (description.empty() ? "" : ", ") + it->second;
+      }
+    }
+    return description;
+  };
+  auto const interval = [](double value, Interval const &i) {
+    std::ostringstream text;
+    text << std::fixed << std::setprecision(1) << value << " [" << i.low << ", " << i.high << "]";
+    return text.str();
+  };
+
+  out << "Baseline:  " << describe(baseline) << "\n"
+    << "Contender: " << describe(contender) << "\n"
+    << "Medians in ns with " << std::setprecision(3) << criteria.confidence * 100.0 << " % intervals; a gated benchmark regresses above +"
+    << criteria.threshold * 100.0 << " % with p < " << criteria.alpha << ".\n\n";
+  out << std::left << std::setw(52) << "Benchmark" << std::setw(30) << "Baseline" << std::setw(30) << "Contender"
+    << std::right << std::setw(9) << "Change" << std::setw(9) << "p" << "\n";
+
+  uint32_t regressions{0};
+  uint32_t gated{0};
+  bool untested{false};
+  for (auto const &comparison : comparisons) {
+    untested = untested || (comparison.gated && !comparison.tested);
+    gated += comparison.gated ? 1 : 0;
+    regressions += comparison.regressed ? 1 : 0;
+    std::ostringstream change;
+    change << std::showpos << std::fixed << std::setprecision(1) << comparison.change * 100.0 << "%";
+    std::ostringstream p;
+    if (comparison.tested) {
+      p << std::fixed << std::setprecision(4) << comparison.pValue;
+    } else {
+      p << "-";
+    }
+    out << std::left << std::setw(52) << comparison.name
+      << std::setw(30) << interval(comparison.baselineMedian, comparison.baselineInterval)
+      << std::setw(30) << interval(comparison.contenderMedian, comparison.contenderInterval)
+      << std::right << std::setw(9) << change.str() << std::setw(9) << p.str()
+      << (comparison.regressed ? "  REGRESSION" : (comparison.gated ? "" : "  (not gated)")) << "\n";
+  }
+  for (auto const &entry : baseline.samples) {
+    if (0 == contender.samples.count(entry.first)) {
+      out << std::left << std::setw(52) << entry.first << "missing in contender\n";
+    }
+  }
+  out << "\n" << regressions << " of " << gated << " gated benchmarks regressed.\n";
+  if (untested) {
+    out << "WARNING: some gated benchmarks have too few repetitions to reach p < " << criteria.alpha
+      << " and were judged by the threshold alone; run the benchmarks with --repetitions=10.\n";
+  }
+  return regressions;
+}
@@ -0,0 +1,172 @@
+/*
+ * Copyright (C) 2018 Ola Benderius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cmath>
+#include <cstdlib>
+#include <sstream>
+
+#include "behavior-parameters.hpp"
+
+namespace {
+
+struct Field {
+  char const *name;
+  float BehaviorParameters::*value;
+};
+
+Field const FIELDS[] = {
+  {"speed", &BehaviorParameters::speed},
+  {"front", &BehaviorParameters::front},
+  {"rear", &BehaviorParameters::rear},
+  {"goalDistanceToWall", &BehaviorParameters::goalDistanceToWall},
+  {"sideWall", &BehaviorParameters::sideWall},
+  {"reverseTimeThreshold", &BehaviorParameters::reverseTimeThreshold},
+  {"groundSteering", &BehaviorParameters::groundSteering},
+  {"wallSteering", &BehaviorParameters::wallSteering},
+  {"rearMin", &BehaviorParameters::rearMin},
+  {"reverseSpeed", &BehaviorParameters::reverseSpeed},
+  {"Kp_side", &BehaviorParameters::Kp_side},
+  {"sideDistanceForStraightReverse", &BehaviorParameters::sideDistanceForStraightReverse},
+  {"frontDistance45", &BehaviorParameters::frontDistance45},
+  {"sideDistance45", &BehaviorParameters::sideDistance45},
+  {"forwardTimeAfterReverseLimit", &BehaviorParameters::forwardTimeAfterReverseLimit},
+  {"addAngleAfterReverse", &BehaviorParameters::addAngleAfterReverse},
+  {"maxSensorAge", &BehaviorParameters::maxSensorAge},
+  {"maxExtrapolation", &BehaviorParameters::maxExtrapolation},
+  {"creepSpeed", &BehaviorParameters::creepSpeed},
+  {"maxSteering", &BehaviorParameters::maxSteering},
+  {"reverseSideClearance", &BehaviorParameters::reverseSideClearance},
+  {"centering", &BehaviorParameters::centering},
+  {"centeringKp", &BehaviorParameters::centeringKp},
+  {"centeringKi", &BehaviorParameters::centeringKi},
+  {"centeringKd", &BehaviorParameters::centeringKd},
+  {"centeringDerivativeTime", &BehaviorParameters::centeringDerivativeTime},
+  {"centeringReferenceSpeed", &BehaviorParameters::centeringReferenceSpeed},
+  {"centeringMaxSteering", &BehaviorParameters::centeringMaxSteering}
+};
+
+Field const *findField(std::string const &name) noexcept
+{
+  for (Field const &field : FIELDS) {
+    if (name == field.name) {
+      return &field;
+    }
+  }
+  return nullptr;
+}
+
+std::string trim(std::string const &text)
+{
+  std::size_t const begin{text.find_first_not_of(" \t\r")};
+  if (std::string::npos == begin) {
+    return std::string{};
+  }
+  return text.substr(begin, text.find_last_not_of(" \t\r") - begin + 1);
+}
+
+bool parseValue(std::string const &text, float &value) noexcept
+{
+  char *end{nullptr};
+  value = std::strtof(text.c_str(), &end);
+  return !text.empty() && '\0' == *end && std::isfinite(value);
+}
+
+}
+
+int32_t applyBehaviorParameters(std::string const &text, BehaviorParameters &parameters) noexcept
+{
+  try {
+    BehaviorParameters parsed{parameters};
+    int32_t count{0};
+    std::stringstream sstr{text};
+    std::string line;
+    while (std::getline(sstr, line)) {
+      line = trim(line);
+      if (line.empty() || '#' == line[0]) {
+        continue;
+      }
+      std::size_t const equals{line.find('=')};
+      if (std::string::npos == equals) {
+        return -1;
+      }
+      Field const *field{findField(trim(line.substr(0, equals)))};
+      float value;
+      if (nullptr == field || !parseValue(trim(line.substr(equals + 1)), value)) {
+        return -1;
+      }
+      parsed.*(field->value) = value;
+      count++;
+    }
+    parameters = parsed;
+    return count;
+  } catch (...) {
+    return -1;
+  }
+}
+
+int32_t applyBehaviorParameters(std::map<std::string, std::string> const &commandlineArguments, BehaviorParameters &parameters) noexcept
+{
+  BehaviorParameters parsed{parameters};
+  int32_t count{0};
+  for (Field const &field : FIELDS) {
+    auto it = commandlineArguments.find(field.name);
+    if (commandlineArguments.end() == it) {
+      continue;
+    }
+    float value;
+    if (!parseValue(it->second, value)) {
+      return -1;
+    }
+    parsed.*(field.value) = value;
+    count++;
+  }
+  parameters = parsed;
+  return count;
+}
+
+BehaviorParameterStore::BehaviorParameterStore(BehaviorParameters const &parameters):
+  m_current{std::make_shared<BehaviorParameters const>(parameters)},
+  m_updateMutex{},
+  m_revision{0}
+{
+}
+
+std::shared_ptr<BehaviorParameters const> BehaviorParameterStore::current() const noexcept
+{
+  return std::atomic_load(&m_current);
+}
+
+int32_t BehaviorParameterStore::update(std::string const &text) noexcept
+{
+  std::lock_guard<std::mutex> lock(m_updateMutex);
+  BehaviorParameters parameters{*std::atomic_load(&m_current)};
+  int32_t const count{applyBehaviorParameters(text, parameters)};
+  if (0 < count) {
+    try {
+      std::atomic_store(&m_current, std::make_shared<BehaviorParameters const>(parameters));
+      m_revision++;
+    } catch (...) {
+      return -1;
+    }
+  }
+  return count;
+}
+
+uint64_t BehaviorParameterStore::revision() const noexcept
+{
+  return m_revision.load();
+}
@@ -0,0 +1,119 @@
+/*
+ * Copyright (C) 2018 Ola Benderius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BEHAVIOR_PARAMETERS
+#define BEHAVIOR_PARAMETERS
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+/*
+ * The tuning parameters of Behavior::step(), named like their command line
+ * options. The defaults are those of the Kiwi docker-compose setup.
+ */
+struct BehaviorParameters {
+  float speed{0.8f};
+  float front{0.2f};
+  float rear{0.4f};
+  float goalDistanceToWall{30.0f};
+  float sideWall{50.0f};
+  float reverseTimeThreshold{2.0f};
+  float groundSteering{0.05f};
+  float wallSteering{0.3f};
+  float rearMin{0.3f};
+  float reverseSpeed{0.8f};
+  float Kp_side{0.01f};
+  float sideDistanceForStraightReverse{20.0f};
+  float frontDistance45{0.5f};
+  float sideDistance45{50.0f};
+  float forwardTimeAfterReverseLimit{2.0f};
+  float addAngleAfterReverse{0.2f};
+  // Time-aligned steps count a sensor as stalled when its newest reading is
+  // older than this, and extrapolate readings at most this far, in seconds.
+  float maxSensorAge{0.5f};
+  float maxExtrapolation{0.1f};
+  // Pedal position of the creep and rear-only degraded modes.
+  float creepSpeed{0.2f};
+  // Bound of the P steering on Kp_side, which adds up outside the forward
+  // mode, in rad.
+  float maxSteering{0.6f};
+  // A reverse ends early when the rear ultrasonic reads below rear or a
+  // side IR below this, in cm; the rear ultrasonic only looks straight
+  // back, and misses a wall Kiwi backs into at an angle.
+  float reverseSideClearance{12.0f};
+  // Side-wall steering: 0 keeps the P steering on Kp_side, 1 switches to
+  // the PID corridor centering with the gains below, given at
+  // centeringReferenceSpeed and scheduled on the pedal position.
+  float centering{0.0f};
+  float centeringKp{0.04f};
+  float centeringKi{0.005f};
+  float centeringKd{0.1f};
+  float centeringDerivativeTime{0.1f};
+  float centeringReferenceSpeed{0.5f};
+  float centeringMaxSteering{0.3f};
+};
+
+/*
+ * Applies "name=value" lines to the parameters; blank lines and lines
+ * starting with '#' are skipped. Returns the number of values set, or -1
+ * (leaving the parameters untouched) on an unknown name or a value that
+ * is not a finite number.
+ */
+int32_t applyBehaviorParameters(std::string const &, BehaviorParameters &) noexcept;
+
+/*
+ * Applies the parameters given as command line options; other options are
+ * ignored. Returns -1 (leaving the parameters untouched) on a malformed
+ * value.
+ */
+int32_t applyBehaviorParameters(std::map<std::string, std::string> const &, BehaviorParameters &) noexcept;
+
+/*
+ * The parameters the control loop runs with. Updates build a new immutable
+ * set and swap it in atomically, so a tick always sees one consistent set
+ * and never waits for a reload.
+ */
+class BehaviorParameterStore {
+ private:
+  BehaviorParameterStore(BehaviorParameterStore const &) = delete;
+  BehaviorParameterStore(BehaviorParameterStore &&) = delete;
+  BehaviorParameterStore &operator=(BehaviorParameterStore const &) = delete;
+  BehaviorParameterStore &operator=(BehaviorParameterStore &&) = delete;
+
+ public:
+  explicit BehaviorParameterStore(BehaviorParameters const &);
+  ~BehaviorParameterStore() = default;
+
+ public:
+  std::shared_ptr<BehaviorParameters const> current() const noexcept;
+  // Applies "name=value" lines on top of the current parameters; returns
+  // as applyBehaviorParameters().
+  int32_t update(std::string const &) noexcept;
+  uint64_t revision() const noexcept;
+
+ private:
+  std::shared_ptr<BehaviorParameters const> m_current;
+  // Serializes updates, so that concurrent ones are not lost.
+  std::mutex m_updateMutex;
+  std::atomic<uint64_t> m_revision;
+};
+
+#endif
@@ -16,13 +16,28 @@
  */
 
 #include "behavior.hpp"
+#include "trace.hpp"
+#include <algorithm>
 #include <cmath>
 
+uint32_t const Behavior::FRONT_ULTRASONIC;
+uint32_t const Behavior::REAR_ULTRASONIC;
+uint32_t const Behavior::LEFT_IR;
+uint32_t const Behavior::RIGHT_IR;
+
 Behavior::Behavior() noexcept:
   m_frontUltrasonicReading{},
   m_rearUltrasonicReading{},
   m_leftIrReading{},
   m_rightIrReading{},
+  m_frontUltrasonicFilter{},
+  m_rearUltrasonicFilter{},
+  m_leftIrFilter{},
+  m_rightIrFilter{},
+  m_frontUltrasonicHistory{},
+  m_rearUltrasonicHistory{},
+  m_leftIrHistory{},
+  m_rightIrHistory{},
   m_groundSteeringAngleRequest{},
   m_pedalPositionRequest{},
   m_frontUltrasonicReadingMutex{},
@@ -30,7 +45,14 @@ Behavior::Behavior() noexcept:
   m_leftIrReadingMutex{},
   m_rightIrReadingMutex{},
   m_groundSteeringAngleRequestMutex{},
-  m_pedalPositionRequestMutex{}
+  m_pedalPositionRequestMutex{},
+  m_driveStateMachine{},
+  m_centeringController{},
+  m_groundSteeringAngle{0.0f},
+  m_stalledSensors{0},
+  m_missingSensors{0},
+  m_degradedMode{DegradedMode::Stop},
+  m_driveStateMachineMutex{}
 {
 }
 
@@ -71,39 +93,93 @@ void Behavior::setFrontUltrasonic(opendlv::proxy::DistanceReading const &frontUl
 {
   std::lock_guard<std::mutex> lock(m_frontUltrasonicReadingMutex);
   m_frontUltrasonicReading = frontUltrasonicReading;
+  m_frontUltrasonicReading.distance(m_frontUltrasonicFilter.update(frontUltrasonicReading.distance()));
+}
+
+void Behavior::setFrontUltrasonic(opendlv::proxy::DistanceReading const &frontUltrasonicReading, int64_t sampleTime) noexcept
+{
+  std::lock_guard<std::mutex> lock(m_frontUltrasonicReadingMutex);
+  m_frontUltrasonicReading = frontUltrasonicReading;
+  m_frontUltrasonicReading.distance(m_frontUltrasonicFilter.update(frontUltrasonicReading.distance()));
+  m_frontUltrasonicHistory.add(sampleTime, m_frontUltrasonicReading.distance());
 }
 
 void Behavior::setRearUltrasonic(opendlv::proxy::DistanceReading const &rearUltrasonicReading) noexcept
 {
   std::lock_guard<std::mutex> lock(m_rearUltrasonicReadingMutex);
   m_rearUltrasonicReading = rearUltrasonicReading;
+  m_rearUltrasonicReading.distance(m_rearUltrasonicFilter.update(rearUltrasonicReading.distance()));
+}
+
+void Behavior::setRearUltrasonic(opendlv::proxy::DistanceReading const &rearUltrasonicReading, int64_t sampleTime) noexcept
+{
+  std::lock_guard<std::mutex> lock(m_rearUltrasonicReadingMutex);
+  m_rearUltrasonicReading = rearUltrasonicReading;
+  m_rearUltrasonicReading.distance(m_rearUltrasonicFilter.update(rearUltrasonicReading.distance()));
+  m_rearUltrasonicHistory.add(sampleTime, m_rearUltrasonicReading.distance());
 }
 
 void Behavior::setLeftIr(opendlv::proxy::VoltageReading const &leftIrReading) noexcept
 {
   std::lock_guard<std::mutex> lock(m_leftIrReadingMutex);
   m_leftIrReading = leftIrReading;
+  m_leftIrReading.voltage(m_leftIrFilter.update(leftIrReading.voltage()));
+}
+
+void Behavior::setLeftIr(opendlv::proxy::VoltageReading const &leftIrReading, int64_t sampleTime) noexcept
+{
+  std::lock_guard<std::mutex> lock(m_leftIrReadingMutex);
+  m_leftIrReading = leftIrReading;
+  m_leftIrReading.voltage(m_leftIrFilter.update(leftIrReading.voltage()));
+  m_leftIrHistory.add(sampleTime, m_leftIrReading.voltage());
 }
 
 void Behavior::setRightIr(opendlv::proxy::VoltageReading const &rightIrReading) noexcept
 {
   std::lock_guard<std::mutex> lock(m_rightIrReadingMutex);
   m_rightIrReading = rightIrReading;
+  m_rightIrReading.voltage(m_rightIrFilter.update(rightIrReading.voltage()));
+}
+
+void Behavior::setRightIr(opendlv::proxy::VoltageReading const &rightIrReading, int64_t sampleTime) noexcept
+{
+  std::lock_guard<std::mutex> lock(m_rightIrReadingMutex);
+  m_rightIrReading = rightIrReading;
+  m_rightIrReading.voltage(m_rightIrFilter.update(rightIrReading.voltage()));
+  m_rightIrHistory.add(sampleTime, m_rightIrReading.voltage());
+}
+
+void Behavior::setFilters(SensorFilter::Config const &ultrasonic, SensorFilter::Config const &ir) noexcept
+{
+  {
+    std::lock_guard<std::mutex> lock(m_frontUltrasonicReadingMutex);
+    m_frontUltrasonicFilter.setConfig(ultrasonic);
+  }
+  {
+    std::lock_guard<std::mutex> lock(m_rearUltrasonicReadingMutex);
+    m_rearUltrasonicFilter.setConfig(ultrasonic);
+  }
+  {
+    std::lock_guard<std::mutex> lock(m_leftIrReadingMutex);
+    m_leftIrFilter.setConfig(ir);
+  }
+  {
+    std::lock_guard<std::mutex> lock(m_rightIrReadingMutex);
+    m_rightIrFilter.setConfig(ir);
+  }
 }
 
-float globalTime = 0.0f; //Added this
-float reverseTime = 11.0f; //Added this
-float errorLeft = 0.0f;
-float errorRight = 0.0f;
-float groundSteeringAngleLeft = 0.0f;
-float groundSteeringAngleRight = 0.0f;
-float prev_groundSteeringAngle = 0.0f;
-float groundSteeringAngle = 0.0f;
+DriveStateMachine::Mode Behavior::getDriveMode() noexcept
+{
+  std::lock_guard<std::mutex> lock(m_driveStateMachineMutex);
+  return m_driveStateMachine.mode();
+}
 
-int reverse = 0;
-int forwardAfterReverse = 0;
-float addAngleVar = 0.0f;
-float forwardTimeAfterReverse = 0.0f;
+std::vector<DriveStateMachine::Record> Behavior::getDriveTransitions()
+{
+  std::lock_guard<std::mutex> lock(m_driveStateMachineMutex);
+  return m_driveStateMachine.transitions();
+}
 
 void Behavior::step(float speed, float front, float rear, float goalDistanceToWall,
  float sideWall, float reverseTimeThreshold, float groundSteering, float wallSteering,
@@ -111,13 +187,80 @@ void Behavior::step(float speed, float front, float rear, float goalDistanceToWa
    float sideDistanceForStraightReverse, float frontDistance45, float sideDistance45
    , float forwardTimeAfterReverseLimit, float addAngleAfterReverse) noexcept
 {
-  float dt = 1.0f/FREQ; //Added this
-  globalTime = globalTime + 1.0f; //Added this
+  BehaviorParameters parameters;
+  parameters.speed = speed;
+  parameters.front = front;
+  parameters.rear = rear;
+  parameters.goalDistanceToWall = goalDistanceToWall;
+  parameters.sideWall = sideWall;
+  parameters.reverseTimeThreshold = reverseTimeThreshold;
+  parameters.groundSteering = groundSteering;
+  parameters.wallSteering = wallSteering;
+  parameters.rearMin = rearMin;
+  parameters.reverseSpeed = reverseSpeed;
+  parameters.Kp_side = Kp_side;
+  parameters.sideDistanceForStraightReverse = sideDistanceForStraightReverse;
+  parameters.frontDistance45 = frontDistance45;
+  parameters.sideDistance45 = sideDistance45;
+  parameters.forwardTimeAfterReverseLimit = forwardTimeAfterReverseLimit;
+  parameters.addAngleAfterReverse = addAngleAfterReverse;
+  step(parameters, FREQ);
+}
+
+void Behavior::setStalledSensors(uint32_t stalledSensors) noexcept
+{
+  std::lock_guard<std::mutex> lock(m_driveStateMachineMutex);
+  m_stalledSensors = stalledSensors;
+}
+
+void Behavior::setDegradedMode(DegradedMode degradedMode) noexcept
+{
+  std::lock_guard<std::mutex> lock(m_driveStateMachineMutex);
+  m_degradedMode = degradedMode;
+}
+
+bool Behavior::isInSafeMode() noexcept
+{
+  std::lock_guard<std::mutex> lock(m_driveStateMachineMutex);
+  return 0 != m_missingSensors;
+}
+
+uint32_t Behavior::getStalledSensors() noexcept
+{
+  std::lock_guard<std::mutex> lock(m_driveStateMachineMutex);
+  return m_missingSensors;
+}
+
+int32_t Behavior::parseDegradedMode(std::string const &text, DegradedMode &degradedMode) noexcept
+{
+  for (DegradedMode const mode : {DegradedMode::Stop, DegradedMode::Creep, DegradedMode::RearOnly}) {
+    if (text == name(mode)) {
+      degradedMode = mode;
+      return 0;
+    }
+  }
+  return -1;
+}
+
+char const *Behavior::name(DegradedMode degradedMode) noexcept
+{
+  switch (degradedMode) {
+    case DegradedMode::Stop: return "stop";
+    case DegradedMode::Creep: return "creep";
+    case DegradedMode::RearOnly: return "rear-only";
+  }
+  return "unknown";
+}
+
+void Behavior::step(BehaviorParameters const &parameters, float FREQ) noexcept
+{
+  TRACE_SCOPE("Behavior::step");
   opendlv::proxy::DistanceReading frontUltrasonicReading;
   opendlv::proxy::DistanceReading rearUltrasonicReading;
   opendlv::proxy::VoltageReading leftIrReading;
   opendlv::proxy::VoltageReading rightIrReading;
   {
+    TRACE_SCOPE("Behavior::step read sensors");
     std::lock_guard<std::mutex> lock1(m_frontUltrasonicReadingMutex);
     std::lock_guard<std::mutex> lock2(m_rearUltrasonicReadingMutex);
     std::lock_guard<std::mutex> lock3(m_leftIrReadingMutex);
@@ -128,217 +271,166 @@ void Behavior::step(float speed, float front, float rear, float goalDistanceToWa
     leftIrReading = m_leftIrReading;
     rightIrReading = m_rightIrReading;
   }
+  act(parameters, FREQ, 0, frontUltrasonicReading.distance(), rearUltrasonicReading.distance(),
+      leftIrReading.voltage(), rightIrReading.voltage());
+}
 
-  float frontDistance = frontUltrasonicReading.distance();
-  float rearDistance = rearUltrasonicReading.distance();
-  double leftDistanceDouble = convertIrVoltageToDistance(leftIrReading.voltage());
-  double rightDistanceDouble = convertIrVoltageToDistance(rightIrReading.voltage());
-  float leftDistance = (float) leftDistanceDouble;
-  float rightDistance = (float) rightDistanceDouble;
-  
-  float pedalPosition = speed;
-
-  (void)wallSteering;
-  // (void)goalDistanceToWall;
-  (void)reverseTimeThreshold;
-  (void)rearMin;
-  // (void)Kp_side;
-  (void)sideDistanceForStraightReverse;
-  (void)frontDistance45;
-  (void)sideDistance45;
-
-
-
-
-
-// if (leftDistance < sideWall) {
-//   groundSteeringAngle = -groundSteering; //Turn right
-// }
-
-// if (rightDistance < sideWall) {
-//   groundSteeringAngle = groundSteering; //Turn left
-// }
-
+void Behavior::step(BehaviorParameters const &parameters, float FREQ, int64_t sampleTime) noexcept
+{
+  TRACE_SCOPE("Behavior::step");
+  int64_t const maxExtrapolation{static_cast<int64_t>(parameters.maxExtrapolation * 1e6f)};
+  SensorHistory::Sample front;
+  SensorHistory::Sample rear;
+  SensorHistory::Sample left;
+  SensorHistory::Sample right;
+  {
+    TRACE_SCOPE("Behavior::step read sensors");
+    std::lock_guard<std::mutex> lock1(m_frontUltrasonicReadingMutex);
+    std::lock_guard<std::mutex> lock2(m_rearUltrasonicReadingMutex);
+    std::lock_guard<std::mutex> lock3(m_leftIrReadingMutex);
+    std::lock_guard<std::mutex> lock4(m_rightIrReadingMutex);
 
-  if (reverse == 0 && forwardAfterReverse == 0) {
-    groundSteeringAngle = 0.05f;
+    front = m_frontUltrasonicHistory.at(sampleTime, maxExtrapolation);
+    rear = m_rearUltrasonicHistory.at(sampleTime, maxExtrapolation);
+    left = m_leftIrHistory.at(sampleTime, maxExtrapolation);
+    right = m_rightIrHistory.at(sampleTime, maxExtrapolation);
   }
 
-  groundSteeringAngleLeft = 0.0f;
-  groundSteeringAngleRight = 0.0f;
+  // A sensor without recent readings is no better than a stalled one.
+  int64_t const maxAge{static_cast<int64_t>(parameters.maxSensorAge * 1e6f)};
+  uint32_t const staleSensors{((!front.valid || front.age > maxAge) ? FRONT_ULTRASONIC : 0)
+    | ((!rear.valid || rear.age > maxAge) ? REAR_ULTRASONIC : 0)
+    | ((!left.valid || left.age > maxAge) ? LEFT_IR : 0)
+    | ((!right.valid || right.age > maxAge) ? RIGHT_IR : 0)};
+  act(parameters, FREQ, staleSensors, front.value, rear.value, left.value, right.value);
+}
 
-  if (leftDistance < sideWall) {
-    // P-controller
-    errorLeft = goalDistanceToWall - leftDistance;  
-    groundSteeringAngleLeft = Kp_side * errorLeft; // Proportional term
-  }
-  if (rightDistance < sideWall) {
-    errorRight = goalDistanceToWall - rightDistance;  
-    groundSteeringAngleRight = Kp_side * errorRight; // Proportional term
+void Behavior::act(BehaviorParameters const &parameters, float FREQ, uint32_t staleSensors, float frontDistance,
+    float rearDistance, float leftVoltage, float rightVoltage) noexcept
+{
+  uint32_t missingSensors;
+  DegradedMode degradedMode;
+  {
+    std::lock_guard<std::mutex> lock(m_driveStateMachineMutex);
+    missingSensors = staleSensors | m_stalledSensors;
+    if ((0 != missingSensors) != (0 != m_missingSensors)) {
+      TRACE_INSTANT((0 != missingSensors) ? "Behavior safe mode" : "Behavior sensors recovered");
+    }
+    m_missingSensors = missingSensors;
+    degradedMode = m_degradedMode;
   }
-  
-  groundSteeringAngle = groundSteeringAngle -(groundSteeringAngleLeft - groundSteeringAngleRight);
-
-
-
-
-
-  if (frontDistance < front) {
-    reverse = 1;
-    pedalPosition = -reverseSpeed; //Reverse
-    
+  if (0 == missingSensors) {
+    control(parameters, FREQ, frontDistance, rearDistance, leftVoltage, rightVoltage);
+    return;
   }
 
-  if (reverse == 1) {
-
-    if (reverseTime < dt) { //Do stuff only once
-      
-      groundSteeringAngle = -groundSteeringAngle; //Invert steering
-      if (leftDistance > rightDistance) {
-        addAngleVar = addAngleAfterReverse;
-      } else if (leftDistance < rightDistance) {
-        addAngleVar = -addAngleAfterReverse;
-      }
-    }
-
-    reverseTime = reverseTime + dt;
-    pedalPosition = -reverseSpeed;
+  if (DegradedMode::Creep == degradedMode) {
+    control(parameters, FREQ, frontDistance, rearDistance, leftVoltage, rightVoltage);
+    std::lock_guard<std::mutex> lock(m_pedalPositionRequestMutex);
+    m_pedalPositionRequest.position(std::min(std::max(m_pedalPositionRequest.position(), -parameters.creepSpeed), parameters.creepSpeed));
+    return;
   }
-
-  if (reverseTime > reverseTimeThreshold) {
-    reverse = 0;
-    reverseTime = 0.0f;
-    forwardAfterReverse = 1;
+  float pedalPosition{0.0f};
+  if (DegradedMode::RearOnly == degradedMode && 0 == (missingSensors & REAR_ULTRASONIC) && rearDistance > parameters.rear) {
+    pedalPosition = -parameters.creepSpeed;
   }
+  std::lock_guard<std::mutex> lock1(m_groundSteeringAngleRequestMutex);
+  std::lock_guard<std::mutex> lock2(m_pedalPositionRequestMutex);
+  m_groundSteeringAngleRequest.groundSteering(0.0f);
+  m_pedalPositionRequest.position(pedalPosition);
+}
 
-  if (forwardAfterReverse == 1) {
-
-    if (forwardTimeAfterReverse < dt) {
-      groundSteeringAngle = groundSteeringAngle + addAngleVar;
+void Behavior::control(BehaviorParameters const &parameters, float FREQ, float frontDistance, float rearDistance,
+    float leftVoltage, float rightVoltage) noexcept
+{
+  float dt = 1.0f/FREQ;
+  double leftDistanceDouble = convertIrVoltageToDistance(leftVoltage);
+  double rightDistanceDouble = convertIrVoltageToDistance(rightVoltage);
+  float leftDistance = (float) leftDistanceDouble;
+  float rightDistance = (float) rightDistanceDouble;
+  
+  float pedalPosition = parameters.speed;
+
+  std::lock_guard<std::mutex> lock(m_driveStateMachineMutex);
+  if (parameters.centering >= 0.5f) {
+    // Handed over on every tick, but the gain schedule is only rebuilt when
+    // the parameters change. The reverse phases steer on their own and
+    // start the centering afresh.
+    CenteringController::Config centering;
+    centering.kp = parameters.centeringKp;
+    centering.ki = parameters.centeringKi;
+    centering.kd = parameters.centeringKd;
+    centering.derivativeTime = parameters.centeringDerivativeTime;
+    centering.referenceSpeed = parameters.centeringReferenceSpeed;
+    centering.maxSteering = parameters.centeringMaxSteering;
+    centering.integralLimit = parameters.centeringMaxSteering;
+    centering.sideWall = parameters.sideWall;
+    centering.goalDistanceToWall = parameters.goalDistanceToWall;
+    m_centeringController.setConfig(centering);
+    if (DriveStateMachine::Mode::Forward == m_driveStateMachine.mode()) {
+      m_groundSteeringAngle = parameters.groundSteering + m_centeringController.update(leftDistance, rightDistance, pedalPosition, dt);
+    } else {
+      m_centeringController.reset();
+    }
+  } else {
+    if (DriveStateMachine::Mode::Forward == m_driveStateMachine.mode()) {
+      m_groundSteeringAngle = 0.05f;
     }
 
-    forwardTimeAfterReverse = forwardTimeAfterReverse + dt;    
+    float groundSteeringAngleLeft = 0.0f;
+    float groundSteeringAngleRight = 0.0f;
 
-    if (forwardTimeAfterReverse > forwardTimeAfterReverseLimit || reverse == 1) {
-      forwardAfterReverse = 0;
-      forwardTimeAfterReverse = 0.0f;
-      groundSteeringAngle = groundSteering;
+    if (leftDistance < parameters.sideWall) {
+      // P-controller
+      float errorLeft = parameters.goalDistanceToWall - leftDistance;
+      groundSteeringAngleLeft = parameters.Kp_side * errorLeft; // Proportional term
+    }
+    if (rightDistance < parameters.sideWall) {
+      float errorRight = parameters.goalDistanceToWall - rightDistance;
+      groundSteeringAngleRight = parameters.Kp_side * errorRight; // Proportional term
     }
-  }
 
-  if (rearDistance < rear) {
-    pedalPosition = speed; //Go forward
+    m_groundSteeringAngle = m_groundSteeringAngle -(groundSteeringAngleLeft - groundSteeringAngleRight);
+    m_groundSteeringAngle = std::min(std::max(m_groundSteeringAngle, -parameters.maxSteering), parameters.maxSteering);
   }
 
+  DriveStateMachine::Parameters modeParameters;
+  modeParameters.reverseTimeThreshold = parameters.reverseTimeThreshold;
+  modeParameters.forwardTimeAfterReverseLimit = parameters.forwardTimeAfterReverseLimit;
+  modeParameters.addAngleAfterReverse = parameters.addAngleAfterReverse;
+  modeParameters.groundSteering = parameters.groundSteering;
+  bool const frontBlocked{frontDistance < parameters.front};
+  bool const rearBlocked{rearDistance < parameters.rear || leftDistance < parameters.reverseSideClearance
+    || rightDistance < parameters.reverseSideClearance};
+  if (m_driveStateMachine.step(frontBlocked, rearBlocked, leftDistance, rightDistance, dt, modeParameters,
+        m_groundSteeringAngle)) {
+    pedalPosition = -parameters.reverseSpeed; //Reverse
+  }
 
-
-
-  // std::string scenario = ""; 
-  
-  // if (frontDistance < front) {
-  //   reverse = 1;
-    
-  // } else if (rearDistance < rear){
-  //   pedalPosition = speed;
-  // }
-
-  // //Avoid 45 degree
-  // if (frontDistance < frontDistance45) {
-  //   if (leftDistance < sideDistance45) {
-  //     reverse = 1;
-  //   } else if (rightDistance < sideDistance45) {
-  //     reverse = 1;
-  //   }
-  // }
-
-  // groundSteeringAngle = 0.05f;
-
-  // // if (frontDistance < front && (leftDistance >goalDdistanceToWall || rightDistance >goalDdistanceToWall)) {
-  // //   if (leftDistance > rightDistance) {
-  // //     scenario = "turnLeft";
-  // //   } else if (rightDistance > leftDistance){
-  // //     scenario = "turnRight";
-  // //   }
-    
-  // // }
-  // // if (scenario == "turnLeft") {
-  // //   groundSteeringAngle = groundSteering;
-  // // } else {
-  // //   if (scenario == "turnRight") {
-  // //     groundSteeringAngle = -groundSteering;
-  // //   }
-  // // }
-
-  // // if (leftDistance < sideWall) {
-  // //   groundSteeringAngle = groundSteeringAngle - wallSteering;
-  // // } else if (rightDistance < sideWall) {
-  // //   groundSteeringAngle = groundSteeringAngle + wallSteering;
-  // // }
-
-  // groundSteeringAngleLeft = 0.0f;
-  // groundSteeringAngleRight = 0.0f;
-
-  // if (leftDistance < sideWall) {
-  //   // P-controller
-  //   errorLeft = goalDistanceToWall - leftDistance;  
-  //   groundSteeringAngleLeft = Kp_side * errorLeft; // Proportional term
-  // }
-  // if (rightDistance < sideWall) {
-  //   errorRight = goalDistanceToWall - rightDistance;  
-  //   groundSteeringAngleRight = Kp_side * errorRight; // Proportional term
-  // }
-  
-  // groundSteeringAngle = 0.05f -(groundSteeringAngleLeft - groundSteeringAngleRight);
-
-  // //Reverse
-  // if (reverse == 1) {
-  //   reverseTime = reverseTime + dt;
-  //   pedalPosition = -reverseSpeed;
-
-  //   // if (prev_groundSteeringAngle < 0.0f && prev_groundSteeringAngle > 0.0f) {
-  //   //   groundSteeringAngle = groundSteeringAngle;
-  //   // } else {
-  //   //   groundSteeringAngle = -groundSteering; //Turn right
-  //   // }
-    
-
-  //   if (leftDistance < sideDistanceForStraightReverse || rightDistance < sideDistanceForStraightReverse) {
-  //     // groundSteeringAngle = 0.0f; //Reverse straight
-  //   } else if (rightDistance < leftDistance) {
-  //     groundSteeringAngle = -groundSteering; //Turn right
-  //   } else if (leftDistance < rightDistance) {
-  //     groundSteeringAngle = groundSteering; //Turn left
-  //   }
-  // } 
-  
-  // if (reverseTime > reverseTimeThreshold) {
-  //   reverse = 0;
-  //   reverseTime = 0.0f;
-  // }
-
-  // if (rearDistance < rearMin) {
-  //   pedalPosition = speed;
-  // }
+  if (rearDistance < parameters.rear) {
+    pedalPosition = parameters.speed; //Go forward
+  }
+  if (frontBlocked && rearBlocked) {
+    pedalPosition = 0.0f; //Boxed in
+  }
 
   {
+    TRACE_SCOPE("Behavior::step write requests");
     std::lock_guard<std::mutex> lock1(m_groundSteeringAngleRequestMutex);
     std::lock_guard<std::mutex> lock2(m_pedalPositionRequestMutex);
 
     opendlv::proxy::GroundSteeringRequest groundSteeringAngleRequest;
-    groundSteeringAngleRequest.groundSteering(groundSteeringAngle);
+    groundSteeringAngleRequest.groundSteering(m_groundSteeringAngle);
     m_groundSteeringAngleRequest = groundSteeringAngleRequest;
 
     opendlv::proxy::PedalPositionRequest pedalPositionRequest;
     pedalPositionRequest.position(pedalPosition);
     m_pedalPositionRequest = pedalPositionRequest;
   }
-
-  globalTime = globalTime + dt; //Added this 
-  prev_groundSteeringAngle = groundSteeringAngle;
 }
 
 // TODO: This is a rough estimate, improve by looking into the sensor specifications.
-double Behavior::convertIrVoltageToDistance(float voltage) const noexcept
+double Behavior::convertIrVoltageToDistance(float voltage) noexcept
 {
   double voltageDividerR1 = 1000.0;
   double voltageDividerR2 = 1000.0;
@@ -18,9 +18,17 @@
 #ifndef BEHAVIOR
 #define BEHAVIOR
 
+#include <cstdint>
 #include <mutex>
+#include <string>
+#include <vector>
 
 #include "opendlv-standard-message-set.hpp"
+#include "behavior-parameters.hpp"
+#include "centering-controller.hpp"
+#include "drive-state-machine.hpp"
+#include "sensor-filter.hpp"
+#include "sensor-history.hpp"
 
 class Behavior {
  private:
@@ -29,6 +37,22 @@ class Behavior {
   Behavior &operator=(Behavior const &) = delete;
   Behavior &operator=(Behavior &&) = delete;
 
+ public:
+  // What Kiwi does while a sensor is stalled: stand still, go on at
+  // creepSpeed with the stalled readings held, or back away at creepSpeed
+  // on the rear ultrasonic alone.
+  enum class DegradedMode : uint8_t {
+    Stop,
+    Creep,
+    RearOnly
+  };
+
+  // Sensor bits of setStalledSensors().
+  static uint32_t const FRONT_ULTRASONIC{1};
+  static uint32_t const REAR_ULTRASONIC{2};
+  static uint32_t const LEFT_IR{4};
+  static uint32_t const RIGHT_IR{8};
+
  public:
   Behavior() noexcept;
   ~Behavior() = default;
@@ -43,20 +67,63 @@ class Behavior {
   void setRearUltrasonic(opendlv::proxy::DistanceReading const &) noexcept;
   void setLeftIr(opendlv::proxy::VoltageReading const &) noexcept;
   void setRightIr(opendlv::proxy::VoltageReading const &) noexcept;
+  // As above, and kept in a history keyed by the sample time in
+  // microseconds for the time-aligned step().
+  void setFrontUltrasonic(opendlv::proxy::DistanceReading const &, int64_t) noexcept;
+  void setRearUltrasonic(opendlv::proxy::DistanceReading const &, int64_t) noexcept;
+  void setLeftIr(opendlv::proxy::VoltageReading const &, int64_t) noexcept;
+  void setRightIr(opendlv::proxy::VoltageReading const &, int64_t) noexcept;
+  // Filters applied to every reading as it arrives, so step() sees the
+  // filtered distances and voltages; both default to a pass through.
+  void setFilters(SensorFilter::Config const &ultrasonic, SensorFilter::Config const &ir) noexcept;
+  DriveStateMachine::Mode getDriveMode() noexcept;
+  std::vector<DriveStateMachine::Record> getDriveTransitions();
   void step(float speed, float front, float rear, float goalDistanceToWall, 
   float sideWall, float reverseTimeThreshold, float groundSteering, 
   float wallSteering, float rearMin, float reverseSpeed, float FREQ,
    float Kp_side, float sideDistanceForStraightReverse, float frontDistance45, float sideDistance45
    , float forwardTimeAfterReverseLimit, float addAngleAfterReverse) noexcept;
+  // One control tick at FREQ Hz on the latest readings.
+  void step(BehaviorParameters const &, float FREQ) noexcept;
+  // One control tick on all readings interpolated to the given time in
+  // microseconds. A sensor without a reading within maxSensorAge counts
+  // as stalled.
+  void step(BehaviorParameters const &, float FREQ, int64_t) noexcept;
+  // Sensors found stalled elsewhere, e.g. by a StreamWatchdog. While any
+  // sensor is stalled, step() drives in the degraded mode and
+  // isInSafeMode() is true.
+  void setStalledSensors(uint32_t) noexcept;
+  void setDegradedMode(DegradedMode) noexcept;
+  bool isInSafeMode() noexcept;
+  // The sensors the last step() went without.
+  uint32_t getStalledSensors() noexcept;
+
+  // Parses "stop", "creep" or "rear-only"; returns -1 on anything else.
+  static int32_t parseDegradedMode(std::string const &, DegradedMode &) noexcept;
+  static char const *name(DegradedMode) noexcept;
+
+  // IR reading in cm, from the ADC voltage behind the 1:1 divider.
+  static double convertIrVoltageToDistance(float) noexcept;
 
  private:
-  double convertIrVoltageToDistance(float) const noexcept;
+  void control(BehaviorParameters const &, float FREQ, float frontDistance, float rearDistance,
+      float leftVoltage, float rightVoltage) noexcept;
+  void act(BehaviorParameters const &, float FREQ, uint32_t staleSensors, float frontDistance,
+      float rearDistance, float leftVoltage, float rightVoltage) noexcept;
 
  private:
   opendlv::proxy::DistanceReading m_frontUltrasonicReading;
   opendlv::proxy::DistanceReading m_rearUltrasonicReading;
   opendlv::proxy::VoltageReading m_leftIrReading;
   opendlv::proxy::VoltageReading m_rightIrReading;
+  SensorFilter m_frontUltrasonicFilter;
+  SensorFilter m_rearUltrasonicFilter;
+  SensorFilter m_leftIrFilter;
+  SensorFilter m_rightIrFilter;
+  SensorHistory m_frontUltrasonicHistory;
+  SensorHistory m_rearUltrasonicHistory;
+  SensorHistory m_leftIrHistory;
+  SensorHistory m_rightIrHistory;
   opendlv::proxy::GroundSteeringRequest m_groundSteeringAngleRequest;
   opendlv::proxy::PedalPositionRequest m_pedalPositionRequest;
   std::mutex m_frontUltrasonicReadingMutex;
@@ -65,6 +132,13 @@ class Behavior {
   std::mutex m_rightIrReadingMutex;
   std::mutex m_groundSteeringAngleRequestMutex;
   std::mutex m_pedalPositionRequestMutex;
+  DriveStateMachine m_driveStateMachine;
+  CenteringController m_centeringController;
+  float m_groundSteeringAngle;
+  uint32_t m_stalledSensors;
+  uint32_t m_missingSensors;
+  DegradedMode m_degradedMode;
+  std::mutex m_driveStateMachineMutex;
 };
 
 // extern float speed;
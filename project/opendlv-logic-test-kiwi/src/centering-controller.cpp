@@ -0,0 +1,135 @@
+/*
+ * Copyright (C) 2018 Ola Benderius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "centering-controller.hpp"
+
+uint32_t const CenteringController::SCHEDULE_SIZE;
+float const CenteringController::MAX_SPEED{1.0f};
+
+CenteringController::CenteringController() noexcept:
+  m_config{},
+  m_schedule{},
+  m_integral{0.0f},
+  m_previousError{0.0f},
+  m_derivative{0.0f},
+  m_hasPrevious{false}
+{
+  buildSchedule();
+}
+
+bool CenteringController::setConfig(Config const &config) noexcept
+{
+  // Compared bitwise, as the parameters come in on every tick.
+  if (0 == std::memcmp(&config, &m_config, sizeof(Config))) {
+    return false;
+  }
+  m_config = config;
+  buildSchedule();
+  m_integral = std::min(std::max(m_integral, -m_config.integralLimit), m_config.integralLimit);
+  return true;
+}
+
+void CenteringController::buildSchedule() noexcept
+{
+  for (uint32_t i{0}; i < SCHEDULE_SIZE; i++) {
+    float const speed{MAX_SPEED * static_cast<float>(i) / static_cast<float>(SCHEDULE_SIZE - 1)};
+    float const ratio{(speed > 0.0f) ? m_config.referenceSpeed / speed : m_config.maxScale};
+    float const scale{std::min(std::max(ratio * ratio, m_config.minScale), m_config.maxScale)};
+    m_schedule[i].kp = m_config.kp * scale;
+    m_schedule[i].ki = m_config.ki * scale;
+    m_schedule[i].kd = m_config.kd * scale;
+  }
+}
+
+CenteringController::Config const &CenteringController::config() const noexcept
+{
+  return m_config;
+}
+
+CenteringController::Gains CenteringController::gains(float speed) const noexcept
+{
+  float const position{std::min(std::max(std::fabs(speed) / MAX_SPEED, 0.0f), 1.0f) * static_cast<float>(SCHEDULE_SIZE - 1)};
+  uint32_t const i{std::min(static_cast<uint32_t>(position), SCHEDULE_SIZE - 2)};
+  float const t{position - static_cast<float>(i)};
+  Gains gains;
+  gains.kp = m_schedule[i].kp + t * (m_schedule[i + 1].kp - m_schedule[i].kp);
+  gains.ki = m_schedule[i].ki + t * (m_schedule[i + 1].ki - m_schedule[i].ki);
+  gains.kd = m_schedule[i].kd + t * (m_schedule[i + 1].kd - m_schedule[i].kd);
+  return gains;
+}
+
+float CenteringController::update(float leftDistance, float rightDistance, float speed, float dt) noexcept
+{
+  bool const leftWall{leftDistance < m_config.sideWall};
+  bool const rightWall{rightDistance < m_config.sideWall};
+  if (!leftWall && !rightWall) {
+    m_hasPrevious = false;
+    m_derivative = 0.0f;
+    return std::min(std::max(m_integral, -m_config.maxSteering), m_config.maxSteering);
+  }
+
+  Gains const scheduled{gains(speed)};
+  float const e{error(leftDistance, rightDistance, m_config)};
+  if (m_hasPrevious && dt > 0.0f) {
+    float const alpha{dt / (m_config.derivativeTime + dt)};
+    m_derivative += alpha * ((e - m_previousError) / dt - m_derivative);
+  }
+  m_previousError = e;
+  m_hasPrevious = true;
+
+  float const proportional{scheduled.kp * e};
+  float const derivative{scheduled.kd * m_derivative};
+  // The integral only gets as much room as the output has left, so that
+  // it does not grow while the output is saturated.
+  float const upper{std::min(m_config.integralLimit, std::max(m_config.maxSteering - proportional - derivative, 0.0f))};
+  float const lower{std::max(-m_config.integralLimit, std::min(-m_config.maxSteering - proportional - derivative, 0.0f))};
+  m_integral = std::min(std::max(m_integral + scheduled.ki * e * dt, lower), upper);
+  return std::min(std::max(proportional + m_integral + derivative, -m_config.maxSteering), m_config.maxSteering);
+}
+
+void CenteringController::reset() noexcept
+{
+  m_integral = 0.0f;
+  m_previousError = 0.0f;
+  m_derivative = 0.0f;
+  m_hasPrevious = false;
+}
+
+float CenteringController::integral() const noexcept
+{
+  return m_integral;
+}
+
+float CenteringController::error(float leftDistance, float rightDistance, Config const &config) noexcept
+{
+  bool const leftWall{leftDistance < config.sideWall};
+  bool const rightWall{rightDistance < config.sideWall};
+  if (leftWall && rightWall) {
+    return 0.5f * (leftDistance - rightDistance);
+  }
+  if (leftWall) {
+    return leftDistance - config.goalDistanceToWall;
+  }
+  if (rightWall) {
+    return config.goalDistanceToWall - rightDistance;
+  }
+  return 0.0f;
+}
@@ -0,0 +1,100 @@
+/*
+ * Copyright (C) 2018 Ola Benderius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CENTERING_CONTROLLER
+#define CENTERING_CONTROLLER
+
+#include <array>
+#include <cstdint>
+
+/*
+ * PID controller keeping Kiwi in the middle of a corridor from the IR side
+ * distances. The lateral acceleration a steering angle gives grows with
+ * the square of the speed, so the gains are scaled by
+ * (referenceSpeed / speed)^2 within [minScale, maxScale] to keep the
+ * response alike at all pedal positions. The schedule is precomputed into
+ * a table whenever the configuration changes, and a tick interpolates
+ * between two entries, so its cost does not depend on the schedule.
+ *
+ * The derivative acts on the error through a first-order low pass, and the
+ * integral is bounded by the room the proportional and derivative terms
+ * leave in the output, so that it does not wind up in saturation.
+ */
+class CenteringController {
+ public:
+  static uint32_t const SCHEDULE_SIZE{33};
+  // Highest pedal position in the schedule.
+  static float const MAX_SPEED;
+
+  struct Gains {
+    float kp{0.0f};
+    float ki{0.0f};
+    float kd{0.0f};
+  };
+
+  struct Config {
+    // Gains at referenceSpeed, per cm of error, in rad.
+    float kp{0.04f};
+    float ki{0.005f};
+    float kd{0.1f};
+    // Time constant of the derivative low pass, in seconds.
+    float derivativeTime{0.1f};
+    float referenceSpeed{0.5f};
+    float minScale{0.25f};
+    float maxScale{4.0f};
+    float maxSteering{0.3f};
+    float integralLimit{0.1f};
+    // Walls further away than sideWall are not seen; with one wall only,
+    // Kiwi keeps goalDistanceToWall to it. In cm.
+    float sideWall{50.0f};
+    float goalDistanceToWall{30.0f};
+  };
+
+ public:
+  CenteringController() noexcept;
+  ~CenteringController() = default;
+
+ public:
+  // Rebuilds the schedule and returns true if the configuration differs
+  // from the current one.
+  bool setConfig(Config const &) noexcept;
+  Config const &config() const noexcept;
+  Gains gains(float speed) const noexcept;
+
+  // Steering angle in rad, positive to the left, for one tick of dt seconds
+  // at the given pedal position. Without any wall in sight the error is
+  // taken as zero and the integral is held.
+  float update(float leftDistance, float rightDistance, float speed, float dt) noexcept;
+  void reset() noexcept;
+  float integral() const noexcept;
+
+  // Positive when Kiwi is right of where it should be, in cm.
+  static float error(float leftDistance, float rightDistance, Config const &) noexcept;
+
+ private:
+  void buildSchedule() noexcept;
+
+ private:
+  Config m_config;
+  std::array<Gains, SCHEDULE_SIZE> m_schedule;
+  float m_integral;
+  float m_previousError;
+  float m_derivative;
+  bool m_hasPrevious;
+};
+
+#endif
@@ -0,0 +1,215 @@
+/*
+ * Copyright (C) 2018 Ola Benderius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "drive-state-machine.hpp"
+#include "trace.hpp"
+
+uint32_t const DriveStateMachine::MODES;
+uint32_t const DriveStateMachine::EVENTS;
+uint32_t const DriveStateMachine::RECORDS;
+constexpr DriveStateMachine::Transition DriveStateMachine::TABLE[DriveStateMachine::MODES][DriveStateMachine::EVENTS];
+constexpr float DriveStateMachine::Parameters::*DriveStateMachine::TIMEOUT[DriveStateMachine::MODES];
+
+namespace {
+
+using Mode = DriveStateMachine::Mode;
+using Event = DriveStateMachine::Event;
+
+constexpr uint32_t index(Mode mode) noexcept
+{
+  return static_cast<uint32_t>(mode);
+}
+
+constexpr uint32_t index(Event event) noexcept
+{
+  return static_cast<uint32_t>(event);
+}
+
+// An obstacle in front always ends in reversing, whatever the mode.
+constexpr bool frontBlockedReverses() noexcept
+{
+  for (uint32_t mode{0}; mode < DriveStateMachine::MODES; mode++) {
+    if (Mode::Reverse != DriveStateMachine::TABLE[mode][index(Event::FrontBlocked)].next) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Timed modes are left on their timeout and the others ignore it, so a
+// step passes every mode at most once.
+constexpr bool timeoutsLeaveTimedModes() noexcept
+{
+  for (uint32_t mode{0}; mode < DriveStateMachine::MODES; mode++) {
+    bool const timed{nullptr != DriveStateMachine::TIMEOUT[mode]};
+    bool const leaves{mode != index(DriveStateMachine::TABLE[mode][index(Event::Timeout)].next)};
+    if (timed != leaves) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Every mode change has a name for the trace.
+constexpr bool transitionsNamed() noexcept
+{
+  for (uint32_t mode{0}; mode < DriveStateMachine::MODES; mode++) {
+    for (uint32_t event{0}; event < DriveStateMachine::EVENTS; event++) {
+      DriveStateMachine::Transition const &transition = DriveStateMachine::TABLE[mode][event];
+      if ((mode != index(transition.next)) != (nullptr != transition.name)) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+// Only reversing is cut short by the rear, and it ends as on its timeout.
+constexpr bool rearBlockedEndsReverse() noexcept
+{
+  for (uint32_t mode{0}; mode < DriveStateMachine::MODES; mode++) {
+    DriveStateMachine::Transition const &rear = DriveStateMachine::TABLE[mode][index(Event::RearBlocked)];
+    DriveStateMachine::Transition const &timeout = DriveStateMachine::TABLE[mode][index(Event::Timeout)];
+    if (index(Mode::Reverse) == mode) {
+      if (rear.next != timeout.next || rear.action != timeout.action) {
+        return false;
+      }
+    } else if (mode != index(rear.next)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static_assert(frontBlockedReverses(), "FrontBlocked must lead to Reverse from every mode.");
+static_assert(rearBlockedEndsReverse(), "RearBlocked must end Reverse as its Timeout does, and nothing else.");
+static_assert(timeoutsLeaveTimedModes(), "Exactly the modes with a TIMEOUT must be left on Timeout.");
+static_assert(transitionsNamed(), "Exactly the mode changes must be named.");
+
+}
+
+DriveStateMachine::DriveStateMachine() noexcept:
+  m_mode{Mode::Forward},
+  m_timer{0.0f},
+  m_time{0.0f},
+  m_nudge{0.0f},
+  m_records{},
+  m_transitions{0}
+{
+}
+
+void DriveStateMachine::reset() noexcept
+{
+  m_mode = Mode::Forward;
+  m_timer = 0.0f;
+  m_time = 0.0f;
+  m_nudge = 0.0f;
+  m_transitions = 0;
+}
+
+bool DriveStateMachine::step(bool frontBlocked, bool rearBlocked, float leftDistance, float rightDistance, float dt,
+    Parameters const &parameters, float &steering) noexcept
+{
+  if (frontBlocked) {
+    fire(Event::FrontBlocked, leftDistance, rightDistance, parameters, steering);
+  }
+  if (rearBlocked) {
+    fire(Event::RearBlocked, leftDistance, rightDistance, parameters, steering);
+  }
+  bool const reversing{Mode::Reverse == m_mode};
+  // A timed mode entered on a timeout is timed from the same tick on.
+  for (uint32_t pass{0}; pass < MODES; pass++) {
+    float Parameters::*const timeout{TIMEOUT[index(m_mode)]};
+    if (nullptr == timeout) {
+      break;
+    }
+    m_timer += dt;
+    if (!(m_timer > parameters.*timeout)) {
+      break;
+    }
+    fire(Event::Timeout, leftDistance, rightDistance, parameters, steering);
+  }
+  m_time += dt;
+  return reversing;
+}
+
+DriveStateMachine::Mode DriveStateMachine::mode() const noexcept
+{
+  return m_mode;
+}
+
+float DriveStateMachine::time() const noexcept
+{
+  return m_time;
+}
+
+std::vector<DriveStateMachine::Record> DriveStateMachine::transitions() const
+{
+  uint64_t const count{(m_transitions < RECORDS) ? m_transitions : RECORDS};
+  std::vector<Record> records;
+  records.reserve(count);
+  for (uint64_t i{m_transitions - count}; i < m_transitions; i++) {
+    records.push_back(m_records[i % RECORDS]);
+  }
+  return records;
+}
+
+uint64_t DriveStateMachine::transitionCount() const noexcept
+{
+  return m_transitions;
+}
+
+char const *DriveStateMachine::name(Mode mode) noexcept
+{
+  static char const *const NAMES[MODES] = {"Forward", "Reverse", "ForwardAfterReverse"};
+  return NAMES[index(mode)];
+}
+
+void DriveStateMachine::fire(Event event, float leftDistance, float rightDistance, Parameters const &parameters, float &steering) noexcept
+{
+  Transition const &transition = TABLE[index(m_mode)][index(event)];
+  switch (transition.action) {
+    case Action::StartReverse:
+    case Action::RestartReverse:
+      steering = (Action::StartReverse == transition.action) ? -steering : parameters.groundSteering;
+      // Turn towards the more open side once driving forward again.
+      if (leftDistance > rightDistance) {
+        m_nudge = parameters.addAngleAfterReverse;
+      } else if (leftDistance < rightDistance) {
+        m_nudge = -parameters.addAngleAfterReverse;
+      }
+      break;
+    case Action::Nudge:
+      steering += m_nudge;
+      break;
+    case Action::RestoreSteering:
+      steering = parameters.groundSteering;
+      break;
+    case Action::None:
+      break;
+  }
+  if (transition.next != m_mode) {
+    TRACE_INSTANT(transition.name);
+    Record &record = m_records[m_transitions++ % RECORDS];
+    record.time = m_time;
+    record.from = m_mode;
+    record.to = transition.next;
+    record.event = event;
+    m_mode = transition.next;
+    m_timer = 0.0f;
+  }
+}
@@ -0,0 +1,142 @@
+/*
+ * Copyright (C) 2018 Ola Benderius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef DRIVE_STATE_MACHINE
+#define DRIVE_STATE_MACHINE
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+/*
+ * The driving modes of Behavior: forward, reversing away from a front
+ * obstacle until it times out or the rear is blocked, and a short forward
+ * phase after reversing that nudges the steering away from the closer
+ * side. Transitions and their actions come
+ * from a constexpr table indexed by mode and event, checked at compile
+ * time, so a step is two table lookups and a timer update. Every
+ * transition is kept with its time for replays.
+ */
+class DriveStateMachine {
+ public:
+  enum class Mode : uint8_t {
+    Forward,
+    Reverse,
+    ForwardAfterReverse
+  };
+
+  enum class Event : uint8_t {
+    FrontBlocked,
+    RearBlocked,
+    Timeout
+  };
+
+  enum class Action : uint8_t {
+    None,
+    // Invert the steering and pick the nudge from the side distances.
+    StartReverse,
+    // As StartReverse, but the steering goes back to groundSteering.
+    RestartReverse,
+    // Add the nudge picked when the reverse started.
+    Nudge,
+    // Back to groundSteering.
+    RestoreSteering
+  };
+
+  struct Transition {
+    Mode next;
+    Action action;
+    char const *name;
+  };
+
+  struct Parameters {
+    float reverseTimeThreshold{2.0f};
+    float forwardTimeAfterReverseLimit{2.0f};
+    float addAngleAfterReverse{0.2f};
+    float groundSteering{0.05f};
+  };
+
+  struct Record {
+    float time{0.0f};
+    Mode from{Mode::Forward};
+    Mode to{Mode::Forward};
+    Event event{Event::FrontBlocked};
+  };
+
+  static uint32_t const MODES{3};
+  static uint32_t const EVENTS{3};
+  static uint32_t const RECORDS{64};
+
+  // Indexed by mode and event; a transition to the same mode without an
+  // action is not recorded.
+  static constexpr Transition TABLE[MODES][EVENTS]{
+    {
+      {Mode::Reverse, Action::StartReverse, "Forward->Reverse"},
+      {Mode::Forward, Action::None, nullptr},
+      {Mode::Forward, Action::None, nullptr}
+    },
+    {
+      {Mode::Reverse, Action::None, nullptr},
+      {Mode::ForwardAfterReverse, Action::Nudge, "Reverse->ForwardAfterReverse"},
+      {Mode::ForwardAfterReverse, Action::Nudge, "Reverse->ForwardAfterReverse"}
+    },
+    {
+      {Mode::Reverse, Action::RestartReverse, "ForwardAfterReverse->Reverse"},
+      {Mode::ForwardAfterReverse, Action::None, nullptr},
+      {Mode::Forward, Action::RestoreSteering, "ForwardAfterReverse->Forward"}
+    }
+  };
+  // How long each mode lasts before its Timeout, or nullptr if it has none.
+  static constexpr float Parameters::*TIMEOUT[MODES]{
+    nullptr,
+    &Parameters::reverseTimeThreshold,
+    &Parameters::forwardTimeAfterReverseLimit
+  };
+
+ public:
+  DriveStateMachine() noexcept;
+  ~DriveStateMachine() = default;
+
+ public:
+  void reset() noexcept;
+
+  // Advances the machine by one tick of dt seconds and updates the steering
+  // angle in place. Returns whether the tick is spent reversing.
+  bool step(bool frontBlocked, bool rearBlocked, float leftDistance, float rightDistance, float dt, Parameters const &,
+      float &steering) noexcept;
+
+  Mode mode() const noexcept;
+  float time() const noexcept;
+  // The last RECORDS transitions, oldest first.
+  std::vector<Record> transitions() const;
+  uint64_t transitionCount() const noexcept;
+
+  static char const *name(Mode) noexcept;
+
+ private:
+  void fire(Event, float leftDistance, float rightDistance, Parameters const &, float &steering) noexcept;
+
+ private:
+  Mode m_mode;
+  float m_timer;
+  float m_time;
+  float m_nudge;
+  std::array<Record, RECORDS> m_records;
+  uint64_t m_transitions;
+};
+
+#endif
@@ -0,0 +1,180 @@
+/*
+ * Copyright (C) 2018 Ola Benderius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstring>
+
+#include "envelope-framing.hpp"
+
+ProtoWriter::ProtoWriter(std::string &buffer) noexcept:
+  m_buffer(buffer)
+{
+}
+
+void ProtoWriter::visit(uint32_t id, std::string &&, std::string &&, bool &v)
+{
+  writeVarintField(id, v ? 1 : 0);
+}
+
+void ProtoWriter::visit(uint32_t id, std::string &&, std::string &&, char &v)
+{
+  writeVarintField(id, static_cast<uint8_t>(v));
+}
+
+void ProtoWriter::visit(uint32_t id, std::string &&, std::string &&, int8_t &v)
+{
+  writeVarintField(id, static_cast<uint8_t>((v << 1) ^ (v >> 7)));
+}
+
+void ProtoWriter::visit(uint32_t id, std::string &&, std::string &&, uint8_t &v)
+{
+  writeVarintField(id, v);
+}
+
+void ProtoWriter::visit(uint32_t id, std::string &&, std::string &&, int16_t &v)
+{
+  writeVarintField(id, static_cast<uint16_t>((v << 1) ^ (v >> 15)));
+}
+
+void ProtoWriter::visit(uint32_t id, std::string &&, std::string &&, uint16_t &v)
+{
+  writeVarintField(id, v);
+}
+
+void ProtoWriter::visit(uint32_t id, std::string &&, std::string &&, int32_t &v)
+{
+  writeVarintField(id, static_cast<uint32_t>((v << 1) ^ (v >> 31)));
+}
+
+void ProtoWriter::visit(uint32_t id, std::string &&, std::string &&, uint32_t &v)
+{
+  writeVarintField(id, v);
+}
+
+void ProtoWriter::visit(uint32_t id, std::string &&, std::string &&, int64_t &v)
+{
+  writeVarintField(id, static_cast<uint64_t>((v << 1) ^ (v >> 63)));
+}
+
+void ProtoWriter::visit(uint32_t id, std::string &&, std::string &&, uint64_t &v)
+{
+  writeVarintField(id, v);
+}
+
+void ProtoWriter::visit(uint32_t id, std::string &&, std::string &&, float &v)
+{
+  writeVarint((static_cast<uint64_t>(id) << 3) | static_cast<uint8_t>(cluon::ProtoConstants::FOUR_BYTES));
+  uint32_t raw;
+  std::memcpy(&raw, &v, sizeof(raw));
+  raw = htole32(raw);
+  m_buffer.append(reinterpret_cast<char const *>(&raw), sizeof(raw));
+}
+
+void ProtoWriter::visit(uint32_t id, std::string &&, std::string &&, double &v)
+{
+  writeVarint((static_cast<uint64_t>(id) << 3) | static_cast<uint8_t>(cluon::ProtoConstants::EIGHT_BYTES));
+  uint64_t raw;
+  std::memcpy(&raw, &v, sizeof(raw));
+  raw = htole64(raw);
+  m_buffer.append(reinterpret_cast<char const *>(&raw), sizeof(raw));
+}
+
+void ProtoWriter::visit(uint32_t id, std::string &&, std::string &&, std::string &v)
+{
+  writeBytesField(id, v.data(), v.size());
+}
+
+void ProtoWriter::writeVarintField(uint32_t id, uint64_t v)
+{
+  writeVarint((static_cast<uint64_t>(id) << 3) | static_cast<uint8_t>(cluon::ProtoConstants::VARINT));
+  writeVarint(v);
+}
+
+void ProtoWriter::writeBytesField(uint32_t id, char const *data, std::size_t size)
+{
+  writeVarint((static_cast<uint64_t>(id) << 3) | static_cast<uint8_t>(cluon::ProtoConstants::LENGTH_DELIMITED));
+  writeVarint(size);
+  m_buffer.append(data, size);
+}
+
+void ProtoWriter::writeTimeStamp(uint32_t id, cluon::data::TimeStamp const &timeStamp)
+{
+  std::size_t const start{beginNested(id)};
+  int32_t const seconds{timeStamp.seconds()};
+  int32_t const microseconds{timeStamp.microseconds()};
+  writeVarintField(1, static_cast<uint32_t>((seconds << 1) ^ (seconds >> 31)));
+  writeVarintField(2, static_cast<uint32_t>((microseconds << 1) ^ (microseconds >> 31)));
+  endNested(start);
+}
+
+void ProtoWriter::writeVarint(uint64_t v)
+{
+  char bytes[10];
+  std::size_t n{0};
+  while (v > 0x7f) {
+    bytes[n++] = static_cast<char>((v & 0x7f) | 0x80);
+    v >>= 7;
+  }
+  bytes[n++] = static_cast<char>(v);
+  m_buffer.append(bytes, n);
+}
+
+std::size_t ProtoWriter::beginNested(uint32_t id)
+{
+  writeVarint((static_cast<uint64_t>(id) << 3) | static_cast<uint8_t>(cluon::ProtoConstants::LENGTH_DELIMITED));
+  return m_buffer.size();
+}
+
+void ProtoWriter::endNested(std::size_t start)
+{
+  // Shift the nested message by the size of its length prefix; for the
+  // short messages on the wire that is a single byte.
+  uint64_t length{m_buffer.size() - start};
+  char prefix[10];
+  std::size_t n{0};
+  while (length > 0x7f) {
+    prefix[n++] = static_cast<char>((length & 0x7f) | 0x80);
+    length >>= 7;
+  }
+  prefix[n++] = static_cast<char>(length);
+  m_buffer.insert(start, prefix, n);
+}
+
+void appendEnvelope(std::string &out, cluon::data::Envelope const &envelope)
+{
+  std::size_t const start{out.size()};
+  out.append("\x0D\xA4\0\0\0", 5);
+  ProtoWriter writer{out};
+  int32_t const dataType{envelope.dataType()};
+  std::string const serializedData{envelope.serializedData()};
+  writer.writeVarintField(1, static_cast<uint32_t>((dataType << 1) ^ (dataType >> 31)));
+  writer.writeBytesField(2, serializedData.data(), serializedData.size());
+  writer.writeTimeStamp(3, envelope.sent());
+  writer.writeTimeStamp(4, envelope.received());
+  writer.writeTimeStamp(5, envelope.sampleTimeStamp());
+  writer.writeVarintField(6, envelope.senderStamp());
+
+  uint32_t const length{static_cast<uint32_t>(out.size() - start - 5)};
+  out[start + 2] = static_cast<char>(length & 0xff);
+  out[start + 3] = static_cast<char>((length >> 8) & 0xff);
+  out[start + 4] = static_cast<char>((length >> 16) & 0xff);
+}
+
+std::string &threadLocalFrameBuffer() noexcept
+{
+  thread_local std::string buffer;
+  return buffer;
+}
@@ -0,0 +1,155 @@
+/*
+ * Copyright (C) 2018 Ola Benderius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+
+#include "envelope-json-encoder.hpp"
+
+EnvelopeJsonEncoder::EnvelopeJsonEncoder(MessageProgramSet const &programs) noexcept:
+  m_programs(programs),
+  m_record{programs},
+  m_writer{},
+  m_messageKeys{},
+  m_frameSize{0}
+{
+}
+
+std::string const &EnvelopeJsonEncoder::encode(cluon::data::Envelope const &envelope)
+{
+  m_writer.clear();
+  if (!writeEnvelope(envelope)) {
+    m_writer.clear();
+    m_writer.beginObject();
+    m_writer.endObject();
+  }
+  return m_writer.buffer();
+}
+
+void EnvelopeJsonEncoder::beginFrame()
+{
+  m_writer.clear();
+  m_writer.beginArray();
+  m_frameSize = 0;
+}
+
+bool EnvelopeJsonEncoder::append(cluon::data::Envelope const &envelope)
+{
+  bool const appended{writeEnvelope(envelope)};
+  if (appended) {
+    m_frameSize++;
+  }
+  return appended;
+}
+
+std::string const &EnvelopeJsonEncoder::endFrame()
+{
+  m_writer.endArray();
+  return m_writer.buffer();
+}
+
+uint32_t EnvelopeJsonEncoder::frameSize() const noexcept
+{
+  return m_frameSize;
+}
+
+bool EnvelopeJsonEncoder::writeEnvelope(cluon::data::Envelope const &envelope)
+{
+  if (!m_record.decode(envelope)) {
+    return false;
+  }
+  MessageProgram const &program = *m_record.program();
+
+  m_writer.beginObject();
+  m_writer.key("dataType", 8);
+  m_writer.value(static_cast<int64_t>(envelope.dataType()));
+  writeTimeStamp("sent", 4, envelope.sent());
+  writeTimeStamp("received", 8, envelope.received());
+  writeTimeStamp("sampleTimeStamp", 15, envelope.sampleTimeStamp());
+  m_writer.key("senderStamp", 11);
+  m_writer.value(static_cast<uint64_t>(envelope.senderStamp()));
+  m_writer.key(messageKey(program));
+  writeMessage(program, 0);
+  m_writer.endObject();
+  return true;
+}
+
+void EnvelopeJsonEncoder::writeTimeStamp(char const *name, std::size_t length, cluon::data::TimeStamp const &timeStamp)
+{
+  m_writer.key(name, length);
+  m_writer.beginObject();
+  m_writer.key("seconds", 7);
+  m_writer.value(static_cast<int64_t>(timeStamp.seconds()));
+  m_writer.key("microseconds", 12);
+  m_writer.value(static_cast<int64_t>(timeStamp.microseconds()));
+  m_writer.endObject();
+}
+
+void EnvelopeJsonEncoder::writeMessage(MessageProgram const &program, uint32_t base)
+{
+  m_writer.beginObject();
+  for (auto const &field : program.fields()) {
+    m_writer.key(field.name);
+    switch (field.type) {
+      case MessageProgram::FieldType::Bool: m_writer.value(m_record.get<bool>(field, base)); break;
+      case MessageProgram::FieldType::Char:
+        {
+          char const c{m_record.get<char>(field, base)};
+          m_writer.valueString(&c, 1);
+          break;
+        }
+      case MessageProgram::FieldType::Int8: m_writer.value(static_cast<int64_t>(m_record.get<int8_t>(field, base))); break;
+      case MessageProgram::FieldType::UInt8: m_writer.value(static_cast<uint64_t>(m_record.get<uint8_t>(field, base))); break;
+      case MessageProgram::FieldType::Int16: m_writer.value(static_cast<int64_t>(m_record.get<int16_t>(field, base))); break;
+      case MessageProgram::FieldType::UInt16: m_writer.value(static_cast<uint64_t>(m_record.get<uint16_t>(field, base))); break;
+      case MessageProgram::FieldType::Int32: m_writer.value(static_cast<int64_t>(m_record.get<int32_t>(field, base))); break;
+      case MessageProgram::FieldType::UInt32: m_writer.value(static_cast<uint64_t>(m_record.get<uint32_t>(field, base))); break;
+      case MessageProgram::FieldType::Int64: m_writer.value(m_record.get<int64_t>(field, base)); break;
+      case MessageProgram::FieldType::UInt64: m_writer.value(m_record.get<uint64_t>(field, base)); break;
+      case MessageProgram::FieldType::Float: m_writer.value(m_record.get<float>(field, base)); break;
+      case MessageProgram::FieldType::Double: m_writer.value(m_record.get<double>(field, base)); break;
+      case MessageProgram::FieldType::String:
+      case MessageProgram::FieldType::Bytes:
+        {
+          // Base64 like cluon::ToJSONVisitor, so that clients can keep
+          // their decoding.
+          DynamicRecord::StringSlice const slice = m_record.getString(field, base);
+          m_writer.valueBase64(slice.data, slice.size);
+          break;
+        }
+      case MessageProgram::FieldType::Message:
+        writeMessage(m_programs.program(field.nestedProgram), base + field.offset);
+        break;
+    }
+  }
+  m_writer.endObject();
+}
+
+std::string const &EnvelopeJsonEncoder::messageKey(MessageProgram const &program)
+{
+  // Keys are built once per program, with '.' replaced as in
+  // cluon::EnvelopeConverter.
+  std::size_t const index{static_cast<std::size_t>(&program - m_programs.programs().data())};
+  if (m_messageKeys.size() != m_programs.programs().size()) {
+    m_messageKeys.assign(m_programs.programs().size(), std::string{});
+  }
+  std::string &key = m_messageKeys[index];
+  if (key.empty()) {
+    key = program.messageName();
+    std::replace(key.begin(), key.end(), '.', '_');
+  }
+  return key;
+}
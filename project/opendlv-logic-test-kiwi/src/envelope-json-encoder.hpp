@@ -0,0 +1,69 @@
+/*
+ * Copyright (C) 2018 Ola Benderius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ENVELOPE_JSON_ENCODER
+#define ENVELOPE_JSON_ENCODER
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "cluon-complete.hpp"
+#include "json-writer.hpp"
+#include "message-program.hpp"
+
+/*
+ * Converts envelopes to JSON with the same layout as
+ * cluon::EnvelopeConverter::getJSONFromEnvelope(), but decodes through a
+ * DynamicRecord and writes through a reusable JsonWriter. Several envelopes
+ * can be collected into one JSON array frame, e.g. one frame per tick of a
+ * dashboard bridge.
+ */
+class EnvelopeJsonEncoder {
+ private:
+  EnvelopeJsonEncoder(EnvelopeJsonEncoder const &) = delete;
+  EnvelopeJsonEncoder(EnvelopeJsonEncoder &&) = delete;
+  EnvelopeJsonEncoder &operator=(EnvelopeJsonEncoder const &) = delete;
+  EnvelopeJsonEncoder &operator=(EnvelopeJsonEncoder &&) = delete;
+
+ public:
+  explicit EnvelopeJsonEncoder(MessageProgramSet const &) noexcept;
+  ~EnvelopeJsonEncoder() = default;
+
+ public:
+  std::string const &encode(cluon::data::Envelope const &);
+
+  void beginFrame();
+  bool append(cluon::data::Envelope const &);
+  std::string const &endFrame();
+  uint32_t frameSize() const noexcept;
+
+ private:
+  bool writeEnvelope(cluon::data::Envelope const &);
+  void writeTimeStamp(char const *, std::size_t, cluon::data::TimeStamp const &);
+  void writeMessage(MessageProgram const &, uint32_t);
+  std::string const &messageKey(MessageProgram const &);
+
+ private:
+  MessageProgramSet const &m_programs;
+  DynamicRecord m_record;
+  JsonWriter m_writer;
+  std::vector<std::string> m_messageKeys;
+  uint32_t m_frameSize;
+};
+
+#endif
@@ -0,0 +1,134 @@
+/*
+ * Copyright (C) 2018 Ola Benderius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#include "file-watcher.hpp"
+
+FileWatcher::FileWatcher(std::string const &path, Callback callback) noexcept:
+  m_path{path},
+  m_name{},
+  m_callback{std::move(callback)},
+  m_inotify{-1},
+  m_wakeup{-1},
+  m_running{false},
+  m_changes{0},
+  m_thread{}
+{
+  std::size_t const slash{path.rfind('/')};
+  std::string const directory{(std::string::npos == slash) ? "." : path.substr(0, slash + 1)};
+  m_name = (std::string::npos == slash) ? path : path.substr(slash + 1);
+
+  m_inotify = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  m_wakeup = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (m_inotify < 0 || m_wakeup < 0
+      || 0 > ::inotify_add_watch(m_inotify, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO)) {
+    std::cerr << "[FileWatcher]: failed to watch " << path << ": " << std::strerror(errno) << std::endl;
+    return;
+  }
+  try {
+    m_running = true;
+    m_thread = std::thread(&FileWatcher::run, this);
+  } catch (...) {
+    m_running = false;
+  }
+}
+
+FileWatcher::~FileWatcher()
+{
+  m_running = false;
+  if (m_wakeup >= 0) {
+    uint64_t const one{1};
+    if (0 > ::write(m_wakeup, &one, sizeof(one))) {
+      std::cerr << "[FileWatcher]: failed to wake up watcher thread." << std::endl;
+    }
+  }
+  if (m_thread.joinable()) {
+    m_thread.join();
+  }
+  if (m_wakeup >= 0) {
+    ::close(m_wakeup);
+  }
+  if (m_inotify >= 0) {
+    ::close(m_inotify);
+  }
+}
+
+bool FileWatcher::isRunning() const noexcept
+{
+  return m_running;
+}
+
+uint64_t FileWatcher::changes() const noexcept
+{
+  return m_changes.load(std::memory_order_relaxed);
+}
+
+void FileWatcher::run() noexcept
+{
+  // Aligned for the inotify_event structs read into it.
+  alignas(struct inotify_event) char buffer[4096];
+  struct pollfd fds[2]{};
+  fds[0].fd = m_inotify;
+  fds[0].events = POLLIN;
+  fds[1].fd = m_wakeup;
+  fds[1].events = POLLIN;
+  while (m_running) {
+    if (0 > ::poll(fds, 2, -1)) {
+      if (EINTR == errno) {
+        continue;
+      }
+      std::cerr << "[FileWatcher]: poll failed: " << std::strerror(errno) << std::endl;
+      break;
+    }
+    if (0 != (fds[1].revents & POLLIN)) {
+      continue;
+    }
+    bool changed{false};
+    ssize_t length;
+    while (0 < (length = ::read(m_inotify, buffer, sizeof(buffer)))) {
+      for (char *p{buffer}; p < buffer + length;) {
+        struct inotify_event const *event{reinterpret_cast<struct inotify_event const *>(p)};
+        if (0 < event->len && m_name == event->name) {
+          changed = true;
+        }
+        p += sizeof(struct inotify_event) + event->len;
+      }
+    }
+    if (changed) {
+      try {
+        std::ifstream file{m_path};
+        std::stringstream contents;
+        contents << file.rdbuf();
+        if (file.is_open()) {
+          m_changes.fetch_add(1, std::memory_order_relaxed);
+          m_callback(contents.str());
+        }
+      } catch (...) {
+      }
+    }
+  }
+}
@@ -0,0 +1,65 @@
+/*
+ * Copyright (C) 2018 Ola Benderius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FILE_WATCHER
+#define FILE_WATCHER
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <thread>
+
+/*
+ * Calls back with the new contents whenever a file is written or replaced,
+ * using inotify on its directory so that editors that save by renaming a
+ * temporary file are noticed as well. The callback runs on the watcher's
+ * own thread.
+ */
+class FileWatcher {
+ private:
+  FileWatcher(FileWatcher const &) = delete;
+  FileWatcher(FileWatcher &&) = delete;
+  FileWatcher &operator=(FileWatcher const &) = delete;
+  FileWatcher &operator=(FileWatcher &&) = delete;
+
+ public:
+  using Callback = std::function<void(std::string const &)>;
+
+ public:
+  FileWatcher(std::string const &, Callback) noexcept;
+  ~FileWatcher();
+
+ public:
+  bool isRunning() const noexcept;
+  uint64_t changes() const noexcept;
+
+ private:
+  void run() noexcept;
+
+ private:
+  std::string m_path;
+  std::string m_name;
+  Callback m_callback;
+  int32_t m_inotify;
+  int32_t m_wakeup;
+  std::atomic<bool> m_running;
+  std::atomic<uint64_t> m_changes;
+  std::thread m_thread;
+};
+
+#endif
@@ -0,0 +1,356 @@
+/*
+ * Copyright (C) 2018 Ola Benderius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "json-writer.hpp"
+
+namespace {
+
+double const POWERS_OF_TEN[] = {
+  1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+  1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+uint64_t const INTEGER_POWERS_OF_TEN[] = {
+  1ull, 10ull, 100ull, 1000ull, 10000ull, 100000ull, 1000000ull,
+  10000000ull, 100000000ull, 1000000000ull, 10000000000ull
+};
+
+// Multiplies by 10^k; exact steps as long as |k| <= 22.
+double scaleByPowerOfTen(double v, int32_t k) noexcept
+{
+  while (k > 22) {
+    v *= 1e22;
+    k -= 22;
+  }
+  while (k < -22) {
+    v /= 1e22;
+    k += 22;
+  }
+  return (k >= 0) ? v * POWERS_OF_TEN[k] : v / POWERS_OF_TEN[-k];
+}
+
+// Exact comparison without -Wfloat-equal; both operands are finite here.
+template <typename T>
+bool sameBits(T a, T b) noexcept
+{
+  return 0 == std::memcmp(&a, &b, sizeof(T));
+}
+
+std::size_t writeUnsigned(uint64_t v, char *out) noexcept
+{
+  char tmp[20];
+  std::size_t n{0};
+  do {
+    tmp[n++] = static_cast<char>('0' + v % 10);
+    v /= 10;
+  } while (v > 0);
+  for (std::size_t i{0}; i < n; i++) {
+    out[i] = tmp[n - 1 - i];
+  }
+  return n;
+}
+
+// Lays out `digits` (most significant first) with the first digit at
+// decimal exponent e10: fixed notation like %.9g, scientific otherwise.
+std::size_t layoutDecimal(char const *digits, std::size_t count, int32_t e10, char *out) noexcept
+{
+  std::size_t n{0};
+  while (count > 1 && '0' == digits[count - 1]) {
+    count--;
+  }
+  if (e10 < -4 || e10 >= 9) {
+    out[n++] = digits[0];
+    if (count > 1) {
+      out[n++] = '.';
+      std::memcpy(out + n, digits + 1, count - 1);
+      n += count - 1;
+    }
+    out[n++] = 'e';
+    if (e10 < 0) {
+      out[n++] = '-';
+      e10 = -e10;
+    }
+    n += writeUnsigned(static_cast<uint64_t>(e10), out + n);
+  } else if (e10 < 0) {
+    out[n++] = '0';
+    out[n++] = '.';
+    for (int32_t i{-1}; i > e10; i--) {
+      out[n++] = '0';
+    }
+    std::memcpy(out + n, digits, count);
+    n += count;
+  } else {
+    std::size_t const integerDigits{static_cast<std::size_t>(e10) + 1};
+    for (std::size_t i{0}; i < integerDigits; i++) {
+      out[n++] = (i < count) ? digits[i] : '0';
+    }
+    if (count > integerDigits) {
+      out[n++] = '.';
+      std::memcpy(out + n, digits + integerDigits, count - integerDigits);
+      n += count - integerDigits;
+    }
+  }
+  return n;
+}
+
+}
+
+std::size_t formatShortestFloat(float v, char *out) noexcept
+{
+  if (!std::isfinite(v)) {
+    std::memcpy(out, "null", 4);
+    return 4;
+  }
+  std::size_t n{0};
+  if (std::signbit(v)) {
+    out[n++] = '-';
+    v = -v;
+  }
+  if (FP_ZERO == std::fpclassify(v)) {
+    out[n++] = '0';
+    return n;
+  }
+
+  double const d{static_cast<double>(v)};
+  int32_t e10{static_cast<int32_t>(std::floor(std::log10(d)))};
+  if (scaleByPowerOfTen(1.0, e10) > d) {
+    e10--;
+  } else if (scaleByPowerOfTen(1.0, e10 + 1) <= d) {
+    e10++;
+  }
+
+  // Try 1..9 significant digits; 9 always round-trips a float.
+  for (int32_t precision{1}; precision <= 9; precision++) {
+    int32_t const k{precision - 1 - e10};
+    uint64_t digits{static_cast<uint64_t>(std::llround(scaleByPowerOfTen(d, k)))};
+    int32_t exponent{e10};
+    if (digits >= INTEGER_POWERS_OF_TEN[precision]) {
+      digits /= 10;
+      exponent++;
+    }
+    double const back{scaleByPowerOfTen(static_cast<double>(digits), exponent - precision + 1)};
+    if (sameBits(static_cast<float>(back), v)) {
+      char buffer[16];
+      std::size_t const count{writeUnsigned(digits, buffer)};
+      return n + layoutDecimal(buffer, count, exponent, out + n);
+    }
+  }
+  return n + static_cast<std::size_t>(std::snprintf(out + n, 24, "%.9g", static_cast<double>(v)));
+}
+
+std::size_t formatShortestDouble(double v, char *out) noexcept
+{
+  if (!std::isfinite(v)) {
+    std::memcpy(out, "null", 4);
+    return 4;
+  }
+  int32_t length{std::snprintf(out, 32, "%.15g", v)};
+  if (!sameBits(std::strtod(out, nullptr), v)) {
+    length = std::snprintf(out, 32, "%.17g", v);
+  }
+  return static_cast<std::size_t>(length);
+}
+
+JsonWriter::JsonWriter() noexcept:
+  m_buffer{},
+  m_hasMembers{0},
+  m_depth{0},
+  m_afterKey{false}
+{
+}
+
+void JsonWriter::clear() noexcept
+{
+  m_buffer.clear();
+  m_hasMembers = 0;
+  m_depth = 0;
+  m_afterKey = false;
+}
+
+void JsonWriter::reserve(std::size_t capacity)
+{
+  m_buffer.reserve(capacity);
+}
+
+std::string const &JsonWriter::buffer() const noexcept
+{
+  return m_buffer;
+}
+
+void JsonWriter::separate()
+{
+  if (m_afterKey) {
+    m_afterKey = false;
+    return;
+  }
+  uint64_t const bit{1ull << m_depth};
+  if (0 != (m_hasMembers & bit)) {
+    m_buffer.push_back(',');
+  }
+  m_hasMembers |= bit;
+}
+
+void JsonWriter::beginObject()
+{
+  separate();
+  m_buffer.push_back('{');
+  if (m_depth + 1 < MAX_DEPTH) {
+    m_depth++;
+  }
+  m_hasMembers &= ~(1ull << m_depth);
+}
+
+void JsonWriter::endObject()
+{
+  m_buffer.push_back('}');
+  if (m_depth > 0) {
+    m_depth--;
+  }
+}
+
+void JsonWriter::beginArray()
+{
+  separate();
+  m_buffer.push_back('[');
+  if (m_depth + 1 < MAX_DEPTH) {
+    m_depth++;
+  }
+  m_hasMembers &= ~(1ull << m_depth);
+}
+
+void JsonWriter::endArray()
+{
+  m_buffer.push_back(']');
+  if (m_depth > 0) {
+    m_depth--;
+  }
+}
+
+void JsonWriter::key(char const *name, std::size_t length)
+{
+  separate();
+  m_buffer.push_back('"');
+  m_buffer.append(name, length);
+  m_buffer.append("\":", 2);
+  m_afterKey = true;
+}
+
+void JsonWriter::key(std::string const &name)
+{
+  key(name.data(), name.size());
+}
+
+void JsonWriter::value(bool v)
+{
+  // Booleans are written as 0/1 like cluon::ToJSONVisitor does.
+  separate();
+  m_buffer.push_back(v ? '1' : '0');
+}
+
+void JsonWriter::value(int64_t v)
+{
+  separate();
+  if (v < 0) {
+    m_buffer.push_back('-');
+    appendUnsigned(~static_cast<uint64_t>(v) + 1);
+  } else {
+    appendUnsigned(static_cast<uint64_t>(v));
+  }
+}
+
+void JsonWriter::value(uint64_t v)
+{
+  separate();
+  appendUnsigned(v);
+}
+
+void JsonWriter::value(float v)
+{
+  separate();
+  char tmp[32];
+  m_buffer.append(tmp, formatShortestFloat(v, tmp));
+}
+
+void JsonWriter::value(double v)
+{
+  separate();
+  char tmp[32];
+  m_buffer.append(tmp, formatShortestDouble(v, tmp));
+}
+
+void JsonWriter::valueString(char const *data, std::size_t length)
+{
+  static char const HEX[] = "0123456789abcdef";
+  separate();
+  m_buffer.push_back('"');
+  for (std::size_t i{0}; i < length; i++) {
+    unsigned char const c{static_cast<unsigned char>(data[i])};
+    if ('"' == c || '\\' == c) {
+      m_buffer.push_back('\\');
+      m_buffer.push_back(static_cast<char>(c));
+    } else if (c < 0x20) {
+      char const escaped[] = {'\\', 'u', '0', '0', HEX[c >> 4], HEX[c & 0xf]};
+      m_buffer.append(escaped, sizeof(escaped));
+    } else {
+      m_buffer.push_back(static_cast<char>(c));
+    }
+  }
+  m_buffer.push_back('"');
+}
+
+void JsonWriter::valueBase64(char const *data, std::size_t length)
+{
+  static char const ALPHABET[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  separate();
+  m_buffer.push_back('"');
+  std::size_t i{0};
+  for (; i + 2 < length; i += 3) {
+    uint32_t const v{(static_cast<uint32_t>(static_cast<uint8_t>(data[i])) << 16)
+      | (static_cast<uint32_t>(static_cast<uint8_t>(data[i + 1])) << 8)
+      | static_cast<uint32_t>(static_cast<uint8_t>(data[i + 2]))};
+    char const quad[] = {ALPHABET[(v >> 18) & 63], ALPHABET[(v >> 12) & 63], ALPHABET[(v >> 6) & 63], ALPHABET[v & 63]};
+    m_buffer.append(quad, 4);
+  }
+  if (length - i == 2) {
+    uint32_t const v{(static_cast<uint32_t>(static_cast<uint8_t>(data[i])) << 16)
+      | (static_cast<uint32_t>(static_cast<uint8_t>(data[i + 1])) << 8)};
+    char const quad[] = {ALPHABET[(v >> 18) & 63], ALPHABET[(v >> 12) & 63], ALPHABET[(v >> 6) & 63], '='};
+    m_buffer.append(quad, 4);
+  } else if (length - i == 1) {
+    uint32_t const v{static_cast<uint32_t>(static_cast<uint8_t>(data[i])) << 16};
+    char const quad[] = {ALPHABET[(v >> 18) & 63], ALPHABET[(v >> 12) & 63], '=', '='};
+    m_buffer.append(quad, 4);
+  }
+  m_buffer.push_back('"');
+}
+
+void JsonWriter::valueNull()
+{
+  separate();
+  m_buffer.append("null", 4);
+}
+
+void JsonWriter::appendUnsigned(uint64_t v)
+{
+  char tmp[20];
+  m_buffer.append(tmp, writeUnsigned(v, tmp));
+}
@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) 2018 Ola Benderius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef JSON_WRITER
+#define JSON_WRITER
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/*
+ * Writes the shortest decimal representation of v that reads back as the
+ * same float into out (at least 24 bytes) and returns the number of bytes.
+ */
+std::size_t formatShortestFloat(float v, char *out) noexcept;
+std::size_t formatShortestDouble(double v, char *out) noexcept;
+
+/*
+ * Streaming JSON writer appending to a reusable buffer; commas between
+ * members and array elements are inserted automatically. clear() keeps the
+ * capacity, so a warm writer does not allocate.
+ */
+class JsonWriter {
+ private:
+  JsonWriter(JsonWriter const &) = delete;
+  JsonWriter(JsonWriter &&) = delete;
+  JsonWriter &operator=(JsonWriter const &) = delete;
+  JsonWriter &operator=(JsonWriter &&) = delete;
+
+ public:
+  JsonWriter() noexcept;
+  ~JsonWriter() = default;
+
+ public:
+  void clear() noexcept;
+  void reserve(std::size_t);
+  std::string const &buffer() const noexcept;
+
+  void beginObject();
+  void endObject();
+  void beginArray();
+  void endArray();
+  void key(char const *, std::size_t);
+  void key(std::string const &);
+  void value(bool);
+  void value(int64_t);
+  void value(uint64_t);
+  void value(float);
+  void value(double);
+  void valueString(char const *, std::size_t);
+  void valueBase64(char const *, std::size_t);
+  void valueNull();
+
+ private:
+  void separate();
+  void appendUnsigned(uint64_t);
+
+ private:
+  static uint32_t const MAX_DEPTH{64};
+
+  std::string m_buffer;
+  uint64_t m_hasMembers;
+  uint32_t m_depth;
+  bool m_afterKey;
+};
+
+#endif
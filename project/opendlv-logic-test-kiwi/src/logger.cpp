@@ -0,0 +1,282 @@
+/*
+ * Copyright (C) 2018 Ola Benderius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <limits>
+
+#include "logger.hpp"
+
+namespace {
+
+std::atomic<uint64_t> g_nextLoggerIdentifier{1};
+
+bool isIntegerConversion(char c) noexcept
+{
+  return nullptr != std::strchr("diouxXc", c);
+}
+
+bool isFloatingConversion(char c) noexcept
+{
+  return nullptr != std::strchr("fFeEgGaA", c);
+}
+
+// Formats one argument with one printf conversion spec (without length
+// modifier), converting the argument to what the spec expects.
+void appendArgument(std::string &out, std::string &spec, char conversion, Logger::Argument const &argument)
+{
+  char buffer[128];
+  int32_t length{0};
+  if (isIntegerConversion(conversion)) {
+    spec.append("ll");
+    spec.push_back(conversion);
+    long long value{0};
+    switch (argument.type) {
+      case Logger::Argument::Type::Signed: value = static_cast<long long>(argument.i); break;
+      case Logger::Argument::Type::Unsigned: value = static_cast<long long>(argument.u); break;
+      case Logger::Argument::Type::Floating: value = static_cast<long long>(argument.d); break;
+      case Logger::Argument::Type::String: value = 0; break;
+    }
+    if ('c' == conversion) {
+      spec.erase(spec.size() - 3, 2);
+      length = std::snprintf(buffer, sizeof(buffer), spec.c_str(), static_cast<int>(value));
+    } else {
+      length = std::snprintf(buffer, sizeof(buffer), spec.c_str(), value);
+    }
+  } else if (isFloatingConversion(conversion)) {
+    spec.push_back(conversion);
+    double value{0.0};
+    switch (argument.type) {
+      case Logger::Argument::Type::Signed: value = static_cast<double>(argument.i); break;
+      case Logger::Argument::Type::Unsigned: value = static_cast<double>(argument.u); break;
+      case Logger::Argument::Type::Floating: value = argument.d; break;
+      case Logger::Argument::Type::String: value = 0.0; break;
+    }
+    length = std::snprintf(buffer, sizeof(buffer), spec.c_str(), value);
+  } else {
+    spec.push_back('s');
+    char const *value{(Logger::Argument::Type::String == argument.type && nullptr != argument.s) ? argument.s : "?"};
+    length = std::snprintf(buffer, sizeof(buffer), spec.c_str(), value);
+  }
+  if (length > 0) {
+    out.append(buffer, std::min(static_cast<std::size_t>(length), sizeof(buffer) - 1));
+  }
+}
+
+}
+
+LogSite::LogSite(char const *format, std::chrono::nanoseconds minimumInterval, uint32_t sampleEvery) noexcept:
+  m_format{format},
+  m_minimumInterval{minimumInterval.count()},
+  m_sampleEvery{(sampleEvery > 0) ? sampleEvery : 1},
+  m_calls{0},
+  m_suppressed{0},
+  m_lastEmitted{std::numeric_limits<int64_t>::min() / 2}
+{
+}
+
+char const *LogSite::format() const noexcept
+{
+  return m_format;
+}
+
+bool LogSite::admit(int64_t now, uint64_t &suppressed) noexcept
+{
+  uint64_t const call{m_calls.fetch_add(1, std::memory_order_relaxed)};
+  if (0 != call % m_sampleEvery) {
+    m_suppressed.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  if (m_minimumInterval > 0) {
+    int64_t last{m_lastEmitted.load(std::memory_order_relaxed)};
+    if (now - last < m_minimumInterval
+        || !m_lastEmitted.compare_exchange_strong(last, now, std::memory_order_relaxed)) {
+      m_suppressed.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+  }
+  suppressed = m_suppressed.exchange(0, std::memory_order_relaxed);
+  return true;
+}
+
+Logger::Logger(std::ostream &out, std::chrono::milliseconds interval) noexcept:
+  m_identifier{g_nextLoggerIdentifier.fetch_add(1)},
+  m_out(out),
+  m_interval{interval},
+  m_ringsMutex{},
+  m_rings{},
+  m_drainMutex{},
+  m_text{},
+  m_wakeupMutex{},
+  m_wakeup{},
+  m_running{true},
+  m_written{0},
+  m_dropped{0},
+  m_thread{}
+{
+  try {
+    m_thread = std::thread(&Logger::run, this);
+  } catch (...) {
+    std::cerr << "[Logger]: failed to start the output thread, logging synchronously on flush." << std::endl;
+  }
+}
+
+Logger::~Logger()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_wakeupMutex);
+    m_running = false;
+  }
+  m_wakeup.notify_all();
+  if (m_thread.joinable()) {
+    m_thread.join();
+  }
+  drain();
+}
+
+uint64_t Logger::written() const noexcept
+{
+  return m_written.load(std::memory_order_relaxed);
+}
+
+uint64_t Logger::dropped() const noexcept
+{
+  return m_dropped.load(std::memory_order_relaxed);
+}
+
+void Logger::flush() noexcept
+{
+  drain();
+}
+
+std::string Logger::format(Record const &record)
+{
+  std::string out;
+  std::string spec;
+  char const *f{(nullptr != record.site) ? record.site->format() : ""};
+  uint32_t next{0};
+  while ('\0' != *f) {
+    if ('%' != *f) {
+      char const *end{std::strchr(f, '%')};
+      std::size_t const length{(nullptr == end) ? std::strlen(f) : static_cast<std::size_t>(end - f)};
+      out.append(f, length);
+      f += length;
+      continue;
+    }
+    if ('%' == f[1]) {
+      out.push_back('%');
+      f += 2;
+      continue;
+    }
+    // Flags, width and precision are kept; length modifiers are replaced.
+    spec.assign(1, '%');
+    f++;
+    while ('\0' != *f && nullptr != std::strchr("-+ #0123456789.", *f)) {
+      spec.push_back(*f++);
+    }
+    while ('\0' != *f && nullptr != std::strchr("hlLqjzt", *f)) {
+      f++;
+    }
+    if ('\0' == *f) {
+      break;
+    }
+    char const conversion{*f++};
+    if (next < record.count) {
+      appendArgument(out, spec, conversion, record.arguments[next++]);
+    }
+  }
+  if (record.suppressed > 0) {
+    out.append(" [suppressed ").append(std::to_string(record.suppressed)).append("]");
+  }
+  return out;
+}
+
+Logger::Ring *Logger::localRing() noexcept
+{
+  // Rings stay with their Logger when a thread ends; the identifier rather
+  // than the address tells instances apart.
+  struct CachedRing {
+    uint64_t owner;
+    Ring *ring;
+  };
+  thread_local std::vector<CachedRing> cache;
+  for (auto const &cached : cache) {
+    if (cached.owner == m_identifier) {
+      return cached.ring;
+    }
+  }
+  try {
+    std::lock_guard<std::mutex> lock(m_ringsMutex);
+    m_rings.push_back(std::make_unique<Ring>());
+    cache.push_back(CachedRing{m_identifier, m_rings.back().get()});
+    return m_rings.back().get();
+  } catch (...) {
+    return nullptr;
+  }
+}
+
+Logger::Record *Logger::beginRecord(Ring &ring) noexcept
+{
+  uint64_t const head{ring.head.load(std::memory_order_relaxed)};
+  if (head - ring.tail.load(std::memory_order_acquire) >= RING_SIZE) {
+    return nullptr;
+  }
+  return &ring.records[head % RING_SIZE];
+}
+
+void Logger::commitRecord(Ring &ring) noexcept
+{
+  ring.head.store(ring.head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+void Logger::drain() noexcept
+{
+  std::lock_guard<std::mutex> drainLock(m_drainMutex);
+  uint64_t lines{0};
+  try {
+    m_text.clear();
+    std::lock_guard<std::mutex> lock(m_ringsMutex);
+    for (auto &ring : m_rings) {
+      uint64_t tail{ring->tail.load(std::memory_order_relaxed)};
+      uint64_t const head{ring->head.load(std::memory_order_acquire)};
+      for (; tail != head; tail++) {
+        m_text.append(format(ring->records[tail % RING_SIZE])).push_back('\n');
+        lines++;
+      }
+      ring->tail.store(tail, std::memory_order_release);
+    }
+    if (lines > 0) {
+      m_out.write(m_text.data(), static_cast<std::streamsize>(m_text.size()));
+      m_out.flush();
+      m_written.fetch_add(lines, std::memory_order_relaxed);
+    }
+  } catch (...) {
+  }
+}
+
+void Logger::run() noexcept
+{
+  std::unique_lock<std::mutex> lock(m_wakeupMutex);
+  while (m_running) {
+    m_wakeup.wait_for(lock, m_interval, [this]() { return !m_running; });
+    lock.unlock();
+    drain();
+    lock.lock();
+  }
+}
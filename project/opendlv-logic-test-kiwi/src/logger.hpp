@@ -0,0 +1,211 @@
+/*
+ * Copyright (C) 2018 Ola Benderius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LOGGER
+#define LOGGER
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+/*
+ * One log statement in the code: its printf-style format and how often it
+ * may emit. A site emits at most once per minimum interval and only every
+ * n-th call; everything else is counted as suppressed and reported with
+ * the next record of the site.
+ */
+class LogSite {
+ private:
+  LogSite(LogSite const &) = delete;
+  LogSite(LogSite &&) = delete;
+  LogSite &operator=(LogSite const &) = delete;
+  LogSite &operator=(LogSite &&) = delete;
+
+ public:
+  LogSite(char const *, std::chrono::nanoseconds, uint32_t) noexcept;
+  ~LogSite() = default;
+
+ public:
+  char const *format() const noexcept;
+  // True if this call may emit; also returns (and resets) the number of
+  // calls suppressed since the last emitted one.
+  bool admit(int64_t, uint64_t &) noexcept;
+
+ private:
+  char const *m_format;
+  int64_t const m_minimumInterval;
+  uint32_t const m_sampleEvery;
+  std::atomic<uint64_t> m_calls;
+  std::atomic<uint64_t> m_suppressed;
+  std::atomic<int64_t> m_lastEmitted;
+};
+
+/*
+ * Asynchronous logger for control loops. The calling thread only copies
+ * the arguments as a binary record into its own single-producer ring
+ * buffer, which never blocks: when the ring is full the record is dropped
+ * and counted. A background thread formats the records and writes them to
+ * the output, flushing once per batch rather than once per line.
+ */
+class Logger {
+ private:
+  Logger(Logger const &) = delete;
+  Logger(Logger &&) = delete;
+  Logger &operator=(Logger const &) = delete;
+  Logger &operator=(Logger &&) = delete;
+
+ public:
+  static uint32_t const MAX_ARGUMENTS{8};
+
+  struct Argument {
+    enum class Type : uint8_t { Signed, Unsigned, Floating, String };
+    Type type{Type::Signed};
+    union {
+      int64_t i{0};
+      uint64_t u;
+      double d;
+      char const *s;
+    };
+  };
+
+  struct Record {
+    LogSite const *site{nullptr};
+    uint64_t suppressed{0};
+    uint32_t count{0};
+    Argument arguments[MAX_ARGUMENTS];
+  };
+
+ public:
+  explicit Logger(std::ostream &, std::chrono::milliseconds = std::chrono::milliseconds(50)) noexcept;
+  ~Logger();
+
+ public:
+  /*
+   * Arguments are numbers or string literals; a string is stored as a
+   * pointer and must outlive the logger.
+   */
+  template <typename... Args>
+  void log(LogSite &site, Args... args) noexcept
+  {
+    static_assert(sizeof...(Args) <= MAX_ARGUMENTS, "Too many log arguments.");
+    uint64_t suppressed{0};
+    int64_t const now{std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count()};
+    if (!site.admit(now, suppressed)) {
+      return;
+    }
+    Ring *ring{localRing()};
+    Record *record{(nullptr == ring) ? nullptr : beginRecord(*ring)};
+    if (nullptr == record) {
+      m_dropped.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+    record->site = &site;
+    record->suppressed = suppressed;
+    record->count = 0;
+    int32_t const unused[] = {0, (store(*record, args), 0)...};
+    (void) unused;
+    commitRecord(*ring);
+  }
+
+  uint64_t written() const noexcept;
+  uint64_t dropped() const noexcept;
+  // Blocks until everything logged so far has been written.
+  void flush() noexcept;
+
+  // Formats a record like the background thread does.
+  static std::string format(Record const &);
+
+ private:
+  static uint32_t const RING_SIZE{1024};
+
+  struct Ring {
+    std::atomic<uint64_t> head{0};
+    std::atomic<uint64_t> tail{0};
+    Record records[RING_SIZE];
+  };
+
+ private:
+  template <typename T, typename std::enable_if<std::is_integral<T>::value && std::is_signed<T>::value, int>::type = 0>
+  static void store(Record &record, T value) noexcept
+  {
+    Argument &argument = record.arguments[record.count++];
+    argument.type = Argument::Type::Signed;
+    argument.i = value;
+  }
+  template <typename T, typename std::enable_if<std::is_integral<T>::value && !std::is_signed<T>::value, int>::type = 0>
+  static void store(Record &record, T value) noexcept
+  {
+    Argument &argument = record.arguments[record.count++];
+    argument.type = Argument::Type::Unsigned;
+    argument.u = value;
+  }
+  template <typename T, typename std::enable_if<std::is_floating_point<T>::value, int>::type = 0>
+  static void store(Record &record, T value) noexcept
+  {
+    Argument &argument = record.arguments[record.count++];
+    argument.type = Argument::Type::Floating;
+    argument.d = static_cast<double>(value);
+  }
+  static void store(Record &record, char const *value) noexcept
+  {
+    Argument &argument = record.arguments[record.count++];
+    argument.type = Argument::Type::String;
+    argument.s = value;
+  }
+
+  Ring *localRing() noexcept;
+  Record *beginRecord(Ring &) noexcept;
+  void commitRecord(Ring &) noexcept;
+  void drain() noexcept;
+  void run() noexcept;
+
+ private:
+  uint64_t const m_identifier;
+  std::ostream &m_out;
+  std::chrono::milliseconds const m_interval;
+  std::mutex m_ringsMutex;
+  std::vector<std::unique_ptr<Ring>> m_rings;
+  std::mutex m_drainMutex;
+  std::string m_text;
+  std::mutex m_wakeupMutex;
+  std::condition_variable m_wakeup;
+  bool m_running;
+  std::atomic<uint64_t> m_written;
+  std::atomic<uint64_t> m_dropped;
+  std::thread m_thread;
+};
+
+/*
+ * Logs at most once per interval (milliseconds) and only every n-th call
+ * from this statement, e.g.
+ *   LOG_RATE_LIMITED(logger, 100, 1, "Steer %6.3f Pedal %6.3f", steer, pedal);
+ */
+#define LOG_RATE_LIMITED(LOGGER, INTERVAL_MS, SAMPLE_EVERY, FORMAT, ...) \
+  do { \
+    static LogSite logSite{FORMAT, std::chrono::milliseconds(INTERVAL_MS), SAMPLE_EVERY}; \
+    (LOGGER).log(logSite, __VA_ARGS__); \
+  } while (false)
+
+#endif
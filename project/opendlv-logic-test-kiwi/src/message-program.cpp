@@ -0,0 +1,403 @@
+/*
+ * Copyright (C) 2018 Ola Benderius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "message-program.hpp"
+
+namespace {
+
+uint32_t const MAX_NESTING_DEPTH{16};
+uint32_t const STRING_SLOT_SIZE{2 * sizeof(uint32_t)};
+uint32_t const IN_PROGRESS{0xFFFFFFFE};
+
+bool readVarInt(char const *&it, char const *end, uint64_t &value) noexcept
+{
+  value = 0;
+  uint32_t shift{0};
+  while (it < end && shift < 64) {
+    uint8_t const b = static_cast<uint8_t>(*it++);
+    value |= static_cast<uint64_t>(b & 0x7f) << shift;
+    if (0 == (b & 0x80)) {
+      return true;
+    }
+    shift += 7;
+  }
+  return false;
+}
+
+template <typename T>
+void store(std::vector<char> &data, uint32_t offset, T value) noexcept
+{
+  std::memcpy(data.data() + offset, &value, sizeof(T));
+}
+
+uint32_t sizeOf(MessageProgram::FieldType type) noexcept
+{
+  switch (type) {
+    case MessageProgram::FieldType::Bool:
+    case MessageProgram::FieldType::Char:
+    case MessageProgram::FieldType::Int8:
+    case MessageProgram::FieldType::UInt8: return 1;
+    case MessageProgram::FieldType::Int16:
+    case MessageProgram::FieldType::UInt16: return 2;
+    case MessageProgram::FieldType::Int32:
+    case MessageProgram::FieldType::UInt32:
+    case MessageProgram::FieldType::Float: return 4;
+    case MessageProgram::FieldType::Int64:
+    case MessageProgram::FieldType::UInt64:
+    case MessageProgram::FieldType::Double: return 8;
+    case MessageProgram::FieldType::String:
+    case MessageProgram::FieldType::Bytes: return STRING_SLOT_SIZE;
+    case MessageProgram::FieldType::Message: return 0;
+  }
+  return 0;
+}
+
+bool toFieldType(cluon::MetaMessage::MetaField::MetaFieldDataTypes type, MessageProgram::FieldType &out) noexcept
+{
+  switch (type) {
+    case cluon::MetaMessage::MetaField::BOOL_T: out = MessageProgram::FieldType::Bool; return true;
+    case cluon::MetaMessage::MetaField::CHAR_T: out = MessageProgram::FieldType::Char; return true;
+    case cluon::MetaMessage::MetaField::INT8_T: out = MessageProgram::FieldType::Int8; return true;
+    case cluon::MetaMessage::MetaField::UINT8_T: out = MessageProgram::FieldType::UInt8; return true;
+    case cluon::MetaMessage::MetaField::INT16_T: out = MessageProgram::FieldType::Int16; return true;
+    case cluon::MetaMessage::MetaField::UINT16_T: out = MessageProgram::FieldType::UInt16; return true;
+    case cluon::MetaMessage::MetaField::INT32_T: out = MessageProgram::FieldType::Int32; return true;
+    case cluon::MetaMessage::MetaField::UINT32_T: out = MessageProgram::FieldType::UInt32; return true;
+    case cluon::MetaMessage::MetaField::INT64_T: out = MessageProgram::FieldType::Int64; return true;
+    case cluon::MetaMessage::MetaField::UINT64_T: out = MessageProgram::FieldType::UInt64; return true;
+    case cluon::MetaMessage::MetaField::FLOAT_T: out = MessageProgram::FieldType::Float; return true;
+    case cluon::MetaMessage::MetaField::DOUBLE_T: out = MessageProgram::FieldType::Double; return true;
+    case cluon::MetaMessage::MetaField::STRING_T: out = MessageProgram::FieldType::String; return true;
+    case cluon::MetaMessage::MetaField::BYTES_T: out = MessageProgram::FieldType::Bytes; return true;
+    case cluon::MetaMessage::MetaField::MESSAGE_T: out = MessageProgram::FieldType::Message; return true;
+    case cluon::MetaMessage::MetaField::UNDEFINED_T: return false;
+  }
+  return false;
+}
+
+uint32_t alignUp(uint32_t offset, uint32_t alignment) noexcept
+{
+  return (offset + alignment - 1) / alignment * alignment;
+}
+
+}
+
+constexpr uint32_t MessageProgram::NO_NESTED_PROGRAM;
+
+MessageProgram::MessageProgram() noexcept:
+  m_messageIdentifier{0},
+  m_messageName{},
+  m_shortName{},
+  m_recordSize{0},
+  m_fields{},
+  m_fieldIndexByIdentifier{}
+{
+}
+
+int32_t MessageProgram::messageIdentifier() const noexcept
+{
+  return m_messageIdentifier;
+}
+
+std::string const &MessageProgram::messageName() const noexcept
+{
+  return m_messageName;
+}
+
+std::string const &MessageProgram::shortName() const noexcept
+{
+  return m_shortName;
+}
+
+uint32_t MessageProgram::recordSize() const noexcept
+{
+  return m_recordSize;
+}
+
+std::vector<MessageProgram::Field> const &MessageProgram::fields() const noexcept
+{
+  return m_fields;
+}
+
+MessageProgram::Field const *MessageProgram::findField(uint32_t fieldIdentifier) const noexcept
+{
+  if (fieldIdentifier < m_fieldIndexByIdentifier.size()) {
+    int32_t const index = m_fieldIndexByIdentifier[fieldIdentifier];
+    if (index >= 0) {
+      return &m_fields[static_cast<std::size_t>(index)];
+    }
+  }
+  return nullptr;
+}
+
+MessageProgramSet::MessageProgramSet() noexcept:
+  m_metaMessages{},
+  m_metaMessageIndexByName{},
+  m_programs{},
+  m_programIndexByMetaMessage{},
+  m_programIndexByIdentifier{}
+{
+}
+
+int32_t MessageProgramSet::setMessageSpecification(std::string const &messageSpecification) noexcept
+{
+  cluon::MessageParser messageParser;
+  auto result = messageParser.parse(messageSpecification);
+  if (cluon::MessageParser::MessageParserErrorCodes::NO_ERROR != result.second) {
+    return -1;
+  }
+  return compile(result.first);
+}
+
+int32_t MessageProgramSet::compile(std::vector<cluon::MetaMessage> const &metaMessages) noexcept
+{
+  m_metaMessages = metaMessages;
+  m_metaMessageIndexByName.clear();
+  m_programs.clear();
+  m_programIndexByMetaMessage.assign(m_metaMessages.size(), MessageProgram::NO_NESTED_PROGRAM);
+  m_programIndexByIdentifier.clear();
+
+  for (uint32_t i{0}; i < m_metaMessages.size(); i++) {
+    auto const &metaMessage = m_metaMessages[i];
+    m_metaMessageIndexByName[metaMessage.messageName()] = i;
+    if (!metaMessage.packageName().empty()) {
+      m_metaMessageIndexByName[metaMessage.packageName() + "." + metaMessage.messageName()] = i;
+    }
+  }
+
+  // Reserve up front; programs refer to each other by index and must not move.
+  m_programs.reserve(m_metaMessages.size());
+  for (uint32_t i{0}; i < m_metaMessages.size(); i++) {
+    uint32_t const index = compileMessage(m_metaMessages[i], 0);
+    m_programIndexByIdentifier[m_metaMessages[i].messageIdentifier()] = index;
+  }
+  return static_cast<int32_t>(m_programs.size());
+}
+
+uint32_t MessageProgramSet::compileMessage(cluon::MetaMessage const &metaMessage, uint32_t depth) noexcept
+{
+  uint32_t const metaIndex = m_metaMessageIndexByName[metaMessage.messageName()];
+  if (MessageProgram::NO_NESTED_PROGRAM != m_programIndexByMetaMessage[metaIndex]) {
+    return m_programIndexByMetaMessage[metaIndex];
+  }
+  m_programIndexByMetaMessage[metaIndex] = IN_PROGRESS;
+
+  MessageProgram program;
+  program.m_messageIdentifier = metaMessage.messageIdentifier();
+  program.m_messageName = metaMessage.messageName();
+  std::size_t const lastDot = program.m_messageName.find_last_of('.');
+  program.m_shortName = (std::string::npos == lastDot) ? program.m_messageName : program.m_messageName.substr(lastDot + 1);
+
+  uint32_t offset{0};
+  uint32_t maxIdentifier{0};
+  for (auto const &metaField : metaMessage.listOfMetaFields()) {
+    MessageProgram::Field field{metaField.fieldIdentifier(), MessageProgram::FieldType::Bool, 0,
+      MessageProgram::NO_NESTED_PROGRAM, metaField.fieldName(), metaField.fieldDataTypeName()};
+    if (!toFieldType(metaField.fieldDataType(), field.type)) {
+      continue;
+    }
+
+    uint32_t size = sizeOf(field.type);
+    uint32_t alignment = (STRING_SLOT_SIZE == size) ? sizeof(uint32_t) : size;
+    if (MessageProgram::FieldType::Message == field.type) {
+      auto nested = m_metaMessageIndexByName.find(metaField.fieldDataTypeName());
+      if (m_metaMessageIndexByName.end() == nested || depth >= MAX_NESTING_DEPTH
+          || IN_PROGRESS == m_programIndexByMetaMessage[nested->second]) {
+        continue;
+      }
+      field.nestedProgram = compileMessage(m_metaMessages[nested->second], depth + 1);
+      size = m_programs[field.nestedProgram].m_recordSize;
+      alignment = sizeof(uint64_t);
+    }
+
+    offset = alignUp(offset, alignment);
+    field.offset = offset;
+    offset += size;
+    if (field.fieldIdentifier > maxIdentifier) {
+      maxIdentifier = field.fieldIdentifier;
+    }
+    program.m_fields.push_back(std::move(field));
+  }
+  program.m_recordSize = alignUp(offset, sizeof(uint64_t));
+
+  program.m_fieldIndexByIdentifier.assign(maxIdentifier + 1, -1);
+  for (std::size_t i{0}; i < program.m_fields.size(); i++) {
+    program.m_fieldIndexByIdentifier[program.m_fields[i].fieldIdentifier] = static_cast<int32_t>(i);
+  }
+
+  uint32_t const index = static_cast<uint32_t>(m_programs.size());
+  m_programs.push_back(std::move(program));
+  m_programIndexByMetaMessage[metaIndex] = index;
+  return index;
+}
+
+MessageProgram const *MessageProgramSet::find(int32_t messageIdentifier) const noexcept
+{
+  auto it = m_programIndexByIdentifier.find(messageIdentifier);
+  return (m_programIndexByIdentifier.end() == it) ? nullptr : &m_programs[it->second];
+}
+
+MessageProgram const &MessageProgramSet::program(uint32_t index) const noexcept
+{
+  return m_programs[index];
+}
+
+std::vector<MessageProgram> const &MessageProgramSet::programs() const noexcept
+{
+  return m_programs;
+}
+
+std::vector<cluon::MetaMessage> const &MessageProgramSet::metaMessages() const noexcept
+{
+  return m_metaMessages;
+}
+
+DynamicRecord::DynamicRecord(MessageProgramSet const &programs) noexcept:
+  m_programs(programs),
+  m_program{nullptr},
+  m_data{},
+  m_arena{}
+{
+}
+
+bool DynamicRecord::decode(int32_t messageIdentifier, std::string const &payload) noexcept
+{
+  return decode(messageIdentifier, payload.data(), payload.size());
+}
+
+bool DynamicRecord::decode(cluon::data::Envelope const &envelope) noexcept
+{
+  std::string const &payload = envelope.serializedData();
+  return decode(envelope.dataType(), payload.data(), payload.size());
+}
+
+bool DynamicRecord::decode(int32_t messageIdentifier, char const *payload, std::size_t length) noexcept
+{
+  m_program = m_programs.find(messageIdentifier);
+  if (nullptr == m_program) {
+    return false;
+  }
+  // Both buffers keep their capacity, so a warm record decodes without allocating.
+  m_data.assign(m_program->recordSize(), 0);
+  m_arena.clear();
+  return decodeInto(*m_program, 0, payload, payload + length, 0);
+}
+
+MessageProgram const *DynamicRecord::program() const noexcept
+{
+  return m_program;
+}
+
+char const *DynamicRecord::data() const noexcept
+{
+  return m_data.data();
+}
+
+DynamicRecord::StringSlice DynamicRecord::getString(MessageProgram::Field const &field, uint32_t base) const noexcept
+{
+  uint32_t slot[2];
+  std::memcpy(slot, m_data.data() + base + field.offset, sizeof(slot));
+  return StringSlice{m_arena.data() + slot[0], slot[1]};
+}
+
+bool DynamicRecord::decodeInto(MessageProgram const &program, uint32_t base, char const *it,
+    char const *end, uint32_t depth) noexcept
+{
+  while (it < end) {
+    uint64_t key{0};
+    if (!readVarInt(it, end, key)) {
+      return false;
+    }
+    MessageProgram::Field const *field = program.findField(static_cast<uint32_t>(key >> 3));
+    cluon::ProtoConstants const wireType = static_cast<cluon::ProtoConstants>(key & 0x7);
+    uint32_t const offset = (nullptr == field) ? 0 : base + field->offset;
+
+    if (cluon::ProtoConstants::VARINT == wireType) {
+      uint64_t v{0};
+      if (!readVarInt(it, end, v)) {
+        return false;
+      }
+      if (nullptr == field) {
+        continue;
+      }
+      switch (field->type) {
+        case MessageProgram::FieldType::Bool: store(m_data, offset, 0 != v); break;
+        case MessageProgram::FieldType::Char: store(m_data, offset, static_cast<char>(v)); break;
+        case MessageProgram::FieldType::UInt8: store(m_data, offset, static_cast<uint8_t>(v)); break;
+        case MessageProgram::FieldType::UInt16: store(m_data, offset, static_cast<uint16_t>(v)); break;
+        case MessageProgram::FieldType::UInt32: store(m_data, offset, static_cast<uint32_t>(v)); break;
+        case MessageProgram::FieldType::UInt64: store(m_data, offset, v); break;
+        case MessageProgram::FieldType::Int8:
+          store(m_data, offset, static_cast<int8_t>((v >> 1) ^ (~(v & 1) + 1)));
+          break;
+        case MessageProgram::FieldType::Int16:
+          store(m_data, offset, static_cast<int16_t>((v >> 1) ^ (~(v & 1) + 1)));
+          break;
+        case MessageProgram::FieldType::Int32:
+          store(m_data, offset, static_cast<int32_t>((v >> 1) ^ (~(v & 1) + 1)));
+          break;
+        case MessageProgram::FieldType::Int64:
+          store(m_data, offset, static_cast<int64_t>((v >> 1) ^ (~(v & 1) + 1)));
+          break;
+        default: break;
+      }
+    } else if (cluon::ProtoConstants::FOUR_BYTES == wireType) {
+      if (end - it < 4) {
+        return false;
+      }
+      if (nullptr != field && MessageProgram::FieldType::Float == field->type) {
+        uint32_t raw;
+        std::memcpy(&raw, it, sizeof(raw));
+        raw = le32toh(raw);
+        std::memcpy(m_data.data() + offset, &raw, sizeof(raw));
+      }
+      it += 4;
+    } else if (cluon::ProtoConstants::EIGHT_BYTES == wireType) {
+      if (end - it < 8) {
+        return false;
+      }
+      if (nullptr != field && MessageProgram::FieldType::Double == field->type) {
+        uint64_t raw;
+        std::memcpy(&raw, it, sizeof(raw));
+        raw = le64toh(raw);
+        std::memcpy(m_data.data() + offset, &raw, sizeof(raw));
+      }
+      it += 8;
+    } else if (cluon::ProtoConstants::LENGTH_DELIMITED == wireType) {
+      uint64_t length{0};
+      if (!readVarInt(it, end, length) || static_cast<uint64_t>(end - it) < length) {
+        return false;
+      }
+      if (nullptr != field) {
+        if (MessageProgram::FieldType::String == field->type || MessageProgram::FieldType::Bytes == field->type) {
+          uint32_t const slot[2]{static_cast<uint32_t>(m_arena.size()), static_cast<uint32_t>(length)};
+          m_arena.append(it, static_cast<std::size_t>(length));
+          std::memcpy(m_data.data() + offset, slot, sizeof(slot));
+        } else if (MessageProgram::FieldType::Message == field->type && depth < MAX_NESTING_DEPTH) {
+          if (!decodeInto(m_programs.program(field->nestedProgram), offset, it,
+                it + length, depth + 1)) {
+            return false;
+          }
+        }
+      }
+      it += length;
+    } else {
+      return false;
+    }
+  }
+  return true;
+}
@@ -0,0 +1,272 @@
+/*
+ * Copyright (C) 2018 Ola Benderius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MESSAGE_PROGRAM
+#define MESSAGE_PROGRAM
+
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "cluon-complete.hpp"
+
+/*
+ * A MessageProgram is a MetaMessage compiled once into a flat list of
+ * (field identifier, type, byte offset) entries. Payloads are decoded by a
+ * DynamicRecord straight into a preallocated buffer laid out by the program,
+ * which replaces the per-field linb::any boxing of cluon::GenericMessage.
+ */
+class MessageProgram {
+ public:
+  enum class FieldType : uint8_t {
+    Bool, Char, Int8, UInt8, Int16, UInt16, Int32, UInt32, Int64, UInt64,
+    Float, Double, String, Bytes, Message
+  };
+
+  struct Field {
+    uint32_t fieldIdentifier;
+    FieldType type;
+    uint32_t offset;
+    uint32_t nestedProgram;
+    std::string name;
+    std::string typeName;
+  };
+
+  static constexpr uint32_t NO_NESTED_PROGRAM{0xFFFFFFFF};
+
+ public:
+  MessageProgram() noexcept;
+
+ public:
+  int32_t messageIdentifier() const noexcept;
+  std::string const &messageName() const noexcept;
+  std::string const &shortName() const noexcept;
+  uint32_t recordSize() const noexcept;
+  std::vector<Field> const &fields() const noexcept;
+  Field const *findField(uint32_t) const noexcept;
+
+ private:
+  friend class MessageProgramSet;
+
+  int32_t m_messageIdentifier;
+  std::string m_messageName;
+  std::string m_shortName;
+  uint32_t m_recordSize;
+  std::vector<Field> m_fields;
+  std::vector<int32_t> m_fieldIndexByIdentifier;
+};
+
+/*
+ * Compiles all messages of a message specification into MessagePrograms.
+ * Nested messages are inlined into the record of their parent.
+ */
+class MessageProgramSet {
+ private:
+  MessageProgramSet(MessageProgramSet const &) = delete;
+  MessageProgramSet(MessageProgramSet &&) = delete;
+  MessageProgramSet &operator=(MessageProgramSet const &) = delete;
+  MessageProgramSet &operator=(MessageProgramSet &&) = delete;
+
+ public:
+  MessageProgramSet() noexcept;
+  ~MessageProgramSet() = default;
+
+ public:
+  int32_t setMessageSpecification(std::string const &) noexcept;
+  int32_t compile(std::vector<cluon::MetaMessage> const &) noexcept;
+  MessageProgram const *find(int32_t) const noexcept;
+  MessageProgram const &program(uint32_t) const noexcept;
+  std::vector<MessageProgram> const &programs() const noexcept;
+  std::vector<cluon::MetaMessage> const &metaMessages() const noexcept;
+
+ private:
+  uint32_t compileMessage(cluon::MetaMessage const &, uint32_t) noexcept;
+
+ private:
+  std::vector<cluon::MetaMessage> m_metaMessages;
+  std::map<std::string, uint32_t> m_metaMessageIndexByName;
+  std::vector<MessageProgram> m_programs;
+  std::vector<uint32_t> m_programIndexByMetaMessage;
+  std::unordered_map<int32_t, uint32_t> m_programIndexByIdentifier;
+};
+
+/*
+ * Typed, preallocated record for one message, filled by decode() from a
+ * Proto-encoded payload. Strings and bytes are stored in a reusable arena so
+ * that decoding does not allocate once the buffers have grown to size.
+ */
+class DynamicRecord {
+ private:
+  DynamicRecord(DynamicRecord const &) = delete;
+  DynamicRecord(DynamicRecord &&) = delete;
+  DynamicRecord &operator=(DynamicRecord const &) = delete;
+  DynamicRecord &operator=(DynamicRecord &&) = delete;
+
+ public:
+  struct StringSlice {
+    char const *data;
+    std::size_t size;
+  };
+
+ public:
+  explicit DynamicRecord(MessageProgramSet const &) noexcept;
+  ~DynamicRecord() = default;
+
+ public:
+  bool decode(int32_t, std::string const &) noexcept;
+  bool decode(int32_t, char const *, std::size_t) noexcept;
+  bool decode(cluon::data::Envelope const &) noexcept;
+  MessageProgram const *program() const noexcept;
+  char const *data() const noexcept;
+
+  template <typename T>
+  T get(MessageProgram::Field const &field, uint32_t base = 0) const noexcept
+  {
+    T value;
+    std::memcpy(&value, m_data.data() + base + field.offset, sizeof(T));
+    return value;
+  }
+  StringSlice getString(MessageProgram::Field const &, uint32_t = 0) const noexcept;
+
+  /*
+   * Calls f(field, value) for every leaf field in declaration order; values
+   * are passed by their C++ type and strings/bytes as StringSlice.
+   */
+  template <typename F>
+  void forEachField(F &&f) const
+  {
+    if (nullptr != m_program) {
+      forEachField(*m_program, 0, f);
+    }
+  }
+
+  /*
+   * Cluon-compatible accept(), so that existing visitors such as
+   * cluon::ToJSONVisitor can consume a decoded record.
+   */
+  template <typename Visitor>
+  void accept(Visitor &visitor)
+  {
+    if (nullptr != m_program) {
+      View view{*this, *m_program, 0};
+      view.accept(visitor);
+    }
+  }
+
+ private:
+  class View {
+   public:
+    View(DynamicRecord &record, MessageProgram const &program, uint32_t base) noexcept:
+      m_record(record),
+      m_program(program),
+      m_base(base)
+    {
+    }
+
+    template <typename Visitor>
+    void accept(Visitor &visitor)
+    {
+      visitor.preVisit(m_program.messageIdentifier(), m_program.shortName(), m_program.messageName());
+      for (auto const &field : m_program.fields()) {
+        switch (field.type) {
+          case MessageProgram::FieldType::Bool: visitScalar<bool>(field, visitor); break;
+          case MessageProgram::FieldType::Char: visitScalar<char>(field, visitor); break;
+          case MessageProgram::FieldType::Int8: visitScalar<int8_t>(field, visitor); break;
+          case MessageProgram::FieldType::UInt8: visitScalar<uint8_t>(field, visitor); break;
+          case MessageProgram::FieldType::Int16: visitScalar<int16_t>(field, visitor); break;
+          case MessageProgram::FieldType::UInt16: visitScalar<uint16_t>(field, visitor); break;
+          case MessageProgram::FieldType::Int32: visitScalar<int32_t>(field, visitor); break;
+          case MessageProgram::FieldType::UInt32: visitScalar<uint32_t>(field, visitor); break;
+          case MessageProgram::FieldType::Int64: visitScalar<int64_t>(field, visitor); break;
+          case MessageProgram::FieldType::UInt64: visitScalar<uint64_t>(field, visitor); break;
+          case MessageProgram::FieldType::Float: visitScalar<float>(field, visitor); break;
+          case MessageProgram::FieldType::Double: visitScalar<double>(field, visitor); break;
+          case MessageProgram::FieldType::String:
+          case MessageProgram::FieldType::Bytes:
+            {
+              StringSlice const slice = m_record.getString(field, m_base);
+              std::string value(slice.data, slice.size);
+              visitor.visit(field.fieldIdentifier, std::string(field.typeName), std::string(field.name), value);
+              break;
+            }
+          case MessageProgram::FieldType::Message:
+            {
+              View nested{m_record, m_record.m_programs.program(field.nestedProgram), m_base + field.offset};
+              uint32_t fieldIdentifier{field.fieldIdentifier};
+              visitor.visit(fieldIdentifier, std::string(field.typeName), std::string(field.name), nested);
+              break;
+            }
+        }
+      }
+      visitor.postVisit();
+    }
+
+   private:
+    template <typename T, typename Visitor>
+    void visitScalar(MessageProgram::Field const &field, Visitor &visitor)
+    {
+      T value = m_record.get<T>(field, m_base);
+      visitor.visit(field.fieldIdentifier, std::string(field.typeName), std::string(field.name), value);
+      std::memcpy(m_record.m_data.data() + m_base + field.offset, &value, sizeof(T));
+    }
+
+   private:
+    DynamicRecord &m_record;
+    MessageProgram const &m_program;
+    uint32_t m_base;
+  };
+
+ private:
+  bool decodeInto(MessageProgram const &, uint32_t, char const *, char const *, uint32_t) noexcept;
+
+  template <typename F>
+  void forEachField(MessageProgram const &program, uint32_t base, F &f) const
+  {
+    for (auto const &field : program.fields()) {
+      switch (field.type) {
+        case MessageProgram::FieldType::Bool: f(field, get<bool>(field, base)); break;
+        case MessageProgram::FieldType::Char: f(field, get<char>(field, base)); break;
+        case MessageProgram::FieldType::Int8: f(field, get<int8_t>(field, base)); break;
+        case MessageProgram::FieldType::UInt8: f(field, get<uint8_t>(field, base)); break;
+        case MessageProgram::FieldType::Int16: f(field, get<int16_t>(field, base)); break;
+        case MessageProgram::FieldType::UInt16: f(field, get<uint16_t>(field, base)); break;
+        case MessageProgram::FieldType::Int32: f(field, get<int32_t>(field, base)); break;
+        case MessageProgram::FieldType::UInt32: f(field, get<uint32_t>(field, base)); break;
+        case MessageProgram::FieldType::Int64: f(field, get<int64_t>(field, base)); break;
+        case MessageProgram::FieldType::UInt64: f(field, get<uint64_t>(field, base)); break;
+        case MessageProgram::FieldType::Float: f(field, get<float>(field, base)); break;
+        case MessageProgram::FieldType::Double: f(field, get<double>(field, base)); break;
+        case MessageProgram::FieldType::String:
+        case MessageProgram::FieldType::Bytes: f(field, getString(field, base)); break;
+        case MessageProgram::FieldType::Message:
+          forEachField(m_programs.program(field.nestedProgram), base + field.offset, f);
+          break;
+      }
+    }
+  }
+
+ private:
+  MessageProgramSet const &m_programs;
+  MessageProgram const *m_program;
+  std::vector<char> m_data;
+  std::string m_arena;
+};
+
+#endif
@@ -0,0 +1,367 @@
+/*
+ * Copyright (C) 2018 Ola Benderius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+
+#include "metrics.hpp"
+
+uint32_t const MetricsServer::CLIENT_TIMEOUT_MS;
+
+namespace {
+
+std::atomic<uint64_t> g_nextMetricsIdentifier{1};
+
+void appendHistogram(std::ostringstream &out, char const *name, int32_t messageIdentifier, Metrics::Histogram const &histogram)
+{
+  uint64_t cumulative{0};
+  for (uint32_t i{0}; i < Metrics::BUCKETS; i++) {
+    cumulative += histogram.buckets[i];
+    out << name << "_bucket{message_id=\"" << messageIdentifier << "\",le=\""
+      << static_cast<double>(64ull << i) * 1e-9 << "\"} " << cumulative << "\n";
+  }
+  out << name << "_bucket{message_id=\"" << messageIdentifier << "\",le=\"+Inf\"} " << histogram.count << "\n";
+  out << name << "_sum{message_id=\"" << messageIdentifier << "\"} " << static_cast<double>(histogram.sumNanoseconds) * 1e-9 << "\n";
+  out << name << "_count{message_id=\"" << messageIdentifier << "\"} " << histogram.count << "\n";
+}
+
+}
+
+Metrics::Metrics() noexcept:
+  m_identifier{g_nextMetricsIdentifier.fetch_add(1)},
+  m_shardsMutex{},
+  m_shards{},
+  m_gauges{}
+{
+}
+
+Metrics::Shard &Metrics::localShard()
+{
+  // Shards stay with their Metrics when a thread ends; the identifier
+  // rather than the address tells instances apart.
+  struct CachedShard {
+    uint64_t owner;
+    Shard *shard;
+  };
+  thread_local std::vector<CachedShard> cache;
+  for (auto const &cached : cache) {
+    if (cached.owner == m_identifier) {
+      return *cached.shard;
+    }
+  }
+  std::lock_guard<std::mutex> lock(m_shardsMutex);
+  m_shards.push_back(std::make_unique<Shard>());
+  cache.push_back(CachedShard{m_identifier, m_shards.back().get()});
+  return *m_shards.back();
+}
+
+Metrics::Slot *Metrics::slot(int32_t messageIdentifier) noexcept
+{
+  Shard *shard{nullptr};
+  try {
+    shard = &localShard();
+  } catch (...) {
+    return nullptr;
+  }
+  // Only the owning thread claims slots, so a plain store is enough.
+  uint32_t const hash{(static_cast<uint32_t>(messageIdentifier) * 2654435761u) >> 25};
+  for (uint32_t i{0}; i < SLOTS; i++) {
+    Slot &candidate = shard->slots[(hash + i) & (SLOTS - 1)];
+    int64_t const key{candidate.messageIdentifier.load(std::memory_order_relaxed)};
+    if (key == messageIdentifier) {
+      return &candidate;
+    }
+    if (EMPTY == key) {
+      candidate.messageIdentifier.store(messageIdentifier, std::memory_order_release);
+      return &candidate;
+    }
+  }
+  return nullptr;
+}
+
+void Metrics::add(std::atomic<uint64_t> &counter, uint64_t value) noexcept
+{
+  // Single writer per shard: no read-modify-write instruction needed.
+  counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
+void Metrics::record(AtomicHistogram &histogram, std::chrono::steady_clock::duration duration) noexcept
+{
+  int64_t const count{std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count()};
+  uint64_t const nanoseconds{(count > 0) ? static_cast<uint64_t>(count) : 0};
+  // Smallest bucket i with nanoseconds <= 64 << i.
+  uint32_t const bucket{(nanoseconds <= 64) ? 0 : static_cast<uint32_t>(64 - __builtin_clzll(nanoseconds - 1)) - 6};
+  if (bucket < BUCKETS) {
+    add(histogram.buckets[bucket], 1);
+  }
+  add(histogram.count, 1);
+  add(histogram.sumNanoseconds, nanoseconds);
+}
+
+void Metrics::received(int32_t messageIdentifier, std::size_t bytes) noexcept
+{
+  Slot *s{slot(messageIdentifier)};
+  if (nullptr != s) {
+    add(s->received, 1);
+    add(s->receivedBytes, bytes);
+  }
+}
+
+void Metrics::sent(int32_t messageIdentifier, std::size_t bytes) noexcept
+{
+  Slot *s{slot(messageIdentifier)};
+  if (nullptr != s) {
+    add(s->sent, 1);
+    add(s->sentBytes, bytes);
+  }
+}
+
+void Metrics::decodeTime(int32_t messageIdentifier, std::chrono::steady_clock::duration duration) noexcept
+{
+  Slot *s{slot(messageIdentifier)};
+  if (nullptr != s) {
+    record(s->decode, duration);
+  }
+}
+
+void Metrics::delegateTime(int32_t messageIdentifier, std::chrono::steady_clock::duration duration) noexcept
+{
+  Slot *s{slot(messageIdentifier)};
+  if (nullptr != s) {
+    record(s->delegate, duration);
+  }
+}
+
+bool Metrics::sampleLatency() noexcept
+{
+  thread_local uint32_t calls{0};
+  return 0 == (calls++ % LATENCY_SAMPLING);
+}
+
+void Metrics::delivered(int32_t messageIdentifier, std::chrono::steady_clock::duration decode, std::chrono::steady_clock::duration delegate) noexcept
+{
+  Slot *s{slot(messageIdentifier)};
+  if (nullptr != s) {
+    record(s->decode, decode);
+    record(s->delegate, delegate);
+  }
+}
+
+void Metrics::addGauge(std::string const &name, std::function<double()> gauge)
+{
+  std::lock_guard<std::mutex> lock(m_shardsMutex);
+  m_gauges.emplace_back(name, std::move(gauge));
+}
+
+std::map<int32_t, Metrics::MessageSnapshot> Metrics::snapshot() const
+{
+  auto const sum = [](Histogram &total, AtomicHistogram const &histogram) {
+    for (uint32_t i{0}; i < BUCKETS; i++) {
+      total.buckets[i] += histogram.buckets[i].load(std::memory_order_relaxed);
+    }
+    total.count += histogram.count.load(std::memory_order_relaxed);
+    total.sumNanoseconds += histogram.sumNanoseconds.load(std::memory_order_relaxed);
+  };
+
+  std::map<int32_t, MessageSnapshot> messages;
+  std::lock_guard<std::mutex> lock(m_shardsMutex);
+  for (auto const &shard : m_shards) {
+    for (Slot const &s : shard->slots) {
+      int64_t const key{s.messageIdentifier.load(std::memory_order_acquire)};
+      if (EMPTY == key) {
+        continue;
+      }
+      // MessageSnapshot() value-initializes, i.e. zeroes, a new entry.
+      MessageSnapshot &total = messages.emplace(static_cast<int32_t>(key), MessageSnapshot()).first->second;
+      total.received += s.received.load(std::memory_order_relaxed);
+      total.receivedBytes += s.receivedBytes.load(std::memory_order_relaxed);
+      total.sent += s.sent.load(std::memory_order_relaxed);
+      total.sentBytes += s.sentBytes.load(std::memory_order_relaxed);
+      sum(total.decode, s.decode);
+      sum(total.delegate, s.delegate);
+    }
+  }
+  return messages;
+}
+
+std::string Metrics::exposition() const
+{
+  auto const messages = snapshot();
+  std::ostringstream out;
+  struct Counter {
+    char const *name;
+    uint64_t MessageSnapshot::*field;
+  };
+  Counter const counters[] = {
+    {"od4_envelopes_received_total", &MessageSnapshot::received},
+    {"od4_bytes_received_total", &MessageSnapshot::receivedBytes},
+    {"od4_envelopes_sent_total", &MessageSnapshot::sent},
+    {"od4_bytes_sent_total", &MessageSnapshot::sentBytes}
+  };
+  for (auto const &counter : counters) {
+    out << "# TYPE " << counter.name << " counter\n";
+    for (auto const &message : messages) {
+      out << counter.name << "{message_id=\"" << message.first << "\"} " << message.second.*counter.field << "\n";
+    }
+  }
+  out << "# TYPE od4_decode_seconds histogram\n";
+  for (auto const &message : messages) {
+    appendHistogram(out, "od4_decode_seconds", message.first, message.second.decode);
+  }
+  out << "# TYPE od4_delegate_seconds histogram\n";
+  for (auto const &message : messages) {
+    appendHistogram(out, "od4_delegate_seconds", message.first, message.second.delegate);
+  }
+
+  std::lock_guard<std::mutex> lock(m_shardsMutex);
+  for (auto const &gauge : m_gauges) {
+    out << "# TYPE " << gauge.first << " gauge\n" << gauge.first << " " << gauge.second() << "\n";
+  }
+  return out.str();
+}
+
+MetricsServer::MetricsServer(Metrics const &metrics, std::string const &address) noexcept:
+  m_metrics(metrics),
+  m_unixPath{},
+  m_socket{-1},
+  m_running{false},
+  m_thread{}
+{
+  if (!isValidAddress(address)) {
+    std::cerr << "[MetricsServer]: '" << address << "' is neither a port nor unix:<path>" << std::endl;
+    return;
+  }
+  int32_t result{-1};
+  if (0 == address.find("unix:")) {
+    m_unixPath = address.substr(5);
+    struct sockaddr_un unixAddress{};
+    unixAddress.sun_family = AF_UNIX;
+    std::strncpy(unixAddress.sun_path, m_unixPath.c_str(), sizeof(unixAddress.sun_path) - 1);
+    ::unlink(m_unixPath.c_str());
+    m_socket = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (m_socket >= 0) {
+      result = ::bind(m_socket, reinterpret_cast<struct sockaddr *>(&unixAddress), sizeof(unixAddress));
+    }
+  } else {
+    uint16_t const port{static_cast<uint16_t>(std::stoul(address))};
+    struct sockaddr_in inetAddress{};
+    inetAddress.sin_family = AF_INET;
+    inetAddress.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    inetAddress.sin_port = htons(port);
+    m_socket = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (m_socket >= 0) {
+      int32_t const yes{1};
+      ::setsockopt(m_socket, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+      result = ::bind(m_socket, reinterpret_cast<struct sockaddr *>(&inetAddress), sizeof(inetAddress));
+    }
+  }
+  if (0 > result || 0 > ::listen(m_socket, 4)) {
+    std::cerr << "[MetricsServer]: failed to listen on " << address << ": " << std::strerror(errno) << std::endl;
+    return;
+  }
+  try {
+    m_running = true;
+    m_thread = std::thread(&MetricsServer::run, this);
+  } catch (...) {
+    m_running = false;
+  }
+}
+
+MetricsServer::~MetricsServer()
+{
+  m_running = false;
+  if (m_socket >= 0) {
+    // Wakes up the blocking accept().
+    ::shutdown(m_socket, SHUT_RDWR);
+  }
+  if (m_thread.joinable()) {
+    m_thread.join();
+  }
+  if (m_socket >= 0) {
+    ::close(m_socket);
+  }
+  if (!m_unixPath.empty()) {
+    ::unlink(m_unixPath.c_str());
+  }
+}
+
+// A TCP port from 1 to 65535, or "unix:" and a path that fits a sockaddr_un.
+bool MetricsServer::isValidAddress(std::string const &address) noexcept
+{
+  if (0 == address.find("unix:")) {
+    std::size_t const pathLength{address.size() - 5};
+    return 0 < pathLength && pathLength < sizeof(sockaddr_un::sun_path);
+  }
+  if (address.empty() || 5 < address.size()
+      || std::string::npos != address.find_first_not_of("0123456789")) {
+    return false;
+  }
+  unsigned long const port{std::stoul(address)};
+  return 0 < port && port <= 65535;
+}
+
+bool MetricsServer::isRunning() const noexcept
+{
+  return m_running;
+}
+
+void MetricsServer::run() noexcept
+{
+  while (m_running) {
+    int32_t const client{::accept4(m_socket, nullptr, nullptr, SOCK_CLOEXEC)};
+    if (client < 0) {
+      if (EINTR == errno || ECONNABORTED == errno) {
+        continue;
+      }
+      break;
+    }
+    struct timeval timeout{};
+    timeout.tv_sec = CLIENT_TIMEOUT_MS / 1000;
+    timeout.tv_usec = (CLIENT_TIMEOUT_MS % 1000) * 1000;
+    ::setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    ::setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+    // Every request gets the full exposition; the request itself is not
+    // interpreted.
+    char request[1024];
+    if (0 <= ::recv(client, request, sizeof(request), 0)) {
+      try {
+        std::string const body{m_metrics.exposition()};
+        std::string const response{"HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: "
+          + std::to_string(body.size()) + "\r\n\r\n" + body};
+        std::size_t written{0};
+        while (written < response.size()) {
+          ssize_t const n{::send(client, response.data() + written, response.size() - written, MSG_NOSIGNAL)};
+          if (n <= 0) {
+            break;
+          }
+          written += static_cast<std::size_t>(n);
+        }
+      } catch (...) {
+      }
+    }
+    ::close(client);
+  }
+  m_running = false;
+}
@@ -0,0 +1,232 @@
+/*
+ * Copyright (C) 2018 Ola Benderius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cmath>
+
+#include "mpc-steering.hpp"
+#include "single-track-model.hpp"
+#include "trace.hpp"
+
+void integratePose(VehicleState &state, double dt) noexcept
+{
+  double const cosYaw{std::cos(state.yaw)};
+  double const sinYaw{std::sin(state.yaw)};
+  state.x += (state.longitudinalSpeed * cosYaw - state.lateralSpeed * sinYaw) * dt;
+  state.y += (state.longitudinalSpeed * sinYaw + state.lateralSpeed * cosYaw) * dt;
+  state.yaw += state.yawRate * dt;
+}
+
+MpcSteering::MpcSteering(WallMap const &map, Config const &config):
+  m_map(map),
+  m_config(config),
+  m_bestSteering(std::max(1u, config.horizon), 0.0f),
+  m_bestPedal(std::max(1u, config.horizon), 0.0f),
+  m_trialSteering(std::max(1u, config.horizon), 0.0f),
+  m_trialPedal(std::max(1u, config.horizon), 0.0f),
+  m_deadline{},
+  m_bestCost{0.0},
+  m_rollouts{0},
+  m_lastSteering{0.0f},
+  m_bestFeasible{false},
+  m_haveBest{false},
+  m_havePrevious{false},
+  m_deadlineHit{false}
+{
+}
+
+void MpcSteering::reset() noexcept
+{
+  m_havePrevious = false;
+  m_lastSteering = 0.0f;
+}
+
+MpcSteering::Config const &MpcSteering::config() const noexcept
+{
+  return m_config;
+}
+
+void MpcSteering::predict(VehicleState &state, float groundSteering, float pedalPosition, double duration, uint32_t substeps) noexcept
+{
+  double const dt{duration / static_cast<double>(std::max(1u, substeps))};
+  for (uint32_t i{0}; i < substeps; i++) {
+    SingleTrackModel::integrate(state.longitudinalSpeed, state.lateralSpeed, state.yawRate, groundSteering, pedalPosition, dt);
+    integratePose(state, dt);
+  }
+}
+
+// Returns whether the sequence stays clear of the walls; cost is the
+// predicted cost, where a collision is charged for every remaining step so
+// that later collisions rank before earlier ones.
+bool MpcSteering::rollout(VehicleState const &initial, float const *steering, float const *pedal, double &cost) const noexcept
+{
+  uint32_t const n{static_cast<uint32_t>(m_bestSteering.size())};
+  double const halfPi{0.5 * M_PI};
+  VehicleState state{initial};
+  float previousSteering{m_lastSteering};
+  cost = 0.0;
+  for (uint32_t k{0}; k < n; k++) {
+    predict(state, steering[k], pedal[k], m_config.stepTime, m_config.substeps);
+    double const clearance{m_map.clearance(state.x, state.y)};
+    if (clearance < m_config.vehicleRadius) {
+      cost += m_config.collisionWeight * static_cast<double>(n - k);
+      return false;
+    }
+    if (clearance < m_config.safetyDistance) {
+      double const intrusion{m_config.safetyDistance - clearance};
+      cost += m_config.barrierWeight * intrusion * intrusion;
+    }
+    double const left{m_map.castRay(state.x, state.y, state.yaw + halfPi, m_config.sideRange)};
+    double const right{m_map.castRay(state.x, state.y, state.yaw - halfPi, m_config.sideRange)};
+    double const steeringChange{static_cast<double>(steering[k] - previousSteering)};
+    cost += m_config.centeringWeight * (left - right) * (left - right)
+      + m_config.smoothnessWeight * steeringChange * steeringChange
+      - m_config.progressWeight * state.longitudinalSpeed * m_config.stepTime;
+    previousSteering = steering[k];
+  }
+  return true;
+}
+
+bool MpcSteering::expired() noexcept
+{
+  if (m_rollouts >= m_config.maxRollouts) {
+    return true;
+  }
+  if (m_config.budget.count() > 0 && std::chrono::steady_clock::now() >= m_deadline) {
+    m_deadlineHit = true;
+    return true;
+  }
+  return false;
+}
+
+// Evaluates the trial sequence and keeps it if it is better than the best
+// one so far; any collision-free sequence beats one that collides.
+bool MpcSteering::tryCandidate(VehicleState const &state) noexcept
+{
+  double cost;
+  bool const feasible{rollout(state, m_trialSteering.data(), m_trialPedal.data(), cost)};
+  m_rollouts++;
+  bool const better{!m_haveBest || (feasible && !m_bestFeasible) || (feasible == m_bestFeasible && cost < m_bestCost)};
+  if (better) {
+    m_bestSteering = m_trialSteering;
+    m_bestPedal = m_trialPedal;
+    m_bestCost = cost;
+    m_bestFeasible = feasible;
+    m_haveBest = true;
+  }
+  return better;
+}
+
+MpcSteering::Solution MpcSteering::solve(VehicleState const &state) noexcept
+{
+  TRACE_SCOPE("MpcSteering::solve");
+  auto const start = std::chrono::steady_clock::now();
+  m_deadline = start + m_config.budget;
+  m_rollouts = 0;
+  m_deadlineHit = false;
+  m_haveBest = false;
+  m_bestFeasible = false;
+
+  std::size_t const n{m_bestSteering.size()};
+  float const maxSteering{m_config.maxSteering};
+
+  // Warm start: the previous solution moved one step ahead.
+  if (m_havePrevious) {
+    std::copy(m_bestSteering.begin() + 1, m_bestSteering.end(), m_trialSteering.begin());
+    std::copy(m_bestPedal.begin() + 1, m_bestPedal.end(), m_trialPedal.begin());
+    m_trialSteering[n - 1] = m_trialSteering[(n > 1) ? n - 2 : 0];
+    m_trialPedal[n - 1] = m_trialPedal[(n > 1) ? n - 2 : 0];
+    tryCandidate(state);
+  }
+
+  // Constant seeds: straight and full lock each way, driving forward, in
+  // reverse, and standing still.
+  float const seedSteering[] = {0.0f, maxSteering, -maxSteering};
+  float const seedPedal[] = {m_config.cruisePedal, m_config.reversePedal};
+  for (float const pedal : seedPedal) {
+    for (float const steering : seedSteering) {
+      if (expired()) {
+        break;
+      }
+      std::fill(m_trialSteering.begin(), m_trialSteering.end(), steering);
+      std::fill(m_trialPedal.begin(), m_trialPedal.end(), pedal);
+      tryCandidate(state);
+    }
+  }
+  if (!expired()) {
+    std::fill(m_trialSteering.begin(), m_trialSteering.end(), 0.0f);
+    std::fill(m_trialPedal.begin(), m_trialPedal.end(), 0.0f);
+    tryCandidate(state);
+  }
+
+  // Pattern search around the best sequence: move one control at a time,
+  // keep any improvement, and halve the step once none is found.
+  float const minPedal{std::min(m_config.reversePedal, 0.0f)};
+  float const maxPedal{std::max(m_config.cruisePedal, 0.0f)};
+  float steeringDelta{0.5f * maxSteering};
+  float pedalDelta{0.25f * (maxPedal - minPedal)};
+  float const minSteeringDelta{maxSteering / 64.0f};
+  while (m_haveBest && steeringDelta >= minSteeringDelta && !expired()) {
+    bool improved{false};
+    for (std::size_t k{0}; k < n && !expired(); k++) {
+      for (float const sign : {1.0f, -1.0f}) {
+        float const steering{std::min(maxSteering, std::max(-maxSteering, m_bestSteering[k] + sign * steeringDelta))};
+        if (std::fabs(steering - m_bestSteering[k]) < 1e-6f || expired()) {
+          continue;
+        }
+        m_trialSteering = m_bestSteering;
+        m_trialPedal = m_bestPedal;
+        m_trialSteering[k] = steering;
+        if (tryCandidate(state)) {
+          improved = true;
+          break;
+        }
+      }
+      for (float const sign : {1.0f, -1.0f}) {
+        float const pedal{std::min(maxPedal, std::max(minPedal, m_bestPedal[k] + sign * pedalDelta))};
+        if (std::fabs(pedal - m_bestPedal[k]) < 1e-6f || expired()) {
+          continue;
+        }
+        m_trialSteering = m_bestSteering;
+        m_trialPedal = m_bestPedal;
+        m_trialPedal[k] = pedal;
+        if (tryCandidate(state)) {
+          improved = true;
+          break;
+        }
+      }
+    }
+    if (!improved) {
+      steeringDelta *= 0.5f;
+      pedalDelta *= 0.5f;
+    }
+  }
+
+  Solution solution;
+  solution.feasible = m_haveBest && m_bestFeasible;
+  solution.cost = m_bestCost;
+  solution.rollouts = m_rollouts;
+  solution.deadlineHit = m_deadlineHit;
+  if (solution.feasible) {
+    solution.groundSteering = m_bestSteering[0];
+    solution.pedalPosition = m_bestPedal[0];
+  }
+  m_havePrevious = solution.feasible;
+  m_lastSteering = solution.groundSteering;
+  solution.solveTime = std::chrono::steady_clock::now() - start;
+  return solution;
+}
@@ -0,0 +1,123 @@
+/*
+ * Copyright (C) 2018 Ola Benderius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MPC_STEERING
+#define MPC_STEERING
+
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+#include "wall-map.hpp"
+
+/*
+ * Planar pose in the map frame together with the body-frame speeds that
+ * SingleTrackModel integrates.
+ */
+struct VehicleState {
+  double x{0.0};
+  double y{0.0};
+  double yaw{0.0};
+  double longitudinalSpeed{0.0};
+  double lateralSpeed{0.0};
+  double yawRate{0.0};
+};
+
+// Moves the pose by the current body-frame speeds for dt seconds.
+void integratePose(VehicleState &, double dt) noexcept;
+
+/*
+ * Model-predictive steering: rolls SingleTrackModel forward over a horizon
+ * of control steps and searches steering and pedal sequences against the
+ * predicted wall distances in a WallMap. A solve starts from the previous
+ * solution shifted by one step, works in buffers allocated up front, and
+ * returns the best collision-free sequence found when the time budget runs
+ * out.
+ */
+class MpcSteering {
+ private:
+  MpcSteering(MpcSteering const &) = delete;
+  MpcSteering(MpcSteering &&) = delete;
+  MpcSteering &operator=(MpcSteering const &) = delete;
+  MpcSteering &operator=(MpcSteering &&) = delete;
+
+ public:
+  struct Config {
+    uint32_t horizon{10};
+    double stepTime{0.1};
+    uint32_t substeps{10};
+    // Zero means no time limit; maxRollouts still bounds the search.
+    std::chrono::microseconds budget{20000};
+    uint32_t maxRollouts{4000};
+    float maxSteering{0.38f};
+    float cruisePedal{0.8f};
+    float reversePedal{-0.6f};
+    double vehicleRadius{0.12};
+    double safetyDistance{0.3};
+    double sideRange{1.0};
+    double collisionWeight{1e4};
+    double barrierWeight{50.0};
+    double progressWeight{10.0};
+    double centeringWeight{1.0};
+    double smoothnessWeight{0.5};
+  };
+
+  struct Solution {
+    float groundSteering{0.0f};
+    float pedalPosition{0.0f};
+    double cost{0.0};
+    bool feasible{false};
+    bool deadlineHit{false};
+    uint32_t rollouts{0};
+    std::chrono::nanoseconds solveTime{0};
+  };
+
+ public:
+  MpcSteering(WallMap const &, Config const &);
+  ~MpcSteering() = default;
+
+ public:
+  Solution solve(VehicleState const &) noexcept;
+  void reset() noexcept;
+  Config const &config() const noexcept;
+
+  // One control step of the prediction model.
+  static void predict(VehicleState &, float groundSteering, float pedalPosition, double duration, uint32_t substeps) noexcept;
+
+ private:
+  bool rollout(VehicleState const &, float const *, float const *, double &) const noexcept;
+  bool expired() noexcept;
+  bool tryCandidate(VehicleState const &) noexcept;
+
+ private:
+  WallMap const &m_map;
+  Config const m_config;
+  std::vector<float> m_bestSteering;
+  std::vector<float> m_bestPedal;
+  std::vector<float> m_trialSteering;
+  std::vector<float> m_trialPedal;
+  std::chrono::steady_clock::time_point m_deadline;
+  double m_bestCost;
+  uint32_t m_rollouts;
+  float m_lastSteering;
+  bool m_bestFeasible;
+  bool m_haveBest;
+  bool m_havePrevious;
+  bool m_deadlineHit;
+};
+
+#endif
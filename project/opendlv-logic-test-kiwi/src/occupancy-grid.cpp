@@ -0,0 +1,290 @@
+/*
+ * Copyright (C) 2018 Ola Benderius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cmath>
+
+#include "behavior.hpp"
+#include "occupancy-grid.hpp"
+
+uint32_t const OccupancyGrid::TILE_BITS;
+uint32_t const OccupancyGrid::TILE_SIZE;
+float constexpr OccupancyGrid::LOG_ODDS_SCALE;
+
+namespace {
+
+int8_t quantizeLogOdds(float logOdds) noexcept
+{
+  float const scaled{std::round(logOdds * OccupancyGrid::LOG_ODDS_SCALE)};
+  return static_cast<int8_t>(std::min(127.0f, std::max(-127.0f, scaled)));
+}
+
+uint32_t tileCount(double extent, double resolution) noexcept
+{
+  uint32_t const cells{static_cast<uint32_t>(std::ceil(extent / resolution))};
+  return std::max(1u, (cells + OccupancyGrid::TILE_SIZE - 1) >> OccupancyGrid::TILE_BITS);
+}
+
+}
+
+OccupancyGrid::OccupancyGrid(Config const &config):
+  m_config(config),
+  m_tilesX{tileCount(config.maxX - config.minX, config.resolution)},
+  m_tilesY{tileCount(config.maxY - config.minY, config.resolution)},
+  m_hit{quantizeLogOdds(config.hitLogOdds)},
+  m_miss{quantizeLogOdds(config.missLogOdds)},
+  m_max{quantizeLogOdds(config.maxLogOdds)},
+  m_cells(static_cast<std::size_t>(m_tilesX) * m_tilesY * TILE_SIZE * TILE_SIZE, 0),
+  m_batchIndices(),
+  m_batchValues(),
+  m_cellUpdates{0}
+{
+  // A straight ray crosses at most width + height cells of the grid;
+  // values are padded to whole blocks of TILE_SIZE.
+  std::size_t const maxCells{static_cast<std::size_t>(m_tilesX + m_tilesY) * TILE_SIZE + 2};
+  m_batchIndices.resize(maxCells);
+  m_batchValues.resize(maxCells + TILE_SIZE);
+}
+
+void OccupancyGrid::clear() noexcept
+{
+  std::fill(m_cells.begin(), m_cells.end(), 0);
+  m_cellUpdates = 0;
+}
+
+OccupancyGrid::Config const &OccupancyGrid::config() const noexcept
+{
+  return m_config;
+}
+
+uint32_t OccupancyGrid::widthCells() const noexcept
+{
+  return m_tilesX * TILE_SIZE;
+}
+
+uint32_t OccupancyGrid::heightCells() const noexcept
+{
+  return m_tilesY * TILE_SIZE;
+}
+
+std::size_t OccupancyGrid::memoryBytes() const noexcept
+{
+  return m_cells.size() * sizeof(int8_t);
+}
+
+double OccupancyGrid::areaSquareMetres() const noexcept
+{
+  return static_cast<double>(widthCells()) * static_cast<double>(heightCells()) * m_config.resolution * m_config.resolution;
+}
+
+uint64_t OccupancyGrid::cellUpdates() const noexcept
+{
+  return m_cellUpdates;
+}
+
+uint32_t OccupancyGrid::cellIndex(uint32_t cx, uint32_t cy) const noexcept
+{
+  uint32_t const tile{(cy >> TILE_BITS) * m_tilesX + (cx >> TILE_BITS)};
+  return (tile << (2 * TILE_BITS)) | ((cy & (TILE_SIZE - 1)) << TILE_BITS) | (cx & (TILE_SIZE - 1));
+}
+
+bool OccupancyGrid::contains(double x, double y) const noexcept
+{
+  double const gx{(x - m_config.minX) / m_config.resolution};
+  double const gy{(y - m_config.minY) / m_config.resolution};
+  return gx >= 0.0 && gy >= 0.0 && gx < static_cast<double>(widthCells()) && gy < static_cast<double>(heightCells());
+}
+
+float OccupancyGrid::logOdds(double x, double y) const noexcept
+{
+  if (!contains(x, y)) {
+    return 0.0f;
+  }
+  uint32_t const cx{static_cast<uint32_t>((x - m_config.minX) / m_config.resolution)};
+  uint32_t const cy{static_cast<uint32_t>((y - m_config.minY) / m_config.resolution)};
+  return static_cast<float>(m_cells[cellIndex(cx, cy)]) / LOG_ODDS_SCALE;
+}
+
+double OccupancyGrid::probability(double x, double y) const noexcept
+{
+  return 1.0 - 1.0 / (1.0 + std::exp(static_cast<double>(logOdds(x, y))));
+}
+
+// Gathers the cells of a ray into a contiguous buffer, adds and clamps in
+// fixed blocks of TILE_SIZE values, which the compiler turns into SIMD
+// code, and scatters the results back.
+void OccupancyGrid::applyBatch(uint32_t count, int32_t delta) noexcept
+{
+  uint32_t const padded{(count + TILE_SIZE - 1) & ~(TILE_SIZE - 1)};
+  int16_t *values{m_batchValues.data()};
+  for (uint32_t i{0}; i < count; i++) {
+    values[i] = m_cells[m_batchIndices[i]];
+  }
+  for (uint32_t i{count}; i < padded; i++) {
+    values[i] = 0;
+  }
+  int16_t const step{static_cast<int16_t>(delta)};
+  int16_t const upper{m_max};
+  int16_t const lower{static_cast<int16_t>(-m_max)};
+  for (uint32_t block{0}; block < padded; block += TILE_SIZE) {
+    for (uint32_t i{0}; i < TILE_SIZE; i++) {
+      int16_t const v{static_cast<int16_t>(values[block + i] + step)};
+      values[block + i] = std::min(upper, std::max(lower, v));
+    }
+  }
+  for (uint32_t i{0}; i < count; i++) {
+    m_cells[m_batchIndices[i]] = static_cast<int8_t>(values[i]);
+  }
+  m_cellUpdates += count;
+}
+
+void OccupancyGrid::updateRay(double x0, double y0, double x1, double y1, bool hit) noexcept
+{
+  double const gx0{(x0 - m_config.minX) / m_config.resolution};
+  double const gy0{(y0 - m_config.minY) / m_config.resolution};
+  double const gx1{(x1 - m_config.minX) / m_config.resolution};
+  double const gy1{(y1 - m_config.minY) / m_config.resolution};
+  int32_t cx{static_cast<int32_t>(std::floor(gx0))};
+  int32_t cy{static_cast<int32_t>(std::floor(gy0))};
+  int32_t const endX{static_cast<int32_t>(std::floor(gx1))};
+  int32_t const endY{static_cast<int32_t>(std::floor(gy1))};
+  int32_t const width{static_cast<int32_t>(widthCells())};
+  int32_t const height{static_cast<int32_t>(heightCells())};
+
+  // Cell traversal after Amanatides and Woo; t runs from 0 to 1 along the ray.
+  double const dx{gx1 - gx0};
+  double const dy{gy1 - gy0};
+  int32_t const stepX{(dx > 0.0) ? 1 : -1};
+  int32_t const stepY{(dy > 0.0) ? 1 : -1};
+  double const deltaX{(std::fabs(dx) > 1e-12) ? 1.0 / std::fabs(dx) : HUGE_VAL};
+  double const deltaY{(std::fabs(dy) > 1e-12) ? 1.0 / std::fabs(dy) : HUGE_VAL};
+  double nextX{(stepX > 0) ? (static_cast<double>(cx) + 1.0 - gx0) * deltaX : (gx0 - static_cast<double>(cx)) * deltaX};
+  double nextY{(stepY > 0) ? (static_cast<double>(cy) + 1.0 - gy0) * deltaY : (gy0 - static_cast<double>(cy)) * deltaY};
+
+  uint32_t const capacity{static_cast<uint32_t>(m_batchIndices.size())};
+  uint32_t count{0};
+  int32_t const steps{std::abs(endX - cx) + std::abs(endY - cy)};
+  for (int32_t i{0}; i < steps && count < capacity; i++) {
+    if (cx >= 0 && cy >= 0 && cx < width && cy < height) {
+      m_batchIndices[count++] = cellIndex(static_cast<uint32_t>(cx), static_cast<uint32_t>(cy));
+    }
+    if (nextX < nextY) {
+      cx += stepX;
+      nextX += deltaX;
+    } else {
+      cy += stepY;
+      nextY += deltaY;
+    }
+  }
+  // The end cell is free as well unless the ray ended on an obstacle.
+  bool const endInside{endX >= 0 && endY >= 0 && endX < width && endY < height};
+  if (endInside && !hit && count < capacity) {
+    m_batchIndices[count++] = cellIndex(static_cast<uint32_t>(endX), static_cast<uint32_t>(endY));
+  }
+  applyBatch(count, m_miss);
+  if (endInside && hit) {
+    m_batchIndices[0] = cellIndex(static_cast<uint32_t>(endX), static_cast<uint32_t>(endY));
+    applyBatch(1, m_hit);
+  }
+}
+
+bool OccupancyGrid::writePgm(std::ostream &out) const
+{
+  uint32_t const width{widthCells()};
+  uint32_t const height{heightCells()};
+  out << "P5\n" << width << " " << height << "\n255\n";
+  std::vector<char> row(width);
+  for (uint32_t y{height}; y-- > 0;) {
+    for (uint32_t x{0}; x < width; x++) {
+      int32_t const value{m_cells[cellIndex(x, y)]};
+      row[x] = static_cast<char>(static_cast<uint8_t>(127 - value));
+    }
+    out.write(row.data(), static_cast<std::streamsize>(row.size()));
+  }
+  return out.good();
+}
+
+OccupancyMapper::OccupancyMapper(OccupancyGrid &grid) noexcept:
+  m_grid(grid),
+  m_mounts{},
+  m_x{0.0},
+  m_y{0.0},
+  m_yaw{0.0}
+{
+  // As mounted in the simulation (docker-compose.yml), which casts a single
+  // ray per sensor; the IR conversion is usable between 10 and 50 cm.
+  Mount &front = m_mounts[static_cast<uint8_t>(Sensor::FrontUltrasonic)];
+  front.x = 0.2;
+  front.maxRange = 3.0;
+  Mount &rear = m_mounts[static_cast<uint8_t>(Sensor::RearUltrasonic)];
+  rear = front;
+  rear.yaw = 3.14;
+  Mount &left = m_mounts[static_cast<uint8_t>(Sensor::LeftIr)];
+  left.y = 0.1;
+  left.yaw = 1.57;
+  left.minRange = 0.1;
+  left.maxRange = 0.5;
+  Mount &right = m_mounts[static_cast<uint8_t>(Sensor::RightIr)];
+  right = left;
+  right.y = -0.1;
+  right.yaw = -1.57;
+}
+
+OccupancyMapper::Mount &OccupancyMapper::mount(Sensor sensor) noexcept
+{
+  return m_mounts[static_cast<uint8_t>(sensor)];
+}
+
+void OccupancyMapper::setPose(double x, double y, double yaw) noexcept
+{
+  m_x = x;
+  m_y = y;
+  m_yaw = yaw;
+}
+
+void OccupancyMapper::addReading(Sensor sensor, opendlv::proxy::DistanceReading const &reading) noexcept
+{
+  addRange(sensor, static_cast<double>(reading.distance()));
+}
+
+void OccupancyMapper::addReading(Sensor sensor, opendlv::proxy::VoltageReading const &reading) noexcept
+{
+  addRange(sensor, Behavior::convertIrVoltageToDistance(reading.voltage()) / 100.0);
+}
+
+// The whole beam is free up to the reading, but only its centre ray marks
+// the obstacle, as it may be anywhere across the beam. Readings beyond the
+// usable range clear the beam without marking an obstacle.
+void OccupancyMapper::addRange(Sensor sensor, double range) noexcept
+{
+  Mount const &m = m_mounts[static_cast<uint8_t>(sensor)];
+  if (!std::isfinite(range) || range < m.minRange) {
+    return;
+  }
+  bool const hit{range < m.maxRange};
+  double const length{hit ? range : m.maxRange};
+  double const cosYaw{std::cos(m_yaw)};
+  double const sinYaw{std::sin(m_yaw)};
+  double const sensorX{m_x + m.x * cosYaw - m.y * sinYaw};
+  double const sensorY{m_y + m.x * sinYaw + m.y * cosYaw};
+  uint32_t const rays{std::max(1u, m.rays)};
+  for (uint32_t i{0}; i < rays; i++) {
+    double const offset{(rays > 1) ? m.beamWidth * (static_cast<double>(i) / static_cast<double>(rays - 1) - 0.5) : 0.0};
+    double const angle{m_yaw + m.yaw + offset};
+    m_grid.updateRay(sensorX, sensorY, sensorX + length * std::cos(angle), sensorY + length * std::sin(angle), hit && 2 * i + 1 == rays);
+  }
+}
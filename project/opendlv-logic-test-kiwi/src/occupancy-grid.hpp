@@ -0,0 +1,139 @@
+/*
+ * Copyright (C) 2018 Ola Benderius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef OCCUPANCY_GRID
+#define OCCUPANCY_GRID
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+#include "opendlv-standard-message-set.hpp"
+
+/*
+ * Log-odds occupancy grid over a fixed rectangular arena. Cells hold the
+ * log-odds in 1/16 steps as int8, grouped in 16 x 16 tiles of 256 bytes
+ * so that the cells around one point share a few cache lines. A ray marks
+ * the cells it passes as free and, on a hit, its end cell as occupied.
+ */
+class OccupancyGrid {
+ private:
+  OccupancyGrid(OccupancyGrid const &) = delete;
+  OccupancyGrid(OccupancyGrid &&) = delete;
+  OccupancyGrid &operator=(OccupancyGrid const &) = delete;
+  OccupancyGrid &operator=(OccupancyGrid &&) = delete;
+
+ public:
+  struct Config {
+    double resolution{0.05};
+    double minX{-2.5};
+    double minY{-2.5};
+    double maxX{2.5};
+    double maxY{2.5};
+    float hitLogOdds{0.85f};
+    float missLogOdds{-0.4f};
+    float maxLogOdds{5.0f};
+  };
+
+  static uint32_t const TILE_BITS{4};
+  static uint32_t const TILE_SIZE{1u << TILE_BITS};
+  static float constexpr LOG_ODDS_SCALE{16.0f};
+
+ public:
+  explicit OccupancyGrid(Config const &);
+  ~OccupancyGrid() = default;
+
+ public:
+  void clear() noexcept;
+  void updateRay(double x0, double y0, double x1, double y1, bool hit) noexcept;
+  bool contains(double x, double y) const noexcept;
+  float logOdds(double x, double y) const noexcept;
+  double probability(double x, double y) const noexcept;
+
+  Config const &config() const noexcept;
+  uint32_t widthCells() const noexcept;
+  uint32_t heightCells() const noexcept;
+  std::size_t memoryBytes() const noexcept;
+  double areaSquareMetres() const noexcept;
+  uint64_t cellUpdates() const noexcept;
+
+  // Binary PGM, north up, occupied cells dark and unknown ones grey.
+  bool writePgm(std::ostream &) const;
+
+ private:
+  uint32_t cellIndex(uint32_t, uint32_t) const noexcept;
+  void applyBatch(uint32_t, int32_t) noexcept;
+
+ private:
+  Config const m_config;
+  uint32_t const m_tilesX;
+  uint32_t const m_tilesY;
+  int8_t const m_hit;
+  int8_t const m_miss;
+  int8_t const m_max;
+  std::vector<int8_t> m_cells;
+  std::vector<uint32_t> m_batchIndices;
+  std::vector<int16_t> m_batchValues;
+  uint64_t m_cellUpdates;
+};
+
+/*
+ * Fuses the Kiwi range sensors into an OccupancyGrid at the pose given by
+ * odometry. Ultrasonic readings are spread over a few rays across the beam.
+ */
+class OccupancyMapper {
+ private:
+  OccupancyMapper(OccupancyMapper const &) = delete;
+  OccupancyMapper(OccupancyMapper &&) = delete;
+  OccupancyMapper &operator=(OccupancyMapper const &) = delete;
+  OccupancyMapper &operator=(OccupancyMapper &&) = delete;
+
+ public:
+  enum class Sensor : uint8_t { FrontUltrasonic, RearUltrasonic, LeftIr, RightIr };
+
+  // Sensor position in the vehicle frame and its usable range in metres.
+  struct Mount {
+    double x{0.0};
+    double y{0.0};
+    double yaw{0.0};
+    double minRange{0.0};
+    double maxRange{1.0};
+    double beamWidth{0.0};
+    uint32_t rays{1};
+  };
+
+ public:
+  explicit OccupancyMapper(OccupancyGrid &) noexcept;
+  ~OccupancyMapper() = default;
+
+ public:
+  void setPose(double x, double y, double yaw) noexcept;
+  void addReading(Sensor, opendlv::proxy::DistanceReading const &) noexcept;
+  void addReading(Sensor, opendlv::proxy::VoltageReading const &) noexcept;
+  void addRange(Sensor, double) noexcept;
+  Mount &mount(Sensor) noexcept;
+
+ private:
+  OccupancyGrid &m_grid;
+  Mount m_mounts[4];
+  double m_x;
+  double m_y;
+  double m_yaw;
+};
+
+#endif
@@ -15,101 +15,498 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <atomic>
+#include <cctype>
+#include <cerrno>
+#include <cmath>
+#include <csignal>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
 #include "cluon-complete.hpp"
 #include "opendlv-standard-message-set.hpp"
+#include "kiwi-message-set.hpp"
 #include "behavior.hpp"
+#include "behavior-parameters.hpp"
+#include "file-watcher.hpp"
+#include "logger.hpp"
+#include "message-bus.hpp"
+#include "metrics.hpp"
+#include "mpc-steering.hpp"
+#include "occupancy-grid.hpp"
+#include "particle-filter.hpp"
+#include "reactor.hpp"
+#include "realtime.hpp"
+#include "sensor-filter.hpp"
+#include "stream-watchdog.hpp"
+#include "trace.hpp"
+#include "proto-decoder.hpp"
+
+namespace {
+
+std::atomic<bool> g_stopRequested{false};
+
+int64_t microseconds(cluon::data::TimeStamp const &timeStamp) noexcept
+{
+  return static_cast<int64_t>(timeStamp.seconds()) * 1000000 + timeStamp.microseconds();
+}
+
+int64_t sampleTimeOf(cluon::data::Envelope const &envelope) noexcept
+{
+  return microseconds(envelope.sampleTimeStamp());
+}
+
+void requestStop(int32_t) noexcept
+{
+  g_stopRequested = true;
+}
+
+// A whole decimal number up to max; unlike std::stoi, neither throws nor
+// lets a sign or trailing text through.
+bool parseCount(std::string const &text, uint32_t max, uint32_t &value) noexcept
+{
+  if (text.empty() || 0 == std::isdigit(static_cast<unsigned char>(text[0]))) {
+    return false;
+  }
+  char *end{nullptr};
+  errno = 0;
+  long const parsed{std::strtol(text.c_str(), &end, 10)};
+  if ('\0' != *end || ERANGE == errno || static_cast<long>(max) < parsed) {
+    return false;
+  }
+  value = static_cast<uint32_t>(parsed);
+  return true;
+}
+
+// A finite frequency of at least min Hz; unlike std::stof, nothing
+// trailing is accepted and nothing throws.
+bool parseFrequency(std::string const &text, float min, float &value) noexcept
+{
+  char *end{nullptr};
+  float const parsed{std::strtof(text.c_str(), &end)};
+  if (text.empty() || '\0' != *end || !std::isfinite(parsed) || min > parsed) {
+    return false;
+  }
+  value = parsed;
+  return true;
+}
+
+}
 
 int32_t main(int32_t argc, char **argv) {
   int32_t retCode{0};
   auto commandlineArguments = cluon::getCommandlineArguments(argc, argv);
-  if (0 == commandlineArguments.count("cid") || 0 == commandlineArguments.count("freq")) {
+  // Malformed options are reported together with the usage before anything
+  // is started.
+  std::string argumentError;
+  if (0 != commandlineArguments.count("metrics") && !MetricsServer::isValidAddress(commandlineArguments["metrics"])) {
+    argumentError = "--metrics must be a port or unix:<path>.";
+  }
+
+  // Walls of the simulation map, for the MPC mode and localization.
+  bool const MPC{"mpc" == commandlineArguments["mode"]};
+  uint32_t const MAX_PARTICLES{1000000};
+  uint32_t particles{0};
+  if (0 != commandlineArguments.count("particles")
+      && !parseCount(commandlineArguments["particles"], MAX_PARTICLES, particles)) {
+    argumentError = "--particles must be a count up to " + std::to_string(MAX_PARTICLES) + ".";
+  }
+  uint32_t const PARTICLES{particles};
+  WallMap wallMap;
+  if (MPC || 0 < PARTICLES) {
+    std::ifstream mapFile{commandlineArguments["map-file"]};
+    std::stringstream mapText;
+    mapText << mapFile.rdbuf();
+    if (0 >= wallMap.setSegments(mapText.str())) {
+      argumentError = "no walls in map file '" + commandlineArguments["map-file"] + "'.";
+    }
+  }
+
+  SensorFilter::Config ultrasonicFilter;
+  SensorFilter::Config irFilter;
+  if (0 > SensorFilter::parse(commandlineArguments["filter-ultrasonic"], ultrasonicFilter)
+      || 0 > SensorFilter::parse(commandlineArguments["filter-ir"], irFilter)) {
+    argumentError = "malformed --filter-ultrasonic or --filter-ir pipeline.";
+  }
+
+  // Tuning parameters: the defaults, then --config, then command line
+  // options.
+  std::string const CONFIG_FILE{commandlineArguments["config"]};
+  BehaviorParameters initialParameters;
+  if (!CONFIG_FILE.empty()) {
+    std::ifstream configFile{CONFIG_FILE};
+    std::stringstream configText;
+    configText << configFile.rdbuf();
+    if (!configFile.is_open() || 0 > applyBehaviorParameters(configText.str(), initialParameters)) {
+      argumentError = "failed to read parameters from '" + CONFIG_FILE + "'.";
+    }
+  }
+  if (0 > applyBehaviorParameters(commandlineArguments, initialParameters)) {
+    argumentError = "malformed parameter on the command line.";
+  }
+
+  Behavior::DegradedMode degradedMode{Behavior::DegradedMode::Stop};
+  if (0 != commandlineArguments.count("degraded-mode")
+      && 0 > Behavior::parseDegradedMode(commandlineArguments["degraded-mode"], degradedMode)) {
+    argumentError = "--degraded-mode must be stop, creep or rear-only.";
+  }
+
+  // Liveness of the sensor streams, in the order of SENSOR_BITS.
+  // The watchdog periods are whole microseconds, so very low rates are
+  // turned down rather than overflowing them.
+  float const MIN_SENSOR_FREQ{0.01f};
+  float sensorFreq{10.0f};
+  if (0 != commandlineArguments.count("sensor-freq")
+      && !parseFrequency(commandlineArguments["sensor-freq"], MIN_SENSOR_FREQ, sensorFreq)) {
+    argumentError = "--sensor-freq must be a number of Hz, at least 0.01.";
+  }
+  float const SENSOR_FREQ{sensorFreq};
+  uint32_t const SENSOR_BITS[] = {Behavior::FRONT_ULTRASONIC, Behavior::REAR_ULTRASONIC, Behavior::LEFT_IR, Behavior::RIGHT_IR};
+  StreamWatchdog watchdog{StreamWatchdog::Config{}};
+  for (char const *name : {"front-ultrasonic", "rear-ultrasonic", "left-ir", "right-ir"}) {
+    watchdog.addStream(name, SENSOR_FREQ);
+  }
+
+  if (0 == commandlineArguments.count("cid") || 0 == commandlineArguments.count("freq") || !argumentError.empty()) {
+    if (!argumentError.empty()) {
+      std::cerr << argv[0] << ": " << argumentError << std::endl;
+    }
     std::cerr << argv[0] << " tests the Kiwi platform by sending actuation commands and reacting to sensor input." << std::endl;
-    std::cerr << "Usage:   " << argv[0] << " --freq=<Integration frequency> --cid=<OpenDaVINCI session> [--verbose]" << std::endl;
+    std::cerr << "Usage:   " << argv[0] << " --freq=<Integration frequency> --cid=<OpenDaVINCI session> [--workers=<delegate threads, default 1>] [--cpu-affinity=<CPUs>] [--rt-priority=<SCHED_FIFO priority>] [--mlockall] [--pack-envelopes (only for receivers that use MessageBus)] [--metrics=<port or unix:path>] [--trace=<trace-event JSON file>] [--verbose] [--log-interval=<minimum ms between verbose lines>] [--mode=mpc --map-file=<simulation map> [--mpc-horizon=<steps, default 10>] [--mpc-budget-ms=<solve budget per tick, default 20>] [--x=<m>] [--y=<m>] [--yaw=<rad>] [--frame-id=<KinematicState sender stamp, default 0>]] [--occupancy-grid=<PGM file written on SIGINT/SIGTERM>] [--particles=<localize against --map-file with this many particles> [--pf-threads=<threads, default 1>]] [--filter-ultrasonic=<pipeline, e.g. median:5,ema:0.5,kalman>] [--filter-ir=<pipeline>] [--config=<name=value parameter file, reloaded when it changes>] [--sensor-freq=<expected Hz of every sensor, default 10>] [--degraded-mode=<stop, creep or rear-only while a sensor is stalled, default stop>] [--speed=<pedal position> --front=<m> ... overriding the defaults and --config]" << std::endl;
     std::cerr << "Example: " << argv[0] << " --freq=10 --cid=111" << std::endl;
     retCode = 1;
   } else {
     bool const VERBOSE{commandlineArguments.count("verbose") != 0};
+    uint32_t const LOG_INTERVAL{(0 != commandlineArguments.count("log-interval")) ? static_cast<uint32_t>(std::stoi(commandlineArguments["log-interval"])) : 0};
+    uint32_t const WORKERS{(0 != commandlineArguments.count("workers")) ? static_cast<uint32_t>(std::stoi(commandlineArguments["workers"])) : 1};
     uint16_t const CID = std::stoi(commandlineArguments["cid"]);
     float const FREQ = std::stof(commandlineArguments["freq"]);
-    float speed = std::stof(commandlineArguments["speed"]);
-    float front = std::stof(commandlineArguments["front"]);
-    float rear = std::stof(commandlineArguments["rear"]);
-    float goalDistanceToWall = std::stof(commandlineArguments["goalDistanceToWall"]);
-    float sideWall = std::stof(commandlineArguments["sideWall"]);
-    float reverseTimeThreshold = std::stof(commandlineArguments["reverseTimeThreshold"]);
-    float groundSteering = std::stof(commandlineArguments["groundSteering"]);
-    float wallSteering = std::stof(commandlineArguments["wallSteering"]);
-    float rearMin = std::stof(commandlineArguments["rearMin"]);
-    float reverseSpeed = std::stof(commandlineArguments["reverseSpeed"]);
-    float Kp_side = std::stof(commandlineArguments["Kp_side"]);
-    float sideDistanceForStraightReverse = std::stof(commandlineArguments["sideDistanceForStraightReverse"]);
-    float frontDistance45 = std::stof(commandlineArguments["frontDistance45"]);
-    float sideDistance45 = std::stof(commandlineArguments["sideDistance45"]);
-    float forwardTimeAfterReverseLimit = std::stof(commandlineArguments["forwardTimeAfterReverseLimit"]);
-    float addAngleAfterReverse = std::stof(commandlineArguments["addAngleAfterReverse"]);
+    std::string const OCCUPANCY_FILE{commandlineArguments["occupancy-grid"]};
     
 
+    // Later changes of the config file and ParameterUpdate messages are
+    // applied on top of the running parameters.
+    BehaviorParameterStore parameterStore{initialParameters};
+
     Behavior behavior;
+    behavior.setFilters(ultrasonicFilter, irFilter);
+    behavior.setDegradedMode(degradedMode);
+
+    // Arrivals of the sensor streams are only stamped, and every tick checks
+    // the deadlines that are due.
+    std::vector<StreamWatchdog::Change> watchdogChanges;
+    watchdogChanges.reserve(StreamWatchdog::MAX_STREAMS);
 
-    auto onDistanceReading{[&behavior](cluon::data::Envelope &&envelope)
+    // Pose dead-reckoned from the KinematicState speeds, starting at --x,
+    // --y and --yaw, for the MPC mode and the occupancy grid. With
+    // --particles, every tick replaces it with the localization estimate.
+    std::mutex vehicleStateMutex;
+    VehicleState vehicleState;
+    vehicleState.x = (0 != commandlineArguments.count("x")) ? std::stod(commandlineArguments["x"]) : 0.0;
+    vehicleState.y = (0 != commandlineArguments.count("y")) ? std::stod(commandlineArguments["y"]) : 0.0;
+    vehicleState.yaw = (0 != commandlineArguments.count("yaw")) ? std::stod(commandlineArguments["yaw"]) : 0.0;
+    int64_t lastKinematicState{0};
+
+    std::unique_ptr<ParticleFilter> particleFilter;
+    std::mutex localizationMutex;
+    std::array<double, ParticleFilter::SENSORS> latestRanges{{-1.0, -1.0, -1.0, -1.0}};
+    if (0 < PARTICLES) {
+      ParticleFilter::Config config;
+      config.particles = PARTICLES;
+      config.threads = (0 != commandlineArguments.count("pf-threads")) ? static_cast<uint32_t>(std::stoi(commandlineArguments["pf-threads"])) : 1;
+      particleFilter = std::make_unique<ParticleFilter>(wallMap, config);
+      particleFilter->initialize(vehicleState.x, vehicleState.y, vehicleState.yaw, 0.1, 0.1);
+    }
+    auto setLatestRange{[&particleFilter, &localizationMutex, &latestRanges](uint32_t sensor, double range)
       {
-        auto distanceReading = cluon::extractMessage<opendlv::proxy::DistanceReading>(std::move(envelope));
-        uint32_t const senderStamp = envelope.senderStamp();
-        if (senderStamp == 0) {
-          behavior.setFrontUltrasonic(distanceReading);
-        } else {
-          behavior.setRearUltrasonic(distanceReading);
+        if (nullptr != particleFilter) {
+          std::lock_guard<std::mutex> lock(localizationMutex);
+          latestRanges[sensor] = range;
         }
       }};
-    auto onVoltageReading{[&behavior](cluon::data::Envelope &&envelope)
+
+    auto onKinematicState{[&vehicleState, &vehicleStateMutex, &lastKinematicState, &particleFilter, &localizationMutex](cluon::data::Envelope &&envelope)
       {
-        auto voltageReading = cluon::extractMessage<opendlv::proxy::VoltageReading>(std::move(envelope));
-        uint32_t const senderStamp = envelope.senderStamp();
-        if (senderStamp == 0) {
-          behavior.setLeftIr(voltageReading);
-        } else {
-          behavior.setRightIr(voltageReading);
+        auto const kinematicState = decodeProto<opendlv::sim::KinematicState>(envelope);
+        int64_t const sampleTime{sampleTimeOf(envelope)};
+        double dt{0.0};
+        {
+          std::lock_guard<std::mutex> lock(vehicleStateMutex);
+          if (0 != lastKinematicState && sampleTime > lastKinematicState) {
+            dt = static_cast<double>(sampleTime - lastKinematicState) * 1e-6;
+            integratePose(vehicleState, dt);
+          }
+          lastKinematicState = sampleTime;
+          vehicleState.longitudinalSpeed = kinematicState.vx();
+          vehicleState.lateralSpeed = kinematicState.vy();
+          vehicleState.yawRate = kinematicState.yawRate();
+        }
+        if (nullptr != particleFilter) {
+          std::lock_guard<std::mutex> lock(localizationMutex);
+          particleFilter->predict(kinematicState.vx(), kinematicState.vy(), kinematicState.yawRate(), dt);
         }
       }};
 
-    cluon::OD4Session od4{CID};
-    od4.dataTrigger(opendlv::proxy::DistanceReading::ID(), onDistanceReading);
-    od4.dataTrigger(opendlv::proxy::VoltageReading::ID(), onVoltageReading);
+    // Occupancy grid over the arena, fused from all four range sensors.
+    std::unique_ptr<OccupancyGrid> occupancyGrid;
+    std::unique_ptr<OccupancyMapper> occupancyMapper;
+    std::mutex occupancyMutex;
+    if (!OCCUPANCY_FILE.empty()) {
+      occupancyGrid = std::make_unique<OccupancyGrid>(OccupancyGrid::Config{});
+      occupancyMapper = std::make_unique<OccupancyMapper>(*occupancyGrid);
+    }
+    auto mapReading{[&occupancyMapper, &occupancyMutex, &vehicleState, &vehicleStateMutex](OccupancyMapper::Sensor sensor, auto const &reading)
+      {
+        if (nullptr == occupancyMapper) {
+          return;
+        }
+        VehicleState pose;
+        {
+          std::lock_guard<std::mutex> lock(vehicleStateMutex);
+          pose = vehicleState;
+        }
+        std::lock_guard<std::mutex> lock(occupancyMutex);
+        occupancyMapper->setPose(pose.x, pose.y, pose.yaw);
+        occupancyMapper->addReading(sensor, reading);
+      }};
+
+    auto onFrontDistanceReading{[&behavior, &mapReading, &setLatestRange, &watchdog](cluon::data::Envelope &&envelope)
+      {
+        watchdog.heartbeat(0, microseconds(envelope.received()));
+        auto const reading = decodeProto<opendlv::proxy::DistanceReading>(envelope);
+        behavior.setFrontUltrasonic(reading, sampleTimeOf(envelope));
+        mapReading(OccupancyMapper::Sensor::FrontUltrasonic, reading);
+        setLatestRange(0, reading.distance());
+      }};
+    auto onRearDistanceReading{[&behavior, &mapReading, &setLatestRange, &watchdog](cluon::data::Envelope &&envelope)
+      {
+        watchdog.heartbeat(1, microseconds(envelope.received()));
+        auto const reading = decodeProto<opendlv::proxy::DistanceReading>(envelope);
+        behavior.setRearUltrasonic(reading, sampleTimeOf(envelope));
+        mapReading(OccupancyMapper::Sensor::RearUltrasonic, reading);
+        setLatestRange(1, reading.distance());
+      }};
+    auto onLeftVoltageReading{[&behavior, &mapReading, &setLatestRange, &watchdog](cluon::data::Envelope &&envelope)
+      {
+        watchdog.heartbeat(2, microseconds(envelope.received()));
+        auto const reading = decodeProto<opendlv::proxy::VoltageReading>(envelope);
+        behavior.setLeftIr(reading, sampleTimeOf(envelope));
+        mapReading(OccupancyMapper::Sensor::LeftIr, reading);
+        setLatestRange(2, Behavior::convertIrVoltageToDistance(reading.voltage()) / 100.0);
+      }};
+    auto onRightVoltageReading{[&behavior, &mapReading, &setLatestRange, &watchdog](cluon::data::Envelope &&envelope)
+      {
+        watchdog.heartbeat(3, microseconds(envelope.received()));
+        auto const reading = decodeProto<opendlv::proxy::VoltageReading>(envelope);
+        behavior.setRightIr(reading, sampleTimeOf(envelope));
+        mapReading(OccupancyMapper::Sensor::RightIr, reading);
+        setLatestRange(3, Behavior::convertIrVoltageToDistance(reading.voltage()) / 100.0);
+      }};
+
+    // Receive, delegate and control threads can be named, pinned and run
+    // with SCHED_FIFO separately, e.g. --cpu-affinity=control:3/receive:2/pipeline:2.
+    RealtimeOptions const REALTIME_OPTIONS{parseRealtimeOptions(commandlineArguments, "logic")};
+    if (REALTIME_OPTIONS.lockMemory) {
+      lockAndPrefaultMemory(1024 * 1024, 16 * 1024 * 1024);
+    }
+    Reactor reactor{WORKERS};
+    reactor.setThreadPolicies(REALTIME_OPTIONS.receive, REALTIME_OPTIONS.pipeline);
+    MessageBus od4{CID, reactor};
+    od4.setDeliveryThreadPolicy(REALTIME_OPTIONS.pipeline);
+    od4.setPackedBatches(0 != commandlineArguments.count("pack-envelopes"));
+
+    // Per message ID counters and latencies, served in the Prometheus text
+    // format, e.g. curl http://127.0.0.1:9100/metrics.
+    Metrics metrics;
+    std::unique_ptr<MetricsServer> metricsServer;
+    if (0 != commandlineArguments.count("metrics")) {
+      metrics.addGauge("od4_reactor_queue_depth", [&reactor]() { return static_cast<double>(reactor.queueDepth()); });
+      metrics.addGauge("od4_conflation_pending", [&od4]() { return static_cast<double>(od4.pendingDeliveries()); });
+      od4.setMetrics(&metrics);
+      metricsServer = std::make_unique<MetricsServer>(metrics, commandlineArguments["metrics"]);
+    }
+
+    // The last trace events of every thread are written as Chrome trace
+    // JSON, and the occupancy grid as PGM, when the process is stopped with
+    // SIGINT or SIGTERM.
+    std::string const TRACE_FILE{commandlineArguments["trace"]};
+    if (!TRACE_FILE.empty()) {
+#ifndef ENABLE_TRACING
+      std::cerr << argv[0] << ": built without trace points, configure with -DTRACING=ON." << std::endl;
+#endif
+      Tracer::instance().setEnabled(true);
+    }
+    if (!TRACE_FILE.empty() || !OCCUPANCY_FILE.empty()) {
+      std::signal(SIGINT, requestStop);
+      std::signal(SIGTERM, requestStop);
+    }
+
+    // Sensors are told apart by sender stamp, which the bus filters on
+    // before anything is decoded. Only the newest reading matters, so
+    // readings that pile up while behavior is busy are conflated.
+    od4.dataTrigger(opendlv::proxy::DistanceReading::ID(), 0, onFrontDistanceReading, MessageBus::Delivery::Conflate);
+    od4.dataTrigger(opendlv::proxy::DistanceReading::ID(), 1, onRearDistanceReading, MessageBus::Delivery::Conflate);
+    od4.dataTrigger(opendlv::proxy::VoltageReading::ID(), 0, onLeftVoltageReading, MessageBus::Delivery::Conflate);
+    od4.dataTrigger(opendlv::proxy::VoltageReading::ID(), 1, onRightVoltageReading, MessageBus::Delivery::Conflate);
+
+    // Parameters pushed from the tuning station, e.g. "Kp_side=0.02".
+    od4.dataTrigger(opendlv::logic::kiwi::ParameterUpdate::ID(), [&parameterStore](cluon::data::Envelope &&envelope)
+      {
+        auto const update = decodeProto<opendlv::logic::kiwi::ParameterUpdate>(envelope);
+        if (0 > parameterStore.update(update.parameters())) {
+          std::cerr << "[Parameters]: rejected update '" << update.parameters() << "'." << std::endl;
+        }
+      });
+    std::unique_ptr<FileWatcher> configWatcher;
+    if (!CONFIG_FILE.empty()) {
+      configWatcher = std::make_unique<FileWatcher>(CONFIG_FILE, [&parameterStore, &CONFIG_FILE](std::string const &text)
+        {
+          if (0 > parameterStore.update(text)) {
+            std::cerr << "[Parameters]: keeping the running parameters, '" << CONFIG_FILE << "' is malformed." << std::endl;
+          }
+        });
+    }
+
+    if (MPC || nullptr != occupancyMapper || nullptr != particleFilter) {
+      uint32_t const FRAME_ID{(0 != commandlineArguments.count("frame-id")) ? static_cast<uint32_t>(std::stoi(commandlineArguments["frame-id"])) : 0};
+      od4.dataTrigger(opendlv::sim::KinematicState::ID(), FRAME_ID, onKinematicState);
+    }
+
+    // Model-predictive steering against the walls of the simulation map.
+    std::unique_ptr<MpcSteering> mpc;
+    if (MPC) {
+      MpcSteering::Config config;
+      config.horizon = (0 != commandlineArguments.count("mpc-horizon")) ? static_cast<uint32_t>(std::stoi(commandlineArguments["mpc-horizon"])) : config.horizon;
+      config.budget = std::chrono::microseconds((0 != commandlineArguments.count("mpc-budget-ms")) ? static_cast<int64_t>(std::stod(commandlineArguments["mpc-budget-ms"]) * 1000.0) : 20000);
+      config.stepTime = 1.0 / static_cast<double>(FREQ);
+      config.cruisePedal = initialParameters.speed;
+      mpc = std::make_unique<MpcSteering>(wallMap, config);
+    }
+
+    // Both requests of a tick are sent together, in one datagram only with
+    // --pack-envelopes: cluon::OD4Session receivers such as
+    // opendlv-device-kiwi-prugw read just the first envelope of a datagram.
+    EnvelopeBatch actuation;
+
+    // Verbose output is formatted and written off the control thread.
+    Logger logger{std::cout};
+    LogSite stateLog{"Steer %6g Pedal %6g Front %6g Rear %6g Left %6g", std::chrono::milliseconds(LOG_INTERVAL), 1};
+    LogSite safeModeLog{"Safe mode %s, stalled sensors 0x%x", std::chrono::milliseconds(LOG_INTERVAL), 1};
+    LogSite mpcLog{"Steer %6g Pedal %6g x %6g y %6g yaw %6g solve %6g us, %u rollouts%s", std::chrono::milliseconds(LOG_INTERVAL), 1};
 
     //In here it is decided what the car should do.
-    auto atFrequency{[&VERBOSE, &behavior, &od4, &speed, &front, &rear, 
-    &goalDistanceToWall, &sideWall, &reverseTimeThreshold, &groundSteering, 
-    &wallSteering, &rearMin, &reverseSpeed, &FREQ, &Kp_side, 
-    &sideDistanceForStraightReverse, &frontDistance45, &sideDistance45,
-    &forwardTimeAfterReverseLimit, &addAngleAfterReverse]() -> bool
+    auto atFrequency{[&VERBOSE, &logger, &stateLog, &mpcLog, &mpc, &vehicleState, &vehicleStateMutex, &particleFilter, &localizationMutex, &latestRanges, &behavior, &od4, &actuation, &parameterStore, &FREQ, &safeModeLog, &watchdog, &watchdogChanges, &SENSOR_BITS, &degradedMode]() -> bool
       {
-        behavior.step(speed, front, rear, goalDistanceToWall, sideWall, 
-        reverseTimeThreshold, groundSteering, wallSteering, rearMin, 
-        reverseSpeed, FREQ, Kp_side, sideDistanceForStraightReverse, frontDistance45, sideDistance45,
-        forwardTimeAfterReverseLimit, addAngleAfterReverse);
+        // Stalls are noticed here, within one tick of the deadline, and
+        // announced on the bus whenever a stream changes status.
+        cluon::data::TimeStamp const now{cluon::time::now()};
+        watchdogChanges.clear();
+        if (0 < watchdog.advance(microseconds(now), watchdogChanges)) {
+          uint32_t stalledSensors{0};
+          for (uint32_t i{0}; i < watchdog.streamCount(); i++) {
+            if (StreamWatchdog::Status::Stalled == watchdog.status(i)) {
+              stalledSensors |= SENSOR_BITS[i];
+            }
+          }
+          behavior.setStalledSensors(stalledSensors);
+          for (auto const &change : watchdogChanges) {
+            std::ostringstream description;
+            description << watchdog.name(change.stream) << " " << StreamWatchdog::name(change.to);
+            if (StreamWatchdog::Status::Stalled == change.to) {
+              description << ", no message for " << static_cast<double>(change.silence) * 1e-6 << " s";
+            } else if (StreamWatchdog::Status::Slow == change.to) {
+              description << " at " << watchdog.rate(change.stream) << " Hz";
+            }
+            description << ", expecting " << watchdog.expectedFrequency(change.stream) << " Hz";
+            opendlv::system::SignalStatusMessage signalStatus;
+            signalStatus.code(static_cast<int32_t>(change.to));
+            signalStatus.description(description.str());
+            od4.send(signalStatus, now, change.stream);
+            std::cerr << "[Watchdog]: " << description.str() << "." << std::endl;
+          }
+        }
+
+        // Each reading is used for one measurement update only.
+        if (nullptr != particleFilter) {
+          ParticleFilter::Estimate estimate;
+          {
+            std::lock_guard<std::mutex> lock(localizationMutex);
+            particleFilter->update(latestRanges);
+            latestRanges.fill(-1.0);
+            estimate = particleFilter->estimate();
+          }
+          std::lock_guard<std::mutex> lock(vehicleStateMutex);
+          vehicleState.x = estimate.x;
+          vehicleState.y = estimate.y;
+          vehicleState.yaw = estimate.yaw;
+        }
+
+        // One consistent parameter set per tick, however often they change,
+        // and all sensors aligned to the time of the tick.
+        std::shared_ptr<BehaviorParameters const> const parameters{parameterStore.current()};
+        cluon::data::TimeStamp sampleTime{now};
+        behavior.step(*parameters, FREQ, microseconds(sampleTime));
+
+        // The MPC only steers while every sensor is live; otherwise the
+        // degraded mode that Behavior::step() chose drives Kiwi.
+        if (mpc && !behavior.isInSafeMode()) {
+          VehicleState state;
+          {
+            std::lock_guard<std::mutex> lock(vehicleStateMutex);
+            state = vehicleState;
+          }
+          MpcSteering::Solution const solution{mpc->solve(state)};
+          opendlv::proxy::GroundSteeringRequest groundSteeringAngleRequest;
+          groundSteeringAngleRequest.groundSteering(solution.groundSteering);
+          opendlv::proxy::PedalPositionRequest pedalPositionRequest;
+          pedalPositionRequest.position(solution.pedalPosition);
+
+          actuation.clear();
+          actuation.add(groundSteeringAngleRequest, sampleTime, 0);
+          actuation.add(pedalPositionRequest, sampleTime, 0);
+          od4.sendBatch(actuation);
+          if (VERBOSE) {
+            logger.log(mpcLog, solution.groundSteering, solution.pedalPosition, state.x, state.y, state.yaw,
+              std::chrono::duration<double, std::micro>(solution.solveTime).count(), solution.rollouts,
+              solution.feasible ? "" : ", no collision-free plan");
+          }
+          return !g_stopRequested;
+        }
+
         auto groundSteeringAngleRequest = behavior.getGroundSteeringAngle();
         auto pedalPositionRequest = behavior.getPedalPositionRequest();
         auto frontUltrasonicReading = behavior.getFrontUltrasonic();
         auto rearUltrasonicReading = behavior.getRearUltrasonic();
         auto leftIrReading = behavior.getLeftIr();
 
-        cluon::data::TimeStamp sampleTime;
-        od4.send(groundSteeringAngleRequest, sampleTime, 0);
-        od4.send(pedalPositionRequest, sampleTime, 0);
-        if (VERBOSE) {
-          std::cout << "Steer " << std::setw(6) << groundSteeringAngleRequest.groundSteering()
-            << " Pedal " << std::setw(6) << pedalPositionRequest.position() 
-            << " Front " <<  std::setw(6) << frontUltrasonicReading.distance()
-            << " Rear " <<  std::setw(6) << rearUltrasonicReading.distance()
-            << " Left " <<  std::setw(6) << leftIrReading
-            // << " Right " << rightDistance
-            << std::endl;
+        actuation.clear();
+        actuation.add(groundSteeringAngleRequest, sampleTime, 0);
+        actuation.add(pedalPositionRequest, sampleTime, 0);
+        od4.sendBatch(actuation);
+        if (VERBOSE && behavior.isInSafeMode()) {
+          logger.log(safeModeLog, Behavior::name(degradedMode), behavior.getStalledSensors());
+        } else if (VERBOSE) {
+          logger.log(stateLog, groundSteeringAngleRequest.groundSteering(),
+            pedalPositionRequest.position(), frontUltrasonicReading.distance(),
+            rearUltrasonicReading.distance(), leftIrReading);
         }
 
-        return true;
+        return !g_stopRequested;
       }};
 
+    applyThreadPolicy(REALTIME_OPTIONS.control);
     od4.timeTrigger(FREQ, atFrequency);
+    if (!TRACE_FILE.empty()) {
+      Tracer::instance().writeTrace(TRACE_FILE);
+    }
+    if (nullptr != occupancyGrid) {
+      std::lock_guard<std::mutex> lock(occupancyMutex);
+      std::ofstream pgm{OCCUPANCY_FILE, std::ios::binary};
+      if (!occupancyGrid->writePgm(pgm)) {
+        std::cerr << argv[0] << ": failed to write " << OCCUPANCY_FILE << "." << std::endl;
+      }
+    }
   }
   return retCode;
 }
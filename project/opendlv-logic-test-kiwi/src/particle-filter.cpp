@@ -0,0 +1,316 @@
+/*
+ * Copyright (C) 2018 Ola Benderius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#include "particle-filter.hpp"
+#include "trace.hpp"
+
+uint32_t const ParticleFilter::BLOCK_SIZE;
+uint32_t const ParticleFilter::SENSORS;
+
+ParticleFilter::ParticleFilter(WallMap const &map, Config const &config):
+  m_config(config),
+  m_size{std::max(1u, (config.particles + BLOCK_SIZE - 1) / BLOCK_SIZE) * BLOCK_SIZE},
+  m_segmentX(map.startX().begin(), map.startX().end()),
+  m_segmentY(map.startY().begin(), map.startY().end()),
+  m_segmentDx(map.directionX().begin(), map.directionX().end()),
+  m_segmentDy(map.directionY().begin(), map.directionY().end()),
+  m_x(m_size, 0.0f),
+  m_y(m_size, 0.0f),
+  m_yaw(m_size, 0.0f),
+  m_logWeight(m_size, 0.0f),
+  m_resampledX(m_size, 0.0f),
+  m_resampledY(m_size, 0.0f),
+  m_resampledYaw(m_size, 0.0f),
+  m_ranges{},
+  m_random(config.seed),
+  m_normal(0.0, 1.0),
+  m_effectiveParticles{static_cast<double>(m_size)},
+  m_workMutex{},
+  m_workCondition{},
+  m_doneCondition{},
+  m_workers{},
+  m_generation{0},
+  m_pending{0},
+  m_running{true}
+{
+  for (uint32_t i{1}; i < std::max(1u, config.threads); i++) {
+    m_workers.emplace_back(&ParticleFilter::runWorker, this, i);
+  }
+}
+
+ParticleFilter::~ParticleFilter()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_workMutex);
+    m_running = false;
+  }
+  m_workCondition.notify_all();
+  for (auto &worker : m_workers) {
+    worker.join();
+  }
+}
+
+uint32_t ParticleFilter::size() const noexcept
+{
+  return m_size;
+}
+
+void ParticleFilter::initialize(double x, double y, double yaw, double positionSpread, double yawSpread) noexcept
+{
+  for (uint32_t i{0}; i < m_size; i++) {
+    m_x[i] = static_cast<float>(x + positionSpread * m_normal(m_random));
+    m_y[i] = static_cast<float>(y + positionSpread * m_normal(m_random));
+    m_yaw[i] = static_cast<float>(yaw + yawSpread * m_normal(m_random));
+    m_logWeight[i] = 0.0f;
+  }
+  m_effectiveParticles = static_cast<double>(m_size);
+}
+
+void ParticleFilter::predict(double longitudinalSpeed, double lateralSpeed, double yawRate, double dt) noexcept
+{
+  if (dt <= 0.0) {
+    return;
+  }
+  // No diffusion while standing still.
+  bool const moving{std::fabs(longitudinalSpeed) > 1e-3 || std::fabs(yawRate) > 1e-3};
+  double const speedNoise{moving ? m_config.speedNoise : 0.0};
+  double const yawRateNoise{moving ? m_config.yawRateNoise : 0.0};
+  for (uint32_t i{0}; i < m_size; i++) {
+    double const vx{longitudinalSpeed + speedNoise * m_normal(m_random)};
+    double const r{yawRate + yawRateNoise * m_normal(m_random)};
+    double const yaw{static_cast<double>(m_yaw[i])};
+    double const cosYaw{std::cos(yaw)};
+    double const sinYaw{std::sin(yaw)};
+    m_x[i] += static_cast<float>((vx * cosYaw - lateralSpeed * sinYaw) * dt);
+    m_y[i] += static_cast<float>((vx * sinYaw + lateralSpeed * cosYaw) * dt);
+    m_yaw[i] = static_cast<float>(yaw + r * dt);
+  }
+}
+
+namespace {
+
+// Four floats in one SIMD register (SSE on x86, NEON on the Kiwi's ARM);
+// comparisons give lane masks and ?: selects per lane.
+typedef float Float4 __attribute__((vector_size(16)));
+typedef int32_t Int4 __attribute__((vector_size(16)));
+
+uint32_t const LANES{4};
+
+Float4 broadcast(float value) noexcept
+{
+  return Float4{value, value, value, value};
+}
+
+}
+
+// Casts every beam with a reading from the particles of the given blocks
+// and adds the log-likelihood of the readings to their weights.
+void ParticleFilter::weighBlocks(uint32_t firstBlock, uint32_t lastBlock) noexcept
+{
+  uint32_t const VECTORS{BLOCK_SIZE / LANES};
+  uint32_t const segments{static_cast<uint32_t>(m_segmentX.size())};
+  Float4 x[VECTORS];
+  Float4 y[VECTORS];
+  Float4 cosYaw[VECTORS]{};
+  Float4 sinYaw[VECTORS]{};
+  Float4 originX[VECTORS];
+  Float4 originY[VECTORS];
+  Float4 rayX[VECTORS];
+  Float4 rayY[VECTORS];
+  Float4 nearest[VECTORS];
+  for (uint32_t block{firstBlock}; block < lastBlock; block++) {
+    uint32_t const base{block * BLOCK_SIZE};
+    std::memcpy(x, &m_x[base], sizeof(x));
+    std::memcpy(y, &m_y[base], sizeof(y));
+    for (uint32_t i{0}; i < BLOCK_SIZE; i++) {
+      cosYaw[i / LANES][i % LANES] = std::cos(m_yaw[base + i]);
+      sinYaw[i / LANES][i % LANES] = std::sin(m_yaw[base + i]);
+    }
+    Float4 logLikelihood[VECTORS]{};
+    for (uint32_t k{0}; k < SENSORS; k++) {
+      float const range{m_ranges[k]};
+      if (!std::isfinite(range)) {
+        continue;
+      }
+      Beam const &beam = m_config.beams[k];
+      float const beamCos{std::cos(beam.yaw)};
+      float const beamSin{std::sin(beam.yaw)};
+      for (uint32_t v{0}; v < VECTORS; v++) {
+        originX[v] = x[v] + beam.x * cosYaw[v] - beam.y * sinYaw[v];
+        originY[v] = y[v] + beam.x * sinYaw[v] + beam.y * cosYaw[v];
+        rayX[v] = cosYaw[v] * beamCos - sinYaw[v] * beamSin;
+        rayY[v] = sinYaw[v] * beamCos + cosYaw[v] * beamSin;
+        nearest[v] = broadcast(beam.maxRange);
+      }
+      // Parallel rays and segments divide by zero; the comparisons with the
+      // resulting infinities and NaNs are all false.
+      for (uint32_t j{0}; j < segments; j++) {
+        float const sx{m_segmentX[j]};
+        float const sy{m_segmentY[j]};
+        float const ex{m_segmentDx[j]};
+        float const ey{m_segmentDy[j]};
+        for (uint32_t v{0}; v < VECTORS; v++) {
+          Float4 const inverse{1.0f / (rayX[v] * ey - rayY[v] * ex)};
+          Float4 const qx{sx - originX[v]};
+          Float4 const qy{sy - originY[v]};
+          Float4 const t{(qx * ey - qy * ex) * inverse};
+          Float4 const u{(qx * rayY[v] - qy * rayX[v]) * inverse};
+          Int4 const hit{(t >= 0.0f) & (u >= 0.0f) & (u <= 1.0f) & (t < nearest[v])};
+          nearest[v] = hit ? t : nearest[v];
+        }
+      }
+      // Errors beyond four sigma count as four sigma, so that one bad
+      // reading cannot wipe out the particles near the true pose.
+      float const measured{std::min(range, beam.maxRange)};
+      float const scale{1.0f / beam.sigma};
+      Float4 const limit{broadcast(16.0f)};
+      for (uint32_t v{0}; v < VECTORS; v++) {
+        Float4 const error{(nearest[v] - measured) * scale};
+        Float4 const squared{error * error};
+        logLikelihood[v] -= 0.5f * ((squared < limit) ? squared : limit);
+      }
+    }
+    for (uint32_t i{0}; i < BLOCK_SIZE; i++) {
+      m_logWeight[base + i] += logLikelihood[i / LANES][i % LANES];
+    }
+  }
+}
+
+void ParticleFilter::update(std::array<double, SENSORS> const &ranges) noexcept
+{
+  TRACE_SCOPE("ParticleFilter::update");
+  for (uint32_t k{0}; k < SENSORS; k++) {
+    m_ranges[k] = (ranges[k] >= 0.0) ? static_cast<float>(ranges[k]) : std::numeric_limits<float>::quiet_NaN();
+  }
+
+  uint32_t const blocks{m_size / BLOCK_SIZE};
+  uint32_t const shares{static_cast<uint32_t>(m_workers.size()) + 1};
+  if (shares > 1) {
+    std::lock_guard<std::mutex> lock(m_workMutex);
+    m_pending = shares - 1;
+    m_generation++;
+  }
+  m_workCondition.notify_all();
+  weighBlocks(0, blocks / shares);
+  if (shares > 1) {
+    std::unique_lock<std::mutex> lock(m_workMutex);
+    m_doneCondition.wait(lock, [this]() { return 0 == m_pending; });
+  }
+
+  float const maximum{*std::max_element(m_logWeight.begin(), m_logWeight.end())};
+  double sum{0.0};
+  double sumSquares{0.0};
+  for (uint32_t i{0}; i < m_size; i++) {
+    m_logWeight[i] -= maximum;
+    double const weight{std::exp(static_cast<double>(m_logWeight[i]))};
+    sum += weight;
+    sumSquares += weight * weight;
+  }
+  m_effectiveParticles = sum * sum / sumSquares;
+  if (m_effectiveParticles < 0.5 * static_cast<double>(m_size)) {
+    resample();
+  }
+}
+
+// Low-variance resampling: one random offset, then equally spaced picks
+// along the cumulative weights.
+void ParticleFilter::resample() noexcept
+{
+  double total{0.0};
+  for (uint32_t i{0}; i < m_size; i++) {
+    total += std::exp(static_cast<double>(m_logWeight[i]));
+  }
+  double const step{total / static_cast<double>(m_size)};
+  double pick{step * std::uniform_real_distribution<double>(0.0, 1.0)(m_random)};
+  double cumulative{std::exp(static_cast<double>(m_logWeight[0]))};
+  uint32_t source{0};
+  for (uint32_t i{0}; i < m_size; i++) {
+    while (pick > cumulative && source + 1 < m_size) {
+      source++;
+      cumulative += std::exp(static_cast<double>(m_logWeight[source]));
+    }
+    m_resampledX[i] = m_x[source];
+    m_resampledY[i] = m_y[source];
+    m_resampledYaw[i] = m_yaw[source];
+    pick += step;
+  }
+  m_x.swap(m_resampledX);
+  m_y.swap(m_resampledY);
+  m_yaw.swap(m_resampledYaw);
+  std::fill(m_logWeight.begin(), m_logWeight.end(), 0.0f);
+  m_effectiveParticles = static_cast<double>(m_size);
+}
+
+ParticleFilter::Estimate ParticleFilter::estimate() const noexcept
+{
+  float const maximum{*std::max_element(m_logWeight.begin(), m_logWeight.end())};
+  double sum{0.0};
+  double x{0.0};
+  double y{0.0};
+  double cosYaw{0.0};
+  double sinYaw{0.0};
+  for (uint32_t i{0}; i < m_size; i++) {
+    double const weight{std::exp(static_cast<double>(m_logWeight[i] - maximum))};
+    sum += weight;
+    x += weight * static_cast<double>(m_x[i]);
+    y += weight * static_cast<double>(m_y[i]);
+    cosYaw += weight * std::cos(static_cast<double>(m_yaw[i]));
+    sinYaw += weight * std::sin(static_cast<double>(m_yaw[i]));
+  }
+  Estimate estimate;
+  estimate.x = x / sum;
+  estimate.y = y / sum;
+  estimate.yaw = std::atan2(sinYaw, cosYaw);
+  double variance{0.0};
+  for (uint32_t i{0}; i < m_size; i++) {
+    double const weight{std::exp(static_cast<double>(m_logWeight[i] - maximum))};
+    double const dx{static_cast<double>(m_x[i]) - estimate.x};
+    double const dy{static_cast<double>(m_y[i]) - estimate.y};
+    variance += weight * (dx * dx + dy * dy);
+  }
+  estimate.spread = std::sqrt(variance / sum);
+  estimate.effectiveParticles = m_effectiveParticles;
+  return estimate;
+}
+
+void ParticleFilter::runWorker(uint32_t share) noexcept
+{
+  uint64_t seen{0};
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(m_workMutex);
+      m_workCondition.wait(lock, [this, &seen]() { return !m_running || m_generation != seen; });
+      if (!m_running) {
+        return;
+      }
+      seen = m_generation;
+    }
+    uint32_t const blocks{m_size / BLOCK_SIZE};
+    uint32_t const shares{static_cast<uint32_t>(m_workers.size()) + 1};
+    weighBlocks(blocks * share / shares, blocks * (share + 1) / shares);
+    {
+      std::lock_guard<std::mutex> lock(m_workMutex);
+      m_pending--;
+    }
+    m_doneCondition.notify_one();
+  }
+}
@@ -0,0 +1,130 @@
+/*
+ * Copyright (C) 2018 Ola Benderius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PARTICLE_FILTER
+#define PARTICLE_FILTER
+
+#include <array>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "wall-map.hpp"
+
+/*
+ * Monte Carlo localization against the walls of a WallMap. The motion
+ * update moves every particle by the KinematicState speeds with noise; the
+ * measurement update weighs particles by how well the front and rear
+ * ultrasonic and left and right IR ranges match rays cast from them.
+ *
+ * Particles are kept as separate coordinate arrays and cast in blocks of
+ * BLOCK_SIZE, one segment at a time across the block, with the
+ * intersection tests running on four particles per SIMD register. Blocks
+ * are split across a pool of threads; the calling thread takes the first
+ * share.
+ */
+class ParticleFilter {
+ private:
+  ParticleFilter(ParticleFilter const &) = delete;
+  ParticleFilter(ParticleFilter &&) = delete;
+  ParticleFilter &operator=(ParticleFilter const &) = delete;
+  ParticleFilter &operator=(ParticleFilter &&) = delete;
+
+ public:
+  static uint32_t const BLOCK_SIZE{16};
+  static uint32_t const SENSORS{4};
+
+  // Sensor position in the vehicle frame, usable range and range noise.
+  struct Beam {
+    float x{0.0f};
+    float y{0.0f};
+    float yaw{0.0f};
+    float maxRange{1.0f};
+    float sigma{0.05f};
+  };
+
+  struct Config {
+    uint32_t particles{512};
+    uint32_t threads{1};
+    uint32_t seed{1};
+    double speedNoise{0.05};
+    double yawRateNoise{0.1};
+    // Front and rear ultrasonic, left and right IR, as in the simulation.
+    std::array<Beam, SENSORS> beams{{
+      {0.2f, 0.0f, 0.0f, 3.0f, 0.05f},
+      {0.2f, 0.0f, 3.14f, 3.0f, 0.05f},
+      {0.0f, 0.1f, 1.57f, 0.5f, 0.03f},
+      {0.0f, -0.1f, -1.57f, 0.5f, 0.03f}}};
+  };
+
+  struct Estimate {
+    double x{0.0};
+    double y{0.0};
+    double yaw{0.0};
+    double spread{0.0};
+    double effectiveParticles{0.0};
+  };
+
+ public:
+  ParticleFilter(WallMap const &, Config const &);
+  ~ParticleFilter();
+
+ public:
+  void initialize(double x, double y, double yaw, double positionSpread, double yawSpread) noexcept;
+  void predict(double longitudinalSpeed, double lateralSpeed, double yawRate, double dt) noexcept;
+  // Ranges in metres in the order of Config::beams; NaN for no reading.
+  void update(std::array<double, SENSORS> const &) noexcept;
+  Estimate estimate() const noexcept;
+  uint32_t size() const noexcept;
+
+ private:
+  void weighBlocks(uint32_t, uint32_t) noexcept;
+  void resample() noexcept;
+  void runWorker(uint32_t) noexcept;
+
+ private:
+  Config const m_config;
+  uint32_t const m_size;
+  std::vector<float> m_segmentX;
+  std::vector<float> m_segmentY;
+  std::vector<float> m_segmentDx;
+  std::vector<float> m_segmentDy;
+  std::vector<float> m_x;
+  std::vector<float> m_y;
+  std::vector<float> m_yaw;
+  std::vector<float> m_logWeight;
+  std::vector<float> m_resampledX;
+  std::vector<float> m_resampledY;
+  std::vector<float> m_resampledYaw;
+  std::array<float, SENSORS> m_ranges;
+  std::mt19937 m_random;
+  std::normal_distribution<double> m_normal;
+  double m_effectiveParticles;
+
+  std::mutex m_workMutex;
+  std::condition_variable m_workCondition;
+  std::condition_variable m_doneCondition;
+  std::vector<std::thread> m_workers;
+  uint64_t m_generation;
+  uint32_t m_pending;
+  bool m_running;
+};
+
+#endif
@@ -0,0 +1,157 @@
+/*
+ * Copyright (C) 2018 Ola Benderius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstring>
+
+#include "proto-decoder.hpp"
+
+namespace {
+
+uint32_t const MAX_NESTING_DEPTH{16};
+
+bool readVarint(char const *&p, char const *end, uint64_t &value) noexcept
+{
+  value = 0;
+  for (uint32_t shift{0}; shift < 64 && p < end; shift += 7) {
+    uint8_t const b{static_cast<uint8_t>(*p++)};
+    value |= static_cast<uint64_t>(b & 0x7f) << shift;
+    if (0 == (b & 0x80)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+template <typename T>
+void store(char *target, T value) noexcept
+{
+  std::memcpy(target, &value, sizeof(T));
+}
+
+template <typename T>
+T fromZigZag(uint64_t v) noexcept
+{
+  return static_cast<T>(static_cast<int64_t>((v >> 1) ^ (~(v & 1) + 1)));
+}
+
+}
+
+ProtoLayout::ProtoLayout() noexcept:
+  m_fields{}
+{
+}
+
+std::vector<ProtoLayout::Field> const &ProtoLayout::fields() const noexcept
+{
+  return m_fields;
+}
+
+void ProtoLayout::Builder::add(uint32_t id, FieldType type, void const *member, ProtoLayout const *nested)
+{
+  if (m_layout.m_fields.size() <= id) {
+    m_layout.m_fields.resize(id + 1, Field{FieldType::Unused, 0, nullptr});
+  }
+  uint32_t const offset{static_cast<uint32_t>(reinterpret_cast<char const *>(member) - m_base)};
+  m_layout.m_fields[id] = Field{type, offset, nested};
+}
+
+bool ProtoLayout::decode(char const *data, std::size_t size, void *message) const noexcept
+{
+  return decode(data, data + size, reinterpret_cast<char *>(message), 0);
+}
+
+bool ProtoLayout::decode(char const *it, char const *end, char *base, uint32_t depth) const noexcept
+{
+  std::size_t const fieldCount{m_fields.size()};
+  while (it < end) {
+    uint64_t key;
+    if (!readVarint(it, end, key)) {
+      return false;
+    }
+    uint64_t const fieldIdentifier{key >> 3};
+    Field const *field = (fieldIdentifier < fieldCount) ? &m_fields[fieldIdentifier] : nullptr;
+    FieldType const type{(nullptr == field) ? FieldType::Unused : field->type};
+    char *target{(nullptr == field) ? nullptr : base + field->offset};
+
+    switch (static_cast<cluon::ProtoConstants>(key & 0x7)) {
+      case cluon::ProtoConstants::VARINT:
+        {
+          uint64_t v;
+          if (!readVarint(it, end, v)) {
+            return false;
+          }
+          switch (type) {
+            case FieldType::Bool: store(target, 0 != v); break;
+            case FieldType::Char: store(target, static_cast<char>(v)); break;
+            case FieldType::UInt8: store(target, static_cast<uint8_t>(v)); break;
+            case FieldType::UInt16: store(target, static_cast<uint16_t>(v)); break;
+            case FieldType::UInt32: store(target, static_cast<uint32_t>(v)); break;
+            case FieldType::UInt64: store(target, v); break;
+            case FieldType::Int8: store(target, fromZigZag<int8_t>(v)); break;
+            case FieldType::Int16: store(target, fromZigZag<int16_t>(v)); break;
+            case FieldType::Int32: store(target, fromZigZag<int32_t>(v)); break;
+            case FieldType::Int64: store(target, fromZigZag<int64_t>(v)); break;
+            default: break;
+          }
+          break;
+        }
+      case cluon::ProtoConstants::FOUR_BYTES:
+        if (end - it < 4) {
+          return false;
+        }
+        if (FieldType::Float == type) {
+          uint32_t raw;
+          std::memcpy(&raw, it, sizeof(raw));
+          raw = le32toh(raw);
+          std::memcpy(target, &raw, sizeof(raw));
+        }
+        it += 4;
+        break;
+      case cluon::ProtoConstants::EIGHT_BYTES:
+        if (end - it < 8) {
+          return false;
+        }
+        if (FieldType::Double == type) {
+          uint64_t raw;
+          std::memcpy(&raw, it, sizeof(raw));
+          raw = le64toh(raw);
+          std::memcpy(target, &raw, sizeof(raw));
+        }
+        it += 8;
+        break;
+      case cluon::ProtoConstants::LENGTH_DELIMITED:
+        {
+          uint64_t length;
+          if (!readVarint(it, end, length) || static_cast<uint64_t>(end - it) < length) {
+            return false;
+          }
+          if (FieldType::String == type) {
+            reinterpret_cast<std::string *>(target)->assign(it, static_cast<std::size_t>(length));
+          } else if (FieldType::Message == type && depth < MAX_NESTING_DEPTH) {
+            if (!field->nested->decode(it, it + length, target, depth + 1)) {
+              return false;
+            }
+          }
+          it += length;
+          break;
+        }
+      default:
+        return false;
+    }
+  }
+  return true;
+}
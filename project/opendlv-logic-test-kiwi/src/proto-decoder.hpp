@@ -0,0 +1,144 @@
+/*
+ * Copyright (C) 2018 Ola Benderius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PROTO_DECODER
+#define PROTO_DECODER
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "cluon-complete.hpp"
+
+/*
+ * Byte offsets of the fields of a generated message type, indexed by field
+ * identifier. The layout is taken once per type from the addresses that the
+ * generated accept() hands to a visitor; decode() then walks the payload in
+ * wire order and stores every field straight into the message, without the
+ * intermediate key/value map of cluon::FromProtoVisitor.
+ */
+class ProtoLayout {
+ public:
+  enum class FieldType : uint8_t {
+    Unused, Bool, Char, Int8, UInt8, Int16, UInt16, Int32, UInt32, Int64, UInt64,
+    Float, Double, String, Message
+  };
+
+  struct Field {
+    FieldType type;
+    uint32_t offset;
+    ProtoLayout const *nested;
+  };
+
+ public:
+  ProtoLayout() noexcept;
+
+ public:
+  template <typename T>
+  static ProtoLayout const &of()
+  {
+    static ProtoLayout const layout{build<T>()};
+    return layout;
+  }
+
+  bool decode(char const *, std::size_t, void *) const noexcept;
+  std::vector<Field> const &fields() const noexcept;
+
+ private:
+  class Builder {
+   public:
+    Builder(ProtoLayout &layout, char const *base) noexcept:
+      m_layout(layout),
+      m_base(base)
+    {
+    }
+
+    void preVisit(int32_t, std::string const &, std::string const &) noexcept {}
+    void postVisit() noexcept {}
+
+    void visit(uint32_t id, std::string &&, std::string &&, bool &v) { add(id, FieldType::Bool, &v, nullptr); }
+    void visit(uint32_t id, std::string &&, std::string &&, char &v) { add(id, FieldType::Char, &v, nullptr); }
+    void visit(uint32_t id, std::string &&, std::string &&, int8_t &v) { add(id, FieldType::Int8, &v, nullptr); }
+    void visit(uint32_t id, std::string &&, std::string &&, uint8_t &v) { add(id, FieldType::UInt8, &v, nullptr); }
+    void visit(uint32_t id, std::string &&, std::string &&, int16_t &v) { add(id, FieldType::Int16, &v, nullptr); }
+    void visit(uint32_t id, std::string &&, std::string &&, uint16_t &v) { add(id, FieldType::UInt16, &v, nullptr); }
+    void visit(uint32_t id, std::string &&, std::string &&, int32_t &v) { add(id, FieldType::Int32, &v, nullptr); }
+    void visit(uint32_t id, std::string &&, std::string &&, uint32_t &v) { add(id, FieldType::UInt32, &v, nullptr); }
+    void visit(uint32_t id, std::string &&, std::string &&, int64_t &v) { add(id, FieldType::Int64, &v, nullptr); }
+    void visit(uint32_t id, std::string &&, std::string &&, uint64_t &v) { add(id, FieldType::UInt64, &v, nullptr); }
+    void visit(uint32_t id, std::string &&, std::string &&, float &v) { add(id, FieldType::Float, &v, nullptr); }
+    void visit(uint32_t id, std::string &&, std::string &&, double &v) { add(id, FieldType::Double, &v, nullptr); }
+    void visit(uint32_t id, std::string &&, std::string &&, std::string &v) { add(id, FieldType::String, &v, nullptr); }
+
+    template <typename T>
+    void visit(uint32_t &id, std::string &&, std::string &&, T &v)
+    {
+      add(id, FieldType::Message, &v, &ProtoLayout::of<T>());
+    }
+
+   private:
+    void add(uint32_t, FieldType, void const *, ProtoLayout const *);
+
+   private:
+    ProtoLayout &m_layout;
+    char const *m_base;
+  };
+
+  template <typename T>
+  static ProtoLayout build()
+  {
+    ProtoLayout layout;
+    T sample;
+    Builder builder{layout, reinterpret_cast<char const *>(&sample)};
+    sample.accept(builder);
+    return layout;
+  }
+
+  bool decode(char const *, char const *, char *, uint32_t) const noexcept;
+
+ private:
+  std::vector<Field> m_fields;
+};
+
+/*
+ * Decodes a Proto-encoded payload into message; fields missing from the
+ * payload keep their value, as with cluon::FromProtoVisitor.
+ */
+template <typename T>
+bool decodeProto(char const *data, std::size_t size, T &message) noexcept
+{
+  return ProtoLayout::of<T>().decode(data, size, &message);
+}
+
+template <typename T>
+bool decodeProto(std::string const &payload, T &message) noexcept
+{
+  return decodeProto(payload.data(), payload.size(), message);
+}
+
+/*
+ * Replacement for cluon::extractMessage().
+ */
+template <typename T>
+T decodeProto(cluon::data::Envelope const &envelope) noexcept
+{
+  T message;
+  decodeProto(envelope.serializedData(), message);
+  return message;
+}
+
+#endif
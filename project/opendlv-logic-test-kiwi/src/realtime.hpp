@@ -0,0 +1,72 @@
+/*
+ * Copyright (C) 2018 Ola Benderius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef REALTIME
+#define REALTIME
+
+#include <pthread.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+/*
+ * Name, CPU set and SCHED_FIFO priority of one thread; an empty CPU set
+ * and priority 0 keep the inherited affinity and scheduling.
+ */
+struct ThreadPolicy {
+  std::string name{};
+  std::vector<uint32_t> cpus{};
+  int32_t priority{0};
+};
+
+/*
+ * The policies of the three kinds of threads in a control binary: the
+ * time-triggered control loop, the socket receive thread and the threads
+ * running the delegates.
+ */
+struct RealtimeOptions {
+  ThreadPolicy control{};
+  ThreadPolicy receive{};
+  ThreadPolicy pipeline{};
+  bool lockMemory{false};
+};
+
+// Parses "2", "0,2" or "0-3,6".
+std::vector<uint32_t> parseCpuList(std::string const &);
+
+/*
+ * Reads --cpu-affinity, --rt-priority and --mlockall. The first two take
+ * either one value for all threads ("--cpu-affinity=2-3") or values per
+ * thread ("--rt-priority=control:80/receive:70/pipeline:60"). Thread names
+ * are the given prefix followed by the role.
+ */
+RealtimeOptions parseRealtimeOptions(std::map<std::string, std::string> &, std::string const &);
+
+bool applyThreadPolicy(pthread_t, ThreadPolicy const &) noexcept;
+bool applyThreadPolicy(ThreadPolicy const &) noexcept;
+
+/*
+ * Locks current and future pages into memory, keeps freed heap memory in
+ * the process, and touches the given amount of stack and heap so that the
+ * control loop does not take page faults later.
+ */
+bool lockAndPrefaultMemory(std::size_t, std::size_t) noexcept;
+
+#endif
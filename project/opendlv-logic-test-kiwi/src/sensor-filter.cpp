@@ -0,0 +1,196 @@
+/*
+ * Copyright (C) 2018 Ola Benderius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+
+#include "sensor-filter.hpp"
+
+uint32_t const SensorFilter::MAX_WINDOW;
+
+SensorFilter::SensorFilter() noexcept:
+  m_config{},
+  m_window{},
+  m_sorted{},
+  m_head{0},
+  m_count{0},
+  m_smoothed{0.0f},
+  m_estimate{0.0f},
+  m_variance{0.0f},
+  m_rejectedInRow{0},
+  m_rejected{0},
+  m_value{0.0f},
+  m_initialized{false}
+{
+}
+
+int32_t SensorFilter::parse(std::string const &text, Config &config) noexcept
+{
+  try {
+    Config parsed;
+    int32_t stages{0};
+    std::stringstream sstr{text};
+    std::string stage;
+    while (std::getline(sstr, stage, ',')) {
+      std::replace(stage.begin(), stage.end(), ':', ' ');
+      std::stringstream values{stage};
+      std::string name;
+      if (!(values >> name) || "none" == name) {
+        continue;
+      }
+      if ("median" == name) {
+        if (!(values >> parsed.medianWindow) || 1 > parsed.medianWindow || MAX_WINDOW < parsed.medianWindow) {
+          return -1;
+        }
+      } else if ("ema" == name) {
+        if (!(values >> parsed.smoothing) || !(0.0f < parsed.smoothing && 1.0f >= parsed.smoothing)) {
+          return -1;
+        }
+      } else if ("kalman" == name) {
+        parsed.kalman = true;
+        if ((values >> parsed.processNoise) && !(values >> parsed.measurementNoise)) {
+          return -1;
+        }
+        if (!(0.0f < parsed.processNoise && 0.0f < parsed.measurementNoise)) {
+          return -1;
+        }
+      } else {
+        return -1;
+      }
+      std::string rest;
+      if (values >> rest) {
+        return -1;
+      }
+      stages++;
+    }
+    config = parsed;
+    return stages;
+  } catch (...) {
+    return -1;
+  }
+}
+
+void SensorFilter::setConfig(Config const &config) noexcept
+{
+  m_config = config;
+  m_config.medianWindow = std::min(std::max(m_config.medianWindow, 1u), MAX_WINDOW);
+  reset();
+}
+
+SensorFilter::Config const &SensorFilter::config() const noexcept
+{
+  return m_config;
+}
+
+void SensorFilter::reset() noexcept
+{
+  m_head = 0;
+  m_count = 0;
+  m_rejectedInRow = 0;
+  m_rejected = 0;
+  m_value = 0.0f;
+  m_initialized = false;
+}
+
+float SensorFilter::update(float sample) noexcept
+{
+  bool const passThrough{1 == m_config.medianWindow && 1.0f <= m_config.smoothing && !m_config.kalman};
+  if (passThrough) {
+    m_value = sample;
+    return m_value;
+  }
+  if (!std::isfinite(sample)) {
+    return m_value;
+  }
+  float value{(1 < m_config.medianWindow) ? median(sample) : sample};
+  if (1.0f > m_config.smoothing) {
+    m_smoothed = m_initialized ? m_smoothed + m_config.smoothing * (value - m_smoothed) : value;
+    value = m_smoothed;
+  }
+  if (m_config.kalman) {
+    value = kalman(value);
+  }
+  m_initialized = true;
+  m_value = value;
+  return m_value;
+}
+
+float SensorFilter::value() const noexcept
+{
+  return m_value;
+}
+
+uint64_t SensorFilter::rejectedSamples() const noexcept
+{
+  return m_rejected;
+}
+
+// Replaces the oldest sample of the window by shifting it out of the sorted
+// copy and the new one in, which is one insertion-sort pass.
+float SensorFilter::median(float sample) noexcept
+{
+  uint32_t const window{m_config.medianWindow};
+  uint32_t i{m_count};
+  if (m_count == window) {
+    float const oldest{m_window[m_head]};
+    i = static_cast<uint32_t>(std::find(m_sorted.begin(), m_sorted.begin() + m_count, oldest) - m_sorted.begin());
+  } else {
+    m_count++;
+  }
+  while (0 < i && sample < m_sorted[i - 1]) {
+    m_sorted[i] = m_sorted[i - 1];
+    i--;
+  }
+  while (i + 1 < m_count && m_sorted[i + 1] < sample) {
+    m_sorted[i] = m_sorted[i + 1];
+    i++;
+  }
+  m_sorted[i] = sample;
+  m_window[m_head] = sample;
+  m_head = (m_head + 1 == window) ? 0 : m_head + 1;
+  return m_sorted[m_count / 2];
+}
+
+float SensorFilter::kalman(float measurement) noexcept
+{
+  if (!m_initialized) {
+    m_estimate = measurement;
+    m_variance = m_config.measurementNoise;
+    return m_estimate;
+  }
+  m_variance += m_config.processNoise;
+  float const innovation{measurement - m_estimate};
+  float const innovationVariance{m_variance + m_config.measurementNoise};
+  float const gate{m_config.gate};
+  if (innovation * innovation > gate * gate * innovationVariance) {
+    m_rejected++;
+    if (++m_rejectedInRow <= m_config.maxRejected) {
+      return m_estimate;
+    }
+    // Consistently outside the gate: the value has changed, not glitched.
+    m_estimate = measurement;
+    m_variance = m_config.measurementNoise;
+    m_rejectedInRow = 0;
+    return m_estimate;
+  }
+  m_rejectedInRow = 0;
+  float const gain{m_variance / innovationVariance};
+  m_estimate += gain * innovation;
+  m_variance *= 1.0f - gain;
+  return m_estimate;
+}
@@ -0,0 +1,94 @@
+/*
+ * Copyright (C) 2018 Ola Benderius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SENSOR_FILTER
+#define SENSOR_FILTER
+
+#include <array>
+#include <cstdint>
+#include <string>
+
+/*
+ * Per-sensor filter pipeline for the raw ultrasonic distances and IR
+ * voltages: an optional median over the last samples, then an optional
+ * exponential smoothing, then an optional 1D Kalman filter that rejects
+ * samples outside its innovation gate. All state lives in fixed-size
+ * arrays, so update() never allocates and costs at most MAX_WINDOW steps.
+ */
+class SensorFilter {
+ public:
+  static uint32_t const MAX_WINDOW{15};
+
+  struct Config {
+    // Median stage; a window of 1 disables it.
+    uint32_t medianWindow{1};
+    // Weight of a new sample in the exponential stage; 1 disables it.
+    float smoothing{1.0f};
+    // Kalman stage over a constant-value model, in the sensor's unit.
+    bool kalman{false};
+    float processNoise{0.001f};
+    float measurementNoise{0.001f};
+    // Samples further than this many standard deviations from the
+    // prediction are rejected, until maxRejected of them in a row show the
+    // value really changed.
+    float gate{3.0f};
+    uint32_t maxRejected{3};
+  };
+
+ public:
+  SensorFilter() noexcept;
+  ~SensorFilter() = default;
+
+ public:
+  // Parses a comma-separated pipeline such as "median:5,ema:0.5,kalman" or
+  // "kalman:<process noise>:<measurement noise>"; "none" or "" is a pass
+  // through. Returns the number of stages, or -1 (keeping config) if the
+  // text is malformed.
+  static int32_t parse(std::string const &, Config &) noexcept;
+
+  void setConfig(Config const &) noexcept;
+  Config const &config() const noexcept;
+  void reset() noexcept;
+
+  // Filters one sample and returns the output; non-finite samples are
+  // dropped.
+  float update(float) noexcept;
+  float value() const noexcept;
+  uint64_t rejectedSamples() const noexcept;
+
+ private:
+  float median(float) noexcept;
+  float kalman(float) noexcept;
+
+ private:
+  Config m_config;
+  // The median window in arrival order (a ring starting at m_head) and the
+  // same samples sorted.
+  std::array<float, MAX_WINDOW> m_window;
+  std::array<float, MAX_WINDOW> m_sorted;
+  uint32_t m_head;
+  uint32_t m_count;
+  float m_smoothed;
+  float m_estimate;
+  float m_variance;
+  uint32_t m_rejectedInRow;
+  uint64_t m_rejected;
+  float m_value;
+  bool m_initialized;
+};
+
+#endif
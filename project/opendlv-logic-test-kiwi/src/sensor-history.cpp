@@ -0,0 +1,105 @@
+/*
+ * Copyright (C) 2018 Ola Benderius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+
+#include "sensor-history.hpp"
+
+uint32_t const SensorHistory::CAPACITY;
+
+SensorHistory::SensorHistory() noexcept:
+  m_times{},
+  m_values{},
+  m_next{0},
+  m_count{0}
+{
+  static_assert(0 == (CAPACITY & (CAPACITY - 1)), "CAPACITY must be a power of two.");
+}
+
+bool SensorHistory::add(int64_t time, float value) noexcept
+{
+  if (0 < m_count && time <= newestTime()) {
+    return false;
+  }
+  m_times[m_next] = time;
+  m_values[m_next] = value;
+  m_next = (m_next + 1) & (CAPACITY - 1);
+  m_count = std::min(m_count + 1, CAPACITY);
+  return true;
+}
+
+SensorHistory::Sample SensorHistory::at(int64_t time, int64_t maxExtrapolation) const noexcept
+{
+  Sample sample;
+  if (0 == m_count) {
+    return sample;
+  }
+  uint32_t const newest{slot(m_count - 1)};
+  sample.valid = true;
+  sample.age = time - m_times[newest];
+  if (0 <= sample.age) {
+    sample.value = m_values[newest];
+    if (1 < m_count) {
+      uint32_t const previous{slot(m_count - 2)};
+      float const slope{(m_values[newest] - m_values[previous]) / static_cast<float>(m_times[newest] - m_times[previous])};
+      sample.value += slope * static_cast<float>(std::min(sample.age, maxExtrapolation));
+    }
+    return sample;
+  }
+
+  // First sample after the instant.
+  uint32_t low{0};
+  uint32_t high{m_count - 1};
+  while (low < high) {
+    uint32_t const middle{(low + high) / 2};
+    if (m_times[slot(middle)] > time) {
+      high = middle;
+    } else {
+      low = middle + 1;
+    }
+  }
+  uint32_t const after{slot(low)};
+  if (0 == low) {
+    sample.value = m_values[after];
+    return sample;
+  }
+  uint32_t const before{slot(low - 1)};
+  float const fraction{static_cast<float>(time - m_times[before]) / static_cast<float>(m_times[after] - m_times[before])};
+  sample.value = m_values[before] + fraction * (m_values[after] - m_values[before]);
+  return sample;
+}
+
+uint32_t SensorHistory::size() const noexcept
+{
+  return m_count;
+}
+
+int64_t SensorHistory::newestTime() const noexcept
+{
+  return (0 == m_count) ? 0 : m_times[slot(m_count - 1)];
+}
+
+void SensorHistory::clear() noexcept
+{
+  m_next = 0;
+  m_count = 0;
+}
+
+uint32_t SensorHistory::slot(uint32_t i) const noexcept
+{
+  return (m_next - m_count + i) & (CAPACITY - 1);
+}
@@ -0,0 +1,68 @@
+/*
+ * Copyright (C) 2018 Ola Benderius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SENSOR_HISTORY
+#define SENSOR_HISTORY
+
+#include <array>
+#include <cstdint>
+
+/*
+ * The last CAPACITY samples of one sensor keyed by their sample time in
+ * microseconds, so that sensors publishing at different rates and phases
+ * can be read at one common instant. Lookups binary search the ring, and
+ * adding a sample overwrites the oldest one; nothing allocates.
+ */
+class SensorHistory {
+ public:
+  static uint32_t const CAPACITY{32};
+
+  struct Sample {
+    float value{0.0f};
+    // Time from the newest sample to the queried instant, in microseconds.
+    int64_t age{0};
+    bool valid{false};
+  };
+
+ public:
+  SensorHistory() noexcept;
+  ~SensorHistory() = default;
+
+ public:
+  // Returns false, dropping the sample, unless it is newer than all others.
+  bool add(int64_t time, float value) noexcept;
+  // The value at the given time: interpolated between the samples around
+  // it, extrapolated from the newest two for at most maxExtrapolation past
+  // the newest one, and the oldest value before the history starts.
+  Sample at(int64_t time, int64_t maxExtrapolation) const noexcept;
+
+  uint32_t size() const noexcept;
+  int64_t newestTime() const noexcept;
+  void clear() noexcept;
+
+ private:
+  // Ring index of the i-th oldest sample.
+  uint32_t slot(uint32_t) const noexcept;
+
+ private:
+  std::array<int64_t, CAPACITY> m_times;
+  std::array<float, CAPACITY> m_values;
+  uint32_t m_next;
+  uint32_t m_count;
+};
+
+#endif
@@ -0,0 +1,183 @@
+/*
+ * Copyright (C) 2018 Ola Benderius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+
+#include "stream-watchdog.hpp"
+
+uint32_t const StreamWatchdog::MAX_STREAMS;
+uint32_t const StreamWatchdog::SLOTS;
+
+StreamWatchdog::StreamWatchdog(Config const &config) noexcept:
+  m_config{config},
+  m_streams{},
+  m_slots{},
+  m_streamCount{0},
+  m_started{false},
+  m_startTime{0},
+  m_tick{0},
+  m_windowStart{0}
+{
+  static_assert(0 == (SLOTS & (SLOTS - 1)), "SLOTS must be a power of two.");
+  m_config.resolution = std::max(m_config.resolution, static_cast<int64_t>(1));
+  m_slots.fill(-1);
+}
+
+int32_t StreamWatchdog::addStream(std::string const &name, float expectedFrequency)
+{
+  if (MAX_STREAMS == m_streamCount || !(expectedFrequency > 0.0f) || m_started) {
+    return -1;
+  }
+  Stream &stream = m_streams[m_streamCount];
+  stream.name = name;
+  stream.expectedFrequency = expectedFrequency;
+  stream.period = std::max(static_cast<int64_t>(1e6f / expectedFrequency), static_cast<int64_t>(1));
+  stream.timeout = std::max(static_cast<int64_t>(m_config.stallPeriods * 1e6f / expectedFrequency), static_cast<int64_t>(1));
+  return static_cast<int32_t>(m_streamCount++);
+}
+
+void StreamWatchdog::heartbeat(uint32_t stream, int64_t time) noexcept
+{
+  if (stream < m_streamCount) {
+    m_streams[stream].lastSeen.store(time, std::memory_order_relaxed);
+    m_streams[stream].messages.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+uint32_t StreamWatchdog::advance(int64_t time, std::vector<Change> &changes)
+{
+  int64_t const tick{time / m_config.resolution};
+  std::size_t const before{changes.size()};
+  if (!m_started) {
+    m_started = true;
+    m_startTime = time;
+    m_tick = tick;
+    m_windowStart = time;
+    for (uint32_t i{0}; i < m_streamCount; i++) {
+      m_streams[i].windowMessages = m_streams[i].messages.load(std::memory_order_relaxed);
+      arm(i, std::max(m_streams[i].lastSeen.load(std::memory_order_relaxed), time) + m_streams[i].timeout, tick);
+    }
+    return 0;
+  }
+
+  // Every slot passed since the last call, but each at most once.
+  for (int64_t t{std::max(m_tick + 1, tick - static_cast<int64_t>(SLOTS) + 1)}; t <= tick; t++) {
+    uint32_t const slot{static_cast<uint32_t>(t) & (SLOTS - 1)};
+    int32_t next{m_slots[slot]};
+    m_slots[slot] = -1;
+    while (0 <= next) {
+      uint32_t const i{static_cast<uint32_t>(next)};
+      Stream &stream = m_streams[i];
+      next = stream.next;
+      int64_t const lastSeen{std::max(stream.lastSeen.load(std::memory_order_relaxed), m_startTime)};
+      int64_t const deadline{lastSeen + stream.timeout};
+      if (deadline <= time) {
+        setStatus(i, Status::Stalled, time - lastSeen, changes);
+        // Looked at again every period, to notice when it is back.
+        arm(i, time + stream.period, tick);
+      } else {
+        if (Status::Stalled == stream.status) {
+          setStatus(i, Status::Alive, time - lastSeen, changes);
+        }
+        arm(i, deadline, tick);
+      }
+    }
+  }
+  m_tick = std::max(m_tick, tick);
+
+  if (time - m_windowStart >= m_config.rateWindow) {
+    float const seconds{static_cast<float>(time - m_windowStart) * 1e-6f};
+    for (uint32_t i{0}; i < m_streamCount; i++) {
+      Stream &stream = m_streams[i];
+      uint64_t const messages{stream.messages.load(std::memory_order_relaxed)};
+      stream.rate = static_cast<float>(messages - stream.windowMessages) / seconds;
+      stream.windowMessages = messages;
+      if (Status::Stalled != stream.status) {
+        int64_t const silence{time - std::max(stream.lastSeen.load(std::memory_order_relaxed), m_startTime)};
+        setStatus(i, (stream.rate < m_config.slowRatio * stream.expectedFrequency) ? Status::Slow : Status::Alive, silence, changes);
+      }
+    }
+    m_windowStart = time;
+  }
+  return static_cast<uint32_t>(changes.size() - before);
+}
+
+uint32_t StreamWatchdog::streamCount() const noexcept
+{
+  return m_streamCount;
+}
+
+std::string const &StreamWatchdog::name(uint32_t stream) const noexcept
+{
+  return m_streams[std::min(stream, MAX_STREAMS - 1)].name;
+}
+
+float StreamWatchdog::expectedFrequency(uint32_t stream) const noexcept
+{
+  return (stream < m_streamCount) ? m_streams[stream].expectedFrequency : 0.0f;
+}
+
+StreamWatchdog::Status StreamWatchdog::status(uint32_t stream) const noexcept
+{
+  return (stream < m_streamCount) ? m_streams[stream].status : Status::Alive;
+}
+
+float StreamWatchdog::rate(uint32_t stream) const noexcept
+{
+  return (stream < m_streamCount) ? m_streams[stream].rate : 0.0f;
+}
+
+uint64_t StreamWatchdog::messages(uint32_t stream) const noexcept
+{
+  return (stream < m_streamCount) ? m_streams[stream].messages.load(std::memory_order_relaxed) : 0;
+}
+
+char const *StreamWatchdog::name(Status status) noexcept
+{
+  switch (status) {
+    case Status::Alive: return "alive";
+    case Status::Slow: return "slow";
+    case Status::Stalled: return "stalled";
+  }
+  return "unknown";
+}
+
+// Puts the stream into the slot of the given time, rounded up so that a
+// deadline is never checked before it has passed, and within the next
+// revolution of the wheel; later deadlines are looked at early and put
+// back.
+void StreamWatchdog::arm(uint32_t stream, int64_t at, int64_t tick) noexcept
+{
+  int64_t const slotTick{std::min(std::max((at + m_config.resolution - 1) / m_config.resolution, tick + 1),
+      tick + static_cast<int64_t>(SLOTS) - 1)};
+  uint32_t const slot{static_cast<uint32_t>(slotTick) & (SLOTS - 1)};
+  m_streams[stream].next = m_slots[slot];
+  m_slots[slot] = static_cast<int32_t>(stream);
+}
+
+void StreamWatchdog::setStatus(uint32_t stream, Status status, int64_t silence, std::vector<Change> &changes)
+{
+  if (status != m_streams[stream].status) {
+    Change change;
+    change.stream = stream;
+    change.from = m_streams[stream].status;
+    change.to = status;
+    change.silence = silence;
+    changes.push_back(change);
+    m_streams[stream].status = status;
+  }
+}
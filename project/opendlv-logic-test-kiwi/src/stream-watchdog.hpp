@@ -0,0 +1,128 @@
+/*
+ * Copyright (C) 2018 Ola Benderius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef STREAM_WATCHDOG
+#define STREAM_WATCHDOG
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/*
+ * Liveness of message streams that are expected at a fixed rate. Arrivals
+ * only record their time and count, and advance() walks a timer wheel of
+ * deadlines from the control loop: a stream whose deadline comes up is
+ * found stalled, or is put back at its new deadline, so that there are no
+ * timers per message. Stalls are found by the first advance() after the
+ * deadline, and rates below the expected ones once per rate window.
+ *
+ * heartbeat() may be called from any thread; everything else from the one
+ * thread calling advance().
+ */
+class StreamWatchdog {
+ private:
+  StreamWatchdog(StreamWatchdog const &) = delete;
+  StreamWatchdog(StreamWatchdog &&) = delete;
+  StreamWatchdog &operator=(StreamWatchdog const &) = delete;
+  StreamWatchdog &operator=(StreamWatchdog &&) = delete;
+
+ public:
+  static uint32_t const MAX_STREAMS{32};
+  static uint32_t const SLOTS{256};
+
+  // The values are the codes of the published SignalStatusMessage.
+  enum class Status : int32_t {
+    Alive = 0,
+    Slow = 1,
+    Stalled = 2
+  };
+
+  struct Config {
+    // Width of one wheel slot, in microseconds.
+    int64_t resolution{10000};
+    // A stream stalls after this many expected periods without a message.
+    float stallPeriods{2.5f};
+    // A stream is slow below this share of its expected rate.
+    float slowRatio{0.5f};
+    // Rates are measured over windows of this length, in microseconds.
+    int64_t rateWindow{1000000};
+  };
+
+  struct Change {
+    uint32_t stream{0};
+    Status from{Status::Alive};
+    Status to{Status::Alive};
+    // Time since the last message of the stream, in microseconds.
+    int64_t silence{0};
+  };
+
+ public:
+  explicit StreamWatchdog(Config const &) noexcept;
+  ~StreamWatchdog() = default;
+
+ public:
+  // Returns the stream number, or -1 when there are MAX_STREAMS already,
+  // the frequency is not positive or advance() has been called.
+  int32_t addStream(std::string const &name, float expectedFrequency);
+  void heartbeat(uint32_t stream, int64_t time) noexcept;
+  // Checks the deadlines up to the given time in microseconds and appends
+  // the status changes; returns their number. The first call starts the
+  // clock for streams that have not sent anything yet.
+  uint32_t advance(int64_t time, std::vector<Change> &);
+
+  uint32_t streamCount() const noexcept;
+  std::string const &name(uint32_t) const noexcept;
+  float expectedFrequency(uint32_t) const noexcept;
+  Status status(uint32_t) const noexcept;
+  // Messages per second over the last complete rate window.
+  float rate(uint32_t) const noexcept;
+  uint64_t messages(uint32_t) const noexcept;
+
+  static char const *name(Status) noexcept;
+
+ private:
+  void arm(uint32_t, int64_t, int64_t) noexcept;
+  void setStatus(uint32_t, Status, int64_t, std::vector<Change> &);
+
+ private:
+  struct Stream {
+    std::string name{};
+    float expectedFrequency{0.0f};
+    int64_t period{0};
+    int64_t timeout{0};
+    std::atomic<int64_t> lastSeen{0};
+    std::atomic<uint64_t> messages{0};
+    Status status{Status::Alive};
+    uint64_t windowMessages{0};
+    float rate{0.0f};
+    // Next stream in the same wheel slot, or -1.
+    int32_t next{-1};
+  };
+
+  Config m_config;
+  std::array<Stream, MAX_STREAMS> m_streams;
+  std::array<int32_t, SLOTS> m_slots;
+  uint32_t m_streamCount;
+  bool m_started;
+  int64_t m_startTime;
+  int64_t m_tick;
+  int64_t m_windowStart;
+};
+
+#endif
@@ -0,0 +1,187 @@
+/*
+ * Copyright (C) 2018 Ola Benderius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <pthread.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+#include "trace.hpp"
+
+namespace {
+
+void writeEscaped(std::ostream &out, char const *text)
+{
+  for (char const *c{text}; nullptr != c && '\0' != *c; c++) {
+    if ('"' == *c || '\\' == *c) {
+      out << '\\';
+    }
+    out << ((static_cast<unsigned char>(*c) < 0x20) ? ' ' : *c);
+  }
+}
+
+}
+
+Tracer::Tracer() noexcept:
+  m_epoch{std::chrono::steady_clock::now()},
+  m_enabled{false},
+  m_ringsMutex{},
+  m_rings{}
+{
+}
+
+Tracer &Tracer::instance() noexcept
+{
+  static Tracer tracer;
+  return tracer;
+}
+
+void Tracer::setEnabled(bool enabled) noexcept
+{
+  m_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+bool Tracer::isEnabled() const noexcept
+{
+  return m_enabled.load(std::memory_order_relaxed);
+}
+
+int64_t Tracer::now() const noexcept
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_epoch).count();
+}
+
+void Tracer::complete(char const *name, int64_t begin, int64_t end) noexcept
+{
+  record(name, begin, std::max<int64_t>(0, end - begin));
+}
+
+void Tracer::instant(char const *name) noexcept
+{
+  if (isEnabled()) {
+    record(name, now(), -1);
+  }
+}
+
+uint64_t Tracer::recorded() noexcept
+{
+  uint64_t events{0};
+  std::lock_guard<std::mutex> lock(m_ringsMutex);
+  for (auto const &ring : m_rings) {
+    events += std::min<uint64_t>(ring->head.load(std::memory_order_acquire), RING_SIZE);
+  }
+  return events;
+}
+
+void Tracer::clear() noexcept
+{
+  std::lock_guard<std::mutex> lock(m_ringsMutex);
+  for (auto &ring : m_rings) {
+    ring->head.store(0, std::memory_order_release);
+  }
+}
+
+void Tracer::writeTrace(std::ostream &out)
+{
+  int64_t const processIdentifier{static_cast<int64_t>(::getpid())};
+  bool first{true};
+  auto const separate = [&out, &first]() {
+    out << (first ? "\n" : ",\n");
+    first = false;
+  };
+
+  out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[" << std::fixed << std::setprecision(3);
+  std::lock_guard<std::mutex> lock(m_ringsMutex);
+  for (auto const &ring : m_rings) {
+    separate();
+    out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" << processIdentifier
+      << ",\"tid\":" << ring->threadIdentifier << ",\"args\":{\"name\":\"";
+    writeEscaped(out, ring->threadName.c_str());
+    out << "\"}}";
+
+    uint64_t const head{ring->head.load(std::memory_order_acquire)};
+    for (uint64_t i{(head > RING_SIZE) ? head - RING_SIZE : 0}; i < head; i++) {
+      Event const &event = ring->events[i % RING_SIZE];
+      separate();
+      out << "{\"name\":\"";
+      writeEscaped(out, event.name);
+      out << "\",\"ph\":\"" << ((event.duration < 0) ? "i\",\"s\":\"t" : "X")
+        << "\",\"ts\":" << static_cast<double>(event.begin) * 1e-3;
+      if (event.duration >= 0) {
+        out << ",\"dur\":" << static_cast<double>(event.duration) * 1e-3;
+      }
+      out << ",\"pid\":" << processIdentifier << ",\"tid\":" << ring->threadIdentifier << "}";
+    }
+  }
+  out << "\n]}\n";
+}
+
+bool Tracer::writeTrace(std::string const &path) noexcept
+{
+  try {
+    std::ofstream file{path};
+    writeTrace(file);
+    file.flush();
+    if (!file.good()) {
+      std::cerr << "[Tracer]: failed to write " << path << "." << std::endl;
+      return false;
+    }
+    return true;
+  } catch (...) {
+    return false;
+  }
+}
+
+Tracer::Ring *Tracer::localRing() noexcept
+{
+  // Rings stay with the tracer when a thread ends, so its events survive.
+  thread_local Ring *ring{nullptr};
+  if (nullptr == ring) {
+    try {
+      auto created = std::make_unique<Ring>();
+      created->threadIdentifier = static_cast<int64_t>(::syscall(SYS_gettid));
+      char name[16]{};
+      if (0 == ::pthread_getname_np(::pthread_self(), name, sizeof(name))) {
+        created->threadName = name;
+      }
+      std::lock_guard<std::mutex> lock(m_ringsMutex);
+      m_rings.push_back(std::move(created));
+      ring = m_rings.back().get();
+    } catch (...) {
+      return nullptr;
+    }
+  }
+  return ring;
+}
+
+void Tracer::record(char const *name, int64_t begin, int64_t duration) noexcept
+{
+  Ring *ring{localRing()};
+  if (nullptr == ring) {
+    return;
+  }
+  uint64_t const head{ring->head.load(std::memory_order_relaxed)};
+  Event &event = ring->events[head % RING_SIZE];
+  event.name = name;
+  event.begin = begin;
+  event.duration = duration;
+  ring->head.store(head + 1, std::memory_order_release);
+}
@@ -0,0 +1,132 @@
+/*
+ * Copyright (C) 2018 Ola Benderius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+
+#include "wall-map.hpp"
+
+WallMap::WallMap() noexcept:
+  m_startX{},
+  m_startY{},
+  m_directionX{},
+  m_directionY{}
+{
+}
+
+int32_t WallMap::setSegments(std::string const &text) noexcept
+{
+  try {
+    std::vector<double> startX;
+    std::vector<double> startY;
+    std::vector<double> directionX;
+    std::vector<double> directionY;
+    std::stringstream sstr{text};
+    std::string segment;
+    while (std::getline(sstr, segment, ';')) {
+      std::replace(segment.begin(), segment.end(), ',', ' ');
+      std::stringstream values{segment};
+      double x1;
+      double y1;
+      double x2;
+      double y2;
+      if (!(values >> x1)) {
+        // Only whitespace after the last segment.
+        continue;
+      }
+      if (!(values >> y1 >> x2 >> y2)) {
+        return -1;
+      }
+      startX.push_back(x1);
+      startY.push_back(y1);
+      directionX.push_back(x2 - x1);
+      directionY.push_back(y2 - y1);
+    }
+    m_startX.swap(startX);
+    m_startY.swap(startY);
+    m_directionX.swap(directionX);
+    m_directionY.swap(directionY);
+    return static_cast<int32_t>(m_startX.size());
+  } catch (...) {
+    return -1;
+  }
+}
+
+uint32_t WallMap::size() const noexcept
+{
+  return static_cast<uint32_t>(m_startX.size());
+}
+
+double WallMap::castRay(double x, double y, double angle, double maxRange) const noexcept
+{
+  double const rayX{std::cos(angle)};
+  double const rayY{std::sin(angle)};
+  double nearest{maxRange};
+  std::size_t const n{m_startX.size()};
+  for (std::size_t i{0}; i < n; i++) {
+    // Solves p + t r = q + u s for the ray distance t and segment position u.
+    double const denominator{rayX * m_directionY[i] - rayY * m_directionX[i]};
+    if (std::fabs(denominator) < 1e-12) {
+      continue;
+    }
+    double const qx{m_startX[i] - x};
+    double const qy{m_startY[i] - y};
+    double const t{(qx * m_directionY[i] - qy * m_directionX[i]) / denominator};
+    double const u{(qx * rayY - qy * rayX) / denominator};
+    if (t >= 0.0 && t < nearest && u >= 0.0 && u <= 1.0) {
+      nearest = t;
+    }
+  }
+  return nearest;
+}
+
+double WallMap::clearance(double x, double y) const noexcept
+{
+  double nearest{HUGE_VAL};
+  std::size_t const n{m_startX.size()};
+  for (std::size_t i{0}; i < n; i++) {
+    double const lengthSquared{m_directionX[i] * m_directionX[i] + m_directionY[i] * m_directionY[i]};
+    double const px{x - m_startX[i]};
+    double const py{y - m_startY[i]};
+    double const u{(lengthSquared > 0.0) ? std::min(1.0, std::max(0.0, (px * m_directionX[i] + py * m_directionY[i]) / lengthSquared)) : 0.0};
+    double const dx{px - u * m_directionX[i]};
+    double const dy{py - u * m_directionY[i]};
+    nearest = std::min(nearest, dx * dx + dy * dy);
+  }
+  return std::sqrt(nearest);
+}
+
+std::vector<double> const &WallMap::startX() const noexcept
+{
+  return m_startX;
+}
+
+std::vector<double> const &WallMap::startY() const noexcept
+{
+  return m_startY;
+}
+
+std::vector<double> const &WallMap::directionX() const noexcept
+{
+  return m_directionX;
+}
+
+std::vector<double> const &WallMap::directionY() const noexcept
+{
+  return m_directionY;
+}
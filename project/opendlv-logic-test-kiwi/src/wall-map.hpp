@@ -0,0 +1,60 @@
+/*
+ * Copyright (C) 2018 Ola Benderius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef WALL_MAP
+#define WALL_MAP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/*
+ * The wall segments of a simulation map file, one "x1,y1,x2,y2;" segment
+ * per line as read by the simulated sensors. Segments are stored as
+ * separate start and direction arrays so ray casts run over them in a
+ * single pass.
+ */
+class WallMap {
+ public:
+  WallMap() noexcept;
+  ~WallMap() = default;
+
+ public:
+  // Returns the number of segments, or -1 (keeping the previous walls) if
+  // the text is malformed.
+  int32_t setSegments(std::string const &) noexcept;
+  uint32_t size() const noexcept;
+
+  // Distance along the ray to the nearest wall, or maxRange if none is
+  // closer.
+  double castRay(double x, double y, double angle, double maxRange) const noexcept;
+  // Distance from the point to the nearest wall.
+  double clearance(double x, double y) const noexcept;
+
+  std::vector<double> const &startX() const noexcept;
+  std::vector<double> const &startY() const noexcept;
+  std::vector<double> const &directionX() const noexcept;
+  std::vector<double> const &directionY() const noexcept;
+
+ private:
+  std::vector<double> m_startX;
+  std::vector<double> m_startY;
+  std::vector<double> m_directionX;
+  std::vector<double> m_directionY;
+};
+
+#endif
@@ -0,0 +1,116 @@
+/*
+ * Copyright (C) 2018 Ola Benderius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <string>
+#include <thread>
+
+#include "catch.hpp"
+
+#include "behavior-parameters.hpp"
+#include "file-watcher.hpp"
+
+TEST_CASE("Test behavior parameters, config text is applied and malformed text rejected.") {
+  BehaviorParameters parameters;
+  REQUIRE(applyBehaviorParameters("# Kiwi in the lab\n\nspeed = 0.5\n  Kp_side=0.02\r\nfront=0.25\n", parameters) == 3);
+  REQUIRE(parameters.speed == Approx(0.5f));
+  REQUIRE(parameters.Kp_side == Approx(0.02f));
+  REQUIRE(parameters.front == Approx(0.25f));
+  REQUIRE(parameters.rear == Approx(0.4f));
+
+  REQUIRE(applyBehaviorParameters("speed=0.1\nkp_side=0.5\n", parameters) == -1);
+  REQUIRE(applyBehaviorParameters("speed=0.1\nrear=fast\n", parameters) == -1);
+  REQUIRE(applyBehaviorParameters("speed=nan\n", parameters) == -1);
+  REQUIRE(applyBehaviorParameters("speed\n", parameters) == -1);
+  REQUIRE(parameters.speed == Approx(0.5f));
+}
+
+TEST_CASE("Test behavior parameters, command line options override and others are ignored.") {
+  BehaviorParameters parameters;
+  std::map<std::string, std::string> arguments{{"cid", "111"}, {"freq", "10"}, {"reverseSpeed", "0.6"}};
+  REQUIRE(applyBehaviorParameters(arguments, parameters) == 1);
+  REQUIRE(parameters.reverseSpeed == Approx(0.6f));
+  arguments["sideWall"] = "";
+  REQUIRE(applyBehaviorParameters(arguments, parameters) == -1);
+}
+
+TEST_CASE("Test behavior parameters, readers always see one complete parameter set.") {
+  BehaviorParameterStore store{BehaviorParameters{}};
+  std::shared_ptr<BehaviorParameters const> const before{store.current()};
+  REQUIRE(store.update("speed=0.3\n") == 1);
+  REQUIRE(store.revision() == 1);
+  REQUIRE(store.current()->speed == Approx(0.3f));
+  REQUIRE(before->speed == Approx(0.8f));
+  REQUIRE(store.update("speed=1.0\nbogus=1\n") == -1);
+  REQUIRE(store.revision() == 1);
+
+  // Every update sets front and rear to the same value.
+  std::atomic<bool> running{true};
+  std::atomic<uint64_t> torn{0};
+  std::thread reader{[&store, &running, &torn]() {
+      while (running) {
+        std::shared_ptr<BehaviorParameters const> const parameters{store.current()};
+        if (parameters->front < parameters->rear || parameters->front > parameters->rear) {
+          torn++;
+        }
+      }
+    }};
+  REQUIRE(store.update("front=0.5\nrear=0.5\n") == 2);
+  for (uint32_t i{0}; i < 2000; i++) {
+    std::string const value{std::to_string(i % 10)};
+    store.update("front=" + value + "\nrear=" + value + "\n");
+  }
+  running = false;
+  reader.join();
+  REQUIRE(torn == 0);
+  REQUIRE(store.revision() == 2002);
+}
+
+TEST_CASE("Test behavior parameters, a rewritten or replaced config file is reloaded.") {
+  std::string const path{"/tmp/test-behavior-parameters-" + std::to_string(::getpid()) + ".conf"};
+  std::ofstream{path} << "speed=0.8\n";
+  BehaviorParameterStore store{BehaviorParameters{}};
+  FileWatcher watcher{path, [&store](std::string const &text) { store.update(text); }};
+  REQUIRE(watcher.isRunning());
+
+  auto const waitForRevision{[&store](uint64_t revision) {
+      auto const deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+      while (store.revision() < revision && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+      return store.revision() >= revision;
+    }};
+
+  std::ofstream{path} << "speed=0.4\n";
+  REQUIRE(waitForRevision(1));
+  REQUIRE(store.current()->speed == Approx(0.4f));
+
+  // Saved through a temporary file, as editors do.
+  std::string const temporary{path + ".tmp"};
+  std::ofstream{temporary} << "speed=0.6\nKp_side=0.03\n";
+  REQUIRE(0 == std::rename(temporary.c_str(), path.c_str()));
+  REQUIRE(waitForRevision(2));
+  REQUIRE(store.current()->speed == Approx(0.6f));
+  REQUIRE(store.current()->Kp_side == Approx(0.03f));
+  std::remove(path.c_str());
+}
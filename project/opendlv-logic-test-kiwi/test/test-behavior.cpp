@@ -15,6 +15,8 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <cmath>
+
 #define CATCH_CONFIG_MAIN  // This tells Catch to provide a main() - only do this in one cpp file
 #include "catch.hpp"
 
@@ -23,17 +25,52 @@
 
 #include "behavior.hpp"
 
-TEST_CASE("Test behavior, a short distance to the front should make Kiwi stop.") {
-  // Behavior b;
+TEST_CASE("Test behavior, a short distance to the front should make Kiwi back off.") {
+  Behavior b;
+  BehaviorParameters parameters;
+
+  opendlv::proxy::DistanceReading front;
+  front.distance(0.1f);
+  opendlv::proxy::DistanceReading rear;
+  rear.distance(1.0f);
+  opendlv::proxy::VoltageReading side;
+  side.voltage(0.2f);
+
+  b.setFrontUltrasonic(front);
+  b.setRearUltrasonic(rear);
+  b.setLeftIr(side);
+  b.setRightIr(side);
+  b.step(parameters, 10.0f);
+
+  auto pp = b.getPedalPositionRequest();
+
+  REQUIRE(pp.position() == Approx(-parameters.reverseSpeed));
+  REQUIRE_FALSE(b.isInSafeMode());
+}
 
-  // opendlv::proxy::DistanceReading dr;
-  // dr.distance(0.1f);
-  
-  // b.setFrontUltrasonic(dr);
-  // b.step();
+TEST_CASE("Test behavior, the P steering stays bounded while reversing.") {
+  Behavior b;
+  BehaviorParameters parameters;
 
-  // auto pp = b.getPedalPositionRequest();
+  opendlv::proxy::DistanceReading front;
+  front.distance(0.1f);
+  opendlv::proxy::DistanceReading rear;
+  rear.distance(1.0f);
+  // About 15 cm to the left wall, and nothing seen to the right.
+  opendlv::proxy::VoltageReading left;
+  left.voltage(0.45f);
+  opendlv::proxy::VoltageReading right;
+  right.voltage(0.0f);
 
-  // REQUIRE(pp.position() == Approx(0.0f));
-  REQUIRE(1);
+  b.setFrontUltrasonic(front);
+  b.setRearUltrasonic(rear);
+  b.setLeftIr(left);
+  b.setRightIr(right);
+  // The correction adds up on every tick of the reverse.
+  for (uint32_t i{0}; i < 15; i++) {
+    b.step(parameters, 10.0f);
+    REQUIRE(b.getPedalPositionRequest().position() == Approx(-parameters.reverseSpeed));
+    REQUIRE(std::fabs(b.getGroundSteeringAngle().groundSteering()) <= parameters.maxSteering);
+  }
+  REQUIRE(b.getGroundSteeringAngle().groundSteering() == Approx(-parameters.maxSteering));
 }
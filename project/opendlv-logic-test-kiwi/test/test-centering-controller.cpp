@@ -0,0 +1,182 @@
+/*
+ * Copyright (C) 2018 Ola Benderius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cmath>
+
+#include "catch.hpp"
+
+#include "behavior.hpp"
+#include "centering-controller.hpp"
+#include "mpc-steering.hpp"
+#include "single-track-model.hpp"
+
+namespace {
+
+// Kiwi on SingleTrackModel in the middle of a corridor 70 cm wide, with
+// the IR sensors 10 cm off the centre line, starting offset by the given
+// number of cm and steering with the given trim added, as Behavior adds
+// groundSteering.
+struct CorridorRun {
+  double finalOffset{0.0};
+  // Furthest past the middle on the side opposite the start, in cm.
+  double overshoot{0.0};
+  float maxSteering{0.0f};
+};
+
+CorridorRun driveCorridor(CenteringController &controller, float speed, double offset, float trim, double seconds)
+{
+  CorridorRun run;
+  VehicleState state;
+  state.y = offset * 0.01;
+  for (double t{0.0}; t < seconds; t += 0.1) {
+    float const y{static_cast<float>(state.y * 100.0)};
+    float const steering{controller.update(25.0f - y, 25.0f + y, speed, 0.1f)};
+    run.maxSteering = std::max(run.maxSteering, std::fabs(steering));
+    for (uint32_t i{0}; i < 10; i++) {
+      SingleTrackModel::integrate(state.longitudinalSpeed, state.lateralSpeed, state.yawRate, trim + steering, speed, 0.01);
+      integratePose(state, 0.01);
+    }
+    run.overshoot = std::max(run.overshoot, -state.y * 100.0 * ((offset > 0.0) ? 1.0 : -1.0));
+  }
+  run.finalOffset = state.y * 100.0;
+  return run;
+}
+
+}
+
+TEST_CASE("Test centering controller, the gain schedule scales with the inverse square of the speed.") {
+  CenteringController controller;
+  CenteringController::Config config;
+  config.kp = 0.02f;
+  config.ki = 0.01f;
+  config.kd = 0.004f;
+  REQUIRE(controller.setConfig(config));
+  REQUIRE_FALSE(controller.setConfig(config));
+
+  REQUIRE(controller.gains(0.5f).kp == Approx(0.02f));
+  REQUIRE(controller.gains(-0.5f).kp == Approx(0.02f));
+  REQUIRE(controller.gains(1.0f).kp == Approx(0.005f));
+  REQUIRE(controller.gains(1.0f).ki == Approx(0.0025f));
+  REQUIRE(controller.gains(1.0f).kd == Approx(0.001f));
+  REQUIRE(controller.gains(0.8f).kp == Approx(0.0078125f).epsilon(0.01));
+  // Bounded by maxScale when slow and beyond the table when fast.
+  REQUIRE(controller.gains(0.1f).kp == Approx(0.08f));
+  REQUIRE(controller.gains(0.0f).kp == Approx(0.08f));
+  REQUIRE(controller.gains(3.0f).kp == Approx(0.005f));
+}
+
+TEST_CASE("Test centering controller, the integral does not wind up in saturation.") {
+  CenteringController controller;
+  CenteringController::Config config;
+  config.ki = 0.05f;
+  config.maxSteering = 0.3f;
+  config.integralLimit = 0.3f;
+  controller.setConfig(config);
+
+  // Far right of the middle for 5 s: the output saturates, and the
+  // integral only grows as long as it is needed to get there.
+  for (uint32_t i{0}; i < 50; i++) {
+    REQUIRE(controller.update(49.0f, 10.0f, 0.5f, 0.1f) <= 0.3f);
+  }
+  REQUIRE(controller.update(49.0f, 10.0f, 0.5f, 0.1f) == Approx(0.3f));
+  REQUIRE(controller.integral() < 0.11f);
+
+  // So that it steers the other way as soon as the error does.
+  REQUIRE(controller.update(10.0f, 49.0f, 0.5f, 0.1f) < 0.0f);
+
+  // Without walls the output is held on the integral.
+  float const integral{controller.integral()};
+  REQUIRE(controller.update(80.0f, 80.0f, 0.5f, 0.1f) == Approx(integral));
+  controller.reset();
+  REQUIRE(controller.integral() == Approx(0.0f));
+}
+
+TEST_CASE("Test centering controller, the derivative is low-pass filtered.") {
+  CenteringController controller;
+  CenteringController::Config config;
+  config.kp = 0.0f;
+  config.ki = 0.0f;
+  config.kd = 0.001f;
+  config.derivativeTime = 0.1f;
+  controller.setConfig(config);
+
+  REQUIRE(controller.update(30.0f, 30.0f, 0.5f, 0.1f) == Approx(0.0f));
+  // A 10 cm step is 100 cm/s for one tick, of which the low pass with
+  // alpha 0.5 lets half through, and then half of that.
+  REQUIRE(controller.update(40.0f, 20.0f, 0.5f, 0.1f) == Approx(0.05f));
+  REQUIRE(controller.update(40.0f, 20.0f, 0.5f, 0.1f) == Approx(0.025f));
+}
+
+TEST_CASE("Test centering controller, Kiwi settles in the middle of a corridor.") {
+  // With the default gains, from either side, with and without the
+  // groundSteering trim that the integral has to take out.
+  BehaviorParameters const parameters;
+  CenteringController::Config const config;
+  REQUIRE(config.kp == Approx(parameters.centeringKp));
+  REQUIRE(config.ki == Approx(parameters.centeringKi));
+  REQUIRE(config.kd == Approx(parameters.centeringKd));
+  for (float const speed : {0.3f, 0.5f, 0.8f}) {
+    for (double const start : {-20.0, -10.0, 10.0, 20.0}) {
+      for (float const trim : {0.0f, parameters.groundSteering}) {
+        CenteringController controller;
+        CorridorRun const run{driveCorridor(controller, speed, start, trim, 20.0)};
+        REQUIRE(std::fabs(run.finalOffset) < 1.0);
+        REQUIRE(run.overshoot < 6.0);
+        REQUIRE(run.maxSteering <= controller.config().maxSteering);
+      }
+    }
+  }
+}
+
+TEST_CASE("Test behavior, the centering parameter selects the PID controller.") {
+  BehaviorParameters parameters;
+  parameters.centering = 1.0f;
+  opendlv::proxy::DistanceReading distance;
+  distance.distance(1.0f);
+  opendlv::proxy::VoltageReading left;
+  left.voltage(0.3f);
+  opendlv::proxy::VoltageReading right;
+  right.voltage(0.4f);
+  float const leftDistance{static_cast<float>(Behavior::convertIrVoltageToDistance(left.voltage()))};
+  float const rightDistance{static_cast<float>(Behavior::convertIrVoltageToDistance(right.voltage()))};
+
+  Behavior behavior;
+  behavior.setFrontUltrasonic(distance);
+  behavior.setRearUltrasonic(distance);
+  behavior.setLeftIr(left);
+  behavior.setRightIr(right);
+
+  CenteringController controller;
+  CenteringController::Config config;
+  config.kp = parameters.centeringKp;
+  config.ki = parameters.centeringKi;
+  config.kd = parameters.centeringKd;
+  config.integralLimit = parameters.centeringMaxSteering;
+  controller.setConfig(config);
+  for (uint32_t i{0}; i < 5; i++) {
+    behavior.step(parameters, 10.0f);
+    float const expected{parameters.groundSteering + controller.update(leftDistance, rightDistance, parameters.speed, 0.1f)};
+    REQUIRE(behavior.getGroundSteeringAngle().groundSteering() == Approx(expected));
+  }
+
+  // And back to the P steering at run time.
+  parameters.centering = 0.0f;
+  behavior.step(parameters, 10.0f);
+  float const proportional{0.05f - parameters.Kp_side * (rightDistance - leftDistance)};
+  REQUIRE(behavior.getGroundSteeringAngle().groundSteering() == Approx(proportional));
+}
@@ -0,0 +1,169 @@
+/*
+ * Copyright (C) 2018 Ola Benderius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <vector>
+
+#include "catch.hpp"
+
+#include "behavior.hpp"
+#include "drive-state-machine.hpp"
+
+namespace {
+
+using Mode = DriveStateMachine::Mode;
+
+void setFront(Behavior &behavior, float front)
+{
+  opendlv::proxy::DistanceReading distance;
+  distance.distance(front);
+  behavior.setFrontUltrasonic(distance);
+  distance.distance(1.0f);
+  behavior.setRearUltrasonic(distance);
+}
+
+// The Kiwi defaults at 10 Hz: 2 s of reversing, then 2 s of nudged forward
+// driving.
+void stepBehavior(Behavior &behavior)
+{
+  behavior.step(0.8f, 0.2f, 0.4f, 30.0f, 50.0f, 2.0f, 0.05f, 0.3f, 0.3f, 0.8f, 10.0f, 0.01f,
+      20.0f, 0.5f, 50.0f, 2.0f, 0.2f);
+}
+
+}
+
+TEST_CASE("Test drive state machine, an obstacle starts a timed reverse and nudged forward phase.") {
+  DriveStateMachine machine;
+  DriveStateMachine::Parameters parameters;
+  float steering{0.05f};
+
+  REQUIRE_FALSE(machine.step(false, false, 40.0f, 40.0f, 0.1f, parameters, steering));
+  REQUIRE(machine.mode() == Mode::Forward);
+
+  // Reversing inverts the steering and picks the nudge towards the more
+  // open left side.
+  REQUIRE(machine.step(true, false, 40.0f, 20.0f, 0.1f, parameters, steering));
+  REQUIRE(machine.mode() == Mode::Reverse);
+  REQUIRE(steering == Approx(-0.05f));
+
+  uint32_t ticks{1};
+  while (Mode::Reverse == machine.mode()) {
+    REQUIRE(machine.step(false, false, 40.0f, 20.0f, 0.1f, parameters, steering));
+    ticks++;
+  }
+  REQUIRE(ticks == 20);
+  REQUIRE(machine.mode() == Mode::ForwardAfterReverse);
+  REQUIRE(steering == Approx(0.15f));
+
+  while (Mode::ForwardAfterReverse == machine.mode()) {
+    REQUIRE_FALSE(machine.step(false, false, 40.0f, 20.0f, 0.1f, parameters, steering));
+  }
+  REQUIRE(steering == Approx(parameters.groundSteering));
+
+  std::vector<DriveStateMachine::Record> const records{machine.transitions()};
+  REQUIRE(records.size() == 3);
+  REQUIRE(records[0].to == Mode::Reverse);
+  REQUIRE(records[0].time == Approx(0.1f));
+  REQUIRE(records[1].to == Mode::ForwardAfterReverse);
+  REQUIRE(records[1].event == DriveStateMachine::Event::Timeout);
+  REQUIRE(records[2].to == Mode::Forward);
+  REQUIRE(records[2].time - records[1].time == Approx(2.0f).margin(0.15f));
+}
+
+TEST_CASE("Test drive state machine, a blocked rear ends the reverse early.") {
+  DriveStateMachine machine;
+  DriveStateMachine::Parameters parameters;
+  float steering{0.05f};
+
+  REQUIRE(machine.step(true, false, 40.0f, 20.0f, 0.1f, parameters, steering));
+  REQUIRE(machine.step(false, false, 40.0f, 20.0f, 0.1f, parameters, steering));
+  // Left as on the timeout, nudge included.
+  REQUIRE_FALSE(machine.step(false, true, 40.0f, 20.0f, 0.1f, parameters, steering));
+  REQUIRE(machine.mode() == Mode::ForwardAfterReverse);
+  REQUIRE(steering == Approx(0.15f));
+  REQUIRE(machine.transitions().back().event == DriveStateMachine::Event::RearBlocked);
+
+  // Other modes do not care.
+  REQUIRE_FALSE(machine.step(false, true, 40.0f, 20.0f, 0.1f, parameters, steering));
+  REQUIRE(machine.mode() == Mode::ForwardAfterReverse);
+  REQUIRE(steering == Approx(0.15f));
+  REQUIRE(machine.transitionCount() == 2);
+}
+
+TEST_CASE("Test drive state machine, only the last transitions are kept.") {
+  DriveStateMachine machine;
+  DriveStateMachine::Parameters parameters;
+  parameters.reverseTimeThreshold = 0.0f;
+  parameters.forwardTimeAfterReverseLimit = 0.0f;
+  float steering{0.0f};
+  for (uint32_t i{0}; i < 100; i++) {
+    machine.step(0 == i % 2, false, 1.0f, 1.0f, 0.1f, parameters, steering);
+  }
+  REQUIRE(machine.transitionCount() == 150);
+  std::vector<DriveStateMachine::Record> const records{machine.transitions()};
+  REQUIRE(records.size() == DriveStateMachine::RECORDS);
+  REQUIRE(records.back().to == Mode::Forward);
+  REQUIRE(records.back().time == Approx(9.8f));
+}
+
+TEST_CASE("Test drive state machine, Behavior replays a front obstacle as a mode sequence.") {
+  Behavior behavior;
+  setFront(behavior, 1.0f);
+  for (uint32_t i{0}; i < 10; i++) {
+    stepBehavior(behavior);
+  }
+  REQUIRE(behavior.getDriveMode() == Mode::Forward);
+
+  setFront(behavior, 0.1f);
+  stepBehavior(behavior);
+  REQUIRE(behavior.getPedalPositionRequest().position() == Approx(-0.8f));
+  // Still blocked when the reverse times out: forward for one tick, then
+  // reversing again.
+  for (uint32_t i{0}; i < 21; i++) {
+    stepBehavior(behavior);
+  }
+  setFront(behavior, 1.0f);
+  for (uint32_t i{0}; i < 60; i++) {
+    stepBehavior(behavior);
+  }
+  REQUIRE(behavior.getPedalPositionRequest().position() == Approx(0.8f));
+
+  std::vector<Mode> sequence;
+  for (auto const &record : behavior.getDriveTransitions()) {
+    sequence.push_back(record.to);
+  }
+  REQUIRE(sequence == std::vector<Mode>({Mode::Reverse, Mode::ForwardAfterReverse, Mode::Reverse,
+        Mode::ForwardAfterReverse, Mode::Forward}));
+}
+
+TEST_CASE("Test drive state machine, Behavior stops backing up when a side IR sees a wall close.") {
+  Behavior behavior;
+  setFront(behavior, 0.1f);
+  stepBehavior(behavior);
+  REQUIRE(behavior.getPedalPositionRequest().position() == Approx(-0.8f));
+
+  // About 7 cm to the left: boxed in while the front is still blocked,
+  // and nudged forward once it is clear.
+  opendlv::proxy::VoltageReading left;
+  left.voltage(0.75f);
+  behavior.setLeftIr(left);
+  stepBehavior(behavior);
+  REQUIRE(behavior.getPedalPositionRequest().position() == Approx(0.0f));
+  setFront(behavior, 1.0f);
+  stepBehavior(behavior);
+  REQUIRE(behavior.getDriveMode() == Mode::ForwardAfterReverse);
+  REQUIRE(behavior.getPedalPositionRequest().position() == Approx(0.8f));
+}
@@ -0,0 +1,95 @@
+/*
+ * Copyright (C) 2018 Ola Benderius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <sstream>
+
+#include "catch.hpp"
+
+#include "cluon-complete.hpp"
+#include "opendlv-standard-message-set.hpp"
+#include "test-message-set.hpp"
+
+#include "envelope-framing.hpp"
+
+TEST_CASE("Test envelope framing, every field type encodes like ToProtoVisitor.") {
+  MyTestMessage1 inner;
+  inner.myValue(4711);
+  MyTestMessage2 message;
+  message.myValue1(true).myValue2(200).myValue3(-7).myValue4(60000).myValue5(-30000)
+    .myValue6(4000000000u).myValue7(-2000000000).myValue8(18000000000000u).myValue9(-9000000000000)
+    .myValue10(3.5f).myValue11(-6.25).myValue12(std::string(300, 'k')).myValue13(inner);
+  cluon::ToProtoVisitor expected;
+  message.accept(expected);
+
+  std::string actual;
+  ProtoWriter writer{actual};
+  message.accept(writer);
+  REQUIRE(actual == expected.encodedData());
+}
+
+TEST_CASE("Test envelope framing, a pre-built envelope matches serializeEnvelope.") {
+  opendlv::proxy::GroundSteeringRequest request;
+  request.groundSteering(0.25f);
+  cluon::ToProtoVisitor encoder;
+  request.accept(encoder);
+
+  cluon::data::Envelope envelope;
+  envelope.dataType(opendlv::proxy::GroundSteeringRequest::ID())
+    .serializedData(encoder.encodedData())
+    .sent(cluon::data::TimeStamp().seconds(1540000000).microseconds(123456))
+    .sampleTimeStamp(cluon::data::TimeStamp().seconds(1540000000).microseconds(100))
+    .senderStamp(3);
+
+  std::string frame{"prefix"};
+  appendEnvelope(frame, envelope);
+  REQUIRE(frame == "prefix" + cluon::serializeEnvelope(std::move(envelope)));
+}
+
+TEST_CASE("Test envelope framing, a message is framed in one buffer and decodes again.") {
+  opendlv::proxy::PedalPositionRequest request;
+  request.position(0.5f);
+  cluon::data::TimeStamp sampleTimeStamp;
+  sampleTimeStamp.seconds(1540000000).microseconds(42);
+
+  std::string frame;
+  appendFrame(frame, request, sampleTimeStamp, 7);
+  std::size_t const first{frame.size()};
+  appendFrame(frame, request);
+  REQUIRE(static_cast<uint8_t>(frame[first]) == 0x0D);
+  REQUIRE(static_cast<uint8_t>(frame[first + 1]) == 0xA4);
+
+  std::stringstream sstr{frame.substr(0, first)};
+  auto result = cluon::extractEnvelope(sstr);
+  REQUIRE(result.first);
+  cluon::data::Envelope envelope = result.second;
+  REQUIRE(envelope.dataType() == opendlv::proxy::PedalPositionRequest::ID());
+  REQUIRE(envelope.senderStamp() == 7);
+  REQUIRE(envelope.sampleTimeStamp().seconds() == 1540000000);
+  REQUIRE(envelope.sampleTimeStamp().microseconds() == 42);
+  REQUIRE(envelope.sent().seconds() > 0);
+
+  cluon::ToProtoVisitor encoder;
+  request.accept(encoder);
+  REQUIRE(envelope.serializedData() == encoder.encodedData());
+
+  // Without a sample time stamp, the sent time is used like OD4Session does.
+  std::stringstream second{frame.substr(first)};
+  cluon::data::Envelope unstamped = cluon::extractEnvelope(second).second;
+  REQUIRE(unstamped.sampleTimeStamp().seconds() == unstamped.sent().seconds());
+  REQUIRE(unstamped.sampleTimeStamp().microseconds() == unstamped.sent().microseconds());
+  REQUIRE(unstamped.senderStamp() == 0);
+}
@@ -0,0 +1,140 @@
+/*
+ * Copyright (C) 2018 Ola Benderius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <string>
+
+#include "catch.hpp"
+
+#include "cluon-complete.hpp"
+#include "opendlv-standard-message-set.hpp"
+
+#include "envelope-json-encoder.hpp"
+#include "json-writer.hpp"
+
+namespace {
+
+std::string formatFloat(float v)
+{
+  char out[32];
+  return std::string(out, formatShortestFloat(v, out));
+}
+
+std::string withoutWhitespace(std::string s)
+{
+  std::string retVal;
+  for (char c : s) {
+    if (' ' != c && '\n' != c) {
+      retVal.push_back(c);
+    }
+  }
+  return retVal;
+}
+
+}
+
+TEST_CASE("Test json writer, floats are written shortest and read back exactly.") {
+  REQUIRE(formatFloat(0.0f) == "0");
+  REQUIRE(formatFloat(0.1f) == "0.1");
+  REQUIRE(formatFloat(-2.5f) == "-2.5");
+  REQUIRE(formatFloat(100.0f) == "100");
+  REQUIRE(formatFloat(1e-7f) == "1e-7");
+  REQUIRE(formatFloat(3.0e20f) == "3e20");
+  REQUIRE(formatFloat(std::numeric_limits<float>::quiet_NaN()) == "null");
+
+  uint32_t bits{0x3dcccccd};
+  for (uint32_t i{0}; i < 100000; i++) {
+    bits = bits * 1664525u + 1013904223u;
+    float v;
+    std::memcpy(&v, &bits, sizeof(v));
+    if (!std::isfinite(v)) {
+      continue;
+    }
+    std::string const s{formatFloat(v)};
+    float const back{std::strtof(s.c_str(), nullptr)};
+    REQUIRE(0 == std::memcmp(&back, &v, sizeof(v)));
+    REQUIRE(s.size() <= 15);
+  }
+}
+
+TEST_CASE("Test json writer, separators, escaping and base64.") {
+  JsonWriter writer;
+  writer.beginObject();
+  writer.key("a", 1);
+  writer.value(static_cast<int64_t>(-12));
+  writer.key("list", 4);
+  writer.beginArray();
+  writer.value(true);
+  writer.valueNull();
+  writer.beginObject();
+  writer.endObject();
+  writer.endArray();
+  writer.key("text", 4);
+  writer.valueString("q\"\\\n", 4);
+  writer.key("b64", 3);
+  writer.valueBase64("kiwi", 4);
+  writer.endObject();
+  REQUIRE(writer.buffer() == R"({"a":-12,"list":[1,null,{}],"text":"q\"\\\u000a","b64":"a2l3aQ=="})");
+
+  writer.clear();
+  writer.value(static_cast<uint64_t>(18446744073709551615ull));
+  REQUIRE(writer.buffer() == "18446744073709551615");
+}
+
+TEST_CASE("Test json writer, envelopes match EnvelopeConverter and batch into one frame.") {
+  std::string const SPECIFICATION{R"(
+message opendlv.sim.KinematicState [id = 1002] {
+  float vx [id = 1];
+  float vy [id = 2];
+  float vz [id = 3];
+  float rollRate [id = 4];
+  float pitchRate [id = 5];
+  float yawRate [id = 6];
+}
+)"};
+  MessageProgramSet programs;
+  REQUIRE(programs.setMessageSpecification(SPECIFICATION) == 1);
+
+  opendlv::sim::KinematicState ks;
+  ks.vx(0.5f).vy(-0.25f).yawRate(1.5f);
+  cluon::ToProtoVisitor encoder;
+  ks.accept(encoder);
+  cluon::data::Envelope envelope;
+  envelope.dataType(opendlv::sim::KinematicState::ID()).serializedData(encoder.encodedData()).senderStamp(3);
+  envelope.sent(cluon::data::TimeStamp().seconds(10).microseconds(20));
+
+  cluon::EnvelopeConverter converter;
+  converter.setMessageSpecification(SPECIFICATION);
+  std::string const expected{withoutWhitespace(converter.getJSONFromEnvelope(envelope))};
+
+  EnvelopeJsonEncoder jsonEncoder{programs};
+  REQUIRE(jsonEncoder.encode(envelope) == expected);
+
+  cluon::data::Envelope unknown;
+  unknown.dataType(4711);
+  REQUIRE(jsonEncoder.encode(unknown) == "{}");
+
+  jsonEncoder.beginFrame();
+  REQUIRE(jsonEncoder.append(envelope));
+  REQUIRE_FALSE(jsonEncoder.append(unknown));
+  REQUIRE(jsonEncoder.append(envelope));
+  REQUIRE(jsonEncoder.endFrame() == "[" + expected + "," + expected + "]");
+  REQUIRE(jsonEncoder.frameSize() == 2);
+}
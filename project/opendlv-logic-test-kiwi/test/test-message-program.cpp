@@ -0,0 +1,196 @@
+/*
+ * Copyright (C) 2018 Ola Benderius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "catch.hpp"
+
+#include "cluon-complete.hpp"
+#include "opendlv-standard-message-set.hpp"
+
+#include "message-program.hpp"
+
+namespace {
+
+char const *TEST_SPECIFICATION = R"(
+message test.Inner [id = 9001] {
+  int16 a [id = 1];
+  string label [id = 2];
+}
+
+message test.AllTypes [id = 9002] {
+  bool b [id = 1];
+  char c [id = 2];
+  int8 i8 [id = 3];
+  uint8 u8 [id = 4];
+  int16 i16 [id = 5];
+  uint16 u16 [id = 6];
+  int32 i32 [id = 7];
+  uint32 u32 [id = 8];
+  int64 i64 [id = 9];
+  uint64 u64 [id = 10];
+  float f [id = 11];
+  double d [id = 12];
+  string s [id = 13];
+  test.Inner inner [id = 14];
+}
+)";
+
+struct Collector {
+  std::vector<std::string> &names;
+  std::string &label;
+  int16_t &a;
+  void operator()(MessageProgram::Field const &field, DynamicRecord::StringSlice v) {
+    names.push_back(field.name);
+    if (field.name == "label") {
+      label.assign(v.data, v.size);
+    }
+  }
+  void operator()(MessageProgram::Field const &field, int16_t v) {
+    names.push_back(field.name);
+    if (field.name == "a") {
+      a = v;
+    }
+  }
+  template <typename T>
+  void operator()(MessageProgram::Field const &field, T) {
+    names.push_back(field.name);
+  }
+};
+
+}
+
+TEST_CASE("Test message program, KinematicState decodes like the generated message.") {
+  MessageProgramSet programs;
+  REQUIRE(programs.setMessageSpecification(R"(
+message opendlv.sim.KinematicState [id = 1002] {
+  float vx [id = 1];
+  float vy [id = 2];
+  float vz [id = 3];
+  float rollRate [id = 4];
+  float pitchRate [id = 5];
+  float yawRate [id = 6];
+}
+)") == 1);
+
+  opendlv::sim::KinematicState ks;
+  ks.vx(0.5f).vy(-0.25f).yawRate(1.5f);
+  cluon::ToProtoVisitor encoder;
+  ks.accept(encoder);
+
+  DynamicRecord record{programs};
+  REQUIRE(record.decode(opendlv::sim::KinematicState::ID(), encoder.encodedData()));
+  MessageProgram const *program = record.program();
+  REQUIRE(program != nullptr);
+  REQUIRE(program->shortName() == "KinematicState");
+  REQUIRE(record.get<float>(*program->findField(1)) == Approx(0.5f));
+  REQUIRE(record.get<float>(*program->findField(2)) == Approx(-0.25f));
+  REQUIRE(record.get<float>(*program->findField(3)) == Approx(0.0f));
+  REQUIRE(record.get<float>(*program->findField(6)) == Approx(1.5f));
+
+  cluon::ToJSONVisitor expected;
+  ks.accept(expected);
+  cluon::ToJSONVisitor actual;
+  record.accept(actual);
+  REQUIRE(actual.json() == expected.json());
+}
+
+TEST_CASE("Test message program, every scalar type, strings and nested messages round trip.") {
+  MessageProgramSet programs;
+  REQUIRE(programs.setMessageSpecification(TEST_SPECIFICATION) == 2);
+
+  cluon::ToProtoVisitor inner;
+  {
+    int16_t a{-1234};
+    std::string label{"inner"};
+    inner.visit(1, "int16", "a", a);
+    inner.visit(2, "string", "label", label);
+  }
+  cluon::ToProtoVisitor outer;
+  {
+    bool b{true};
+    char c{'k'};
+    int8_t i8{-7};
+    uint8_t u8{200};
+    int16_t i16{-30000};
+    uint16_t u16{60000};
+    int32_t i32{-2000000000};
+    uint32_t u32{4000000000};
+    int64_t i64{-9000000000000};
+    uint64_t u64{18000000000000};
+    float f{3.5f};
+    double d{-6.25};
+    std::string s{"kiwi"};
+    std::string nested{inner.encodedData()};
+    outer.visit(1, "bool", "b", b);
+    outer.visit(2, "char", "c", c);
+    outer.visit(3, "int8", "i8", i8);
+    outer.visit(4, "uint8", "u8", u8);
+    outer.visit(5, "int16", "i16", i16);
+    outer.visit(6, "uint16", "u16", u16);
+    outer.visit(7, "int32", "i32", i32);
+    outer.visit(8, "uint32", "u32", u32);
+    outer.visit(9, "int64", "i64", i64);
+    outer.visit(10, "uint64", "u64", u64);
+    outer.visit(11, "float", "f", f);
+    outer.visit(12, "double", "d", d);
+    outer.visit(13, "string", "s", s);
+    outer.visit(14, "string", "inner", nested);
+  }
+
+  DynamicRecord record{programs};
+  REQUIRE(record.decode(9002, outer.encodedData()));
+  MessageProgram const &p = *record.program();
+  REQUIRE(record.get<bool>(*p.findField(1)));
+  REQUIRE(record.get<char>(*p.findField(2)) == 'k');
+  REQUIRE(record.get<int8_t>(*p.findField(3)) == -7);
+  REQUIRE(record.get<uint8_t>(*p.findField(4)) == 200);
+  REQUIRE(record.get<int16_t>(*p.findField(5)) == -30000);
+  REQUIRE(record.get<uint16_t>(*p.findField(6)) == 60000);
+  REQUIRE(record.get<int32_t>(*p.findField(7)) == -2000000000);
+  REQUIRE(record.get<uint32_t>(*p.findField(8)) == 4000000000u);
+  REQUIRE(record.get<int64_t>(*p.findField(9)) == -9000000000000);
+  REQUIRE(record.get<uint64_t>(*p.findField(10)) == 18000000000000u);
+  REQUIRE(record.get<float>(*p.findField(11)) == Approx(3.5f));
+  REQUIRE(record.get<double>(*p.findField(12)) == Approx(-6.25));
+  DynamicRecord::StringSlice s = record.getString(*p.findField(13));
+  REQUIRE(std::string(s.data, s.size) == "kiwi");
+
+  std::vector<std::string> leaves;
+  std::string nestedLabel;
+  int16_t nestedA{0};
+  Collector collector{leaves, nestedLabel, nestedA};
+  record.forEachField(collector);
+  REQUIRE(leaves.size() == 15);
+  REQUIRE(nestedA == -1234);
+  REQUIRE(nestedLabel == "inner");
+}
+
+TEST_CASE("Test message program, unknown messages and truncated payloads are rejected.") {
+  MessageProgramSet programs;
+  REQUIRE(programs.setMessageSpecification(TEST_SPECIFICATION) == 2);
+  REQUIRE(programs.setMessageSpecification("message broken {") == -1);
+  REQUIRE(programs.setMessageSpecification(TEST_SPECIFICATION) == 2);
+
+  DynamicRecord record{programs};
+  REQUIRE_FALSE(record.decode(4711, std::string{}));
+
+  cluon::ToProtoVisitor encoder;
+  double d{1.0};
+  encoder.visit(12, "double", "d", d);
+  std::string truncated{encoder.encodedData()};
+  truncated.pop_back();
+  REQUIRE_FALSE(record.decode(9002, truncated));
+}
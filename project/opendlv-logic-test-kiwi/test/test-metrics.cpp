@@ -0,0 +1,177 @@
+/*
+ * Copyright (C) 2018 Ola Benderius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "catch.hpp"
+
+#include "cluon-complete.hpp"
+#include "opendlv-standard-message-set.hpp"
+
+#include "message-bus.hpp"
+#include "metrics.hpp"
+
+TEST_CASE("Test metrics, counters of all threads are summed per message ID.") {
+  Metrics metrics;
+  std::vector<std::thread> threads;
+  for (uint32_t t{0}; t < 4; t++) {
+    threads.emplace_back([&metrics]() {
+        for (uint32_t i{0}; i < 1000; i++) {
+          metrics.received(1039, 20);
+          metrics.sent(1090, 30);
+        }
+        metrics.received(-3, 1);
+      });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  auto const snapshot = metrics.snapshot();
+  REQUIRE(snapshot.size() == 3);
+  REQUIRE(snapshot.at(1039).received == 4000);
+  REQUIRE(snapshot.at(1039).receivedBytes == 80000);
+  REQUIRE(snapshot.at(1039).sent == 0);
+  REQUIRE(snapshot.at(1090).sent == 4000);
+  REQUIRE(snapshot.at(1090).sentBytes == 120000);
+  REQUIRE(snapshot.at(-3).received == 4);
+}
+
+TEST_CASE("Test metrics, latencies fall into power of two buckets and are exposed as text.") {
+  Metrics metrics;
+  metrics.delegateTime(1039, std::chrono::nanoseconds(10));
+  metrics.delegateTime(1039, std::chrono::nanoseconds(64));
+  metrics.delegateTime(1039, std::chrono::nanoseconds(65));
+  metrics.delegateTime(1039, std::chrono::microseconds(1));
+  metrics.delegateTime(1039, std::chrono::seconds(1));
+  metrics.addGauge("od4_test_queue_depth", []() { return 3.0; });
+
+  Metrics::Histogram const &delegate = metrics.snapshot().at(1039).delegate;
+  REQUIRE(delegate.count == 5);
+  REQUIRE(delegate.buckets[0] == 2);
+  REQUIRE(delegate.buckets[1] == 1);
+  REQUIRE(delegate.buckets[4] == 1);
+  REQUIRE(delegate.sumNanoseconds == 1000001139u);
+
+  std::string const text{metrics.exposition()};
+  REQUIRE(std::string::npos != text.find("# TYPE od4_delegate_seconds histogram\n"));
+  REQUIRE(std::string::npos != text.find("od4_delegate_seconds_bucket{message_id=\"1039\",le=\"1.28e-07\"} 3\n"));
+  REQUIRE(std::string::npos != text.find("od4_delegate_seconds_bucket{message_id=\"1039\",le=\"+Inf\"} 5\n"));
+  REQUIRE(std::string::npos != text.find("od4_delegate_seconds_count{message_id=\"1039\"} 5\n"));
+  REQUIRE(std::string::npos != text.find("od4_envelopes_received_total{message_id=\"1039\"} 0\n"));
+  REQUIRE(std::string::npos != text.find("od4_test_queue_depth 3\n"));
+}
+
+TEST_CASE("Test metrics, a message bus records received, delivered and sent envelopes.") {
+  Metrics metrics;
+  MessageBus bus{249};
+  bus.setMetrics(&metrics);
+  bus.dataTrigger(opendlv::proxy::DistanceReading::ID(), [](cluon::data::Envelope &&) {});
+
+  opendlv::proxy::DistanceReading reading;
+  std::string frame;
+  appendFrame(frame, reading);
+  auto const now = std::chrono::system_clock::now();
+  for (uint32_t i{0}; i < 2 * Metrics::LATENCY_SAMPLING; i++) {
+    bus.dispatch(frame, now);
+  }
+
+  opendlv::proxy::PedalPositionRequest request;
+  EnvelopeBatch batch;
+  batch.add(request);
+  batch.add(request);
+  bus.sendBatch(batch);
+  bus.send(request);
+
+  auto const snapshot = metrics.snapshot();
+  Metrics::MessageSnapshot const &distance = snapshot.at(opendlv::proxy::DistanceReading::ID());
+  REQUIRE(distance.received == 2 * Metrics::LATENCY_SAMPLING);
+  REQUIRE(distance.receivedBytes == 2 * Metrics::LATENCY_SAMPLING * frame.size());
+  REQUIRE(distance.decode.count == 2);
+  REQUIRE(distance.delegate.count == 2);
+  REQUIRE(snapshot.at(opendlv::proxy::PedalPositionRequest::ID()).sent == 3);
+}
+
+TEST_CASE("Test metrics, the server answers on a Unix domain socket.") {
+  Metrics metrics;
+  metrics.received(1039, 20);
+  std::string const path{"/tmp/test-metrics-" + std::to_string(::getpid()) + ".sock"};
+  MetricsServer server{metrics, "unix:" + path};
+  REQUIRE(server.isRunning());
+
+  int32_t const client{::socket(AF_UNIX, SOCK_STREAM, 0)};
+  REQUIRE(client >= 0);
+  struct sockaddr_un address{};
+  address.sun_family = AF_UNIX;
+  std::strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+  REQUIRE(0 == ::connect(client, reinterpret_cast<struct sockaddr *>(&address), sizeof(address)));
+  std::string const request{"GET /metrics HTTP/1.0\r\n\r\n"};
+  REQUIRE(::send(client, request.data(), request.size(), 0) > 0);
+
+  std::string response;
+  char buffer[4096];
+  ssize_t n;
+  while ((n = ::recv(client, buffer, sizeof(buffer), 0)) > 0) {
+    response.append(buffer, static_cast<std::size_t>(n));
+  }
+  ::close(client);
+  REQUIRE(0 == response.find("HTTP/1.0 200 OK\r\n"));
+  REQUIRE(std::string::npos != response.find("od4_envelopes_received_total{message_id=\"1039\"} 1\n"));
+}
+
+TEST_CASE("Test metrics, a silent client does not hold up the server or its shutdown.") {
+  Metrics metrics;
+  std::string const path{"/tmp/test-metrics-silent-" + std::to_string(::getpid()) + ".sock"};
+  int32_t const client{::socket(AF_UNIX, SOCK_STREAM, 0)};
+  REQUIRE(client >= 0);
+  auto const start = std::chrono::steady_clock::now();
+  {
+    MetricsServer server{metrics, "unix:" + path};
+    REQUIRE(server.isRunning());
+    struct sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    std::strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+    REQUIRE(0 == ::connect(client, reinterpret_cast<struct sockaddr *>(&address), sizeof(address)));
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  }
+  ::close(client);
+  REQUIRE(std::chrono::steady_clock::now() - start < std::chrono::milliseconds(5 * MetricsServer::CLIENT_TIMEOUT_MS));
+}
+
+TEST_CASE("Test metrics, only ports and Unix socket paths are accepted as addresses.") {
+  REQUIRE(MetricsServer::isValidAddress("9100"));
+  REQUIRE(MetricsServer::isValidAddress("65535"));
+  REQUIRE(MetricsServer::isValidAddress("unix:/tmp/metrics.sock"));
+  REQUIRE_FALSE(MetricsServer::isValidAddress(""));
+  REQUIRE_FALSE(MetricsServer::isValidAddress("0"));
+  REQUIRE_FALSE(MetricsServer::isValidAddress("65536"));
+  REQUIRE_FALSE(MetricsServer::isValidAddress("-1"));
+  REQUIRE_FALSE(MetricsServer::isValidAddress("http"));
+  REQUIRE_FALSE(MetricsServer::isValidAddress("unix:"));
+
+  Metrics metrics;
+  MetricsServer server{metrics, "metrics"};
+  REQUIRE_FALSE(server.isRunning());
+}
@@ -0,0 +1,106 @@
+/*
+ * Copyright (C) 2018 Ola Benderius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cmath>
+
+#include "catch.hpp"
+
+#include "mpc-steering.hpp"
+
+namespace {
+
+char const *BOX = "-2.0,-2.0,-2.0,2.0;\n-2.0,2.0,2.0,2.0;\n2.0,2.0,2.0,-2.0;\n2.0,-2.0,-2.0,-2.0;\n";
+
+}
+
+TEST_CASE("Test MPC steering, turns away from a wall ahead.") {
+  WallMap map;
+  REQUIRE(map.setSegments(BOX) == 4);
+  MpcSteering::Config config;
+  config.horizon = 40;
+  config.budget = std::chrono::microseconds(0);
+  MpcSteering mpc{map, config};
+
+  // Driving straight on hits the wall at x = 2 within the horizon.
+  VehicleState state;
+  state.x = 0.3;
+  MpcSteering::Solution const solution{mpc.solve(state)};
+  REQUIRE(solution.feasible);
+  REQUIRE_FALSE(solution.deadlineHit);
+  REQUIRE(solution.pedalPosition > 0.0f);
+  REQUIRE(std::fabs(solution.groundSteering) > 0.1f);
+}
+
+TEST_CASE("Test MPC steering, drives around the box without touching a wall.") {
+  WallMap map;
+  REQUIRE(map.setSegments(BOX) == 4);
+  MpcSteering::Config config;
+  config.horizon = 20;
+  config.budget = std::chrono::microseconds(0);
+  config.maxRollouts = 300;
+  MpcSteering mpc{map, config};
+
+  VehicleState state;
+  state.x = -1.0;
+  state.y = 0.5;
+  state.yaw = 0.3;
+  double travelled{0.0};
+  double closest{map.clearance(state.x, state.y)};
+  for (uint32_t tick{0}; tick < 150; tick++) {
+    MpcSteering::Solution const solution{mpc.solve(state)};
+    REQUIRE(solution.feasible);
+    double const x{state.x};
+    double const y{state.y};
+    MpcSteering::predict(state, solution.groundSteering, solution.pedalPosition, config.stepTime, config.substeps);
+    travelled += std::hypot(state.x - x, state.y - y);
+    closest = std::min(closest, map.clearance(state.x, state.y));
+  }
+  REQUIRE(closest > config.vehicleRadius);
+  REQUIRE(travelled > 3.0);
+}
+
+TEST_CASE("Test MPC steering, returns the best answer so far when the budget runs out.") {
+  WallMap map;
+  REQUIRE(map.setSegments(BOX) == 4);
+  MpcSteering::Config config;
+  config.horizon = 40;
+  config.budget = std::chrono::microseconds(200);
+  config.maxRollouts = 1000000;
+  MpcSteering mpc{map, config};
+
+  VehicleState state;
+  MpcSteering::Solution const solution{mpc.solve(state)};
+  REQUIRE(solution.deadlineHit);
+  REQUIRE(solution.feasible);
+  REQUIRE(solution.rollouts > 0);
+  REQUIRE(solution.solveTime < std::chrono::milliseconds(5));
+}
+
+TEST_CASE("Test MPC steering, stops when no sequence avoids a collision.") {
+  WallMap map;
+  REQUIRE(map.setSegments(BOX) == 4);
+  MpcSteering::Config config;
+  config.budget = std::chrono::microseconds(0);
+  MpcSteering mpc{map, config};
+
+  VehicleState state;
+  state.x = 1.95;
+  MpcSteering::Solution const solution{mpc.solve(state)};
+  REQUIRE_FALSE(solution.feasible);
+  REQUIRE(solution.pedalPosition == Approx(0.0f));
+  REQUIRE(solution.groundSteering == Approx(0.0f));
+}
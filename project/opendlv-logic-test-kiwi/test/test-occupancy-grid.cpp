@@ -0,0 +1,115 @@
+/*
+ * Copyright (C) 2018 Ola Benderius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cmath>
+#include <sstream>
+#include <string>
+
+#include "catch.hpp"
+
+#include "behavior.hpp"
+#include "occupancy-grid.hpp"
+#include "wall-map.hpp"
+
+TEST_CASE("Test occupancy grid, a ray frees the cells it passes and marks its end.") {
+  OccupancyGrid::Config config;
+  OccupancyGrid grid{config};
+  REQUIRE(grid.widthCells() == 112);
+  REQUIRE(grid.heightCells() == 112);
+  REQUIRE(grid.memoryBytes() == 112 * 112);
+  REQUIRE(grid.probability(0.0, 0.0) == Approx(0.5));
+
+  grid.updateRay(0.01, 0.01, 1.01, 0.51, true);
+  REQUIRE(grid.logOdds(0.01, 0.01) == Approx(-0.375));
+  REQUIRE(grid.logOdds(0.51, 0.26) == Approx(-0.375));
+  REQUIRE(grid.logOdds(1.01, 0.51) == Approx(0.875));
+  REQUIRE(grid.probability(1.01, 0.51) > 0.7);
+  REQUIRE(grid.logOdds(0.51, 0.51) == Approx(0.0));
+  REQUIRE(grid.cellUpdates() == 31);
+
+  grid.updateRay(0.01, 0.01, 1.01, 0.51, false);
+  REQUIRE(grid.logOdds(1.01, 0.51) == Approx(0.5));
+}
+
+TEST_CASE("Test occupancy grid, log-odds saturate and rays are clipped to the arena.") {
+  OccupancyGrid::Config config;
+  config.maxLogOdds = 2.0f;
+  OccupancyGrid grid{config};
+  for (uint32_t i{0}; i < 20; i++) {
+    grid.updateRay(-10.0, 0.02, 0.52, 0.02, true);
+  }
+  REQUIRE(grid.logOdds(0.52, 0.02) == Approx(2.0));
+  REQUIRE(grid.logOdds(-2.4, 0.02) == Approx(-2.0));
+  REQUIRE(grid.logOdds(0.0, 0.02) == Approx(-2.0));
+  REQUIRE(grid.logOdds(-10.0, 0.02) == Approx(0.0));
+  REQUIRE_FALSE(grid.contains(-10.0, 0.02));
+
+  std::ostringstream pgm;
+  REQUIRE(grid.writePgm(pgm));
+  REQUIRE(pgm.str().find("P5\n112 112\n255\n") == 0);
+  REQUIRE(pgm.str().size() == 15 + 112 * 112);
+
+  grid.clear();
+  REQUIRE(grid.logOdds(0.52, 0.02) == Approx(0.0));
+}
+
+TEST_CASE("Test occupancy grid, the mapper outlines the walls of the simulation box.") {
+  WallMap map;
+  REQUIRE(map.setSegments("-2.0,-2.0,-2.0,2.0;\n-2.0,2.0,2.0,2.0;\n2.0,2.0,2.0,-2.0;\n2.0,-2.0,-2.0,-2.0;\n") == 4);
+  OccupancyGrid::Config config;
+  OccupancyGrid grid{config};
+  OccupancyMapper mapper{grid};
+
+  // Turning on the spot in the middle of the box, one reading per sensor
+  // every degree. Walls on cell borders end up in the outer cell.
+  for (uint32_t i{0}; i < 360; i++) {
+    double const yaw{static_cast<double>(i) * M_PI / 180.0};
+    mapper.setPose(0.0, 0.0, yaw);
+    for (auto sensor : {OccupancyMapper::Sensor::FrontUltrasonic, OccupancyMapper::Sensor::RearUltrasonic}) {
+      OccupancyMapper::Mount const &m = mapper.mount(sensor);
+      double const x{m.x * std::cos(yaw)};
+      double const y{m.x * std::sin(yaw)};
+      opendlv::proxy::DistanceReading reading;
+      reading.distance(static_cast<float>(map.castRay(x, y, yaw + m.yaw, 10.0)));
+      mapper.addReading(sensor, reading);
+    }
+  }
+  for (double const along : {-1.5, -0.5, 0.5, 1.5}) {
+    REQUIRE(grid.logOdds(2.02, along) > 0.5f);
+    REQUIRE(grid.logOdds(along, 2.02) > 0.5f);
+    REQUIRE(grid.logOdds(along, 1.0) < -0.5f);
+    REQUIRE(grid.logOdds(-1.0, along) < -0.5f);
+  }
+  REQUIRE(grid.logOdds(2.5, 0.0) == Approx(0.0));
+
+  // An IR reading of 40 cm on the left marks a wall 0.5 m left of centre.
+  grid.clear();
+  mapper.setPose(0.0, 0.0, 0.0);
+  for (uint32_t i{0}; i < 5; i++) {
+    mapper.addRange(OccupancyMapper::Sensor::LeftIr, 0.4);
+  }
+
+  // 0.2 V reads as 32 cm on the right.
+  opendlv::proxy::VoltageReading voltage;
+  voltage.voltage(0.2f);
+  REQUIRE(Behavior::convertIrVoltageToDistance(voltage.voltage()) == Approx(32.16).epsilon(0.01));
+  mapper.addReading(OccupancyMapper::Sensor::RightIr, voltage);
+  REQUIRE(grid.probability(0.0, -0.43) > 0.5);
+  REQUIRE(grid.probability(0.0, -0.25) < 0.5);
+  REQUIRE(grid.probability(0.0, 0.48) > 0.9);
+  REQUIRE(grid.probability(0.0, 0.3) < 0.2);
+}
@@ -0,0 +1,103 @@
+/*
+ * Copyright (C) 2018 Ola Benderius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cmath>
+
+#include "catch.hpp"
+
+#include "mpc-steering.hpp"
+#include "particle-filter.hpp"
+
+namespace {
+
+char const *BOX = "-2.0,-2.0,-2.0,2.0;\n-2.0,2.0,2.0,2.0;\n2.0,2.0,2.0,-2.0;\n2.0,-2.0,-2.0,-2.0;\n";
+
+// Readings as the simulated sensors would report them at the given pose.
+std::array<double, ParticleFilter::SENSORS> simulateReadings(WallMap const &map, ParticleFilter::Config const &config, VehicleState const &state)
+{
+  std::array<double, ParticleFilter::SENSORS> ranges;
+  for (uint32_t k{0}; k < ParticleFilter::SENSORS; k++) {
+    ParticleFilter::Beam const &beam = config.beams[k];
+    double const x{state.x + beam.x * std::cos(state.yaw) - beam.y * std::sin(state.yaw)};
+    double const y{state.y + beam.x * std::sin(state.yaw) + beam.y * std::cos(state.yaw)};
+    ranges[k] = map.castRay(x, y, state.yaw + beam.yaw, 10.0);
+  }
+  return ranges;
+}
+
+// Drives a left-hand curve through the box and returns the final error.
+ParticleFilter::Estimate track(WallMap const &map, ParticleFilter::Config const &config, VehicleState &state)
+{
+  ParticleFilter filter{map, config};
+  filter.initialize(state.x + 0.2, state.y - 0.2, state.yaw + 0.2, 0.3, 0.3);
+  for (uint32_t tick{0}; tick < 60; tick++) {
+    MpcSteering::predict(state, 0.15f, 0.6f, 0.1, 10);
+    filter.predict(state.longitudinalSpeed, state.lateralSpeed, state.yawRate, 0.1);
+    filter.update(simulateReadings(map, config, state));
+  }
+  return filter.estimate();
+}
+
+}
+
+TEST_CASE("Test particle filter, converges on the pose while driving through the box.") {
+  WallMap map;
+  REQUIRE(map.setSegments(BOX) == 4);
+  ParticleFilter::Config config;
+  config.particles = 500;
+  REQUIRE(ParticleFilter{map, config}.size() == 512);
+
+  VehicleState state;
+  state.x = -1.0;
+  state.y = -0.5;
+  ParticleFilter::Estimate const estimate{track(map, config, state)};
+  REQUIRE(std::hypot(estimate.x - state.x, estimate.y - state.y) < 0.1);
+  REQUIRE(std::fabs(std::remainder(estimate.yaw - state.yaw, 2.0 * M_PI)) < 0.1);
+  REQUIRE(estimate.spread < 0.2);
+}
+
+TEST_CASE("Test particle filter, worker threads give the same estimate as one thread.") {
+  WallMap map;
+  REQUIRE(map.setSegments(BOX) == 4);
+  ParticleFilter::Config config;
+  config.particles = 256;
+  VehicleState single;
+  single.x = -1.0;
+  ParticleFilter::Estimate const expected{track(map, config, single)};
+  config.threads = 3;
+  VehicleState parallel;
+  parallel.x = -1.0;
+  ParticleFilter::Estimate const actual{track(map, config, parallel)};
+  REQUIRE(actual.x == Approx(expected.x));
+  REQUIRE(actual.y == Approx(expected.y));
+  REQUIRE(actual.yaw == Approx(expected.yaw));
+}
+
+TEST_CASE("Test particle filter, missing readings leave the weights alone.") {
+  WallMap map;
+  REQUIRE(map.setSegments(BOX) == 4);
+  ParticleFilter::Config config;
+  ParticleFilter filter{map, config};
+  filter.initialize(0.5, 0.5, 1.0, 0.1, 0.1);
+  ParticleFilter::Estimate const before{filter.estimate()};
+  filter.predict(0.0, 0.0, 0.0, 0.1);
+  filter.update({{-1.0, -1.0, -1.0, -1.0}});
+  ParticleFilter::Estimate const after{filter.estimate()};
+  REQUIRE(after.effectiveParticles == Approx(filter.size()));
+  REQUIRE(after.x == Approx(before.x));
+  REQUIRE(after.yaw == Approx(before.yaw));
+}
@@ -0,0 +1,105 @@
+/*
+ * Copyright (C) 2018 Ola Benderius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <sstream>
+
+#include "catch.hpp"
+
+#include "cluon-complete.hpp"
+#include "opendlv-standard-message-set.hpp"
+#include "test-message-set.hpp"
+
+#include "proto-decoder.hpp"
+
+TEST_CASE("Test proto decoder, KinematicState decodes like FromProtoVisitor.") {
+  opendlv::sim::KinematicState ks;
+  ks.vx(0.5f).vy(-0.25f).vz(0.125f).rollRate(-1.0f).pitchRate(2.0f).yawRate(1.5f);
+  cluon::ToProtoVisitor encoder;
+  ks.accept(encoder);
+
+  opendlv::sim::KinematicState decoded;
+  REQUIRE(decodeProto(encoder.encodedData(), decoded));
+  REQUIRE(decoded.vx() == Approx(0.5f));
+  REQUIRE(decoded.vy() == Approx(-0.25f));
+  REQUIRE(decoded.vz() == Approx(0.125f));
+  REQUIRE(decoded.rollRate() == Approx(-1.0f));
+  REQUIRE(decoded.pitchRate() == Approx(2.0f));
+  REQUIRE(decoded.yawRate() == Approx(1.5f));
+
+  cluon::data::Envelope envelope;
+  envelope.dataType(opendlv::sim::KinematicState::ID()).serializedData(encoder.encodedData());
+  REQUIRE(decodeProto<opendlv::sim::KinematicState>(envelope).yawRate() == Approx(1.5f));
+}
+
+TEST_CASE("Test proto decoder, every scalar type, string and nested message match FromProtoVisitor.") {
+  MyTestMessage1 inner;
+  inner.myValue(4711);
+  MyTestMessage2 message;
+  message.myValue1(true).myValue2(200).myValue3(-7).myValue4(60000).myValue5(-30000)
+    .myValue6(4000000000u).myValue7(-2000000000).myValue8(18000000000000u).myValue9(-9000000000000)
+    .myValue10(3.5f).myValue11(-6.25).myValue12("kiwi").myValue13(inner);
+  cluon::ToProtoVisitor encoder;
+  message.accept(encoder);
+
+  MyTestMessage2 expected;
+  {
+    std::stringstream sstr{encoder.encodedData()};
+    cluon::FromProtoVisitor decoder;
+    decoder.decodeFrom(sstr);
+    expected.accept(decoder);
+  }
+  MyTestMessage2 decoded;
+  decoded.myValue12("a longer string that is replaced");
+  REQUIRE(decodeProto(encoder.encodedData(), decoded));
+
+  REQUIRE(decoded.myValue1() == expected.myValue1());
+  REQUIRE(decoded.myValue2() == expected.myValue2());
+  REQUIRE(decoded.myValue3() == expected.myValue3());
+  REQUIRE(decoded.myValue4() == expected.myValue4());
+  REQUIRE(decoded.myValue5() == expected.myValue5());
+  REQUIRE(decoded.myValue6() == expected.myValue6());
+  REQUIRE(decoded.myValue7() == expected.myValue7());
+  REQUIRE(decoded.myValue8() == expected.myValue8());
+  REQUIRE(decoded.myValue9() == expected.myValue9());
+  REQUIRE(decoded.myValue10() == Approx(expected.myValue10()));
+  REQUIRE(decoded.myValue11() == Approx(expected.myValue11()));
+  REQUIRE(decoded.myValue12() == "kiwi");
+  REQUIRE(decoded.myValue13().myValue() == 4711);
+
+  std::string truncated{encoder.encodedData()};
+  truncated.resize(truncated.size() - 3);
+  REQUIRE_FALSE(decodeProto(truncated, decoded));
+}
+
+TEST_CASE("Test proto decoder, Envelope headers with time stamps decode like FromProtoVisitor.") {
+  cluon::data::Envelope envelope;
+  envelope.dataType(1030).senderStamp(3).serializedData(std::string("\x0d\x00\x00\x80\x3f", 5))
+    .sent(cluon::data::TimeStamp().seconds(1539000000).microseconds(250))
+    .sampleTimeStamp(cluon::data::TimeStamp().seconds(1539000001).microseconds(750));
+  cluon::ToProtoVisitor encoder;
+  envelope.accept(encoder);
+
+  cluon::data::Envelope decoded;
+  REQUIRE(decodeProto(encoder.encodedData(), decoded));
+  REQUIRE(decoded.dataType() == 1030);
+  REQUIRE(decoded.senderStamp() == 3);
+  REQUIRE(decoded.serializedData() == envelope.serializedData());
+  REQUIRE(decoded.sent().seconds() == 1539000000);
+  REQUIRE(decoded.sent().microseconds() == 250);
+  REQUIRE(decoded.sampleTimeStamp().seconds() == 1539000001);
+  REQUIRE(decoded.sampleTimeStamp().microseconds() == 750);
+}
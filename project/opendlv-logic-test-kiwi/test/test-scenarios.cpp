@@ -0,0 +1,227 @@
+/*
+ * Copyright (C) 2018 Ola Benderius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <string>
+
+#include "catch.hpp"
+
+#include "behavior.hpp"
+#include "mpc-steering.hpp"
+#include "single-track-model.hpp"
+#include "wall-map.hpp"
+
+namespace {
+
+// Kiwi's footprint as a circle, as MpcSteering uses it.
+double const VEHICLE_RADIUS{MpcSteering::Config{}.vehicleRadius};
+
+struct Mount {
+  double x;
+  double y;
+  double yaw;
+  // First reading, in microseconds, of a sensor sampling at 10 Hz.
+  int64_t phase;
+};
+
+// Front and rear ultrasonic, left and right IR, mounted as in the
+// docker-compose simulation.
+Mount const MOUNTS[] = {
+  {0.2, 0.0, 0.0, 0},
+  {0.2, 0.0, 3.14, 30000},
+  {0.0, 0.1, 1.57, 50000},
+  {0.0, -0.1, -1.57, 70000}};
+
+// Maps in metres, with Kiwi starting at (0, 0.1) facing along x.
+std::string const ARENA{"-2.0,-2.0,-2.0,2.0;\n-2.0,2.0,2.0,2.0;\n2.0,2.0,2.0,-2.0;\n2.0,-2.0,-2.0,-2.0;\n"};
+std::string const CORRIDOR{"-1.0,0.35,10.0,0.35;\n-1.0,-0.35,10.0,-0.35;\n"};
+std::string const DEAD_END{"-3.0,0.7,2.0,0.7;\n-3.0,-0.7,2.0,-0.7;\n2.0,-0.7,2.0,0.7;\n"};
+std::string const WALL_45{ARENA + "0.0,-1.0,1.5,0.5;\n"};
+
+struct Scenario {
+  std::string map{};
+  double x{0.0};
+  double y{0.1};
+  double yaw{0.0};
+  double seconds{30.0};
+  BehaviorParameters parameters{};
+};
+
+struct Outcome {
+  double closest{1e9};
+  double travelled{0.0};
+  double maxX{-1e9};
+  VehicleState state{};
+  uint32_t reverses{0};
+};
+
+double castRay(WallMap const &map, VehicleState const &state, Mount const &mount, double maxRange)
+{
+  double const cosYaw{std::cos(state.yaw)};
+  double const sinYaw{std::sin(state.yaw)};
+  return map.castRay(state.x + mount.x * cosYaw - mount.y * sinYaw, state.y + mount.x * sinYaw + mount.y * cosYaw,
+      state.yaw + mount.yaw, maxRange);
+}
+
+// The ADC voltage at which Behavior::convertIrVoltageToDistance() gives
+// the distance, by bisection over the range where it is decreasing; 0 V
+// beyond the range of the sensor.
+float irVoltage(double distance)
+{
+  float low{0.0f};
+  float high{0.9135f};
+  if (distance * 100.0 >= Behavior::convertIrVoltageToDistance(low)) {
+    return low;
+  }
+  for (uint32_t i{0}; i < 32; i++) {
+    float const middle{0.5f * (low + high)};
+    if (Behavior::convertIrVoltageToDistance(middle) > distance * 100.0) {
+      low = middle;
+    } else {
+      high = middle;
+    }
+  }
+  return 0.5f * (low + high);
+}
+
+// Runs Behavior in closed loop on a virtual clock with 1 ms resolution: the
+// motor model at 70 Hz, every sensor and the control loop at 10 Hz, as in
+// the docker-compose simulation.
+Outcome drive(Scenario const &scenario)
+{
+  WallMap map;
+  REQUIRE(0 < map.setSegments(scenario.map));
+  Behavior behavior;
+  SingleTrackModel model;
+  Outcome outcome;
+  VehicleState &state = outcome.state;
+  state.x = scenario.x;
+  state.y = scenario.y;
+  state.yaw = scenario.yaw;
+
+  int64_t const end{static_cast<int64_t>(scenario.seconds * 1e6)};
+  int64_t const modelPeriod{1000000 / 70};
+  int64_t nextModel{0};
+  int64_t nextSensor[] = {MOUNTS[0].phase, MOUNTS[1].phase, MOUNTS[2].phase, MOUNTS[3].phase};
+  int64_t nextControl{90000};
+  for (int64_t time{0}; time < end; time += 1000) {
+    if (time >= nextModel) {
+      double const dt{static_cast<double>(modelPeriod) * 1e-6};
+      opendlv::sim::KinematicState const kinematicState{model.step(dt)};
+      state.longitudinalSpeed = kinematicState.vx();
+      state.lateralSpeed = kinematicState.vy();
+      state.yawRate = kinematicState.yawRate();
+      integratePose(state, dt);
+      outcome.travelled += std::hypot(state.longitudinalSpeed, state.lateralSpeed) * dt;
+      outcome.closest = std::min(outcome.closest, map.clearance(state.x, state.y));
+      outcome.maxX = std::max(outcome.maxX, state.x);
+      nextModel += modelPeriod;
+    }
+    for (uint32_t sensor{0}; sensor < 4; sensor++) {
+      if (time < nextSensor[sensor]) {
+        continue;
+      }
+      if (sensor < 2) {
+        opendlv::proxy::DistanceReading reading;
+        reading.distance(static_cast<float>(castRay(map, state, MOUNTS[sensor], 3.0)));
+        (0 == sensor) ? behavior.setFrontUltrasonic(reading, time) : behavior.setRearUltrasonic(reading, time);
+      } else {
+        opendlv::proxy::VoltageReading reading;
+        reading.voltage(irVoltage(castRay(map, state, MOUNTS[sensor], 1.0)));
+        (2 == sensor) ? behavior.setLeftIr(reading, time) : behavior.setRightIr(reading, time);
+      }
+      nextSensor[sensor] += 100000;
+    }
+    if (time >= nextControl) {
+      behavior.step(scenario.parameters, 10.0f, time);
+      model.setGroundSteeringAngle(behavior.getGroundSteeringAngle());
+      model.setPedalPosition(behavior.getPedalPositionRequest());
+      nextControl += 100000;
+    }
+  }
+  for (auto const &record : behavior.getDriveTransitions()) {
+    outcome.reverses += (DriveStateMachine::Mode::Reverse == record.to) ? 1 : 0;
+  }
+  return outcome;
+}
+
+Outcome drive(std::string const &map, float centering)
+{
+  Scenario scenario;
+  scenario.map = map;
+  scenario.parameters.centering = centering;
+  return drive(scenario);
+}
+
+}
+
+TEST_CASE("Test scenarios, Kiwi roams an empty arena without hitting a wall.") {
+  for (float const centering : {0.0f, 1.0f}) {
+    Outcome const outcome{drive(ARENA, centering)};
+    REQUIRE(outcome.closest > VEHICLE_RADIUS);
+    REQUIRE(outcome.travelled > 10.0);
+    REQUIRE(outcome.reverses >= 1);
+  }
+}
+
+TEST_CASE("Test scenarios, Kiwi drives down a corridor.") {
+  // The PID centering keeps to the middle and drives the full length
+  // without backing up.
+  Outcome const pid{drive(CORRIDOR, 1.0f)};
+  REQUIRE(pid.closest > VEHICLE_RADIUS);
+  REQUIRE(pid.maxX > 10.0);
+  REQUIRE(0 == pid.reverses);
+
+  // The legacy P steering weaves and backs off the walls, but still makes
+  // progress without touching them.
+  Outcome const legacy{drive(CORRIDOR, 0.0f)};
+  REQUIRE(legacy.closest > VEHICLE_RADIUS);
+  REQUIRE(legacy.maxX > 3.5);
+}
+
+TEST_CASE("Test scenarios, Kiwi backs out of a dead end.") {
+  for (float const centering : {0.0f, 1.0f}) {
+    Outcome const outcome{drive(DEAD_END, centering)};
+    REQUIRE(outcome.closest > VEHICLE_RADIUS);
+    REQUIRE(outcome.maxX < 2.0 - VEHICLE_RADIUS);
+    REQUIRE(outcome.reverses >= 1);
+    REQUIRE(outcome.travelled > 5.0);
+  }
+}
+
+TEST_CASE("Test scenarios, Kiwi turns away from a wall at 45 degrees.") {
+  for (float const centering : {0.0f, 1.0f}) {
+    Outcome const outcome{drive(WALL_45, centering)};
+    REQUIRE(outcome.closest > VEHICLE_RADIUS);
+    REQUIRE(outcome.travelled > 10.0);
+    REQUIRE(outcome.reverses >= 1);
+  }
+}
+
+// Wall-clock bound, hidden from the default run since slow or emulated
+// builds miss it; run with the [timing] tag.
+TEST_CASE("Test scenarios, the whole suite runs in under a second.", "[.][timing]") {
+  auto const start = std::chrono::steady_clock::now();
+  for (auto const &map : {ARENA, CORRIDOR, DEAD_END, WALL_45}) {
+    for (float const centering : {0.0f, 1.0f}) {
+      drive(map, centering);
+    }
+  }
+  REQUIRE(std::chrono::steady_clock::now() - start < std::chrono::seconds(1));
+}
@@ -0,0 +1,162 @@
+/*
+ * Copyright (C) 2018 Ola Benderius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include "catch.hpp"
+
+#include "behavior.hpp"
+#include "sensor-filter.hpp"
+
+namespace {
+
+// A free corridor with a front glitch every 5 s, alternating between
+// single short samples and bursts of two, at one sample per 10 Hz tick.
+std::vector<float> glitchyCorridor()
+{
+  std::vector<float> trace;
+  for (uint32_t i{0}; i < 500; i++) {
+    uint32_t const phase{i % 50};
+    bool const glitch{25 == phase || (26 == phase && 1 == (i / 50) % 2)};
+    trace.push_back(glitch ? 0.05f : 1.0f + 0.01f * std::sin(1.3f * static_cast<float>(i)));
+  }
+  return trace;
+}
+
+// Closing in on a wall at 0.2 m/s.
+std::vector<float> approachingWall()
+{
+  std::vector<float> trace;
+  for (uint32_t i{0}; i < 50; i++) {
+    trace.push_back(1.0f - 0.02f * static_cast<float>(i) + 0.01f * std::sin(1.3f * static_cast<float>(i)));
+  }
+  return trace;
+}
+
+// Replays front distances through Behavior and returns the tick of every
+// switch into reversing.
+std::vector<uint32_t> replay(std::string const &filter, std::vector<float> const &front)
+{
+  SensorFilter::Config ultrasonic;
+  REQUIRE(SensorFilter::parse(filter, ultrasonic) >= 0);
+  Behavior behavior;
+  behavior.setFilters(ultrasonic, SensorFilter::Config{});
+
+  opendlv::proxy::DistanceReading distance;
+  opendlv::proxy::VoltageReading voltage;
+  voltage.voltage(0.5f);
+  behavior.setLeftIr(voltage);
+  behavior.setRightIr(voltage);
+  distance.distance(1.0f);
+  behavior.setRearUltrasonic(distance);
+
+  auto const step{[&behavior]() {
+      behavior.step(0.5f, 0.2f, 0.1f, 0.0f, 0.0f, 1.0f, 0.05f, 0.0f, 0.0f, 0.5f, 10.0f, 0.0f,
+          0.0f, 0.0f, 0.0f, 1.0f, 0.0f);
+      return behavior.getPedalPositionRequest().position() < 0.0f;
+    }};
+  std::vector<uint32_t> reverses;
+  bool reversing{false};
+  for (uint32_t i{0}; i < front.size(); i++) {
+    distance.distance(front[i]);
+    behavior.setFrontUltrasonic(distance);
+    bool const reversingNow{step()};
+    if (reversingNow && !reversing) {
+      reverses.push_back(i);
+    }
+    reversing = reversingNow;
+  }
+  return reverses;
+}
+
+}
+
+TEST_CASE("Test sensor filter, pipelines are parsed and malformed ones rejected.") {
+  SensorFilter::Config config;
+  REQUIRE(SensorFilter::parse("median:5,ema:0.5,kalman:0.01:0.02", config) == 3);
+  REQUIRE(config.medianWindow == 5);
+  REQUIRE(config.smoothing == Approx(0.5f));
+  REQUIRE(config.kalman);
+  REQUIRE(config.processNoise == Approx(0.01f));
+  REQUIRE(config.measurementNoise == Approx(0.02f));
+
+  REQUIRE(SensorFilter::parse("median:16", config) == -1);
+  REQUIRE(SensorFilter::parse("ema:0", config) == -1);
+  REQUIRE(SensorFilter::parse("kalman:0.01", config) == -1);
+  REQUIRE(SensorFilter::parse("mean:3", config) == -1);
+  REQUIRE(config.medianWindow == 5);
+  REQUIRE(SensorFilter::parse("", config) == 0);
+  REQUIRE(config.medianWindow == 1);
+  REQUIRE_FALSE(config.kalman);
+}
+
+TEST_CASE("Test sensor filter, the median follows a sliding window.") {
+  SensorFilter filter;
+  SensorFilter::Config config;
+  config.medianWindow = 5;
+  filter.setConfig(config);
+  float const samples[] = {3.0f, 1.0f, 4.0f, 1.0f, 5.0f, 9.0f, 2.0f, 6.0f, 5.0f, 3.0f};
+  float const medians[] = {3.0f, 3.0f, 3.0f, 3.0f, 3.0f, 4.0f, 4.0f, 5.0f, 5.0f, 5.0f};
+  for (uint32_t i{0}; i < 10; i++) {
+    REQUIRE(filter.update(samples[i]) == Approx(medians[i]));
+  }
+  REQUIRE(filter.update(NAN) == Approx(5.0f));
+}
+
+TEST_CASE("Test sensor filter, the Kalman gate drops glitches but follows real changes.") {
+  SensorFilter filter;
+  SensorFilter::Config config;
+  config.kalman = true;
+  filter.setConfig(config);
+  for (uint32_t i{0}; i < 20; i++) {
+    filter.update(1.0f);
+  }
+  REQUIRE(filter.update(0.05f) == Approx(1.0f));
+  REQUIRE(filter.rejectedSamples() == 1);
+  REQUIRE(filter.update(1.0f) == Approx(1.0f));
+
+  // A wall appearing around a corner gets through after maxRejected
+  // samples outside the gate.
+  for (uint32_t i{0}; i < config.maxRejected; i++) {
+    REQUIRE(filter.update(0.3f) == Approx(1.0f));
+  }
+  REQUIRE(filter.update(0.3f) == Approx(0.3f));
+}
+
+TEST_CASE("Test sensor filter, replayed front glitches cause no reverses once filtered.") {
+  std::vector<float> const trace{glitchyCorridor()};
+  REQUIRE(replay("none", trace).size() == 10);
+  REQUIRE(replay("median:3", trace).size() == 5);
+  REQUIRE(replay("median:5", trace).empty());
+  REQUIRE(replay("ema:0.3", trace).empty());
+  REQUIRE(replay("kalman", trace).empty());
+  REQUIRE(replay("median:3,kalman", trace).empty());
+}
+
+TEST_CASE("Test sensor filter, a real wall still makes Kiwi reverse in time.") {
+  std::vector<float> const trace{approachingWall()};
+  std::vector<uint32_t> const raw{replay("none", trace)};
+  REQUIRE_FALSE(raw.empty());
+  for (std::string const filter : {"median:5", "ema:0.3", "kalman", "median:3,kalman"}) {
+    INFO(filter);
+    std::vector<uint32_t> const filtered{replay(filter, trace)};
+    REQUIRE_FALSE(filtered.empty());
+    REQUIRE(filtered.front() <= raw.front() + 3);
+  }
+}
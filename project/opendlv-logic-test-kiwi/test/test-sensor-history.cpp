@@ -0,0 +1,222 @@
+/*
+ * Copyright (C) 2018 Ola Benderius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "catch.hpp"
+
+#include "cluon-complete.hpp"
+#include "opendlv-standard-message-set.hpp"
+
+#include "behavior.hpp"
+#include "sensor-history.hpp"
+
+namespace {
+
+cluon::data::TimeStamp timeStamp(int64_t microseconds)
+{
+  cluon::data::TimeStamp stamp;
+  stamp.seconds(static_cast<int32_t>(microseconds / 1000000)).microseconds(static_cast<int32_t>(microseconds % 1000000));
+  return stamp;
+}
+
+template <typename T>
+void record(std::string &recording, T &message, uint32_t senderStamp, int64_t sampleTime)
+{
+  cluon::ToProtoVisitor encoder;
+  message.accept(encoder);
+  cluon::data::Envelope envelope;
+  envelope.dataType(T::ID()).senderStamp(senderStamp).sampleTimeStamp(timeStamp(sampleTime)).serializedData(encoder.encodedData());
+  recording += cluon::serializeEnvelope(std::move(envelope));
+}
+
+/*
+ * A recording of Kiwi driving at a wall at 0.5 m/s, in the .rec layout of
+ * concatenated envelopes: the front sensor at 10 Hz with a 30 ms phase,
+ * the rear one at 7 Hz and both IR sensors at 10 Hz with a 70 ms phase.
+ * The left IR sensor is silent between silentFrom and silentTo seconds.
+ */
+std::string recordApproach(double silentFrom, double silentTo)
+{
+  struct Event {
+    int64_t time;
+    uint32_t sensor;
+  };
+  std::vector<Event> events;
+  for (int64_t i{0}; i < 40; i++) {
+    events.push_back({i * 100000 + 30000, 0});
+    events.push_back({i * 100000 + 70000, 2});
+    events.push_back({i * 100000 + 70000, 3});
+  }
+  for (int64_t i{0}; i < 28; i++) {
+    events.push_back({i * 142857, 1});
+  }
+  std::stable_sort(events.begin(), events.end(), [](Event const &a, Event const &b) { return a.time < b.time; });
+
+  std::string recording;
+  for (Event const &event : events) {
+    double const t{static_cast<double>(event.time) * 1e-6};
+    if (event.sensor < 2) {
+      opendlv::proxy::DistanceReading reading;
+      reading.distance(static_cast<float>((0 == event.sensor) ? 1.5 - 0.5 * t : 1.0));
+      record(recording, reading, event.sensor, event.time);
+    } else if (3 == event.sensor || t < silentFrom || t >= silentTo) {
+      opendlv::proxy::VoltageReading reading;
+      reading.voltage(0.5f);
+      record(recording, reading, event.sensor - 2, event.time);
+    }
+  }
+  return recording;
+}
+
+struct Tick {
+  int64_t time;
+  float pedal;
+  bool safeMode;
+};
+
+// Replays the recording as the microservice would receive it, stepping
+// Behavior at 10 Hz on the tick boundaries.
+std::vector<Tick> replay(std::string const &recording, bool aligned)
+{
+  BehaviorParameters parameters;
+  parameters.front = 0.22f;
+  parameters.rear = 0.1f;
+  Behavior behavior;
+  std::vector<Tick> ticks;
+  int64_t nextTick{100000};
+  auto const step{[&]() {
+      if (aligned) {
+        behavior.step(parameters, 10.0f, nextTick);
+      } else {
+        behavior.step(parameters, 10.0f);
+      }
+      ticks.push_back({nextTick, behavior.getPedalPositionRequest().position(), behavior.isInSafeMode()});
+      nextTick += 100000;
+    }};
+
+  std::stringstream sstr{recording};
+  while (sstr.peek() != EOF) {
+    auto entry = cluon::extractEnvelope(sstr);
+    REQUIRE(entry.first);
+    cluon::data::Envelope const &envelope = entry.second;
+    int64_t const sampleTime{static_cast<int64_t>(envelope.sampleTimeStamp().seconds()) * 1000000 + envelope.sampleTimeStamp().microseconds()};
+    while (sampleTime > nextTick) {
+      step();
+    }
+    std::stringstream payload{envelope.serializedData()};
+    cluon::FromProtoVisitor decoder;
+    decoder.decodeFrom(payload);
+    if (opendlv::proxy::DistanceReading::ID() == envelope.dataType()) {
+      opendlv::proxy::DistanceReading reading;
+      reading.accept(decoder);
+      if (0 == envelope.senderStamp()) {
+        behavior.setFrontUltrasonic(reading, sampleTime);
+      } else {
+        behavior.setRearUltrasonic(reading, sampleTime);
+      }
+    } else {
+      opendlv::proxy::VoltageReading reading;
+      reading.accept(decoder);
+      if (0 == envelope.senderStamp()) {
+        behavior.setLeftIr(reading, sampleTime);
+      } else {
+        behavior.setRightIr(reading, sampleTime);
+      }
+    }
+  }
+  return ticks;
+}
+
+int64_t firstReverse(std::vector<Tick> const &ticks)
+{
+  for (Tick const &tick : ticks) {
+    if (tick.pedal < 0.0f) {
+      return tick.time;
+    }
+  }
+  return -1;
+}
+
+}
+
+TEST_CASE("Test sensor history, readings are interpolated between and extrapolated past samples.") {
+  SensorHistory history;
+  REQUIRE_FALSE(history.at(0, 0).valid);
+  REQUIRE(history.add(1000, 1.0f));
+  REQUIRE(history.add(2000, 2.0f));
+  REQUIRE(history.add(4000, 0.0f));
+  REQUIRE_FALSE(history.add(3000, 5.0f));
+  REQUIRE(history.size() == 3);
+
+  REQUIRE(history.at(1500, 0).value == Approx(1.5f));
+  REQUIRE(history.at(3000, 0).value == Approx(1.0f));
+  REQUIRE(history.at(2000, 0).value == Approx(2.0f));
+  REQUIRE(history.at(500, 0).value == Approx(1.0f));
+  REQUIRE(history.at(3000, 0).age == -1000);
+
+  // Extrapolated along the last slope, for at most 1000 us.
+  SensorHistory::Sample const ahead{history.at(4500, 1000)};
+  REQUIRE(ahead.valid);
+  REQUIRE(ahead.age == 500);
+  REQUIRE(ahead.value == Approx(-0.5f));
+  REQUIRE(history.at(9000, 1000).value == Approx(-1.0f));
+}
+
+TEST_CASE("Test sensor history, the ring keeps the newest samples.") {
+  SensorHistory history;
+  for (int64_t i{0}; i < 100; i++) {
+    REQUIRE(history.add(i * 10, static_cast<float>(i)));
+  }
+  REQUIRE(history.size() == SensorHistory::CAPACITY);
+  REQUIRE(history.newestTime() == 990);
+  REQUIRE(history.at(985, 0).value == Approx(98.5f));
+  REQUIRE(history.at(0, 0).value == Approx(100.0f - SensorHistory::CAPACITY));
+  for (int64_t t{(100 - SensorHistory::CAPACITY) * 10}; t < 990; t += 7) {
+    REQUIRE(history.at(t, 0).value == Approx(static_cast<float>(t) / 10.0f));
+  }
+}
+
+TEST_CASE("Test sensor history, aligned readings react to a recorded wall one tick earlier.") {
+  std::string const recording{recordApproach(10.0, 10.0)};
+  std::vector<Tick> const aligned{replay(recording, true)};
+  std::vector<Tick> const latest{replay(recording, false)};
+  // The true distance falls below 0.22 m at 2.56 s. At the 2.6 s tick the
+  // newest front reading is from 2.53 s and still 0.235 m.
+  REQUIRE(firstReverse(aligned) == 2600000);
+  REQUIRE(firstReverse(latest) == 2700000);
+  for (Tick const &tick : aligned) {
+    REQUIRE_FALSE(tick.safeMode);
+  }
+}
+
+TEST_CASE("Test sensor history, a silent sensor stops Kiwi until it is back.") {
+  std::vector<Tick> const ticks{replay(recordApproach(0.8, 1.6), true)};
+  for (Tick const &tick : ticks) {
+    INFO(tick.time);
+    // The last left reading before the gap is from 0.77 s, the first after
+    // it from 1.67 s.
+    bool const stale{tick.time > 1270000 && tick.time < 1670000};
+    REQUIRE(tick.safeMode == stale);
+    if (stale) {
+      REQUIRE(tick.pedal == Approx(0.0f));
+    }
+  }
+}
@@ -0,0 +1,179 @@
+/*
+ * Copyright (C) 2018 Ola Benderius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <vector>
+
+#include "catch.hpp"
+
+#include "behavior.hpp"
+#include "stream-watchdog.hpp"
+
+namespace {
+
+using Status = StreamWatchdog::Status;
+
+void setReadings(Behavior &behavior, float front, float rear, int64_t time)
+{
+  opendlv::proxy::DistanceReading distance;
+  distance.distance(front);
+  behavior.setFrontUltrasonic(distance, time);
+  distance.distance(rear);
+  behavior.setRearUltrasonic(distance, time);
+  opendlv::proxy::VoltageReading voltage;
+  voltage.voltage(0.2f);
+  behavior.setLeftIr(voltage, time);
+  behavior.setRightIr(voltage, time);
+}
+
+}
+
+TEST_CASE("Test stream watchdog, a stall is found within one control period.") {
+  StreamWatchdog watchdog{StreamWatchdog::Config{}};
+  REQUIRE(0 == watchdog.addStream("front", 10.0f));
+  REQUIRE(1 == watchdog.addStream("rear", 10.0f));
+  std::vector<StreamWatchdog::Change> changes;
+
+  // Both at 10 Hz until the front one stops after 1 s; the control loop
+  // runs at 10 Hz with a 50 ms phase.
+  int64_t stalledAt{0};
+  for (int64_t time{0}; time <= 2900000; time += 10000) {
+    if (0 == time % 100000) {
+      if (time <= 1000000) {
+        watchdog.heartbeat(0, time);
+      }
+      watchdog.heartbeat(1, time);
+    }
+    if (50000 == time % 100000) {
+      changes.clear();
+      watchdog.advance(time, changes);
+      for (auto const &change : changes) {
+        REQUIRE(0 == change.stream);
+        REQUIRE(change.from == Status::Alive);
+        REQUIRE(change.to == Status::Stalled);
+        stalledAt = time;
+      }
+    }
+  }
+  // Due 2.5 periods after the last message, at 1.25 s.
+  REQUIRE(stalledAt >= 1250000);
+  REQUIRE(stalledAt <= 1350000);
+  REQUIRE(watchdog.status(0) == Status::Stalled);
+  REQUIRE(watchdog.status(1) == Status::Alive);
+  REQUIRE(watchdog.rate(1) == Approx(10.0f).epsilon(0.15));
+  REQUIRE(watchdog.rate(0) == Approx(0.0f));
+
+  // Back with its first message.
+  watchdog.heartbeat(0, 2910000);
+  changes.clear();
+  REQUIRE(1 == watchdog.advance(2950000, changes));
+  REQUIRE(changes[0].from == Status::Stalled);
+  REQUIRE(changes[0].to == Status::Alive);
+}
+
+TEST_CASE("Test stream watchdog, streams below their expected rate are slow.") {
+  StreamWatchdog::Config config;
+  config.stallPeriods = 4.0f;
+  StreamWatchdog watchdog{config};
+  REQUIRE(0 == watchdog.addStream("ir", 10.0f));
+  REQUIRE(-1 == watchdog.addStream("off", 0.0f));
+  std::vector<StreamWatchdog::Change> changes;
+
+  // 4 Hz is too slow, but never quiet long enough to stall.
+  for (int64_t time{0}; time <= 2000000; time += 10000) {
+    if (0 == time % 250000) {
+      watchdog.heartbeat(0, time);
+    }
+    watchdog.advance(time, changes);
+  }
+  REQUIRE(1 == changes.size());
+  REQUIRE(changes[0].to == Status::Slow);
+  REQUIRE(watchdog.rate(0) == Approx(4.0f).epsilon(0.3));
+  REQUIRE(-1 == watchdog.addStream("late", 10.0f));
+}
+
+TEST_CASE("Test stream watchdog, silent streams and long gaps between calls.") {
+  StreamWatchdog::Config config;
+  config.rateWindow = 100000000;
+  StreamWatchdog watchdog{config};
+  REQUIRE(0 == watchdog.addStream("never", 10.0f));
+  REQUIRE(1 == watchdog.addStream("slow", 0.1f));
+  std::vector<StreamWatchdog::Change> changes;
+
+  // Nothing is due before the timeout counted from the first call.
+  watchdog.advance(5000000, changes);
+  watchdog.advance(5200000, changes);
+  REQUIRE(changes.empty());
+  watchdog.advance(5260000, changes);
+  REQUIRE(1 == changes.size());
+  REQUIRE(0 == changes[0].stream);
+
+  // A 25 s timeout is further out than one revolution of the wheel, and a
+  // call may skip more than one revolution.
+  watchdog.heartbeat(1, 10000000);
+  changes.clear();
+  watchdog.advance(34000000, changes);
+  REQUIRE(watchdog.status(1) == Status::Alive);
+  watchdog.advance(35010000, changes);
+  REQUIRE(watchdog.status(1) == Status::Stalled);
+  REQUIRE(changes.back().silence == 25010000);
+}
+
+TEST_CASE("Test behavior, degraded modes while a sensor is stalled.") {
+  BehaviorParameters parameters;
+  Behavior behavior;
+  setReadings(behavior, 1.0f, 1.0f, 0);
+  behavior.step(parameters, 10.0f, 50000);
+  REQUIRE_FALSE(behavior.isInSafeMode());
+  REQUIRE(behavior.getPedalPositionRequest().position() == Approx(parameters.speed));
+
+  behavior.setStalledSensors(Behavior::FRONT_ULTRASONIC);
+  behavior.step(parameters, 10.0f, 50000);
+  REQUIRE(behavior.isInSafeMode());
+  REQUIRE(behavior.getStalledSensors() == Behavior::FRONT_ULTRASONIC);
+  REQUIRE(behavior.getPedalPositionRequest().position() == Approx(0.0f));
+  REQUIRE(behavior.getGroundSteeringAngle().groundSteering() == Approx(0.0f));
+
+  behavior.setDegradedMode(Behavior::DegradedMode::Creep);
+  behavior.step(parameters, 10.0f, 50000);
+  REQUIRE(behavior.getPedalPositionRequest().position() == Approx(parameters.creepSpeed));
+
+  // Backs away until the rear sensor sees something, unless that one is
+  // gone as well.
+  behavior.setDegradedMode(Behavior::DegradedMode::RearOnly);
+  behavior.step(parameters, 10.0f, 50000);
+  REQUIRE(behavior.getPedalPositionRequest().position() == Approx(-parameters.creepSpeed));
+  setReadings(behavior, 1.0f, 0.3f, 100000);
+  behavior.step(parameters, 10.0f, 150000);
+  REQUIRE(behavior.getPedalPositionRequest().position() == Approx(0.0f));
+  behavior.setStalledSensors(Behavior::FRONT_ULTRASONIC | Behavior::REAR_ULTRASONIC);
+  setReadings(behavior, 1.0f, 1.0f, 200000);
+  behavior.step(parameters, 10.0f, 250000);
+  REQUIRE(behavior.getPedalPositionRequest().position() == Approx(0.0f));
+
+  // Sensors that are merely old count as stalled too.
+  behavior.setStalledSensors(0);
+  behavior.step(parameters, 10.0f, 250000);
+  REQUIRE_FALSE(behavior.isInSafeMode());
+  behavior.step(parameters, 10.0f, 900000);
+  REQUIRE(behavior.getStalledSensors() == (Behavior::FRONT_ULTRASONIC | Behavior::REAR_ULTRASONIC | Behavior::LEFT_IR | Behavior::RIGHT_IR));
+
+  Behavior::DegradedMode mode{Behavior::DegradedMode::Stop};
+  REQUIRE(0 == Behavior::parseDegradedMode("rear-only", mode));
+  REQUIRE(mode == Behavior::DegradedMode::RearOnly);
+  REQUIRE(-1 == Behavior::parseDegradedMode("crawl", mode));
+  REQUIRE(mode == Behavior::DegradedMode::RearOnly);
+}
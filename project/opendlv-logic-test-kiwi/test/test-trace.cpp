@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) 2018 Ola Benderius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include "catch.hpp"
+
+#include "trace.hpp"
+
+TEST_CASE("Test trace, scopes are recorded only while the tracer is enabled.") {
+  Tracer &tracer = Tracer::instance();
+  tracer.clear();
+  {
+    TraceScope scope{"disabled"};
+  }
+  REQUIRE(tracer.recorded() == 0);
+
+  tracer.setEnabled(true);
+  {
+    TraceScope scope{"outer"};
+    TraceScope inner{"inner \"quoted\""};
+  }
+  tracer.instant("mark");
+  {
+    TRACE_SCOPE("macro");
+  }
+  tracer.setEnabled(false);
+#ifdef ENABLE_TRACING
+  REQUIRE(tracer.recorded() == 4);
+#else
+  REQUIRE(tracer.recorded() == 3);
+#endif
+
+  std::ostringstream out;
+  tracer.writeTrace(out);
+  std::string const json{out.str()};
+  REQUIRE(json.find("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[") == 0);
+  REQUIRE(json.find("\"name\":\"thread_name\",\"ph\":\"M\"") != std::string::npos);
+  REQUIRE(json.find("\"name\":\"outer\",\"ph\":\"X\",\"ts\":") != std::string::npos);
+  REQUIRE(json.find("\"name\":\"inner \\\"quoted\\\"\",\"ph\":\"X\"") != std::string::npos);
+  REQUIRE(json.find("\"name\":\"mark\",\"ph\":\"i\",\"s\":\"t\"") != std::string::npos);
+  REQUIRE(json.rfind("]}\n") == json.size() - 3);
+  tracer.clear();
+}
+
+TEST_CASE("Test trace, every thread keeps the newest events in its own ring.") {
+  Tracer &tracer = Tracer::instance();
+  tracer.clear();
+  tracer.setEnabled(true);
+  std::thread first{[&tracer]() {
+      for (uint32_t i{0}; i < Tracer::RING_SIZE + 10; i++) {
+        TraceScope scope{"first"};
+      }
+    }};
+  first.join();
+  std::thread second{[&tracer]() {
+      for (uint32_t i{0}; i < 10; i++) {
+        TraceScope scope{"second"};
+      }
+    }};
+  second.join();
+  tracer.setEnabled(false);
+  REQUIRE(tracer.recorded() == Tracer::RING_SIZE + 10);
+  tracer.clear();
+}
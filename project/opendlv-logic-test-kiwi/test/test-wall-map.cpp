@@ -0,0 +1,58 @@
+/*
+ * Copyright (C) 2018 Ola Benderius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "catch.hpp"
+
+#include "wall-map.hpp"
+
+namespace {
+
+char const *BOX = "-2.0,-2.0,-2.0,2.0;\n-2.0,2.0,2.0,2.0;\n2.0,2.0,2.0,-2.0;\n2.0,-2.0,-2.0,-2.0;\n";
+
+}
+
+TEST_CASE("Test wall map, map files are parsed and malformed ones rejected.") {
+  WallMap map;
+  REQUIRE(map.setSegments(BOX) == 4);
+  REQUIRE(map.size() == 4);
+  REQUIRE(map.startX()[1] == Approx(-2.0));
+  REQUIRE(map.directionX()[1] == Approx(4.0));
+  REQUIRE(map.directionY()[1] == Approx(0.0));
+
+  REQUIRE(map.setSegments("0.0,0.0,1.0;") == -1);
+  REQUIRE(map.size() == 4);
+  REQUIRE(map.setSegments("") == 0);
+  REQUIRE(map.size() == 0);
+}
+
+TEST_CASE("Test wall map, rays stop at the nearest wall.") {
+  WallMap map;
+  REQUIRE(map.setSegments(BOX) == 4);
+  REQUIRE(map.castRay(0.0, 0.0, 0.0, 10.0) == Approx(2.0));
+  REQUIRE(map.castRay(1.0, 0.0, M_PI, 10.0) == Approx(3.0));
+  REQUIRE(map.castRay(0.0, 0.0, 0.25 * M_PI, 10.0) == Approx(2.0 * std::sqrt(2.0)));
+  REQUIRE(map.castRay(0.0, 0.0, 0.5 * M_PI, 1.5) == Approx(1.5));
+  REQUIRE(map.castRay(3.0, 0.0, 0.0, 10.0) == Approx(10.0));
+}
+
+TEST_CASE("Test wall map, clearance is the distance to the closest point of any wall.") {
+  WallMap map;
+  REQUIRE(map.setSegments("0.0,0.0,1.0,0.0;") == 1);
+  REQUIRE(map.clearance(0.5, 0.3) == Approx(0.3));
+  REQUIRE(map.clearance(2.0, 0.0) == Approx(1.0));
+  REQUIRE(map.clearance(-3.0, 4.0) == Approx(5.0));
+}
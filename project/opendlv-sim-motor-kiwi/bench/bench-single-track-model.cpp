@@ -0,0 +1,206 @@
+/*
+ * Copyright (C) 2018 Ola Benderius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include "cluon-complete.hpp"
+#include "opendlv-standard-message-set.hpp"
+#include "fleet.hpp"
+#include "message-bus.hpp"
+#include "reactor.hpp"
+#include "single-track-model.hpp"
+#include "bench.hpp"
+
+namespace {
+
+double const DT{0.01};
+
+template <typename T>
+void encode(BenchmarkState &state, T message)
+{
+  std::size_t bytes{0};
+  while (state.keepRunning()) {
+    cluon::ToProtoVisitor encoder;
+    message.accept(encoder);
+    bytes += encoder.encodedData().size();
+  }
+  doNotOptimize(bytes);
+  state.setItemsProcessed(state.iterations());
+}
+
+template <typename T>
+void decode(BenchmarkState &state, T message)
+{
+  cluon::ToProtoVisitor encoder;
+  message.accept(encoder);
+  std::string const payload{encoder.encodedData()};
+  while (state.keepRunning()) {
+    std::stringstream sstr{payload};
+    cluon::FromProtoVisitor decoder;
+    decoder.decodeFrom(sstr);
+    T decoded;
+    decoded.accept(decoder);
+    doNotOptimize(decoded);
+  }
+  state.setItemsProcessed(state.iterations());
+}
+
+opendlv::sim::KinematicState kinematicState()
+{
+  opendlv::sim::KinematicState message;
+  message.vx(0.5f).vy(-0.25f).vz(0.0f).rollRate(0.0f).pitchRate(0.0f).yawRate(1.5f);
+  return message;
+}
+
+// Sends a PedalPositionRequest and waits for the KinematicState the
+// echoing peer answers with, over multicast loopback.
+template <typename Session>
+void roundTrip(BenchmarkState &state, Session &client, std::atomic<uint64_t> &answered)
+{
+  opendlv::proxy::PedalPositionRequest request;
+  request.position(0.1f);
+  uint64_t lost{0};
+  while (state.keepRunning()) {
+    uint64_t const expected{answered.load() + 1};
+    client.send(request);
+    auto const deadline = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+    while (answered.load() < expected) {
+      if (std::chrono::steady_clock::now() > deadline) {
+        lost++;
+        break;
+      }
+      std::this_thread::yield();
+    }
+  }
+  state.setItemsProcessed(state.iterations());
+  state.setCounter("lost", static_cast<double>(lost));
+}
+
+}
+
+BENCHMARK_CASE("SingleTrackModel/step")
+{
+  SingleTrackModel model;
+  opendlv::proxy::GroundSteeringRequest steering;
+  steering.groundSteering(0.2f);
+  model.setGroundSteeringAngle(steering);
+  opendlv::proxy::PedalPositionRequest pedal;
+  pedal.position(0.12f);
+  model.setPedalPosition(pedal);
+  float yawRate{0.0f};
+  while (state.keepRunning()) {
+    yawRate += model.step(DT).yawRate();
+  }
+  doNotOptimize(yawRate);
+  state.setItemsProcessed(state.iterations());
+}
+
+BENCHMARK_CASE("SingleTrackModel/integrate")
+{
+  double longitudinalSpeed{0.0};
+  double lateralSpeed{0.0};
+  double yawRate{0.0};
+  while (state.keepRunning()) {
+    SingleTrackModel::integrate(longitudinalSpeed, lateralSpeed, yawRate, 0.2f, 0.12f, DT);
+  }
+  doNotOptimize(yawRate);
+  state.setItemsProcessed(state.iterations());
+}
+
+BENCHMARK_CASE("Fleet/step 50 vehicles")
+{
+  Fleet fleet{Fleet::parseFrameIds("0-49")};
+  for (uint32_t frameId : fleet.frameIds()) {
+    fleet.setGroundSteeringAngle(frameId, 0.2f);
+    fleet.setPedalPosition(frameId, 0.12f);
+  }
+  float yawRate{0.0f};
+  while (state.keepRunning()) {
+    yawRate += fleet.step(DT)[0].yawRate();
+  }
+  doNotOptimize(yawRate);
+  state.setItemsProcessed(state.iterations() * fleet.size());
+}
+
+BENCHMARK_CASE("Proto/encode KinematicState")
+{
+  encode(state, kinematicState());
+}
+
+BENCHMARK_CASE("Proto/decode KinematicState")
+{
+  decode(state, kinematicState());
+}
+
+BENCHMARK_CASE("Proto/encode GroundSteeringRequest")
+{
+  opendlv::proxy::GroundSteeringRequest message;
+  message.groundSteering(-0.25f);
+  encode(state, message);
+}
+
+BENCHMARK_CASE("Proto/decode GroundSteeringRequest")
+{
+  opendlv::proxy::GroundSteeringRequest message;
+  message.groundSteering(-0.25f);
+  decode(state, message);
+}
+
+BENCHMARK_CASE("Proto/encode PedalPositionRequest")
+{
+  opendlv::proxy::PedalPositionRequest message;
+  message.position(0.12f);
+  encode(state, message);
+}
+
+BENCHMARK_CASE("Proto/decode PedalPositionRequest")
+{
+  opendlv::proxy::PedalPositionRequest message;
+  message.position(0.12f);
+  decode(state, message);
+}
+
+BENCHMARK_CASE("Loopback/OD4Session round trip")
+{
+  std::atomic<uint64_t> answered{0};
+  cluon::OD4Session client{233};
+  client.dataTrigger(opendlv::sim::KinematicState::ID(), [&answered](cluon::data::Envelope &&) { answered++; });
+  cluon::OD4Session echo{233};
+  echo.dataTrigger(opendlv::proxy::PedalPositionRequest::ID(), [&echo](cluon::data::Envelope &&) {
+      opendlv::sim::KinematicState answer{kinematicState()};
+      echo.send(answer);
+    });
+  roundTrip(state, client, answered);
+}
+
+BENCHMARK_CASE("Loopback/MessageBus round trip")
+{
+  std::atomic<uint64_t> answered{0};
+  Reactor reactor{1};
+  MessageBus client{234, reactor};
+  client.dataTrigger(opendlv::sim::KinematicState::ID(), [&answered](cluon::data::Envelope &&) { answered++; });
+  MessageBus echo{234, reactor};
+  echo.dataTrigger(opendlv::proxy::PedalPositionRequest::ID(), [&echo](cluon::data::Envelope &&) {
+      opendlv::sim::KinematicState answer{kinematicState()};
+      echo.send(answer);
+    });
+  roundTrip(state, client, answered);
+}
@@ -0,0 +1,78 @@
+/*
+ * Copyright (C) 2018 Ola Benderius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BENCH
+#define BENCH
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <string>
+
+class BenchmarkState {
+ private:
+  BenchmarkState(BenchmarkState const &) = delete;
+  BenchmarkState(BenchmarkState &&) = delete;
+  BenchmarkState &operator=(BenchmarkState const &) = delete;
+  BenchmarkState &operator=(BenchmarkState &&) = delete;
+
+ public:
+  explicit BenchmarkState(uint64_t) noexcept;
+  ~BenchmarkState() = default;
+
+ public:
+  bool keepRunning() noexcept;
+  uint64_t iterations() const noexcept;
+  double elapsedSeconds() const noexcept;
+  double cpuSeconds() const noexcept;
+  uint64_t itemsProcessed() const noexcept;
+  void setItemsProcessed(uint64_t) noexcept;
+  std::map<std::string, double> const &counters() const noexcept;
+  void setCounter(std::string const &, double) noexcept;
+
+ private:
+  uint64_t m_iterations;
+  uint64_t m_remaining;
+  uint64_t m_itemsProcessed;
+  std::chrono::steady_clock::time_point m_start;
+  std::chrono::steady_clock::time_point m_stop;
+  double m_cpuStart;
+  double m_cpuStop;
+  std::map<std::string, double> m_counters;
+};
+
+bool registerBenchmark(std::string const &, std::function<void(BenchmarkState &)>);
+
+// Number of operator new calls so far in this process, for allocs/op counters.
+uint64_t allocationCount() noexcept;
+
+template <typename T>
+inline void doNotOptimize(T const &value) noexcept
+{
+  asm volatile("" : : "r,m"(value) : "memory");
+}
+
+#define BENCHMARK_CONCAT_IMPL(a, b) a##b
+#define BENCHMARK_CONCAT(a, b) BENCHMARK_CONCAT_IMPL(a, b)
+#define BENCHMARK_CASE_IMPL(NAME, FUNCTION) \
+  static void FUNCTION(BenchmarkState &); \
+  static bool const BENCHMARK_CONCAT(FUNCTION, Registered) __attribute__((unused)){registerBenchmark(NAME, &FUNCTION)}; \
+  static void FUNCTION(BenchmarkState &state)
+#define BENCHMARK_CASE(NAME) BENCHMARK_CASE_IMPL(NAME, BENCHMARK_CONCAT(benchmarkCase, __LINE__))
+
+#endif
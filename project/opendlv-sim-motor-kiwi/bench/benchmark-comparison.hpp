@@ -0,0 +1,98 @@
+/*
+ * Copyright (C) 2018 Ola Benderius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BENCHMARK_COMPARISON
+#define BENCHMARK_COMPARISON
+
+#include <istream>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/*
+ * Compares two benchmark result files in Google Benchmark's JSON layout
+ * (as written by --json) repetition by repetition. A benchmark regresses
+ * when it is gated, its median time grew by more than the threshold, and
+ * the Mann-Whitney U test finds the two sets of repetitions different. With
+ * too few repetitions for the test to reach alpha, the threshold alone
+ * decides and the report says so.
+ */
+std::size_t const MANN_WHITNEY_EXACT_LIMIT{40};
+
+struct BenchmarkResults {
+  std::map<std::string, std::string> context{};
+  // Nanoseconds per iteration of every repetition, by benchmark name.
+  std::map<std::string, std::vector<double>> samples{};
+};
+
+struct ComparisonCriteria {
+  // Largest accepted growth of the median time, 0.05 is 5 %.
+  double threshold{0.05};
+  // Significance level of the Mann-Whitney U test.
+  double alpha{0.05};
+  // Confidence level of the intervals around the medians.
+  double confidence{0.95};
+  // Benchmarks whose name contains one of these can fail the comparison;
+  // all benchmarks are gated when empty.
+  std::vector<std::string> gates{};
+};
+
+struct Interval {
+  double low{0.0};
+  double high{0.0};
+};
+
+struct BenchmarkComparison {
+  std::string name{};
+  std::size_t baselineRepetitions{0};
+  std::size_t contenderRepetitions{0};
+  double baselineMedian{0.0};
+  double contenderMedian{0.0};
+  Interval baselineInterval{};
+  Interval contenderInterval{};
+  // Relative change of the median time, positive is slower.
+  double change{0.0};
+  // Two-sided p-value, 1 when there are too few repetitions.
+  double pValue{1.0};
+  // Whether the repetitions allow a p-value below alpha at all.
+  bool tested{false};
+  bool gated{false};
+  bool regressed{false};
+};
+
+// Returns false and describes the problem in the error string if the
+// input is not a benchmark result file.
+bool readBenchmarkResults(std::istream &, BenchmarkResults &, std::string &);
+
+double median(std::vector<double>);
+// Distribution-free interval around the median from order statistics.
+Interval medianInterval(std::vector<double>, double);
+// Two-sided p-value of the Mann-Whitney U test; exact for up to
+// MANN_WHITNEY_EXACT_LIMIT values in total, otherwise the normal
+// approximation with tie correction.
+double mannWhitneyPValue(std::vector<double> const &, std::vector<double> const &);
+// Smallest two-sided p-value the test can give for these sample sizes,
+// e.g. 0.1 for 3 against 3 repetitions.
+double mannWhitneyMinimumPValue(std::size_t, std::size_t);
+
+std::vector<BenchmarkComparison> compareBenchmarks(BenchmarkResults const &, BenchmarkResults const &, ComparisonCriteria const &);
+// Writes a readable report and returns the number of regressions.
+uint32_t writeComparisonReport(std::ostream &, BenchmarkResults const &, BenchmarkResults const &,
+    std::vector<BenchmarkComparison> const &, ComparisonCriteria const &);
+
+#endif
@@ -0,0 +1,130 @@
+/*
+ * Copyright (C) 2018 Ola Benderius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ENVELOPE_FRAMING
+#define ENVELOPE_FRAMING
+
+#include <cstdint>
+#include <string>
+
+#include "cluon-complete.hpp"
+
+/*
+ * Proto encoder with the cluon visitor interface that appends straight to
+ * a caller-owned buffer. Nested messages are encoded in place and their
+ * length prefix is inserted afterwards, so no intermediate buffers or
+ * streams are involved. The output is byte-identical to
+ * cluon::ToProtoVisitor.
+ */
+class ProtoWriter {
+ private:
+  ProtoWriter(ProtoWriter const &) = delete;
+  ProtoWriter(ProtoWriter &&) = delete;
+  ProtoWriter &operator=(ProtoWriter const &) = delete;
+  ProtoWriter &operator=(ProtoWriter &&) = delete;
+
+ public:
+  explicit ProtoWriter(std::string &) noexcept;
+  ~ProtoWriter() = default;
+
+ public:
+  void preVisit(int32_t, std::string const &, std::string const &) noexcept {}
+  void postVisit() noexcept {}
+
+  void visit(uint32_t, std::string &&, std::string &&, bool &);
+  void visit(uint32_t, std::string &&, std::string &&, char &);
+  void visit(uint32_t, std::string &&, std::string &&, int8_t &);
+  void visit(uint32_t, std::string &&, std::string &&, uint8_t &);
+  void visit(uint32_t, std::string &&, std::string &&, int16_t &);
+  void visit(uint32_t, std::string &&, std::string &&, uint16_t &);
+  void visit(uint32_t, std::string &&, std::string &&, int32_t &);
+  void visit(uint32_t, std::string &&, std::string &&, uint32_t &);
+  void visit(uint32_t, std::string &&, std::string &&, int64_t &);
+  void visit(uint32_t, std::string &&, std::string &&, uint64_t &);
+  void visit(uint32_t, std::string &&, std::string &&, float &);
+  void visit(uint32_t, std::string &&, std::string &&, double &);
+  void visit(uint32_t, std::string &&, std::string &&, std::string &);
+
+  template <typename T>
+  void visit(uint32_t &id, std::string &&, std::string &&, T &value)
+  {
+    writeMessage(id, value);
+  }
+
+  template <typename T>
+  void writeMessage(uint32_t id, T &value)
+  {
+    std::size_t const start{beginNested(id)};
+    value.accept(*this);
+    endNested(start);
+  }
+
+  void writeVarintField(uint32_t, uint64_t);
+  void writeBytesField(uint32_t, char const *, std::size_t);
+  // Written field by field: TimeStamp::accept() would build its name
+  // strings, which do not fit the small string buffer.
+  void writeTimeStamp(uint32_t, cluon::data::TimeStamp const &);
+
+ private:
+  void writeVarint(uint64_t);
+  std::size_t beginNested(uint32_t);
+  void endNested(std::size_t);
+
+ private:
+  std::string &m_buffer;
+};
+
+/*
+ * Appends a complete OD4 frame (0x0D 0xA4, 24 bit length, Proto-encoded
+ * envelope) to out. The header is reserved first and its length written
+ * back at the end; the message is encoded directly as the envelope's
+ * serializedData field.
+ */
+template <typename T>
+void appendFrame(std::string &out, T &message, cluon::data::TimeStamp const &sampleTimeStamp = cluon::data::TimeStamp(), uint32_t senderStamp = 0)
+{
+  std::size_t const start{out.size()};
+  out.append("\x0D\xA4\0\0\0", 5);
+  ProtoWriter writer{out};
+
+  cluon::data::TimeStamp const sent{cluon::time::now()};
+  int32_t const dataType{static_cast<int32_t>(T::ID())};
+  writer.writeVarintField(1, static_cast<uint32_t>((dataType << 1) ^ (dataType >> 31)));
+  writer.writeMessage(2, message);
+  writer.writeTimeStamp(3, sent);
+  writer.writeTimeStamp(4, cluon::data::TimeStamp());
+  writer.writeTimeStamp(5, (0 == (sampleTimeStamp.seconds() + sampleTimeStamp.microseconds())) ? sent : sampleTimeStamp);
+  writer.writeVarintField(6, senderStamp);
+
+  uint32_t const length{static_cast<uint32_t>(out.size() - start - 5)};
+  out[start + 2] = static_cast<char>(length & 0xff);
+  out[start + 3] = static_cast<char>((length >> 8) & 0xff);
+  out[start + 4] = static_cast<char>((length >> 16) & 0xff);
+}
+
+/*
+ * Appends the OD4 frame of an already filled envelope, as serializeEnvelope
+ * would produce it.
+ */
+void appendEnvelope(std::string &, cluon::data::Envelope const &);
+
+/*
+ * Per-thread scratch buffer for building frames on the send path.
+ */
+std::string &threadLocalFrameBuffer() noexcept;
+
+#endif
@@ -0,0 +1,156 @@
+/*
+ * Copyright (C) 2018 Ola Benderius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <iostream>
+#include <sstream>
+
+#include "fleet.hpp"
+#include "single-track-model.hpp"
+#include "trace.hpp"
+
+uint32_t const Fleet::MAX_FRAME_IDS;
+
+Fleet::Fleet(std::vector<uint32_t> const &frameIds) noexcept:
+  m_requestMutex{},
+  m_frameIds{},
+  m_indexByFrameId{},
+  m_groundSteeringAngles{},
+  m_pedalPositions{},
+  m_groundSteeringAnglesCopy{},
+  m_pedalPositionsCopy{},
+  m_longitudinalSpeeds{},
+  m_lateralSpeeds{},
+  m_yawRates{},
+  m_kinematicStates{}
+{
+  for (uint32_t frameId : frameIds) {
+    if (0 == m_indexByFrameId.count(frameId)) {
+      m_indexByFrameId[frameId] = static_cast<uint32_t>(m_frameIds.size());
+      m_frameIds.push_back(frameId);
+    }
+  }
+  std::size_t const n{m_frameIds.size()};
+  m_groundSteeringAngles.assign(n, 0.0f);
+  m_pedalPositions.assign(n, 0.0f);
+  m_groundSteeringAnglesCopy.assign(n, 0.0f);
+  m_pedalPositionsCopy.assign(n, 0.0f);
+  m_longitudinalSpeeds.assign(n, 0.0);
+  m_lateralSpeeds.assign(n, 0.0);
+  m_yawRates.assign(n, 0.0);
+  m_kinematicStates.resize(n);
+}
+
+namespace {
+
+// Accepts decimal digits only, so "-1" or "7x" are not wrapped or truncated.
+bool parseFrameId(std::string const &str, uint32_t &frameId) noexcept
+{
+  if (str.empty() || 10 < str.size()
+      || std::string::npos != str.find_first_not_of("0123456789")) {
+    return false;
+  }
+  uint64_t const value{std::stoull(str)};
+  if (UINT32_MAX < value) {
+    return false;
+  }
+  frameId = static_cast<uint32_t>(value);
+  return true;
+}
+
+}
+
+// Parses "0", "0,3,7" or ranges such as "0-49". A malformed item, a reversed
+// range or more than MAX_FRAME_IDS IDs are reported and give an empty list.
+std::vector<uint32_t> Fleet::parseFrameIds(std::string const &list) noexcept
+{
+  std::vector<uint32_t> frameIds;
+  std::stringstream sstr{list};
+  std::string item;
+  while (std::getline(sstr, item, ',')) {
+    std::size_t const dash{item.find('-', 1)};
+    uint32_t first{0};
+    uint32_t last{0};
+    bool valid{false};
+    if (std::string::npos == dash) {
+      valid = parseFrameId(item, first);
+      last = first;
+    } else {
+      valid = parseFrameId(item.substr(0, dash), first)
+        && parseFrameId(item.substr(dash + 1), last) && first <= last;
+    }
+    if (!valid) {
+      std::cerr << "[Fleet]: invalid frame ID or range '" << item << "'" << std::endl;
+      return std::vector<uint32_t>{};
+    }
+    if (MAX_FRAME_IDS < frameIds.size() + (static_cast<uint64_t>(last) - first + 1)) {
+      std::cerr << "[Fleet]: more than " << MAX_FRAME_IDS << " frame IDs in '" << list << "'" << std::endl;
+      return std::vector<uint32_t>{};
+    }
+    for (uint64_t frameId{first}; frameId <= last; frameId++) {
+      frameIds.push_back(static_cast<uint32_t>(frameId));
+    }
+  }
+  return frameIds;
+}
+
+uint32_t Fleet::size() const noexcept
+{
+  return static_cast<uint32_t>(m_frameIds.size());
+}
+
+std::vector<uint32_t> const &Fleet::frameIds() const noexcept
+{
+  return m_frameIds;
+}
+
+int32_t Fleet::find(uint32_t frameId) const noexcept
+{
+  auto it = m_indexByFrameId.find(frameId);
+  return (m_indexByFrameId.end() == it) ? -1 : static_cast<int32_t>(it->second);
+}
+
+void Fleet::setGroundSteeringAngle(uint32_t index, float groundSteeringAngle) noexcept
+{
+  std::lock_guard<std::mutex> lock(m_requestMutex);
+  m_groundSteeringAngles[index] = groundSteeringAngle;
+}
+
+void Fleet::setPedalPosition(uint32_t index, float pedalPosition) noexcept
+{
+  std::lock_guard<std::mutex> lock(m_requestMutex);
+  m_pedalPositions[index] = pedalPosition;
+}
+
+std::vector<opendlv::sim::KinematicState> const &Fleet::step(double dt) noexcept
+{
+  TRACE_SCOPE("Fleet::step");
+  {
+    std::lock_guard<std::mutex> lock(m_requestMutex);
+    m_groundSteeringAnglesCopy = m_groundSteeringAngles;
+    m_pedalPositionsCopy = m_pedalPositions;
+  }
+
+  std::size_t const n{m_frameIds.size()};
+  for (std::size_t i{0}; i < n; i++) {
+    SingleTrackModel::integrate(m_longitudinalSpeeds[i], m_lateralSpeeds[i], m_yawRates[i],
+        m_groundSteeringAnglesCopy[i], m_pedalPositionsCopy[i], dt);
+    m_kinematicStates[i].vx(static_cast<float>(m_longitudinalSpeeds[i]))
+      .vy(static_cast<float>(m_lateralSpeeds[i]))
+      .yawRate(static_cast<float>(m_yawRates[i]));
+  }
+  return m_kinematicStates;
+}
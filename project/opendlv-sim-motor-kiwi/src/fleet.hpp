@@ -0,0 +1,71 @@
+/*
+ * Copyright (C) 2018 Ola Benderius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FLEET
+#define FLEET
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "opendlv-standard-message-set.hpp"
+
+/*
+ * Single track models for a set of frame IDs, stored as arrays and stepped
+ * together. Requests are routed to a vehicle by sender stamp through a hash
+ * lookup, so one process can simulate a whole fleet.
+ */
+class Fleet {
+ private:
+  Fleet(Fleet const &) = delete;
+  Fleet(Fleet &&) = delete;
+  Fleet &operator=(Fleet const &) = delete;
+  Fleet &operator=(Fleet &&) = delete;
+
+ public:
+  explicit Fleet(std::vector<uint32_t> const &) noexcept;
+  ~Fleet() = default;
+
+ public:
+  static uint32_t const MAX_FRAME_IDS{1024};
+
+  static std::vector<uint32_t> parseFrameIds(std::string const &) noexcept;
+
+  uint32_t size() const noexcept;
+  std::vector<uint32_t> const &frameIds() const noexcept;
+  int32_t find(uint32_t) const noexcept;
+  void setGroundSteeringAngle(uint32_t, float) noexcept;
+  void setPedalPosition(uint32_t, float) noexcept;
+  std::vector<opendlv::sim::KinematicState> const &step(double) noexcept;
+
+ private:
+  std::mutex m_requestMutex;
+  std::vector<uint32_t> m_frameIds;
+  std::unordered_map<uint32_t, uint32_t> m_indexByFrameId;
+  std::vector<float> m_groundSteeringAngles;
+  std::vector<float> m_pedalPositions;
+  std::vector<float> m_groundSteeringAnglesCopy;
+  std::vector<float> m_pedalPositionsCopy;
+  std::vector<double> m_longitudinalSpeeds;
+  std::vector<double> m_lateralSpeeds;
+  std::vector<double> m_yawRates;
+  std::vector<opendlv::sim::KinematicState> m_kinematicStates;
+};
+
+#endif
@@ -0,0 +1,486 @@
+/*
+ * Copyright (C) 2018 Ola Benderius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <thread>
+
+#include "message-bus.hpp"
+#include "proto-decoder.hpp"
+#include "trace.hpp"
+
+namespace {
+
+bool readVarint(char const *&p, char const *end, uint64_t &value) noexcept
+{
+  value = 0;
+  for (uint32_t shift{0}; shift < 64 && p < end; shift += 7) {
+    uint8_t const b{static_cast<uint8_t>(*p++)};
+    value |= static_cast<uint64_t>(b & 0x7f) << shift;
+    if (0 == (b & 0x80)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+}
+
+bool peekEnvelopeHeader(char const *data, std::size_t size, EnvelopeHeader &header) noexcept
+{
+  uint32_t const OD4_HEADER_SIZE{5};
+  if (size < OD4_HEADER_SIZE || 0x0D != static_cast<uint8_t>(data[0]) || 0xA4 != static_cast<uint8_t>(data[1])) {
+    return false;
+  }
+  header.dataType = 0;
+  header.senderStamp = 0;
+  header.length = static_cast<uint32_t>(static_cast<uint8_t>(data[2]))
+    | (static_cast<uint32_t>(static_cast<uint8_t>(data[3])) << 8)
+    | (static_cast<uint32_t>(static_cast<uint8_t>(data[4])) << 16);
+  if (size < OD4_HEADER_SIZE + header.length) {
+    return false;
+  }
+
+  // Envelope fields: dataType (1, zigzag varint) and senderStamp (6, varint)
+  // are read; serializedData and the time stamps are skipped over.
+  char const *p{data + OD4_HEADER_SIZE};
+  char const *end{p + header.length};
+  while (p < end) {
+    uint64_t tag;
+    if (!readVarint(p, end, tag)) {
+      return false;
+    }
+    uint64_t value{0};
+    switch (tag & 0x7) {
+      case 0:
+        if (!readVarint(p, end, value)) {
+          return false;
+        }
+        if (1 == (tag >> 3)) {
+          uint32_t const zigZag{static_cast<uint32_t>(value)};
+          header.dataType = static_cast<int32_t>((zigZag >> 1) ^ (~(zigZag & 1) + 1));
+        } else if (6 == (tag >> 3)) {
+          header.senderStamp = static_cast<uint32_t>(value);
+        }
+        break;
+      case 1: p += 8; break;
+      case 2:
+        if (!readVarint(p, end, value) || value > static_cast<uint64_t>(end - p)) {
+          return false;
+        }
+        p += value;
+        break;
+      case 5: p += 4; break;
+      default: return false;
+    }
+  }
+  return p == end;
+}
+
+EnvelopeBatch::EnvelopeBatch() noexcept:
+  m_data{},
+  m_size{0}
+{
+}
+
+void EnvelopeBatch::clear() noexcept
+{
+  m_data.clear();
+  m_size = 0;
+}
+
+uint32_t EnvelopeBatch::size() const noexcept
+{
+  return m_size;
+}
+
+std::string const &EnvelopeBatch::data() const noexcept
+{
+  return m_data;
+}
+
+void EnvelopeBatch::add(cluon::data::Envelope &&envelope)
+{
+  appendEnvelope(m_data, envelope);
+  m_size++;
+}
+
+MessageBus::MessageBus(uint16_t cid, Reactor &reactor) noexcept:
+  m_reactor(reactor),
+  m_receiver{-1},
+  m_sendSocket{-1},
+  m_sendAddress{},
+  m_delegatesMutex{},
+  m_delegates{},
+  m_delegatesBySenderStamp{},
+  m_mailboxesMutex{},
+  m_mailboxesCondition{},
+  m_mailboxes{},
+  m_pendingMailboxes{},
+  m_deliveryThread{},
+  m_deliveryThreadPolicy{},
+  m_deliveryRunning{false},
+  m_metrics{nullptr},
+  m_packedBatches{false},
+  m_datagrams{0},
+  m_received{0},
+  m_delivered{0},
+  m_skipped{0},
+  m_skippedBytes{0},
+  m_malformed{0},
+  m_conflated{0},
+  m_superseded{0}
+{
+  // A plain socket rather than cluon::UDPSender, so that frames built in
+  // place can be sent without handing over (and copying) a std::string.
+  std::memset(&m_sendAddress, 0, sizeof(m_sendAddress));
+  m_sendAddress.sin_family = AF_INET;
+  m_sendAddress.sin_addr.s_addr = ::inet_addr(("225.0.0." + std::to_string(cid)).c_str());
+  m_sendAddress.sin_port = htons(12175);
+  m_sendSocket = ::socket(PF_INET, SOCK_DGRAM, IPPROTO_UDP);
+
+  m_receiver = m_reactor.joinMulticastGroup("225.0.0." + std::to_string(cid), 12175,
+      [this](std::string const &data, std::chrono::system_clock::time_point timepoint) {
+        this->dispatch(data, timepoint);
+      });
+}
+
+MessageBus::~MessageBus()
+{
+  // Stop receiving first, as the reactor calls into this object.
+  m_reactor.leave(m_receiver);
+  {
+    std::lock_guard<std::mutex> lock(m_mailboxesMutex);
+    m_deliveryRunning = false;
+  }
+  m_mailboxesCondition.notify_all();
+  if (m_deliveryThread.joinable()) {
+    m_deliveryThread.join();
+  }
+  if (m_sendSocket >= 0) {
+    ::close(m_sendSocket);
+  }
+}
+
+uint64_t MessageBus::key(int32_t messageIdentifier, uint32_t senderStamp) noexcept
+{
+  return (static_cast<uint64_t>(static_cast<uint32_t>(messageIdentifier)) << 32) | senderStamp;
+}
+
+bool MessageBus::dataTrigger(int32_t messageIdentifier, Delegate delegate, Delivery delivery) noexcept
+{
+  return subscribe(m_delegates, static_cast<uint32_t>(messageIdentifier), std::move(delegate), delivery);
+}
+
+bool MessageBus::dataTrigger(int32_t messageIdentifier, uint32_t senderStamp, Delegate delegate, Delivery delivery) noexcept
+{
+  return subscribe(m_delegatesBySenderStamp, key(messageIdentifier, senderStamp), std::move(delegate), delivery);
+}
+
+bool MessageBus::subscribe(std::unordered_map<uint64_t, Subscription> &subscriptions, uint64_t subscriptionKey, Delegate delegate, Delivery delivery) noexcept
+{
+  try {
+    if (Delivery::Conflate == delivery) {
+      std::lock_guard<std::mutex> lock(m_mailboxesMutex);
+      if (!m_deliveryRunning) {
+        m_deliveryRunning = true;
+        m_deliveryThread = std::thread(&MessageBus::runDelivery, this);
+        applyThreadPolicy(m_deliveryThread.native_handle(), m_deliveryThreadPolicy);
+      }
+    }
+    std::lock_guard<std::mutex> lock(m_delegatesMutex);
+    if (nullptr == delegate) {
+      subscriptions.erase(subscriptionKey);
+    } else {
+      subscriptions[subscriptionKey] = Subscription{std::make_shared<Delegate>(std::move(delegate)), delivery};
+    }
+  } catch (...) {
+    return false;
+  }
+  return true;
+}
+
+void MessageBus::timeTrigger(float freq, std::function<bool()> delegate) noexcept
+{
+  if (nullptr == delegate) {
+    return;
+  }
+  auto const TIME_SLICE = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+      std::chrono::duration<double>(1.0 / static_cast<double>((freq > 0.0f) ? freq : 1.0f)));
+  auto next = std::chrono::steady_clock::now();
+  bool delegateIsRunning{true};
+  do {
+    try {
+      TRACE_SCOPE("timeTrigger");
+      delegateIsRunning = delegate();
+    } catch (...) {
+      delegateIsRunning = false;
+    }
+    next += TIME_SLICE;
+    auto const now = std::chrono::steady_clock::now();
+    if (now < next) {
+      std::this_thread::sleep_until(next);
+    } else {
+      TRACE_INSTANT("timeTrigger overrun");
+      std::cerr << "[MessageBus]: time-triggered delegate violated allocated time slice." << std::endl;
+      next = now;
+    }
+  } while (delegateIsRunning);
+}
+
+bool MessageBus::isRunning() noexcept
+{
+  return m_receiver >= 0 && m_reactor.isRunning();
+}
+
+MessageBus::Statistics MessageBus::statistics() const noexcept
+{
+  Statistics statistics;
+  statistics.datagrams = m_datagrams.load(std::memory_order_relaxed);
+  statistics.received = m_received.load(std::memory_order_relaxed);
+  statistics.delivered = m_delivered.load(std::memory_order_relaxed);
+  statistics.skipped = m_skipped.load(std::memory_order_relaxed);
+  statistics.skippedBytes = m_skippedBytes.load(std::memory_order_relaxed);
+  statistics.malformed = m_malformed.load(std::memory_order_relaxed);
+  statistics.conflated = m_conflated.load(std::memory_order_relaxed);
+  statistics.superseded = m_superseded.load(std::memory_order_relaxed);
+  return statistics;
+}
+
+bool MessageBus::setDeliveryThreadPolicy(ThreadPolicy const &policy) noexcept
+{
+  try {
+    std::lock_guard<std::mutex> lock(m_mailboxesMutex);
+    m_deliveryThreadPolicy = policy;
+    if (m_deliveryRunning) {
+      return applyThreadPolicy(m_deliveryThread.native_handle(), m_deliveryThreadPolicy);
+    }
+  } catch (...) {
+    return false;
+  }
+  return true;
+}
+
+void MessageBus::setMetrics(Metrics *metrics) noexcept
+{
+  m_metrics.store(metrics);
+}
+
+void MessageBus::setPackedBatches(bool packedBatches) noexcept
+{
+  m_packedBatches.store(packedBatches);
+}
+
+std::size_t MessageBus::pendingDeliveries() noexcept
+{
+  std::lock_guard<std::mutex> lock(m_mailboxesMutex);
+  return m_pendingMailboxes.size();
+}
+
+void MessageBus::recordSent(int32_t messageIdentifier, std::size_t bytes) noexcept
+{
+  Metrics *metrics{m_metrics.load(std::memory_order_relaxed)};
+  if (nullptr != metrics) {
+    metrics->sent(messageIdentifier, bytes);
+  }
+}
+
+bool MessageBus::findSubscription(EnvelopeHeader const &header, Subscription &subscription) noexcept
+{
+  std::lock_guard<std::mutex> lock(m_delegatesMutex);
+  auto bySenderStamp = m_delegatesBySenderStamp.find(key(header.dataType, header.senderStamp));
+  if (m_delegatesBySenderStamp.end() != bySenderStamp) {
+    subscription = bySenderStamp->second;
+    return true;
+  }
+  auto byIdentifier = m_delegates.find(static_cast<uint32_t>(header.dataType));
+  if (m_delegates.end() != byIdentifier) {
+    subscription = byIdentifier->second;
+    return true;
+  }
+  return false;
+}
+
+void MessageBus::dispatch(std::string const &data, std::chrono::system_clock::time_point timepoint) noexcept
+{
+  TRACE_SCOPE("processPipeline");
+  m_datagrams.fetch_add(1, std::memory_order_relaxed);
+  std::size_t offset{0};
+  while (offset < data.size()) {
+    m_received.fetch_add(1, std::memory_order_relaxed);
+    EnvelopeHeader header;
+    if (!peekEnvelopeHeader(data.data() + offset, data.size() - offset, header)) {
+      m_malformed.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+    dispatchFrame(data.data() + offset, header, timepoint);
+    offset += 5 + header.length;
+  }
+}
+
+void MessageBus::dispatchFrame(char const *frame, EnvelopeHeader const &header, std::chrono::system_clock::time_point timepoint) noexcept
+{
+  Metrics *metrics{m_metrics.load(std::memory_order_relaxed)};
+  if (nullptr != metrics) {
+    metrics->received(header.dataType, 5 + header.length);
+  }
+  Subscription subscription{nullptr, Delivery::EveryMessage};
+  if (!findSubscription(header, subscription)) {
+    m_skipped.fetch_add(1, std::memory_order_relaxed);
+    m_skippedBytes.fetch_add(5 + header.length, std::memory_order_relaxed);
+    return;
+  }
+  try {
+    if (Delivery::Conflate == subscription.delivery) {
+      conflate(frame, header, timepoint);
+    } else {
+      deliver(frame, header, timepoint, *subscription.delegate);
+    }
+  } catch (...) {
+  }
+}
+
+void MessageBus::deliver(char const *frame, EnvelopeHeader const &header, std::chrono::system_clock::time_point timepoint, Delegate &delegate)
+{
+  // The clock is only read for the deliveries whose latency is sampled.
+  Metrics *metrics{m_metrics.load(std::memory_order_relaxed)};
+  bool const timed{nullptr != metrics && metrics->sampleLatency()};
+  auto const decodeStart = timed ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point();
+
+  cluon::data::Envelope envelope;
+  if (!decodeProto(frame + 5, header.length, envelope)) {
+    return;
+  }
+  envelope.received(cluon::time::convert(timepoint));
+  m_delivered.fetch_add(1, std::memory_order_relaxed);
+
+  TRACE_SCOPE("callback");
+  if (timed) {
+    auto const delegateStart = std::chrono::steady_clock::now();
+    delegate(std::move(envelope));
+    metrics->delivered(header.dataType, delegateStart - decodeStart, std::chrono::steady_clock::now() - delegateStart);
+  } else {
+    delegate(std::move(envelope));
+  }
+}
+
+void MessageBus::conflate(char const *frame, EnvelopeHeader const &header, std::chrono::system_clock::time_point timepoint)
+{
+  m_conflated.fetch_add(1, std::memory_order_relaxed);
+  uint64_t const mailboxKey{key(header.dataType, header.senderStamp)};
+  {
+    std::lock_guard<std::mutex> lock(m_mailboxesMutex);
+    Mailbox &mailbox = m_mailboxes[mailboxKey];
+    if (mailbox.pending) {
+      m_superseded.fetch_add(1, std::memory_order_relaxed);
+    } else {
+      mailbox.pending = true;
+      m_pendingMailboxes.push_back(mailboxKey);
+    }
+    // assign() reuses the capacity of the previous frame.
+    mailbox.frame.assign(frame, 5 + header.length);
+    mailbox.timepoint = timepoint;
+  }
+  m_mailboxesCondition.notify_one();
+}
+
+void MessageBus::runDelivery() noexcept
+{
+  std::vector<uint64_t> keys;
+  std::string frame;
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(m_mailboxesMutex);
+      m_mailboxesCondition.wait(lock, [this]() { return !m_deliveryRunning || !m_pendingMailboxes.empty(); });
+      if (!m_deliveryRunning) {
+        return;
+      }
+      keys.swap(m_pendingMailboxes);
+    }
+    for (uint64_t mailboxKey : keys) {
+      std::chrono::system_clock::time_point timepoint;
+      {
+        std::lock_guard<std::mutex> lock(m_mailboxesMutex);
+        Mailbox &mailbox = m_mailboxes[mailboxKey];
+        frame.assign(mailbox.frame);
+        timepoint = mailbox.timepoint;
+        mailbox.pending = false;
+      }
+      EnvelopeHeader header;
+      Subscription subscription{nullptr, Delivery::Conflate};
+      if (peekEnvelopeHeader(frame.data(), frame.size(), header) && findSubscription(header, subscription)) {
+        try {
+          deliver(frame.data(), header, timepoint, *subscription.delegate);
+        } catch (...) {
+        }
+      }
+    }
+    keys.clear();
+  }
+}
+
+void MessageBus::send(cluon::data::Envelope &&envelope) noexcept
+{
+  try {
+    std::string &frame = threadLocalFrameBuffer();
+    frame.clear();
+    appendEnvelope(frame, envelope);
+    sendDatagram(frame.data(), frame.size());
+    recordSent(envelope.dataType(), frame.size());
+  } catch (...) {
+  }
+}
+
+void MessageBus::sendDatagram(char const *data, std::size_t size) noexcept
+{
+  TRACE_SCOPE("send");
+  if (m_sendSocket >= 0) {
+    ::sendto(m_sendSocket, data, size, 0, reinterpret_cast<struct sockaddr const *>(&m_sendAddress), sizeof(m_sendAddress));
+  }
+}
+
+// Sends one datagram per frame, or with packed batches as few datagrams as
+// the UDP size limit allows, and returns the number of datagrams.
+uint32_t MessageBus::sendBatch(EnvelopeBatch const &batch) noexcept
+{
+  bool const packed{m_packedBatches.load(std::memory_order_relaxed)};
+  std::size_t const MAX_DATAGRAM{static_cast<std::size_t>(cluon::UDPPacketSizeConstraints::MAX_SIZE_UDP_PACKET)
+    - static_cast<std::size_t>(cluon::UDPPacketSizeConstraints::SIZE_IPv4_HEADER)
+    - static_cast<std::size_t>(cluon::UDPPacketSizeConstraints::SIZE_UDP_HEADER)};
+  std::string const &data = batch.data();
+  uint32_t datagrams{0};
+  std::size_t begin{0};
+  while (begin < data.size()) {
+    std::size_t end{begin};
+    EnvelopeHeader header;
+    while (end < data.size() && peekEnvelopeHeader(data.data() + end, data.size() - end, header)
+        && (end == begin || (packed && end + 5 + header.length - begin <= MAX_DATAGRAM))) {
+      recordSent(header.dataType, 5 + header.length);
+      end += 5 + header.length;
+    }
+    if (end == begin) {
+      break;
+    }
+    sendDatagram(data.data() + begin, end - begin);
+    datagrams++;
+    begin = end;
+  }
+  return datagrams;
+}
@@ -0,0 +1,225 @@
+/*
+ * Copyright (C) 2018 Ola Benderius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MESSAGE_BUS
+#define MESSAGE_BUS
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <netinet/in.h>
+
+#include "cluon-complete.hpp"
+#include "envelope-framing.hpp"
+#include "metrics.hpp"
+#include "reactor.hpp"
+
+/*
+ * The routing fields of an OD4 frame, read without decoding or copying the
+ * payload.
+ */
+struct EnvelopeHeader {
+  int32_t dataType;
+  uint32_t senderStamp;
+  uint32_t length;
+};
+
+bool peekEnvelopeHeader(char const *, std::size_t, EnvelopeHeader &) noexcept;
+
+/*
+ * Several OD4 frames packed back to back for one datagram; the 0x0DA4 header
+ * and length of each frame let a MessageBus split them again. Receivers that
+ * use cluon::OD4Session only see the first frame of a batch, so a MessageBus
+ * only packs batches after setPackedBatches(true).
+ */
+class EnvelopeBatch {
+ private:
+  EnvelopeBatch(EnvelopeBatch const &) = delete;
+  EnvelopeBatch(EnvelopeBatch &&) = delete;
+  EnvelopeBatch &operator=(EnvelopeBatch const &) = delete;
+  EnvelopeBatch &operator=(EnvelopeBatch &&) = delete;
+
+ public:
+  EnvelopeBatch() noexcept;
+  ~EnvelopeBatch() = default;
+
+ public:
+  void clear() noexcept;
+  uint32_t size() const noexcept;
+  std::string const &data() const noexcept;
+  void add(cluon::data::Envelope &&);
+
+  template <typename T>
+  void add(T &message, cluon::data::TimeStamp const &sampleTimeStamp = cluon::data::TimeStamp(), uint32_t senderStamp = 0)
+  {
+    appendFrame(m_data, message, sampleTimeStamp, senderStamp);
+    m_size++;
+  }
+
+ private:
+  std::string m_data;
+  uint32_t m_size;
+};
+
+/*
+ * Drop-in replacement for cluon::OD4Session on the same multicast group.
+ * The socket is served by a Reactor, by default the process-wide one, so
+ * several buses in a process share its threads. Incoming frames are
+ * matched on (message ID, sender stamp) from the header alone, so
+ * envelopes nobody subscribed to are never decoded.
+ *
+ * Subscriptions made with Delivery::Conflate keep only the newest frame per
+ * (message ID, sender stamp) in a mailbox that a separate delivery thread
+ * drains; frames superseded while the consumer is busy are dropped
+ * undecoded, so a slow consumer cannot build up a backlog.
+ */
+class MessageBus {
+ private:
+  MessageBus(MessageBus const &) = delete;
+  MessageBus(MessageBus &&) = delete;
+  MessageBus &operator=(MessageBus const &) = delete;
+  MessageBus &operator=(MessageBus &&) = delete;
+
+ public:
+  using Delegate = std::function<void(cluon::data::Envelope &&)>;
+
+  enum class Delivery : uint8_t {
+    EveryMessage,
+    Conflate
+  };
+
+  struct Statistics {
+    uint64_t datagrams;
+    uint64_t received;
+    uint64_t delivered;
+    uint64_t skipped;
+    uint64_t skippedBytes;
+    uint64_t malformed;
+    uint64_t conflated;
+    uint64_t superseded;
+
+    // Share of conflated frames that were replaced before delivery.
+    double conflationRate() const noexcept
+    {
+      return (conflated > 0) ? static_cast<double>(superseded) / static_cast<double>(conflated) : 0.0;
+    }
+  };
+
+ public:
+  explicit MessageBus(uint16_t, Reactor & = Reactor::shared()) noexcept;
+  ~MessageBus();
+
+ public:
+  bool dataTrigger(int32_t, Delegate, Delivery = Delivery::EveryMessage) noexcept;
+  bool dataTrigger(int32_t, uint32_t, Delegate, Delivery = Delivery::EveryMessage) noexcept;
+  void timeTrigger(float, std::function<bool()>) noexcept;
+  bool isRunning() noexcept;
+  Statistics statistics() const noexcept;
+  // Policy of the thread delivering conflated frames, also applied when
+  // that thread is only started later.
+  bool setDeliveryThreadPolicy(ThreadPolicy const &) noexcept;
+  // Records traffic and delegate latencies per message ID; nullptr (the
+  // default) turns recording off.
+  void setMetrics(Metrics *) noexcept;
+  // Lets sendBatch() pack several frames into one datagram; off by default,
+  // as only MessageBus receivers unpack them.
+  void setPackedBatches(bool) noexcept;
+  std::size_t pendingDeliveries() noexcept;
+
+  /*
+   * Entry point for every received datagram, which may hold a batch of
+   * frames; public so that recorded traffic can be replayed without a
+   * network.
+   */
+  void dispatch(std::string const &, std::chrono::system_clock::time_point) noexcept;
+
+  void send(cluon::data::Envelope &&) noexcept;
+  uint32_t sendBatch(EnvelopeBatch const &) noexcept;
+
+  template <typename T>
+  void send(T &message, cluon::data::TimeStamp const &sampleTimeStamp = cluon::data::TimeStamp(), uint32_t senderStamp = 0) noexcept
+  {
+    try {
+      std::string &frame = threadLocalFrameBuffer();
+      frame.clear();
+      appendFrame(frame, message, sampleTimeStamp, senderStamp);
+      sendDatagram(frame.data(), frame.size());
+      recordSent(static_cast<int32_t>(T::ID()), frame.size());
+    } catch (...) {
+    }
+  }
+
+ private:
+  struct Subscription {
+    std::shared_ptr<Delegate> delegate{};
+    Delivery delivery{Delivery::EveryMessage};
+  };
+
+  struct Mailbox {
+    std::string frame{};
+    std::chrono::system_clock::time_point timepoint{};
+    bool pending{false};
+  };
+
+ private:
+  static uint64_t key(int32_t, uint32_t) noexcept;
+  bool subscribe(std::unordered_map<uint64_t, Subscription> &, uint64_t, Delegate, Delivery) noexcept;
+  bool findSubscription(EnvelopeHeader const &, Subscription &) noexcept;
+  void dispatchFrame(char const *, EnvelopeHeader const &, std::chrono::system_clock::time_point) noexcept;
+  void deliver(char const *, EnvelopeHeader const &, std::chrono::system_clock::time_point, Delegate &);
+  void conflate(char const *, EnvelopeHeader const &, std::chrono::system_clock::time_point);
+  void runDelivery() noexcept;
+  void sendDatagram(char const *, std::size_t) noexcept;
+  void recordSent(int32_t, std::size_t) noexcept;
+
+ private:
+  Reactor &m_reactor;
+  int32_t m_receiver;
+  int32_t m_sendSocket;
+  struct sockaddr_in m_sendAddress;
+  std::mutex m_delegatesMutex;
+  std::unordered_map<uint64_t, Subscription> m_delegates;
+  std::unordered_map<uint64_t, Subscription> m_delegatesBySenderStamp;
+  std::mutex m_mailboxesMutex;
+  std::condition_variable m_mailboxesCondition;
+  std::unordered_map<uint64_t, Mailbox> m_mailboxes;
+  std::vector<uint64_t> m_pendingMailboxes;
+  std::thread m_deliveryThread;
+  ThreadPolicy m_deliveryThreadPolicy;
+  bool m_deliveryRunning;
+  std::atomic<Metrics *> m_metrics;
+  std::atomic<bool> m_packedBatches;
+  std::atomic<uint64_t> m_datagrams;
+  std::atomic<uint64_t> m_received;
+  std::atomic<uint64_t> m_delivered;
+  std::atomic<uint64_t> m_skipped;
+  std::atomic<uint64_t> m_skippedBytes;
+  std::atomic<uint64_t> m_malformed;
+  std::atomic<uint64_t> m_conflated;
+  std::atomic<uint64_t> m_superseded;
+};
+
+#endif
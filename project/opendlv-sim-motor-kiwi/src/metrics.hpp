@@ -0,0 +1,160 @@
+/*
+ * Copyright (C) 2018 Ola Benderius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef METRICS
+#define METRICS
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/*
+ * Per message ID counters and latency histograms. Every thread records into
+ * its own shard with plain relaxed stores, so the hot path takes no lock
+ * and shares no cache line with other threads; shards are only summed up
+ * when a snapshot or the text exposition is requested.
+ */
+class Metrics {
+ private:
+  Metrics(Metrics const &) = delete;
+  Metrics(Metrics &&) = delete;
+  Metrics &operator=(Metrics const &) = delete;
+  Metrics &operator=(Metrics &&) = delete;
+
+ public:
+  // Histogram buckets are powers of two from 64 ns to 64 ms.
+  static uint32_t const BUCKETS{21};
+  static uint32_t const LATENCY_SAMPLING{8};
+
+  struct Histogram {
+    uint64_t buckets[BUCKETS];
+    uint64_t count;
+    uint64_t sumNanoseconds;
+  };
+
+  struct MessageSnapshot {
+    uint64_t received;
+    uint64_t receivedBytes;
+    uint64_t sent;
+    uint64_t sentBytes;
+    Histogram decode;
+    Histogram delegate;
+  };
+
+ public:
+  Metrics() noexcept;
+  ~Metrics() = default;
+
+ public:
+  void received(int32_t, std::size_t) noexcept;
+  void sent(int32_t, std::size_t) noexcept;
+  void decodeTime(int32_t, std::chrono::steady_clock::duration) noexcept;
+  void delegateTime(int32_t, std::chrono::steady_clock::duration) noexcept;
+  // True for one in LATENCY_SAMPLING calls per thread; latencies are only
+  // measured then, as reading the clock costs more than the counters.
+  bool sampleLatency() noexcept;
+  // Both latencies of one delivery with a single slot lookup.
+  void delivered(int32_t, std::chrono::steady_clock::duration, std::chrono::steady_clock::duration) noexcept;
+
+  // Gauges are sampled when the metrics are read, e.g. queue depths.
+  void addGauge(std::string const &, std::function<double()>);
+
+  std::map<int32_t, MessageSnapshot> snapshot() const;
+  // Prometheus text exposition format.
+  std::string exposition() const;
+
+ private:
+  static uint32_t const SLOTS{128};
+
+  struct AtomicHistogram {
+    std::atomic<uint64_t> buckets[BUCKETS];
+    std::atomic<uint64_t> count{0};
+    std::atomic<uint64_t> sumNanoseconds{0};
+  };
+
+  struct Slot {
+    std::atomic<int64_t> messageIdentifier{EMPTY};
+    std::atomic<uint64_t> received{0};
+    std::atomic<uint64_t> receivedBytes{0};
+    std::atomic<uint64_t> sent{0};
+    std::atomic<uint64_t> sentBytes{0};
+    AtomicHistogram decode{};
+    AtomicHistogram delegate{};
+  };
+
+  struct alignas(64) Shard {
+    Slot slots[SLOTS];
+  };
+
+  static int64_t const EMPTY{INT64_MIN};
+
+ private:
+  Shard &localShard();
+  Slot *slot(int32_t) noexcept;
+  static void add(std::atomic<uint64_t> &, uint64_t) noexcept;
+  static void record(AtomicHistogram &, std::chrono::steady_clock::duration) noexcept;
+
+ private:
+  uint64_t const m_identifier;
+  mutable std::mutex m_shardsMutex;
+  std::vector<std::unique_ptr<Shard>> m_shards;
+  std::vector<std::pair<std::string, std::function<double()>>> m_gauges;
+};
+
+/*
+ * Serves Metrics::exposition() over HTTP on 127.0.0.1:<port> or, for an
+ * address of the form "unix:<path>", on a Unix domain socket. A client that
+ * stalls is dropped after CLIENT_TIMEOUT_MS, so it cannot hold up shutdown.
+ */
+class MetricsServer {
+ private:
+  MetricsServer(MetricsServer const &) = delete;
+  MetricsServer(MetricsServer &&) = delete;
+  MetricsServer &operator=(MetricsServer const &) = delete;
+  MetricsServer &operator=(MetricsServer &&) = delete;
+
+ public:
+  static uint32_t const CLIENT_TIMEOUT_MS{500};
+
+ public:
+  MetricsServer(Metrics const &, std::string const &) noexcept;
+  ~MetricsServer();
+
+ public:
+  static bool isValidAddress(std::string const &) noexcept;
+  bool isRunning() const noexcept;
+
+ private:
+  void run() noexcept;
+
+ private:
+  Metrics const &m_metrics;
+  std::string m_unixPath;
+  int32_t m_socket;
+  std::atomic<bool> m_running;
+  std::thread m_thread;
+};
+
+#endif
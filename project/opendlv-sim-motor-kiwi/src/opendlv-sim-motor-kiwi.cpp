@@ -15,65 +15,142 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <atomic>
+#include <csignal>
+
 #include "cluon-complete.hpp"
 #include "opendlv-standard-message-set.hpp"
-#include "single-track-model.hpp"
+#include "fleet.hpp"
+#include "logger.hpp"
+#include "message-bus.hpp"
+#include "metrics.hpp"
+#include "reactor.hpp"
+#include "realtime.hpp"
+#include "trace.hpp"
+
+namespace {
+
+std::atomic<bool> g_stopRequested{false};
+
+void requestStop(int32_t) noexcept
+{
+  g_stopRequested = true;
+}
+
+}
 
 int32_t main(int32_t argc, char **argv) {
   int32_t retCode{0};
   auto commandlineArguments = cluon::getCommandlineArguments(argc, argv);
-  if (0 == commandlineArguments.count("cid") || 0 == commandlineArguments.count("freq") || 0 == commandlineArguments.count("frame-id")) {
+  std::vector<uint32_t> const FRAME_IDS = Fleet::parseFrameIds(commandlineArguments["frame-id"]);
+  // Malformed options are reported together with the usage before anything
+  // is started.
+  std::string argumentError;
+  if (0 != commandlineArguments.count("metrics") && !MetricsServer::isValidAddress(commandlineArguments["metrics"])) {
+    argumentError = "--metrics must be a port or unix:<path>.";
+  }
+  if (0 == commandlineArguments.count("cid") || 0 == commandlineArguments.count("freq") || FRAME_IDS.empty() || !argumentError.empty()) {
+    if (!argumentError.empty()) {
+      std::cerr << argv[0] << ": " << argumentError << std::endl;
+    }
     std::cerr << argv[0] << " is a dynamics model for the Chalmers Kiwi platform." << std::endl;
-    std::cerr << "Usage:   " << argv[0] << " --frame-id=<ID of frame (used for integration)> --freq=<Model frequency> --cid=<OpenDaVINCI session>" << std::endl;
+    std::cerr << "Usage:   " << argv[0] << " --frame-id=<ID(s) of frames (used for integration), e.g. 0 or 0,2 or 0-49> --freq=<Model frequency> --cid=<OpenDaVINCI session> [--workers=<delegate threads, default 1>] [--cpu-affinity=<CPUs>] [--rt-priority=<SCHED_FIFO priority>] [--mlockall] [--metrics=<port or unix:path>] [--trace=<trace-event JSON file>] [--verbose] [--log-interval=<minimum ms between verbose lines>]" << std::endl;
     std::cerr << "Example: " << argv[0] << " --frame-id=0 --freq=100 --cid=111" << std::endl;
+    std::cerr << "         " << argv[0] << " --frame-id=0-49 --freq=100 --cid=111" << std::endl;
     retCode = 1;
   } else {
     bool const VERBOSE{commandlineArguments.count("verbose") != 0};
+    uint32_t const LOG_INTERVAL{(0 != commandlineArguments.count("log-interval")) ? static_cast<uint32_t>(std::stoi(commandlineArguments["log-interval"])) : 0};
+    uint32_t const WORKERS{(0 != commandlineArguments.count("workers")) ? static_cast<uint32_t>(std::stoi(commandlineArguments["workers"])) : 1};
     uint16_t const CID = std::stoi(commandlineArguments["cid"]);
-    uint32_t const FRAME_ID = std::stoi(commandlineArguments["frame-id"]);
     float const FREQ = std::stof(commandlineArguments["freq"]);
     double const DT = 1.0 / FREQ;
     
-    SingleTrackModel singleTrackModel;
+    Fleet fleet{FRAME_IDS};
 
-    auto onGroundSteeringRequest{[&FRAME_ID, &singleTrackModel](cluon::data::Envelope &&envelope)
-      {
-        uint32_t const senderStamp = envelope.senderStamp();
-        if (FRAME_ID == senderStamp) {
+    // Receive, delegate and control threads can be named, pinned and run
+    // with SCHED_FIFO separately, e.g. --cpu-affinity=control:3/receive:2/pipeline:2.
+    RealtimeOptions const REALTIME_OPTIONS{parseRealtimeOptions(commandlineArguments, "sim")};
+    if (REALTIME_OPTIONS.lockMemory) {
+      lockAndPrefaultMemory(1024 * 1024, 16 * 1024 * 1024);
+    }
+    Reactor reactor{WORKERS};
+    reactor.setThreadPolicies(REALTIME_OPTIONS.receive, REALTIME_OPTIONS.pipeline);
+    MessageBus od4{CID, reactor};
+    od4.setDeliveryThreadPolicy(REALTIME_OPTIONS.pipeline);
+
+    // Per message ID counters and latencies, served in the Prometheus text
+    // format, e.g. curl http://127.0.0.1:9100/metrics.
+    Metrics metrics;
+    std::unique_ptr<MetricsServer> metricsServer;
+    if (0 != commandlineArguments.count("metrics")) {
+      metrics.addGauge("od4_reactor_queue_depth", [&reactor]() { return static_cast<double>(reactor.queueDepth()); });
+      metrics.addGauge("od4_conflation_pending", [&od4]() { return static_cast<double>(od4.pendingDeliveries()); });
+      od4.setMetrics(&metrics);
+      metricsServer = std::make_unique<MetricsServer>(metrics, commandlineArguments["metrics"]);
+    }
+
+    // The last trace events of every thread are written as Chrome trace
+    // JSON when the process is stopped with SIGINT or SIGTERM.
+    std::string const TRACE_FILE{commandlineArguments["trace"]};
+    if (!TRACE_FILE.empty()) {
+#ifndef ENABLE_TRACING
+      std::cerr << argv[0] << ": built without trace points, configure with -DTRACING=ON." << std::endl;
+#endif
+      Tracer::instance().setEnabled(true);
+      std::signal(SIGINT, requestStop);
+      std::signal(SIGTERM, requestStop);
+    }
+
+    // One subscription per owned frame ID; requests for other vehicles are
+    // dropped by the bus before they are decoded.
+    for (uint32_t i{0}; i < fleet.size(); i++) {
+      auto onGroundSteeringRequest{[i, &fleet](cluon::data::Envelope &&envelope)
+        {
           auto groundSteeringAngleRequest = cluon::extractMessage<opendlv::proxy::GroundSteeringRequest>(std::move(envelope));
-          singleTrackModel.setGroundSteeringAngle(groundSteeringAngleRequest);
-        }
-      }};
-    auto onPedalPositionRequest{[&FRAME_ID, &singleTrackModel](cluon::data::Envelope &&envelope)
-      {
-        uint32_t const senderStamp = envelope.senderStamp();
-        if (FRAME_ID == senderStamp) {
+          fleet.setGroundSteeringAngle(i, groundSteeringAngleRequest.groundSteering());
+        }};
+      auto onPedalPositionRequest{[i, &fleet](cluon::data::Envelope &&envelope)
+        {
           auto pedalPositionRequest = cluon::extractMessage<opendlv::proxy::PedalPositionRequest>(std::move(envelope));
-          singleTrackModel.setPedalPosition(pedalPositionRequest);
-        }
-      }};
+          fleet.setPedalPosition(i, pedalPositionRequest.position());
+        }};
+      od4.dataTrigger(opendlv::proxy::GroundSteeringRequest::ID(), fleet.frameIds()[i], onGroundSteeringRequest);
+      od4.dataTrigger(opendlv::proxy::PedalPositionRequest::ID(), fleet.frameIds()[i], onPedalPositionRequest);
+    }
 
-    cluon::OD4Session od4{CID};
-    od4.dataTrigger(opendlv::proxy::GroundSteeringRequest::ID(), onGroundSteeringRequest);
-    od4.dataTrigger(opendlv::proxy::PedalPositionRequest::ID(), onPedalPositionRequest);
+    // Verbose output is formatted and written off the control thread; the
+    // interval applies to the whole fleet, so all vehicles share one site.
+    Logger logger{std::cout};
+    LogSite stateLog{"Kinematic state with id %u is at velocity [vx=%g, vy=%g, vz=%g] with the rotation rate [rollRate=%g, pitchRate=%g, yawRate=%g].",
+      std::chrono::milliseconds(LOG_INTERVAL), 1};
 
-    auto atFrequency{[&FRAME_ID, &VERBOSE, &DT, &singleTrackModel, &od4]() -> bool
+    auto atFrequency{[&VERBOSE, &logger, &stateLog, &DT, &fleet, &od4]() -> bool
       {
-        opendlv::sim::KinematicState kinematicState = singleTrackModel.step(DT);
+        // Step every vehicle first, then publish all states in one burst.
+        std::vector<opendlv::sim::KinematicState> const &kinematicStates = fleet.step(DT);
 
         cluon::data::TimeStamp sampleTime;
-        od4.send(kinematicState, sampleTime, FRAME_ID);
+        for (uint32_t i{0}; i < fleet.size(); i++) {
+          opendlv::sim::KinematicState kinematicState{kinematicStates[i]};
+          od4.send(kinematicState, sampleTime, fleet.frameIds()[i]);
+        }
         if (VERBOSE) {
-          std::cout << "Kinematic state with id " << FRAME_ID
-            << " is at velocity [vx=" << kinematicState.vx() << ", vy=" << kinematicState.vy() << ", vz="
-            << kinematicState.vz() << "] with the rotation rate [rollRate=" << kinematicState.rollRate() << ", pitchRate="
-            << kinematicState.pitchRate() << ", yawRate=" << kinematicState.yawRate() << "]." << std::endl;
+          for (uint32_t i{0}; i < fleet.size(); i++) {
+            opendlv::sim::KinematicState const &kinematicState = kinematicStates[i];
+            logger.log(stateLog, fleet.frameIds()[i], kinematicState.vx(), kinematicState.vy(), kinematicState.vz(),
+              kinematicState.rollRate(), kinematicState.pitchRate(), kinematicState.yawRate());
+          }
         }
 
-        return true;
+        return !g_stopRequested;
       }};
 
+    applyThreadPolicy(REALTIME_OPTIONS.control);
     od4.timeTrigger(FREQ, atFrequency);
+    if (!TRACE_FILE.empty()) {
+      Tracer::instance().writeTrace(TRACE_FILE);
+    }
   }
   return retCode;
 }
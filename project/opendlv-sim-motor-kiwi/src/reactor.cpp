@@ -0,0 +1,316 @@
+/*
+ * Copyright (C) 2018 Ola Benderius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <arpa/inet.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+
+#include "reactor.hpp"
+#include "trace.hpp"
+
+Reactor::Source::~Source()
+{
+  if (socket >= 0) {
+    ::setsockopt(socket, IPPROTO_IP, IP_DROP_MEMBERSHIP, &membership, sizeof(membership));
+    ::close(socket);
+  }
+}
+
+Reactor::Reactor(uint32_t workers) noexcept:
+  m_epoll{-1},
+  m_wakeup{-1},
+  m_running{false},
+  m_sourcesMutex{},
+  m_sources{},
+  m_workers{},
+  m_nextWorker{0},
+  m_thread{},
+  m_wakeups{0},
+  m_datagrams{0}
+{
+  m_epoll = ::epoll_create1(EPOLL_CLOEXEC);
+  m_wakeup = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (m_epoll < 0 || m_wakeup < 0) {
+    std::cerr << "[Reactor]: failed to create epoll instance: " << std::strerror(errno) << std::endl;
+    return;
+  }
+  struct epoll_event event{};
+  event.events = EPOLLIN;
+  event.data.fd = m_wakeup;
+  ::epoll_ctl(m_epoll, EPOLL_CTL_ADD, m_wakeup, &event);
+
+  try {
+    for (uint32_t i{0}; i < workers; i++) {
+      m_workers.push_back(std::make_unique<Worker>());
+      Worker &worker = *m_workers.back();
+      worker.thread = std::thread(&Reactor::runWorker, this, std::ref(worker));
+    }
+    m_running = true;
+    m_thread = std::thread(&Reactor::runReactor, this);
+  } catch (...) {
+    m_running = false;
+  }
+}
+
+Reactor::~Reactor()
+{
+  m_running = false;
+  if (m_wakeup >= 0) {
+    uint64_t const one{1};
+    if (0 > ::write(m_wakeup, &one, sizeof(one))) {
+      std::cerr << "[Reactor]: failed to wake up reactor thread." << std::endl;
+    }
+  }
+  if (m_thread.joinable()) {
+    m_thread.join();
+  }
+  for (auto &worker : m_workers) {
+    {
+      std::lock_guard<std::mutex> lock(worker->mutex);
+      worker->running = false;
+    }
+    worker->condition.notify_all();
+    if (worker->thread.joinable()) {
+      worker->thread.join();
+    }
+  }
+  m_workers.clear();
+  m_sources.clear();
+  if (m_wakeup >= 0) {
+    ::close(m_wakeup);
+  }
+  if (m_epoll >= 0) {
+    ::close(m_epoll);
+  }
+}
+
+Reactor &Reactor::shared() noexcept
+{
+  static Reactor reactor{1};
+  return reactor;
+}
+
+int32_t Reactor::joinMulticastGroup(std::string const &group, uint16_t port, Handler handler) noexcept
+{
+  if (!m_running || nullptr == handler) {
+    return -1;
+  }
+  try {
+    auto source = std::make_shared<Source>();
+    source->handler = std::move(handler);
+    source->socket = ::socket(PF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, IPPROTO_UDP);
+    if (source->socket < 0) {
+      return -1;
+    }
+
+    // Same socket setup as cluon::UDPReceiver, so both can share a group.
+    int32_t const yes{1};
+    struct sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = ::inet_addr(group.c_str());
+    address.sin_port = htons(port);
+    source->membership.imr_multiaddr.s_addr = ::inet_addr(group.c_str());
+    source->membership.imr_interface.s_addr = htonl(INADDR_ANY);
+    if (0 > ::setsockopt(source->socket, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes))
+        || 0 > ::bind(source->socket, reinterpret_cast<struct sockaddr *>(&address), sizeof(address))
+        || 0 > ::setsockopt(source->socket, IPPROTO_IP, IP_ADD_MEMBERSHIP, &source->membership, sizeof(source->membership))) {
+      std::cerr << "[Reactor]: failed to join " << group << ":" << port << ": " << std::strerror(errno) << std::endl;
+      return -1;
+    }
+
+    int32_t const id{source->socket};
+    std::lock_guard<std::mutex> lock(m_sourcesMutex);
+    if (!m_workers.empty()) {
+      source->worker = m_nextWorker++ % static_cast<uint32_t>(m_workers.size());
+    }
+    m_sources[id] = source;
+    struct epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.fd = id;
+    if (0 > ::epoll_ctl(m_epoll, EPOLL_CTL_ADD, id, &event)) {
+      m_sources.erase(id);
+      return -1;
+    }
+    return id;
+  } catch (...) {
+    return -1;
+  }
+}
+
+void Reactor::leave(int32_t id) noexcept
+{
+  std::shared_ptr<Source> source;
+  {
+    std::lock_guard<std::mutex> lock(m_sourcesMutex);
+    auto it = m_sources.find(id);
+    if (m_sources.end() == it) {
+      return;
+    }
+    source = it->second;
+    m_sources.erase(it);
+    ::epoll_ctl(m_epoll, EPOLL_CTL_DEL, id, nullptr);
+  }
+  // Queued datagrams still hold the source; they are dropped once it is
+  // inactive, and the socket closes with the last of them.
+  std::lock_guard<std::mutex> lock(source->callMutex);
+  source->active = false;
+}
+
+bool Reactor::isRunning() const noexcept
+{
+  return m_running;
+}
+
+uint32_t Reactor::workerCount() const noexcept
+{
+  return static_cast<uint32_t>(m_workers.size());
+}
+
+std::size_t Reactor::queueDepth() noexcept
+{
+  std::size_t depth{0};
+  for (auto &worker : m_workers) {
+    std::lock_guard<std::mutex> lock(worker->mutex);
+    depth += worker->jobs.size();
+  }
+  return depth;
+}
+
+bool Reactor::setThreadPolicies(ThreadPolicy const &receive, ThreadPolicy const &pipeline) noexcept
+{
+  if (!m_thread.joinable()) {
+    return false;
+  }
+  bool success{applyThreadPolicy(m_thread.native_handle(), receive)};
+  for (auto &worker : m_workers) {
+    success = applyThreadPolicy(worker->thread.native_handle(), pipeline) && success;
+  }
+  return success;
+}
+
+Reactor::Statistics Reactor::statistics() const noexcept
+{
+  Statistics statistics;
+  statistics.wakeups = m_wakeups.load(std::memory_order_relaxed);
+  statistics.datagrams = m_datagrams.load(std::memory_order_relaxed);
+  return statistics;
+}
+
+void Reactor::runReactor() noexcept
+{
+  uint32_t const MAX_EVENTS{16};
+  struct epoll_event events[MAX_EVENTS];
+  std::vector<char> buffer(65535);
+  while (m_running) {
+    int32_t const n{::epoll_wait(m_epoll, events, MAX_EVENTS, -1)};
+    if (n < 0) {
+      if (EINTR == errno) {
+        continue;
+      }
+      std::cerr << "[Reactor]: epoll_wait failed: " << std::strerror(errno) << std::endl;
+      break;
+    }
+    m_wakeups.fetch_add(1, std::memory_order_relaxed);
+    for (int32_t i{0}; i < n; i++) {
+      if (events[i].data.fd == m_wakeup) {
+        uint64_t count;
+        while (0 < ::read(m_wakeup, &count, sizeof(count))) {
+        }
+        continue;
+      }
+      std::shared_ptr<Source> source;
+      {
+        std::lock_guard<std::mutex> lock(m_sourcesMutex);
+        auto it = m_sources.find(events[i].data.fd);
+        if (m_sources.end() != it) {
+          source = it->second;
+        }
+      }
+      if (nullptr != source) {
+        try {
+          readAll(source, buffer.data(), buffer.size());
+        } catch (...) {
+        }
+      }
+    }
+  }
+}
+
+// Drains the socket, as epoll is level-triggered and one wakeup may cover
+// several datagrams.
+void Reactor::readAll(std::shared_ptr<Source> const &source, char *buffer, std::size_t size)
+{
+  TRACE_SCOPE("readFromSocket");
+  while (true) {
+    ssize_t const length{::recv(source->socket, buffer, size, MSG_DONTWAIT)};
+    if (length < 0) {
+      return;
+    }
+    m_datagrams.fetch_add(1, std::memory_order_relaxed);
+    auto const timepoint = std::chrono::system_clock::now();
+    if (m_workers.empty()) {
+      call(*source, std::string(buffer, static_cast<std::size_t>(length)), timepoint);
+      continue;
+    }
+    Worker &worker = *m_workers[source->worker];
+    {
+      std::lock_guard<std::mutex> lock(worker.mutex);
+      worker.jobs.emplace_back();
+      Job &job = worker.jobs.back();
+      job.source = source;
+      job.data.assign(buffer, static_cast<std::size_t>(length));
+      job.timepoint = timepoint;
+    }
+    worker.condition.notify_one();
+  }
+}
+
+void Reactor::runWorker(Worker &worker) noexcept
+{
+  std::vector<Job> jobs;
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(worker.mutex);
+      worker.condition.wait(lock, [&worker]() { return !worker.running || !worker.jobs.empty(); });
+      if (!worker.running) {
+        return;
+      }
+      jobs.swap(worker.jobs);
+    }
+    for (Job &job : jobs) {
+      call(*job.source, job.data, job.timepoint);
+    }
+    jobs.clear();
+  }
+}
+
+void Reactor::call(Source &source, std::string const &data, std::chrono::system_clock::time_point timepoint) noexcept
+{
+  std::lock_guard<std::mutex> lock(source.callMutex);
+  if (source.active) {
+    try {
+      source.handler(data, timepoint);
+    } catch (...) {
+    }
+  }
+}
@@ -0,0 +1,124 @@
+/*
+ * Copyright (C) 2018 Ola Benderius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef REACTOR
+#define REACTOR
+
+#include <netinet/in.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "realtime.hpp"
+
+/*
+ * One epoll thread that reads every UDP socket registered in the process
+ * and hands the datagrams to a fixed pool of worker threads, instead of a
+ * receiver thread per session. Each socket is bound to one worker, so
+ * datagrams of a session are still handled in order; with no workers the
+ * handlers run on the reactor thread itself.
+ */
+class Reactor {
+ private:
+  Reactor(Reactor const &) = delete;
+  Reactor(Reactor &&) = delete;
+  Reactor &operator=(Reactor const &) = delete;
+  Reactor &operator=(Reactor &&) = delete;
+
+ public:
+  using Handler = std::function<void(std::string const &, std::chrono::system_clock::time_point)>;
+
+  struct Statistics {
+    uint64_t wakeups;
+    uint64_t datagrams;
+  };
+
+ public:
+  explicit Reactor(uint32_t = 1) noexcept;
+  ~Reactor();
+
+ public:
+  // Process-wide reactor with one worker, created on first use.
+  static Reactor &shared() noexcept;
+
+  int32_t joinMulticastGroup(std::string const &, uint16_t, Handler) noexcept;
+  // Returns once no handler of the socket is running any more; must not be
+  // called from within that handler.
+  void leave(int32_t) noexcept;
+  bool isRunning() const noexcept;
+  uint32_t workerCount() const noexcept;
+  // Datagrams queued for the workers but not handled yet.
+  std::size_t queueDepth() noexcept;
+  // Applies the policies to the reactor thread and to every worker thread.
+  bool setThreadPolicies(ThreadPolicy const &, ThreadPolicy const &) noexcept;
+  Statistics statistics() const noexcept;
+
+ private:
+  struct Source {
+    int32_t socket{-1};
+    struct ip_mreq membership{};
+    Handler handler{};
+    uint32_t worker{0};
+    std::mutex callMutex{};
+    bool active{true};
+
+    ~Source();
+  };
+
+  struct Job {
+    std::shared_ptr<Source> source{};
+    std::string data{};
+    std::chrono::system_clock::time_point timepoint{};
+  };
+
+  struct Worker {
+    std::mutex mutex{};
+    std::condition_variable condition{};
+    std::vector<Job> jobs{};
+    std::thread thread{};
+    bool running{true};
+  };
+
+ private:
+  void runReactor() noexcept;
+  void runWorker(Worker &) noexcept;
+  void readAll(std::shared_ptr<Source> const &, char *, std::size_t);
+  static void call(Source &, std::string const &, std::chrono::system_clock::time_point) noexcept;
+
+ private:
+  int32_t m_epoll;
+  int32_t m_wakeup;
+  std::atomic<bool> m_running;
+  std::mutex m_sourcesMutex;
+  std::unordered_map<int32_t, std::shared_ptr<Source>> m_sources;
+  std::vector<std::unique_ptr<Worker>> m_workers;
+  uint32_t m_nextWorker;
+  std::thread m_thread;
+  std::atomic<uint64_t> m_wakeups;
+  std::atomic<uint64_t> m_datagrams;
+};
+
+#endif
@@ -0,0 +1,180 @@
+/*
+ * Copyright (C) 2018 Ola Benderius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <sched.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+
+#include "realtime.hpp"
+
+namespace {
+
+// Splits "control:3/receive:2" into a map by role; a value without a role
+// is stored under "".
+std::map<std::string, std::string> splitByRole(std::string const &value)
+{
+  std::map<std::string, std::string> byRole;
+  std::stringstream sstr{value};
+  std::string entry;
+  while (std::getline(sstr, entry, '/')) {
+    std::size_t const colon{entry.find(':')};
+    if (std::string::npos == colon) {
+      byRole[""] = entry;
+    } else {
+      byRole[entry.substr(0, colon)] = entry.substr(colon + 1);
+    }
+  }
+  return byRole;
+}
+
+std::string forRole(std::map<std::string, std::string> const &byRole, std::string const &role)
+{
+  auto it = byRole.find(role);
+  if (byRole.end() == it) {
+    it = byRole.find("");
+  }
+  return (byRole.end() != it) ? it->second : std::string{};
+}
+
+void fillPolicy(ThreadPolicy &policy, std::string const &name, std::string const &cpus, std::string const &priority)
+{
+  // Thread names are limited to 15 characters.
+  policy.name = name.substr(0, 15);
+  policy.cpus = parseCpuList(cpus);
+  policy.priority = priority.empty() ? 0 : std::stoi(priority);
+}
+
+std::size_t const STACK_FRAME_PREFAULT{64 * 1024};
+
+// Touches one byte per page of each 64 KiB frame, recursing until the
+// requested depth of stack has been touched.
+__attribute__((noinline)) void prefaultStack(std::size_t bytes, std::size_t pageSize)
+{
+  volatile char stack[STACK_FRAME_PREFAULT];
+  for (std::size_t i{0}; i < STACK_FRAME_PREFAULT; i += pageSize) {
+    stack[i] = 0;
+  }
+  if (bytes > STACK_FRAME_PREFAULT) {
+    prefaultStack(bytes - STACK_FRAME_PREFAULT, pageSize);
+  }
+  // Using the frame after the call keeps it from becoming a tail call.
+  stack[0] = stack[0];
+}
+
+}
+
+std::vector<uint32_t> parseCpuList(std::string const &list)
+{
+  std::vector<uint32_t> cpus;
+  std::stringstream sstr{list};
+  std::string entry;
+  while (std::getline(sstr, entry, ',')) {
+    if (entry.empty()) {
+      continue;
+    }
+    std::size_t const dash{entry.find('-')};
+    uint32_t const first{static_cast<uint32_t>(std::stoul(entry.substr(0, dash)))};
+    uint32_t const last{(std::string::npos == dash) ? first : static_cast<uint32_t>(std::stoul(entry.substr(dash + 1)))};
+    for (uint32_t cpu{first}; cpu <= last; cpu++) {
+      cpus.push_back(cpu);
+    }
+  }
+  return cpus;
+}
+
+RealtimeOptions parseRealtimeOptions(std::map<std::string, std::string> &commandlineArguments, std::string const &namePrefix)
+{
+  auto const cpus = splitByRole(commandlineArguments["cpu-affinity"]);
+  auto const priorities = splitByRole(commandlineArguments["rt-priority"]);
+
+  RealtimeOptions options;
+  fillPolicy(options.control, namePrefix + "-control", forRole(cpus, "control"), forRole(priorities, "control"));
+  fillPolicy(options.receive, namePrefix + "-receive", forRole(cpus, "receive"), forRole(priorities, "receive"));
+  fillPolicy(options.pipeline, namePrefix + "-pipeline", forRole(cpus, "pipeline"), forRole(priorities, "pipeline"));
+  options.lockMemory = (0 != commandlineArguments.count("mlockall"));
+  return options;
+}
+
+bool applyThreadPolicy(pthread_t thread, ThreadPolicy const &policy) noexcept
+{
+  bool success{true};
+  if (!policy.name.empty()) {
+    ::pthread_setname_np(thread, policy.name.c_str());
+  }
+  if (!policy.cpus.empty()) {
+    cpu_set_t cpuSet;
+    CPU_ZERO(&cpuSet);
+    for (uint32_t cpu : policy.cpus) {
+      CPU_SET(cpu, &cpuSet);
+    }
+    int32_t const error{::pthread_setaffinity_np(thread, sizeof(cpuSet), &cpuSet)};
+    if (0 != error) {
+      std::cerr << "[Realtime]: failed to pin " << policy.name << ": " << std::strerror(error) << std::endl;
+      success = false;
+    }
+  }
+  if (policy.priority > 0) {
+    struct sched_param parameter{};
+    parameter.sched_priority = policy.priority;
+    int32_t const error{::pthread_setschedparam(thread, SCHED_FIFO, &parameter)};
+    if (0 != error) {
+      std::cerr << "[Realtime]: failed to set SCHED_FIFO " << policy.priority << " for " << policy.name << ": " << std::strerror(error) << std::endl;
+      success = false;
+    }
+  }
+  return success;
+}
+
+bool applyThreadPolicy(ThreadPolicy const &policy) noexcept
+{
+  return applyThreadPolicy(::pthread_self(), policy);
+}
+
+bool lockAndPrefaultMemory(std::size_t stackBytes, std::size_t heapBytes) noexcept
+{
+  // Freed memory stays in the heap instead of going back to the kernel, so
+  // prefaulted pages are reused. musl (the alpine images) has no mallopt(),
+  // there mlockall() alone keeps the pages that remain mapped resident.
+#ifdef __GLIBC__
+  ::mallopt(M_TRIM_THRESHOLD, -1);
+  ::mallopt(M_MMAP_MAX, 0);
+#endif
+  if (0 != ::mlockall(MCL_CURRENT | MCL_FUTURE)) {
+    std::cerr << "[Realtime]: mlockall failed: " << std::strerror(errno) << std::endl;
+    return false;
+  }
+
+  std::size_t const pageSize{static_cast<std::size_t>(::sysconf(_SC_PAGESIZE))};
+  prefaultStack(stackBytes, pageSize);
+  char *heap{static_cast<char *>(std::malloc(heapBytes))};
+  if (nullptr != heap) {
+    for (std::size_t i{0}; i < heapBytes; i += pageSize) {
+      heap[i] = 0;
+    }
+    std::free(heap);
+  }
+  return true;
+}
@@ -19,6 +19,7 @@
 #include <iostream>
 
 #include "single-track-model.hpp"
+#include "trace.hpp"
 
 SingleTrackModel::SingleTrackModel() noexcept:
   m_groundSteeringAngleMutex{},
@@ -44,6 +45,28 @@ void SingleTrackModel::setPedalPosition(opendlv::proxy::PedalPositionRequest con
 }
 
 opendlv::sim::KinematicState SingleTrackModel::step(double dt) noexcept
+{
+  TRACE_SCOPE("SingleTrackModel::step");
+  float groundSteeringAngleCopy;
+  float pedalPositionCopy;
+  {
+    std::lock_guard<std::mutex> lock1(m_groundSteeringAngleMutex);
+    std::lock_guard<std::mutex> lock2(m_pedalPositionMutex);
+    groundSteeringAngleCopy = m_groundSteeringAngle;
+    pedalPositionCopy = m_pedalPosition;
+  }
+
+  integrate(m_longitudinalSpeed, m_lateralSpeed, m_yawRate, groundSteeringAngleCopy, pedalPositionCopy, dt);
+
+  opendlv::sim::KinematicState kinematicState;
+  kinematicState.vx(static_cast<float>(m_longitudinalSpeed));
+  kinematicState.vy(static_cast<float>(m_lateralSpeed));
+  kinematicState.yawRate(static_cast<float>(m_yawRate));
+
+  return kinematicState;
+}
+
+void SingleTrackModel::integrate(double &longitudinalSpeed, double &lateralSpeed, double &yawRate, float groundSteeringAngle, float pedalPosition, double dt) noexcept
 {
   double const pedalSpeedGain{0.5};
 
@@ -54,44 +77,28 @@ opendlv::sim::KinematicState SingleTrackModel::step(double dt) noexcept
   double const rearToCog{length - frontToCog};
   double const corneringStiffnessFront{1.0};
   double const corneringStiffnessRear{1.0};
-  
-  float groundSteeringAngleCopy;
-  float pedalPositionCopy;
-  {
-    std::lock_guard<std::mutex> lock1(m_groundSteeringAngleMutex);
-    std::lock_guard<std::mutex> lock2(m_pedalPositionMutex);
-    groundSteeringAngleCopy = m_groundSteeringAngle;
-    pedalPositionCopy = m_pedalPosition;
-  }
 
-  m_longitudinalSpeed = pedalPositionCopy * pedalSpeedGain;
+  longitudinalSpeed = pedalPosition * pedalSpeedGain;
 
-  if (std::abs(m_longitudinalSpeed) > 0.01f) {
-    double const slipAngleFront = groundSteeringAngleCopy 
-      - (m_lateralSpeed + frontToCog * m_yawRate) 
-      / std::abs(m_longitudinalSpeed);
-    double const slipAngleRear = (rearToCog * m_yawRate - m_lateralSpeed) 
-      / std::abs(m_longitudinalSpeed);
+  if (std::abs(longitudinalSpeed) > 0.01f) {
+    double const slipAngleFront = groundSteeringAngle 
+      - (lateralSpeed + frontToCog * yawRate) 
+      / std::abs(longitudinalSpeed);
+    double const slipAngleRear = (rearToCog * yawRate - lateralSpeed) 
+      / std::abs(longitudinalSpeed);
 
     double const lateralSpeedDot = (corneringStiffnessFront * slipAngleFront 
         + corneringStiffnessRear * slipAngleRear)
-      / (mass - m_longitudinalSpeed * m_yawRate);
+      / (mass - longitudinalSpeed * yawRate);
 
     double const yawRateDot = (frontToCog * corneringStiffnessFront * slipAngleFront 
         - rearToCog * corneringStiffnessRear * slipAngleRear)
       / momentOfInertiaZ;
     
-    m_lateralSpeed += lateralSpeedDot * dt;
-    m_yawRate += yawRateDot * dt;
+    lateralSpeed += lateralSpeedDot * dt;
+    yawRate += yawRateDot * dt;
   } else {
-    m_lateralSpeed = 0.0f;
-    m_yawRate = 0.0f;
+    lateralSpeed = 0.0f;
+    yawRate = 0.0f;
   }
-
-  opendlv::sim::KinematicState kinematicState;
-  kinematicState.vx(static_cast<float>(m_longitudinalSpeed));
-  kinematicState.vy(static_cast<float>(m_lateralSpeed));
-  kinematicState.yawRate(static_cast<float>(m_yawRate));
-
-  return kinematicState;
 }
@@ -38,6 +38,8 @@ class SingleTrackModel {
   void setPedalPosition(opendlv::proxy::PedalPositionRequest const &) noexcept;
   opendlv::sim::KinematicState step(double) noexcept;
 
+  static void integrate(double &, double &, double &, float, float, double) noexcept;
+
  private:
   std::mutex m_groundSteeringAngleMutex;
   std::mutex m_pedalPositionMutex;
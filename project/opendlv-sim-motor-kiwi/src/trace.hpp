@@ -0,0 +1,135 @@
+/*
+ * Copyright (C) 2018 Ola Benderius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TRACE
+#define TRACE
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/*
+ * Flight recorder for scoped trace points. Every thread records complete
+ * and instant events into its own ring buffer, overwriting the oldest
+ * events, and the last events of all threads can be written as a Chrome
+ * trace-event JSON file (chrome://tracing, ui.perfetto.dev). Recording is
+ * off until enabled; the trace points themselves are only compiled in when
+ * ENABLE_TRACING is defined (cmake -DTRACING=ON).
+ */
+class Tracer {
+ private:
+  Tracer(Tracer const &) = delete;
+  Tracer(Tracer &&) = delete;
+  Tracer &operator=(Tracer const &) = delete;
+  Tracer &operator=(Tracer &&) = delete;
+
+ public:
+  static uint32_t const RING_SIZE{4096};
+
+ public:
+  Tracer() noexcept;
+  ~Tracer() = default;
+
+ public:
+  static Tracer &instance() noexcept;
+
+  void setEnabled(bool) noexcept;
+  bool isEnabled() const noexcept;
+  // Nanoseconds since the tracer was created.
+  int64_t now() const noexcept;
+
+  // Names are string literals; only the pointer is recorded.
+  void complete(char const *, int64_t, int64_t) noexcept;
+  void instant(char const *) noexcept;
+
+  // Events currently held in the rings of all threads.
+  uint64_t recorded() noexcept;
+  void clear() noexcept;
+  // The events of a thread still writing to its ring may be torn; dump
+  // after the traced threads are stopped for an exact trace.
+  void writeTrace(std::ostream &);
+  bool writeTrace(std::string const &) noexcept;
+
+ private:
+  struct Event {
+    char const *name{nullptr};
+    int64_t begin{0};
+    // Negative for instant events.
+    int64_t duration{0};
+  };
+
+  struct Ring {
+    int64_t threadIdentifier{0};
+    std::string threadName{};
+    std::atomic<uint64_t> head{0};
+    Event events[RING_SIZE];
+  };
+
+ private:
+  Ring *localRing() noexcept;
+  void record(char const *, int64_t, int64_t) noexcept;
+
+ private:
+  std::chrono::steady_clock::time_point const m_epoch;
+  std::atomic<bool> m_enabled;
+  std::mutex m_ringsMutex;
+  std::vector<std::unique_ptr<Ring>> m_rings;
+};
+
+// Records the lifetime of the scope as one complete event.
+class TraceScope {
+ private:
+  TraceScope(TraceScope const &) = delete;
+  TraceScope(TraceScope &&) = delete;
+  TraceScope &operator=(TraceScope const &) = delete;
+  TraceScope &operator=(TraceScope &&) = delete;
+
+ public:
+  explicit TraceScope(char const *name) noexcept:
+    m_name{name},
+    m_begin{Tracer::instance().isEnabled() ? Tracer::instance().now() : -1}
+  {
+  }
+
+  ~TraceScope()
+  {
+    if (m_begin >= 0) {
+      Tracer::instance().complete(m_name, m_begin, Tracer::instance().now());
+    }
+  }
+
+ private:
+  char const *m_name;
+  int64_t const m_begin;
+};
+
+#ifdef ENABLE_TRACING
+#define TRACE_CONCATENATE_(A, B) A##B
+#define TRACE_CONCATENATE(A, B) TRACE_CONCATENATE_(A, B)
+#define TRACE_SCOPE(NAME) TraceScope TRACE_CONCATENATE(traceScope, __LINE__){NAME}
+#define TRACE_INSTANT(NAME) Tracer::instance().instant(NAME)
+#else
+#define TRACE_SCOPE(NAME) static_cast<void>(0)
+#define TRACE_INSTANT(NAME) static_cast<void>(0)
+#endif
+
+#endif
@@ -0,0 +1,130 @@
+/*
+ * Copyright (C) 2018 Ola Benderius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "catch.hpp"
+
+#include "benchmark-comparison.hpp"
+
+namespace {
+
+std::string resultFile(std::string const &libcluon, std::vector<std::pair<std::string, double>> const &runs)
+{
+  std::ostringstream out;
+  out << "{\"context\": {\"libcluon\": \"" << libcluon << "\", \"num_cpus\": 1}, \"benchmarks\": [";
+  for (std::size_t i{0}; i < runs.size(); i++) {
+    out << ((0 == i) ? "" : ",") << "{\"name\": \"" << runs[i].first << "\", \"run_type\": \"iteration\", "
+      << "\"iterations\": 1000, \"real_time\": " << runs[i].second << ", \"time_unit\": \"us\"}";
+  }
+  out << ", {\"name\": \"Behavior/step_median\", \"run_type\": \"aggregate\", \"real_time\": 1e9, \"time_unit\": \"ns\"}]}";
+  return out.str();
+}
+
+}
+
+TEST_CASE("Test benchmark comparison, result files are read per repetition in nanoseconds.") {
+  BenchmarkResults results;
+  std::string error;
+  std::istringstream in{resultFile("cluon-complete-v0.0.65.hpp", {{"Behavior/step", 0.15}, {"Behavior/step", 0.25}, {"Proto/encode \\\"x\\\"", 1.0}})};
+  REQUIRE(readBenchmarkResults(in, results, error));
+  REQUIRE(results.context.at("libcluon") == "cluon-complete-v0.0.65.hpp");
+  REQUIRE(results.context.at("num_cpus") == "1");
+  REQUIRE(results.samples.size() == 2);
+  REQUIRE(results.samples.at("Behavior/step").size() == 2);
+  REQUIRE(results.samples.at("Behavior/step")[1] == Approx(250.0));
+  REQUIRE(results.samples.at("Proto/encode \"x\"")[0] == Approx(1000.0));
+
+  std::istringstream broken{"{\"benchmarks\": [ {\"name\": 1,"};
+  REQUIRE_FALSE(readBenchmarkResults(broken, results, error));
+  REQUIRE_FALSE(error.empty());
+}
+
+TEST_CASE("Test benchmark comparison, median, interval and Mann-Whitney U test.") {
+  REQUIRE(median({3.0, 1.0, 2.0}) == Approx(2.0));
+  REQUIRE(median({4.0, 1.0, 2.0, 3.0}) == Approx(2.5));
+
+  std::vector<double> values;
+  for (int32_t i{1}; i <= 20; i++) {
+    values.push_back(static_cast<double>(i));
+  }
+  // For n = 20 the 95 % interval of the median spans x(6) to x(15).
+  Interval const interval{medianInterval(values, 0.95)};
+  REQUIRE(interval.low == Approx(6.0));
+  REQUIRE(interval.high == Approx(15.0));
+
+  std::vector<double> const a{10.0, 11.0, 12.0, 13.0, 14.0, 15.0, 16.0, 17.0};
+  std::vector<double> const b{20.0, 21.0, 22.0, 23.0, 24.0, 25.0, 26.0, 27.0};
+  REQUIRE(mannWhitneyPValue(a, b) < 0.01);
+  REQUIRE(mannWhitneyPValue(a, a) > 0.9);
+  REQUIRE(mannWhitneyPValue({1.0}, b) == Approx(1.0));
+
+  // Exact for small samples: 2 of the C(8, 4) = 70 splits are as extreme.
+  REQUIRE(mannWhitneyPValue({1.0, 2.0, 3.0, 4.0}, {5.0, 6.0, 7.0, 8.0}) == Approx(2.0 / 70.0));
+  REQUIRE(mannWhitneyPValue({1.0, 2.0, 3.0}, {5.0, 6.0, 7.0}) == Approx(0.1));
+  REQUIRE(mannWhitneyMinimumPValue(3, 3) == Approx(0.1));
+  REQUIRE(mannWhitneyMinimumPValue(4, 4) < 0.05);
+  REQUIRE(mannWhitneyMinimumPValue(1, 10) == Approx(1.0));
+}
+
+TEST_CASE("Test benchmark comparison, only significant gated slowdowns fail.") {
+  BenchmarkResults baseline;
+  baseline.samples["Behavior/step"] = {100.0, 101.0, 99.0, 100.5, 100.2, 99.8};
+  baseline.samples["Loopback/MessageBus round trip"] = {100.0, 101.0, 99.0, 100.5, 100.2, 99.8};
+  baseline.samples["Proto/decode KinematicState"] = {100.0, 150.0, 60.0, 120.0, 80.0, 100.0};
+  BenchmarkResults contender;
+  contender.samples["Behavior/step"] = {120.0, 121.0, 119.0, 120.5, 120.2, 119.8};
+  contender.samples["Loopback/MessageBus round trip"] = {200.0, 201.0, 199.0, 200.5, 200.2, 199.8};
+  contender.samples["Proto/decode KinematicState"] = {110.0, 60.0, 150.0, 90.0, 130.0, 105.0};
+
+  ComparisonCriteria criteria;
+  criteria.gates = {"Behavior/step", "Proto/"};
+  auto const comparisons = compareBenchmarks(baseline, contender, criteria);
+  REQUIRE(comparisons.size() == 3);
+  REQUIRE(comparisons[0].name == "Behavior/step");
+  REQUIRE(comparisons[0].change == Approx(0.2).epsilon(0.01));
+  REQUIRE(comparisons[0].regressed);
+  REQUIRE_FALSE(comparisons[1].gated);
+  REQUIRE_FALSE(comparisons[1].regressed);
+  REQUIRE(comparisons[2].gated);
+  REQUIRE_FALSE(comparisons[2].regressed);
+
+  std::ostringstream report;
+  REQUIRE(writeComparisonReport(report, baseline, contender, comparisons, criteria) == 1);
+  REQUIRE(report.str().find("REGRESSION") != std::string::npos);
+  REQUIRE(report.str().find("1 of 2 gated benchmarks regressed.") != std::string::npos);
+}
+
+TEST_CASE("Test benchmark comparison, too few repetitions for alpha are judged by the threshold.") {
+  BenchmarkResults baseline;
+  baseline.samples["Behavior/step"] = {100.0, 101.0, 99.0};
+  BenchmarkResults contender;
+  contender.samples["Behavior/step"] = {200.0, 202.0, 198.0};
+
+  ComparisonCriteria criteria;
+  auto const comparisons = compareBenchmarks(baseline, contender, criteria);
+  REQUIRE(comparisons.size() == 1);
+  REQUIRE(comparisons[0].pValue == Approx(0.1));
+  REQUIRE_FALSE(comparisons[0].tested);
+  REQUIRE(comparisons[0].regressed);
+
+  std::ostringstream report;
+  REQUIRE(writeComparisonReport(report, baseline, contender, comparisons, criteria) == 1);
+  REQUIRE(report.str().find("WARNING: some gated benchmarks have too few repetitions") != std::string::npos);
+}
@@ -0,0 +1,78 @@
+/*
+ * Copyright (C) 2018 Ola Benderius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "catch.hpp"
+
+#include "cluon-complete.hpp"
+#include "opendlv-standard-message-set.hpp"
+
+#include "fleet.hpp"
+#include "single-track-model.hpp"
+
+TEST_CASE("Test fleet, frame ID lists and ranges are parsed.") {
+  REQUIRE(Fleet::parseFrameIds("0") == std::vector<uint32_t>{0});
+  REQUIRE(Fleet::parseFrameIds("3,1,7") == std::vector<uint32_t>{3, 1, 7});
+  REQUIRE(Fleet::parseFrameIds("2-4,9") == std::vector<uint32_t>{2, 3, 4, 9});
+  REQUIRE(Fleet::parseFrameIds("4294967294-4294967295") == std::vector<uint32_t>{4294967294u, 4294967295u});
+
+  Fleet fleet{Fleet::parseFrameIds("10,11,10")};
+  REQUIRE(fleet.size() == 2);
+  REQUIRE(fleet.find(10) == 0);
+  REQUIRE(fleet.find(11) == 1);
+  REQUIRE(fleet.find(12) == -1);
+}
+
+TEST_CASE("Test fleet, malformed frame ID lists give no vehicles.") {
+  REQUIRE(Fleet::parseFrameIds("").empty());
+  REQUIRE(Fleet::parseFrameIds("x,5").empty());
+  REQUIRE(Fleet::parseFrameIds("-1").empty());
+  REQUIRE(Fleet::parseFrameIds("7x").empty());
+  REQUIRE(Fleet::parseFrameIds("4294967296").empty());
+  REQUIRE(Fleet::parseFrameIds("9-2").empty());
+  REQUIRE(Fleet::parseFrameIds("0,,1").empty());
+  REQUIRE(Fleet::parseFrameIds("0-4000000000").empty());
+  REQUIRE(Fleet::parseFrameIds("0-1023").size() == Fleet::MAX_FRAME_IDS);
+  REQUIRE(Fleet::parseFrameIds("0-1023,2000").empty());
+}
+
+TEST_CASE("Test fleet, every vehicle follows its own requests like a single track model.") {
+  Fleet fleet{Fleet::parseFrameIds("0-49")};
+  SingleTrackModel reference;
+
+  opendlv::proxy::GroundSteeringRequest gsr;
+  gsr.groundSteering(0.3f);
+  reference.setGroundSteeringAngle(gsr);
+  opendlv::proxy::PedalPositionRequest ppr;
+  ppr.position(0.2f);
+  reference.setPedalPosition(ppr);
+
+  int32_t const index{fleet.find(17)};
+  REQUIRE(index >= 0);
+  fleet.setGroundSteeringAngle(static_cast<uint32_t>(index), 0.3f);
+  fleet.setPedalPosition(static_cast<uint32_t>(index), 0.2f);
+
+  for (uint16_t i{0}; i < 100; i++) {
+    opendlv::sim::KinematicState expected = reference.step(0.01);
+    std::vector<opendlv::sim::KinematicState> const &states = fleet.step(0.01);
+    REQUIRE(states.size() == 50);
+    REQUIRE(states[static_cast<uint32_t>(index)].vx() == Approx(expected.vx()));
+    REQUIRE(states[static_cast<uint32_t>(index)].vy() == Approx(expected.vy()));
+    REQUIRE(states[static_cast<uint32_t>(index)].yawRate() == Approx(expected.yawRate()));
+    REQUIRE(states[0].vx() == Approx(0.0f));
+    REQUIRE(states[0].yawRate() == Approx(0.0f));
+  }
+}
@@ -0,0 +1,88 @@
+/*
+ * Copyright (C) 2018 Ola Benderius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <chrono>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "catch.hpp"
+
+#include "logger.hpp"
+
+TEST_CASE("Test logger, records are formatted like printf on the output thread.") {
+  std::ostringstream out;
+  {
+    Logger logger{out};
+    LogSite site{"Steer %6g Pedal %.2f id %u %d%% %s", std::chrono::nanoseconds(0), 1};
+    logger.log(site, 0.25f, 0.5, 7u, -3, "kiwi");
+    logger.flush();
+    REQUIRE(out.str() == "Steer   0.25 Pedal 0.50 id 7 -3% kiwi\n");
+    REQUIRE(logger.written() == 1);
+  }
+
+  Logger::Record record;
+  LogSite mismatched{"%d %f %s", std::chrono::nanoseconds(0), 1};
+  record.site = &mismatched;
+  record.count = 1;
+  record.arguments[0].type = Logger::Argument::Type::Floating;
+  record.arguments[0].d = 2.75;
+  REQUIRE(Logger::format(record) == "2  ");
+}
+
+TEST_CASE("Test logger, rate limiting and sampling count the suppressed calls.") {
+  std::ostringstream out;
+  Logger logger{out};
+  LogSite sampled{"sampled %d", std::chrono::nanoseconds(0), 4};
+  for (int32_t i{0}; i < 10; i++) {
+    logger.log(sampled, i);
+  }
+  LogSite limited{"limited %d", std::chrono::hours(1), 1};
+  for (int32_t i{0}; i < 10; i++) {
+    logger.log(limited, i);
+  }
+  logger.flush();
+  REQUIRE(out.str() == "sampled 0\nsampled 4 [suppressed 3]\nsampled 8 [suppressed 3]\nlimited 0\n");
+}
+
+TEST_CASE("Test logger, every thread writes to its own ring and a full ring drops.") {
+  std::ostringstream out;
+  Logger logger{out, std::chrono::milliseconds(10000)};
+  LogSite site{"%d %d", std::chrono::nanoseconds(0), 1};
+  std::vector<std::thread> threads;
+  for (int32_t t{0}; t < 4; t++) {
+    threads.emplace_back([&logger, &site, t]() {
+        for (int32_t i{0}; i < 100; i++) {
+          logger.log(site, t, i);
+        }
+      });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  logger.flush();
+  REQUIRE(logger.written() == 400);
+  REQUIRE(logger.dropped() == 0);
+
+  for (int32_t i{0}; i < 5000; i++) {
+    logger.log(site, 0, i);
+  }
+  REQUIRE(logger.dropped() > 0);
+  logger.flush();
+  REQUIRE(logger.written() + logger.dropped() == 5400);
+}
@@ -0,0 +1,177 @@
+/*
+ * Copyright (C) 2018 Ola Benderius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "catch.hpp"
+
+#include "cluon-complete.hpp"
+#include "opendlv-standard-message-set.hpp"
+
+#include "message-bus.hpp"
+
+namespace {
+
+std::string frame(float distance, uint32_t senderStamp)
+{
+  opendlv::proxy::DistanceReading reading;
+  reading.distance(distance);
+  cluon::ToProtoVisitor encoder;
+  reading.accept(encoder);
+  cluon::data::Envelope envelope;
+  envelope.dataType(opendlv::proxy::DistanceReading::ID()).serializedData(encoder.encodedData()).senderStamp(senderStamp);
+  envelope.sent(cluon::time::now());
+  return cluon::serializeEnvelope(std::move(envelope));
+}
+
+}
+
+TEST_CASE("Test message bus, the envelope header is read without decoding the payload.") {
+  std::string const data{frame(1.5f, 4711)};
+  EnvelopeHeader header;
+  REQUIRE(peekEnvelopeHeader(data.data(), data.size(), header));
+  REQUIRE(header.dataType == opendlv::proxy::DistanceReading::ID());
+  REQUIRE(header.senderStamp == 4711);
+  REQUIRE(header.length + 5 == data.size());
+
+  cluon::data::Envelope negative;
+  negative.dataType(-3);
+  std::string const negativeData{cluon::serializeEnvelope(std::move(negative))};
+  REQUIRE(peekEnvelopeHeader(negativeData.data(), negativeData.size(), header));
+  REQUIRE(header.dataType == -3);
+
+  REQUIRE_FALSE(peekEnvelopeHeader(data.data(), data.size() - 1, header));
+  REQUIRE_FALSE(peekEnvelopeHeader(data.data() + 1, data.size() - 1, header));
+}
+
+TEST_CASE("Test message bus, subscriptions are matched on message ID and sender stamp.") {
+  MessageBus bus{249};
+  std::vector<float> front;
+  std::vector<float> any;
+  bus.dataTrigger(opendlv::proxy::DistanceReading::ID(), 0, [&front](cluon::data::Envelope &&envelope) {
+      front.push_back(cluon::extractMessage<opendlv::proxy::DistanceReading>(std::move(envelope)).distance());
+    });
+
+  auto const now = std::chrono::system_clock::now();
+  for (uint32_t i{0}; i < 10; i++) {
+    bus.dispatch(frame(static_cast<float>(i), i % 5), now);
+  }
+  bus.dispatch(std::string{"garbage"}, now);
+  REQUIRE(front.size() == 2);
+  REQUIRE(front[1] == Approx(5.0f));
+
+  MessageBus::Statistics statistics = bus.statistics();
+  REQUIRE(statistics.received == 11);
+  REQUIRE(statistics.delivered == 2);
+  REQUIRE(statistics.skipped == 8);
+  REQUIRE(statistics.skippedBytes > 0);
+  REQUIRE(statistics.malformed == 1);
+
+  bus.dataTrigger(opendlv::proxy::DistanceReading::ID(), [&any](cluon::data::Envelope &&envelope) {
+      any.push_back(static_cast<float>(envelope.senderStamp()));
+    });
+  bus.dispatch(frame(1.0f, 0), now);
+  bus.dispatch(frame(1.0f, 3), now);
+  REQUIRE(front.size() == 3);
+  REQUIRE(any.size() == 1);
+  REQUIRE(any[0] == Approx(3.0f));
+}
+
+TEST_CASE("Test message bus, conflated subscriptions only deliver the newest frame to a busy consumer.") {
+  MessageBus bus{249};
+  std::mutex consumerBusy;
+  std::atomic<uint32_t> calls{0};
+  std::vector<float> received;
+  bus.dataTrigger(opendlv::proxy::DistanceReading::ID(), 0, [&](cluon::data::Envelope &&envelope) {
+      calls++;
+      std::lock_guard<std::mutex> lock(consumerBusy);
+      received.push_back(cluon::extractMessage<opendlv::proxy::DistanceReading>(std::move(envelope)).distance());
+    }, MessageBus::Delivery::Conflate);
+
+  auto const now = std::chrono::system_clock::now();
+  {
+    std::unique_lock<std::mutex> lock(consumerBusy);
+    bus.dispatch(frame(1.0f, 0), now);
+    while (calls < 1) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    for (uint32_t i{2}; i <= 10; i++) {
+      bus.dispatch(frame(static_cast<float>(i), 0), now);
+    }
+  }
+  while (calls < 2) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  std::lock_guard<std::mutex> lock(consumerBusy);
+  REQUIRE(received.size() == 2);
+  REQUIRE(received[0] == Approx(1.0f));
+  REQUIRE(received[1] == Approx(10.0f));
+
+  MessageBus::Statistics statistics = bus.statistics();
+  REQUIRE(statistics.conflated == 10);
+  REQUIRE(statistics.superseded == 8);
+  REQUIRE(statistics.conflationRate() == Approx(0.8));
+}
+
+TEST_CASE("Test message bus, a batch of frames in one datagram is split by the receiver.") {
+  MessageBus bus{249};
+  std::vector<uint32_t> senderStamps;
+  bus.dataTrigger(opendlv::proxy::DistanceReading::ID(), [&senderStamps](cluon::data::Envelope &&envelope) {
+      senderStamps.push_back(envelope.senderStamp());
+    });
+
+  EnvelopeBatch batch;
+  for (uint32_t i{0}; i < 3; i++) {
+    opendlv::proxy::DistanceReading reading;
+    reading.distance(static_cast<float>(i));
+    batch.add(reading, cluon::data::TimeStamp(), i);
+  }
+  opendlv::proxy::VoltageReading voltage;
+  batch.add(voltage);
+  REQUIRE(batch.size() == 4);
+
+  bus.dispatch(batch.data(), std::chrono::system_clock::now());
+  REQUIRE(senderStamps == std::vector<uint32_t>{0, 1, 2});
+
+  std::string truncated{batch.data()};
+  truncated.pop_back();
+  bus.dispatch(truncated, std::chrono::system_clock::now());
+  REQUIRE(senderStamps.size() == 6);
+
+  MessageBus::Statistics statistics = bus.statistics();
+  REQUIRE(statistics.datagrams == 2);
+  REQUIRE(statistics.received == 8);
+  REQUIRE(statistics.delivered == 6);
+  REQUIRE(statistics.skipped == 1);
+  REQUIRE(statistics.malformed == 1);
+}
+
+TEST_CASE("Test message bus, batches are only packed into one datagram on request.") {
+  MessageBus bus{249};
+  EnvelopeBatch batch;
+  opendlv::proxy::GroundSteeringRequest gsr;
+  opendlv::proxy::PedalPositionRequest ppr;
+  batch.add(gsr);
+  batch.add(ppr);
+
+  REQUIRE(bus.sendBatch(batch) == 2);
+  bus.setPackedBatches(true);
+  REQUIRE(bus.sendBatch(batch) == 1);
+}
@@ -0,0 +1,128 @@
+/*
+ * Copyright (C) 2018 Ola Benderius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "catch.hpp"
+
+#include "cluon-complete.hpp"
+
+#include "message-bus.hpp"
+#include "reactor.hpp"
+
+namespace {
+
+uint32_t threadCount()
+{
+  std::ifstream status{"/proc/self/status"};
+  std::string line;
+  while (std::getline(status, line)) {
+    if (0 == line.find("Threads:")) {
+      return static_cast<uint32_t>(std::stoul(line.substr(8)));
+    }
+  }
+  return 0;
+}
+
+template <typename Predicate>
+bool waitFor(Predicate predicate)
+{
+  for (uint32_t i{0}; i < 200 && !predicate(); i++) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  }
+  return predicate();
+}
+
+}
+
+TEST_CASE("Test reactor, datagrams of a group are handled in order until it is left.") {
+  Reactor reactor{2};
+  std::mutex receivedMutex;
+  std::vector<std::string> received;
+  int32_t const id{reactor.joinMulticastGroup("225.0.0.241", 12175,
+      [&receivedMutex, &received](std::string const &data, std::chrono::system_clock::time_point) {
+        std::lock_guard<std::mutex> lock(receivedMutex);
+        received.push_back(data);
+      })};
+  REQUIRE(id >= 0);
+
+  cluon::UDPSender sender{"225.0.0.241", 12175};
+  for (uint32_t i{0}; i < 10; i++) {
+    sender.send(std::to_string(i));
+  }
+  REQUIRE(waitFor([&receivedMutex, &received]() {
+        std::lock_guard<std::mutex> lock(receivedMutex);
+        return received.size() == 10;
+      }));
+  for (uint32_t i{0}; i < 10; i++) {
+    REQUIRE(received[i] == std::to_string(i));
+  }
+  REQUIRE(reactor.statistics().datagrams == 10);
+
+  reactor.leave(id);
+  sender.send("late");
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  std::lock_guard<std::mutex> lock(receivedMutex);
+  REQUIRE(received.size() == 10);
+}
+
+TEST_CASE("Test reactor, without workers handlers run on the reactor thread.") {
+  Reactor reactor{0};
+  REQUIRE(reactor.workerCount() == 0);
+  std::atomic<uint32_t> count{0};
+  std::thread::id handlerThread;
+  int32_t const id{reactor.joinMulticastGroup("225.0.0.242", 12175,
+      [&count, &handlerThread](std::string const &, std::chrono::system_clock::time_point) {
+        handlerThread = std::this_thread::get_id();
+        count++;
+      })};
+  REQUIRE(id >= 0);
+
+  cluon::UDPSender sender{"225.0.0.242", 12175};
+  sender.send("ping");
+  REQUIRE(waitFor([&count]() { return count == 1; }));
+  REQUIRE(handlerThread != std::this_thread::get_id());
+  reactor.leave(id);
+}
+
+TEST_CASE("Test reactor, eight message buses share the reactor threads.") {
+  Reactor reactor{2};
+  uint32_t const before{threadCount()};
+
+  std::atomic<uint32_t> delivered{0};
+  std::vector<std::unique_ptr<MessageBus>> buses;
+  for (uint16_t cid{230}; cid < 238; cid++) {
+    buses.push_back(std::make_unique<MessageBus>(cid, reactor));
+    REQUIRE(buses.back()->isRunning());
+    buses.back()->dataTrigger(cluon::data::TimeStamp::ID(), [&delivered](cluon::data::Envelope &&) { delivered++; });
+  }
+  REQUIRE(threadCount() == before);
+
+  for (auto &bus : buses) {
+    cluon::data::TimeStamp timeStamp;
+    bus->send(timeStamp);
+  }
+  REQUIRE(waitFor([&delivered]() { return delivered == 8; }));
+  REQUIRE(threadCount() == before);
+}
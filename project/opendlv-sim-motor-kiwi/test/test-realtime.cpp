@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) 2018 Ola Benderius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <pthread.h>
+#include <sched.h>
+
+#include <map>
+#include <string>
+#include <thread>
+
+#include "catch.hpp"
+
+#include "realtime.hpp"
+
+TEST_CASE("Test realtime, CPU lists accept single CPUs and ranges.") {
+  REQUIRE(parseCpuList("").empty());
+  REQUIRE(parseCpuList("2") == std::vector<uint32_t>({2}));
+  REQUIRE(parseCpuList("0,2") == std::vector<uint32_t>({0, 2}));
+  REQUIRE(parseCpuList("0-3,6") == std::vector<uint32_t>({0, 1, 2, 3, 6}));
+}
+
+TEST_CASE("Test realtime, options apply to all threads or per role.") {
+  std::map<std::string, std::string> arguments{{"cpu-affinity", "2-3"}, {"rt-priority", "control:80/receive:70"}, {"mlockall", "1"}};
+  RealtimeOptions const options{parseRealtimeOptions(arguments, "logic")};
+  REQUIRE(options.lockMemory);
+  REQUIRE(options.control.name == "logic-control");
+  REQUIRE(options.pipeline.name == "logic-pipeline");
+  REQUIRE(options.control.cpus == std::vector<uint32_t>({2, 3}));
+  REQUIRE(options.receive.cpus == std::vector<uint32_t>({2, 3}));
+  REQUIRE(options.pipeline.cpus == std::vector<uint32_t>({2, 3}));
+  REQUIRE(options.control.priority == 80);
+  REQUIRE(options.receive.priority == 70);
+  REQUIRE(options.pipeline.priority == 0);
+
+  std::map<std::string, std::string> none;
+  RealtimeOptions const defaults{parseRealtimeOptions(none, "a-rather-long-prefix")};
+  REQUIRE_FALSE(defaults.lockMemory);
+  REQUIRE(defaults.control.cpus.empty());
+  REQUIRE(defaults.control.priority == 0);
+  REQUIRE(defaults.control.name.size() == 15);
+}
+
+TEST_CASE("Test realtime, a thread is named and pinned.") {
+  ThreadPolicy policy;
+  policy.name = "test-pinned";
+  policy.cpus = {0};
+
+  std::string name;
+  int32_t cpuCount{0};
+  bool onCpuZero{false};
+  bool applied{false};
+  std::thread thread{[&]() {
+      applied = applyThreadPolicy(policy);
+      char buffer[16];
+      ::pthread_getname_np(::pthread_self(), buffer, sizeof(buffer));
+      name = buffer;
+      cpu_set_t cpuSet;
+      ::pthread_getaffinity_np(::pthread_self(), sizeof(cpuSet), &cpuSet);
+      cpuCount = CPU_COUNT(&cpuSet);
+      onCpuZero = CPU_ISSET(0, &cpuSet);
+    }};
+  thread.join();
+  REQUIRE(applied);
+  REQUIRE(name == "test-pinned");
+  REQUIRE(cpuCount == 1);
+  REQUIRE(onCpuZero);
+}